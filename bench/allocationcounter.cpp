@@ -0,0 +1,61 @@
+/* ---------------------------------------------------------------- *\
+ * allocationcounter.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Replaces the global operator new with one that counts every call
+ * in Profiler::ALLOCATIONS and hands it to malloc. Only the
+ * benchmark links this, so the game and tools keep the standard
+ * allocator and their ALLOCATIONS counter stays at 0.
+ *
+ * Every form that can reach the global allocator is defined here, so
+ * none mixes the replacement with the library's own. The nothrow
+ * forms call these by the standard's definition, and the aligned
+ * forms are left alone as a pair.
+\* ---------------------------------------------------------------- */
+
+#include "profiler.hpp"
+
+#include <cstdlib>
+#include <new>
+
+
+void *operator new(std::size_t size)
+{
+  Anthrax::Profiler::addCounter(Anthrax::Profiler::ALLOCATIONS, 1);
+  void *pointer = malloc(size > 0 ? size : 1);
+  if (pointer == nullptr) throw std::bad_alloc();
+  return pointer;
+}
+
+
+void *operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+
+void operator delete(void *pointer) noexcept
+{
+  free(pointer);
+}
+
+
+void operator delete[](void *pointer) noexcept
+{
+  free(pointer);
+}
+
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+  free(pointer);
+}
+
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+  free(pointer);
+}
@@ -0,0 +1,1145 @@
+/* ---------------------------------------------------------------- *\
+ * roxel_bench.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Headless world streaming benchmark. Generates (or reuses) a
+ * synthetic world, then replays a scripted camera path through
+ * World without a window or GL context, reporting the time spent in
+ * each step of World::loadAreaRecursive along with node and cube
+ * counts. The workload is fully deterministic - the node/cube
+ * counts and the checksum printed at the end only change when the
+ * streaming behavior changes, so they can be used to gate
+ * regressions alongside the timings.
+ *
+ * With --load-test, it instead measures how long it takes to load
+ * every zone in the world through ZoneStore, first after evicting
+ * the world's files from the page cache and then again warm. Run it
+ * on a world before and after roxel_worldgen pack to compare the
+ * per-zone and region archive layouts.
+ *
+ * Usage: roxel_bench [--dir DIR] [--generate] [--seed N]
+ *                    [--radius ZONES] [--steps N] [--csv FILE]
+ *                    [--load-test] [--zone-cache-mb MB] [--oscillate]
+ *                    [--lod-budget N] [--lod-quality PRESET]
+ *                    [--stream-us MICROSECONDS]
+ *                    [--svo-image FILE | --raycast-image FILE]
+ *                    [--svo-camera FRAME] [--collision-test]
+ *                    [--edit-test] [--scan-bench] [--brick-layer N]
+ *                    [--no-svo-dag] [--pyramid-depth N]
+ *                    [--memory-budget-mb MB]
+ *
+ * With --svo-image, it instead builds the linear SVO the RAYTRACED
+ * render mode draws and ray casts it on the CPU into FILE (a PPM in
+ * Svo's debug palette). --svo-camera takes the camera and image size
+ * from a frame the game dumped with F4 and reports how many pixels
+ * differ from it, which is how the GPU paths are checked against the
+ * CPU reference. It also reports how many of the SVO's blocks of 8
+ * children were shared with an identical one (see svo.hpp) - with
+ * --no-svo-dag none are.
+ *
+ * --raycast-image does the same through Raycaster, straight over the
+ * octree, timing single rays against packets on one and on every
+ * thread, and checks that both agree with each other and with the SVO.
+ *
+ * --collision-test times VoxelCollider queries for a player's hitbox
+ * standing at a few distances ahead of the camera under each LOD
+ * preset up to --lod-quality, along with how many solid boxes each
+ * query had to test.
+ *
+ * --edit-test copies the world and makes a few thousand voxel edits
+ * per step near the camera, timing how long applying them and
+ * rebuilding the affected cubes takes, then checks every edited
+ * voxel both in the loaded tree and, once the writes have landed,
+ * from a fresh World reading the copy back from disk. A copy taken
+ * before the zones were written (as a crash would leave it) is
+ * checked too, with every edit coming from its journal.
+ *
+ * --scan-bench times the run length search VoxelSet splits with (see
+ * runscan.hpp), on its own and as the searches that split a node into
+ * its quadrants, once per SIMD kernel the CPU has. The runs are the
+ * world's own zones and synthetic noise of a few run lengths, and
+ * every kernel has to agree with the scalar one. Splitting only views
+ * the runs, so it fails if that allocates.
+ *
+ * --brick-layer sets the layer near-field nodes stop splitting at and
+ * hold their voxels as a dense brick instead (see brick.hpp), 0 to
+ * split all the way down to single voxels as before.
+ *
+ * --pyramid-depth sets how many layers under each zone's node its LOD
+ * pyramid covers (see zonepyramid.hpp). A world's pyramids are built
+ * before the run if they aren't already, so every run reads the same
+ * zones.
+ *
+ * --memory-budget-mb keeps the loaded tree and the zone cache within
+ * MB (see residency.hpp), reporting the peak resident bytes, how many
+ * subtrees were paged out and splits held back, and whether the bytes
+ * tracked as nodes change match a count from scratch.
+ *
+ * --cube-threads sets how many threads World::getCubes builds cubes
+ * on (see Octree::getCubes), 1 to build them all on the main thread.
+ * The cubes built are the same whatever it is.
+ *
+ * Every step reports how many times it called the global allocator
+ * (Profiler::ALLOCATIONS, counted by allocationcounter.cpp, which
+ * only the bench links). After the last step the camera stays put
+ * for a few more frames, and once the tree has nothing left to do
+ * those should allocate nothing.
+\* ---------------------------------------------------------------- */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include "profiler.hpp"
+#include "World/world.hpp"
+#include "World/runscan.hpp"
+#include "World/worldgenerator.hpp"
+#include "World/zoneindex.hpp"
+#include "World/zonestore.hpp"
+
+struct BenchOptions
+{
+  std::string directory = "bench_world";
+  bool force_generate = false;
+  uint32_t seed = 1;
+  int radius = 2; // Zones generated in each horizontal direction from the origin
+  int num_steps = 64;
+  uint64_t zone_cache_mb = 256;
+  bool oscillate = false; // Jump back and forth across the zones' LOD boundary instead of sweeping
+  unsigned int lod_budget = 0; // Splits and merges per frame, 0 for unlimited
+  std::string lod_quality = "medium"; // A ScreenSpaceLodPolicy preset, or "distance" for DistanceLodPolicy
+  uint64_t stream_us = 0; // Refine through World::streamLod with this time budget per step instead of updateLod
+  std::string svo_image = "";
+  std::string svo_camera = ""; // A frame.ppm written by the game
+  std::string raycast_image = "";
+  bool collision_test = false;
+  bool edit_test = false;
+  bool scan_bench = false;
+  bool svo_dag = true; // Share identical SVO subtrees
+  int brick_layer = -1; // Octree's default if negative
+  int pyramid_depth = -1; // ZoneStore's default if negative
+  uint64_t memory_budget_mb = 0; // 0 for no budget
+  unsigned int cube_threads = 0; // One per core if 0
+  std::string csv_file = "";
+  bool load_test = false;
+};
+
+struct StepResult
+{
+  Anthrax::vec3<int64_t> position;
+  double load_area_us;
+  double neighbors_us;
+  double cubes_us;
+  uint64_t nodes_loaded;
+  uint64_t cubes_created;
+  uint64_t zone_files_read;
+  uint64_t zone_cache_hits;
+  uint64_t lod_splits;
+  uint64_t lod_merges;
+  uint64_t lod_deferred;
+  uint64_t allocations;
+  uint64_t num_nodes;
+  uint64_t num_cubes;
+};
+
+
+static double elapsedMicroseconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+static long peakMemoryKB()
+{
+#ifndef WIN32
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+#else
+  return -1;
+#endif
+}
+
+
+static void writeVoxelMap(std::string filepath)
+{
+  std::ofstream file(filepath);
+  file << "{\n"
+       << "  \"1\": {\"color\": [0.2, 0.6, 0.2], \"reflectivity\": 0.1, \"shininess\": 0.1, \"opacity\": 1.0},\n"
+       << "  \"2\": {\"color\": [0.4, 0.3, 0.2], \"reflectivity\": 0.1, \"shininess\": 0.1, \"opacity\": 1.0},\n"
+       << "  \"3\": {\"color\": [0.5, 0.5, 0.5], \"reflectivity\": 0.3, \"shininess\": 0.2, \"opacity\": 1.0}\n"
+       << "}\n";
+}
+
+
+static void generateWorld(BenchOptions &options, ZoneAddress zone_address)
+{
+  std::filesystem::create_directories(options.directory + "/world");
+  writeVoxelMap(options.directory + "/voxelmap.json");
+
+  WorldGenerator generator(options.seed, zone_address);
+  ZoneIndex zone_index;
+  int64_t width = zone_address.getZoneWidth();
+  int num_zones = 0;
+  for (int zone_x = -options.radius; zone_x < options.radius; zone_x++)
+  {
+    for (int zone_y = -1; zone_y <= 0; zone_y++)
+    {
+      for (int zone_z = -options.radius; zone_z < options.radius; zone_z++)
+      {
+        std::string path = zone_address.pathFromPosition(Anthrax::vec3<int64_t>(zone_x*width, zone_y*width, zone_z*width));
+        VoxelSet voxel_set = generator.generateZone(path);
+        voxel_set.writeFile(options.directory + "/world/" + path + ".zn");
+        zone_index.insert(path, 0, 6*voxel_set.getNumRuns(), voxel_set.isUniform(), voxel_set.getVoxelType());
+        num_zones++;
+      }
+    }
+  }
+  zone_index.writeFile(options.directory + "/world/zones.idx");
+  std::filesystem::remove(options.directory + "/world/zones.lod"); // Built from the old zones
+  std::cout << "Generated " << num_zones << " zones in " << options.directory << "/world" << std::endl;
+}
+
+
+// Best effort - asks the kernel to drop the cached pages of every file in the directory
+static bool evictPageCache(std::string directory)
+{
+#ifndef WIN32
+  for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(directory))
+  {
+    if (!entry.is_regular_file()) continue;
+    int fd = open(entry.path().c_str(), O_RDONLY);
+    if (fd < 0) continue;
+    fdatasync(fd); // Dirty pages can't be dropped
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+static void loadAllZones(std::string directory, ZoneAddress zone_address, std::string label)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  ZoneStore zone_store;
+  zone_store.open(directory, zone_address);
+  double open_us = elapsedMicroseconds(start);
+
+  ZoneIndex &zone_index = zone_store.getIndex();
+  uint64_t num_bytes = 0, num_runs = 0;
+  unsigned int num_archived = 0;
+  start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < zone_index.size(); i++)
+  {
+    const ZoneIndex::Entry &entry = zone_index.getEntry(i);
+    VoxelSet voxel_set = zone_store.loadZone(ZoneIndex::pathFromKey(entry.key, zone_address.getPathLength()));
+    num_runs += voxel_set.getNumRuns();
+    if (!entry.isUniform()) num_bytes += entry.size;
+    if (entry.isArchived()) num_archived++;
+  }
+  double load_us = elapsedMicroseconds(start);
+
+  std::cout << std::fixed << std::setprecision(1) << label << ": opened index in " << open_us / 1000.0 << " ms, loaded "
+            << zone_index.size() << " zones (" << num_archived << " archived, " << num_bytes / 1024 << " KB, " << num_runs << " runs) in "
+            << load_us / 1000.0 << " ms - " << load_us / std::max(1u, zone_index.size()) << " us/zone, "
+            << (num_bytes / 1048576.0) / (load_us / 1000000.0) << " MB/s" << std::endl;
+}
+
+
+static int loadTest(BenchOptions &options, ZoneAddress zone_address)
+{
+  std::string directory = options.directory + "/world";
+  if (!evictPageCache(directory)) std::cout << "Can't evict the page cache on this platform - the cold run may be warm" << std::endl;
+  loadAllZones(directory, zone_address, "Cold");
+  loadAllZones(directory, zone_address, "Warm");
+  std::cout << "Peak memory: " << peakMemoryKB() << " KB" << std::endl;
+  return 0;
+}
+
+
+// Sets of runs to split, all from one run length distribution
+struct ScanSets
+{
+  std::string name;
+  std::vector<VoxelSet> sets;
+  uint64_t num_runs = 0;
+};
+
+
+// Noise - run lengths are geometric with the given mean, and a run's type always differs from the
+// last one's so none of them would merge
+static ScanSets noiseSets(unsigned int num_sets, int total_num_voxels, double mean_length, uint64_t random)
+{
+  ScanSets scan_sets;
+  std::ostringstream name;
+  name << "noise, mean run " << mean_length;
+  scan_sets.name = name.str();
+  auto next = [&random]()
+  {
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+    return random;
+  };
+  for (unsigned int i = 0; i < num_sets; i++)
+  {
+    std::vector<int> num_voxels;
+    std::vector<uint16_t> voxel_type;
+    int remaining = total_num_voxels;
+    uint16_t type = 0;
+    while (remaining > 0)
+    {
+      double uniform = ((next() >> 11) + 0.5) / 9007199254740992.0;
+      int length = std::min(remaining, 1 + (int)(std::log(uniform) / std::log(1.0 - 1.0 / mean_length)));
+      type = (type + 1 + next() % 3) % 4;
+      num_voxels.push_back(length);
+      voxel_type.push_back(type);
+      remaining -= length;
+    }
+    scan_sets.num_runs += num_voxels.size();
+    scan_sets.sets.push_back(VoxelSet(total_num_voxels, num_voxels, voxel_type));
+  }
+  return scan_sets;
+}
+
+
+// The world's own zones, leaving out the uniform ones since they have nothing to search
+static ScanSets worldSets(std::string directory, ZoneAddress zone_address)
+{
+  ScanSets scan_sets;
+  scan_sets.name = "world zones";
+  ZoneStore zone_store;
+  zone_store.open(directory, zone_address);
+  ZoneIndex &zone_index = zone_store.getIndex();
+  for (unsigned int i = 0; i < zone_index.size(); i++)
+  {
+    const ZoneIndex::Entry &entry = zone_index.getEntry(i);
+    if (entry.isUniform()) continue;
+    VoxelSet voxel_set = zone_store.loadZone(ZoneIndex::pathFromKey(entry.key, zone_address.getPathLength()));
+    if (voxel_set.isUniform()) continue;
+    scan_sets.num_runs += voxel_set.getNumRuns();
+    scan_sets.sets.push_back(voxel_set);
+  }
+  return scan_sets;
+}
+
+
+// Times the split search and the searches Octree does to split a node into its quadrants (see
+// Octree::splitVoxelSet), once per kernel this CPU has, over several run length distributions.
+// Every kernel has to find the same splits, without allocating.
+static int scanBench(BenchOptions &options, ZoneAddress zone_address)
+{
+  const unsigned int num_searches = 256; // Per set
+  std::vector<ScanSets> distributions;
+  distributions.push_back(worldSets(options.directory + "/world", zone_address));
+  // Nodes of 64^3 voxels, from noisy to terrain-like
+  distributions.push_back(noiseSets(32, 1 << 18, 1.5, 88172645463325252ULL));
+  distributions.push_back(noiseSets(32, 1 << 18, 8.0, 2463534242ULL));
+  distributions.push_back(noiseSets(32, 1 << 18, 64.0, 1181783497276652981ULL));
+
+  std::cout << "Best kernel: " << RunScan::getLevelName(RunScan::getBestLevel()) << std::endl;
+  std::cout << std::fixed;
+  bool mismatch = false;
+  bool allocated = false;
+  for (unsigned int d = 0; d < distributions.size(); d++)
+  {
+    ScanSets &scan_sets = distributions[d];
+    if (scan_sets.sets.empty()) continue;
+    std::cout << scan_sets.name << ": " << scan_sets.sets.size() << " sets, " << std::setprecision(0)
+              << (double)scan_sets.num_runs / scan_sets.sets.size() << " runs per set" << std::endl;
+    uint64_t reference_checksum = 0;
+    double reference_split_us = 0.0;
+    for (int level = RunScan::SCALAR; level < RunScan::NUM_LEVELS; level++)
+    {
+      if (!RunScan::setLevel((RunScan::Level)level)) continue;
+      uint64_t checksum = 0;
+      uint64_t runs_scanned = 0;
+      uint64_t random = 88172645463325252ULL;
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      for (unsigned int i = 0; i < scan_sets.sets.size(); i++)
+      {
+        VoxelSet &voxel_set = scan_sets.sets[i];
+        for (unsigned int j = 0; j < num_searches; j++)
+        {
+          random ^= random << 13;
+          random ^= random >> 7;
+          random ^= random << 17;
+          uint32_t index = random % voxel_set.getNumVoxels();
+          checksum = checksum * 31 + voxel_set.getVoxel(index);
+          runs_scanned += voxel_set.getNumRuns();
+        }
+      }
+      double search_us = elapsedMicroseconds(start);
+
+      // Splitting only views the set's runs, so neither it nor handing the quadrants to children
+      // should allocate
+      Anthrax::Profiler::endFrame();
+      start = std::chrono::steady_clock::now();
+      for (unsigned int i = 0; i < scan_sets.sets.size(); i++)
+      {
+        VoxelSet quadrants[8];
+        for (unsigned int j = 0; j < 8; j++) quadrants[j] = scan_sets.sets[i].getQuadrant(j);
+        for (unsigned int j = 0; j < 8; j++)
+        {
+          VoxelSet child = quadrants[j]; // As the child node takes it
+          checksum = checksum * 31 + child.getNumRuns() * 65536 + child.getVoxelType();
+        }
+      }
+      double split_us = elapsedMicroseconds(start);
+      Anthrax::Profiler::endFrame();
+      uint64_t split_allocations = Anthrax::Profiler::getLastFrameCounter(Anthrax::Profiler::ALLOCATIONS);
+      if (split_allocations > 0)
+      {
+        allocated = true;
+        std::cout << "  " << RunScan::getLevelName((RunScan::Level)level) << " allocated " << split_allocations << " times splitting" << std::endl;
+      }
+      // Bisecting into halves and quarters on the way has to find the same quadrants
+      for (unsigned int i = 0; i < scan_sets.sets.size(); i++)
+      {
+        VoxelSet halves[2], quarters[4], quadrants[8];
+        scan_sets.sets[i].bisect(&halves[0], &halves[1]);
+        for (unsigned int j = 0; j < 2; j++) halves[j].bisect(&quarters[2*j], &quarters[2*j + 1]);
+        for (unsigned int j = 0; j < 4; j++) quarters[j].bisect(&quadrants[2*j], &quadrants[2*j + 1]);
+        for (unsigned int j = 0; j < 8; j++)
+        {
+          if (scan_sets.sets[i].getQuadrant(j).toBytes() != quadrants[j].toBytes()) checksum++;
+        }
+      }
+
+      if (level == RunScan::SCALAR)
+      {
+        reference_checksum = checksum;
+        reference_split_us = split_us;
+      }
+      else if (checksum != reference_checksum)
+      {
+        mismatch = true;
+        std::cout << "  " << RunScan::getLevelName((RunScan::Level)level) << " found different splits to scalar" << std::endl;
+      }
+      std::cout << "  " << std::setw(6) << RunScan::getLevelName((RunScan::Level)level) << ": search "
+                << std::setprecision(3) << search_us * 1000.0 / ((double)scan_sets.sets.size() * num_searches) / 1000.0 << " us ("
+                << std::setprecision(2) << search_us * 1000.0 / std::max(runs_scanned, (uint64_t)1) * 2.0 << " ns/run), split into quadrants "
+                << std::setprecision(1) << split_us / scan_sets.sets.size() << " us/set ("
+                << std::setprecision(2) << reference_split_us / split_us << "x scalar)" << std::endl;
+    }
+  }
+  RunScan::setLevel(RunScan::getBestLevel());
+  return (mismatch || allocated) ? 1 : 0;
+}
+
+
+// The scripted camera path - a sweep across the generated area and back at walking height
+static Anthrax::vec3<int64_t> cameraPosition(int step, int num_steps, int64_t extent, bool oscillate)
+{
+  if (oscillate)
+  {
+    // Far enough away on odd steps that every generated zone gets unloaded
+    return Anthrax::vec3<int64_t>((step % 2) * (extent + 6000), 40, 0);
+  }
+  int half = num_steps / 2;
+  int64_t t = (step <= half) ? step : num_steps - step;
+  int64_t x = -extent + (2*extent*t) / (half > 0 ? half : 1);
+  int64_t z = (x / 2) + ((step % 8) - 4);
+  return Anthrax::vec3<int64_t>(x, 40, z);
+}
+
+
+// Looking along the direction of travel
+static Anthrax::vec3<float> cameraDirection(int step, int num_steps, bool oscillate)
+{
+  Anthrax::vec3<float> direction(2.0f, 0.0f, 1.0f);
+  if (oscillate) direction = Anthrax::vec3<float>(1.0f, 0.0f, 0.0f);
+  else if (step > num_steps / 2) direction = -direction;
+  direction.normalize();
+  return direction;
+}
+
+
+// A binary PPM as written by Svo::writeDebugImage, along with its comment line
+static bool readImage(std::string filename, std::string *comment, unsigned int *width, unsigned int *height, std::vector<unsigned char> *pixels)
+{
+  std::ifstream file(filename, std::ios::binary);
+  std::string magic;
+  file >> magic;
+  if (magic != "P6") return false;
+  file >> std::ws;
+  while (file.peek() == '#')
+  {
+    std::string line;
+    std::getline(file, line);
+    *comment = line.substr(1);
+  }
+  unsigned int max_value;
+  file >> *width >> *height >> max_value;
+  file.get();
+  pixels->resize((*width) * (*height) * 3);
+  file.read((char *)pixels->data(), pixels->size());
+  return file.good();
+}
+
+
+struct BenchCamera
+{
+  Anthrax::vec3<double> position;
+  Anthrax::vec3<float> forward;
+  Anthrax::vec3<float> up = Anthrax::vec3<float>(0.0f, 1.0f, 0.0f);
+  float vertical_fov = 0.785398163f;
+  float max_distance = 10000.0f;
+  unsigned int width = 640;
+  unsigned int height = 360;
+};
+
+
+static Anthrax::vec3<int64_t> getCameraVoxel(const BenchCamera &camera)
+{
+  return Anthrax::vec3<int64_t>((int64_t)floor(camera.position.getX()), (int64_t)floor(camera.position.getY()), (int64_t)floor(camera.position.getZ()));
+}
+
+
+// The camera for the image modes - the first step of the scripted path, or the one in the
+// --svo-camera frame (whose pixels go in frame). Settles the LOD around it in one go.
+static bool setUpCamera(BenchOptions &options, World &world, BenchCamera &camera, std::vector<unsigned char> &frame)
+{
+  int64_t extent = options.radius * world.getZoneAddress().getZoneWidth();
+  Anthrax::vec3<int64_t> start = cameraPosition(0, options.num_steps, extent, false);
+  camera.position = Anthrax::vec3<double>(start.getX(), start.getY(), start.getZ());
+  camera.forward = cameraDirection(0, options.num_steps, false);
+  if (!options.svo_camera.empty())
+  {
+    std::string comment;
+    std::istringstream camera_line;
+    std::string label;
+    double x, y, z;
+    float fx, fy, fz, ux, uy, uz;
+    if (!readImage(options.svo_camera, &comment, &camera.width, &camera.height, &frame)) 
+    {
+      std::cout << "Couldn't read " << options.svo_camera << std::endl;
+      return false;
+    }
+    camera_line.str(comment);
+    camera_line >> label >> x >> y >> z >> fx >> fy >> fz >> ux >> uy >> uz >> camera.vertical_fov >> camera.max_distance;
+    if (label != "camera")
+    {
+      std::cout << options.svo_camera << " doesn't have a camera - it should be a frame dumped with F4" << std::endl;
+      return false;
+    }
+    camera.position = Anthrax::vec3<double>(x, y, z);
+    camera.forward = Anthrax::vec3<float>(fx, fy, fz);
+    camera.up = Anthrax::vec3<float>(ux, uy, uz);
+  }
+
+  world.getLodPolicy()->setBudget(LodPolicy::unlimited_, LodPolicy::unlimited_);
+  LodView view = world.getLodPolicy()->getView();
+  view.look_direction = camera.forward;
+  view.vertical_fov = camera.vertical_fov;
+  view.viewport_width = camera.width;
+  view.viewport_height = camera.height;
+  world.getLodPolicy()->setView(view);
+  world.updateLod(getCameraVoxel(camera));
+  return true;
+}
+
+
+// Pixels whose debug colors differ
+static uint64_t countDifferences(const std::vector<Anthrax::SvoHit> &image, const std::vector<unsigned char> &pixels)
+{
+  uint64_t num_different = 0;
+  for (unsigned int i = 0; i < image.size() && 3*i + 2 < pixels.size(); i++)
+  {
+    unsigned char rgb[3];
+    Anthrax::Svo::getDebugColor(image[i], rgb);
+    if (rgb[0] != pixels[3*i] || rgb[1] != pixels[3*i + 1] || rgb[2] != pixels[3*i + 2]) num_different++;
+  }
+  return num_different;
+}
+
+
+static std::vector<unsigned char> toPixels(const std::vector<Anthrax::SvoHit> &image)
+{
+  std::vector<unsigned char> pixels(3 * image.size());
+  for (unsigned int i = 0; i < image.size(); i++)
+  {
+    Anthrax::Svo::getDebugColor(image[i], &pixels[3*i]);
+  }
+  return pixels;
+}
+
+
+static void printDifferences(std::string label, uint64_t num_different, const BenchCamera &camera)
+{
+  uint64_t num_pixels = camera.width * camera.height;
+  std::cout << "Differs from " << label << " at " << num_different << " of " << num_pixels << " pixels ("
+            << std::fixed << std::setprecision(2) << 100.0 * num_different / num_pixels << "%)" << std::endl;
+}
+
+
+static int svoImage(BenchOptions &options, World &world)
+{
+  BenchCamera camera;
+  std::vector<unsigned char> frame;
+  if (!setUpCamera(options, world, camera, frame)) return 1;
+  std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+  world.updateSvo(getCameraVoxel(camera));
+  double build_us = elapsedMicroseconds(time);
+  const Anthrax::Svo &svo = world.getSvo();
+
+  time = std::chrono::steady_clock::now();
+  std::vector<Anthrax::SvoHit> hits = svo.renderReference(camera.position, camera.forward, camera.up, camera.vertical_fov, camera.width, camera.height, camera.max_distance);
+  double render_us = elapsedMicroseconds(time);
+  Anthrax::Svo::writeDebugImage(options.svo_image, camera.width, camera.height, hits, "");
+  std::cout << "SVO: " << svo.getNodes().size() << " nodes (" << svo.getMemoryUsage() / 1024 << " KB), built in "
+            << std::fixed << std::setprecision(1) << build_us / 1000.0 << " ms" << std::endl;
+  std::cout << "Blocks: " << svo.getNumBlocks() << " stored of " << svo.getNumBlocksAdded() << " built, dedup ratio "
+            << std::setprecision(2) << (double)svo.getNumBlocksAdded() / std::max((uint64_t)1, svo.getNumBlocks()) << std::setprecision(1) << std::endl;
+  std::cout << "Reference: " << camera.width << "x" << camera.height << " in " << render_us / 1000.0 << " ms, written to " << options.svo_image << std::endl;
+  if (!frame.empty()) printDifferences(options.svo_camera, countDifferences(hits, frame), camera);
+  return 0;
+}
+
+
+static int raycastImage(BenchOptions &options, World &world)
+{
+  BenchCamera camera;
+  std::vector<unsigned char> frame;
+  if (!setUpCamera(options, world, camera, frame)) return 1;
+  Raycaster raycaster = world.getRaycaster();
+  uint64_t num_pixels = camera.width * camera.height;
+
+  // One ray at a time, as gameplay queries are cast
+  std::vector<Anthrax::vec3<float>> directions = Anthrax::Svo::getPixelDirections(camera.forward, camera.up, camera.vertical_fov, camera.width, camera.height);
+  std::vector<RayHit> single_hits(num_pixels);
+  std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < num_pixels; i++)
+  {
+    Ray ray;
+    ray.origin = camera.position;
+    ray.direction = directions[i];
+    ray.max_distance = camera.max_distance;
+    single_hits[i] = raycaster.castRay(ray);
+  }
+  double single_us = elapsedMicroseconds(time);
+
+  time = std::chrono::steady_clock::now();
+  std::vector<Anthrax::SvoHit> packet_image = raycaster.renderReference(camera.position, camera.forward, camera.up, camera.vertical_fov, camera.width, camera.height, camera.max_distance, 1);
+  double packet_us = elapsedMicroseconds(time);
+  unsigned int num_threads = std::max(1u, std::thread::hardware_concurrency());
+  time = std::chrono::steady_clock::now();
+  std::vector<Anthrax::SvoHit> image = raycaster.renderReference(camera.position, camera.forward, camera.up, camera.vertical_fov, camera.width, camera.height, camera.max_distance, num_threads);
+  double threaded_us = elapsedMicroseconds(time);
+  Anthrax::Svo::writeDebugImage(options.raycast_image, camera.width, camera.height, image, "");
+
+  std::cout << "Ray caster: " << camera.width << "x" << camera.height << " written to " << options.raycast_image << std::endl;
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "  single rays:          " << std::setw(8) << single_us / 1000.0 << " ms (" << std::setprecision(2) << num_pixels / single_us << " Mrays/s)" << std::endl;
+  std::cout << std::setprecision(1);
+  std::cout << "  packets, 1 thread:    " << std::setw(8) << packet_us / 1000.0 << " ms (" << std::setprecision(2) << num_pixels / packet_us << " Mrays/s)" << std::endl;
+  std::cout << std::setprecision(1);
+  std::cout << "  packets, " << std::setw(2) << num_threads << " threads:  " << std::setw(8) << threaded_us / 1000.0 << " ms (" << std::setprecision(2) << num_pixels / threaded_us << " Mrays/s)" << std::endl;
+
+  // The packet path has to agree with single rays exactly, and with the SVO up to rays that
+  // graze an edge
+  uint64_t num_mismatched = 0;
+  for (unsigned int i = 0; i < num_pixels; i++)
+  {
+    if (single_hits[i].hit != image[i].hit || single_hits[i].type != image[i].type || single_hits[i].face != image[i].face) num_mismatched++;
+  }
+  std::cout << "Single rays and packets disagree at " << num_mismatched << " pixels" << std::endl;
+  world.updateSvo(getCameraVoxel(camera));
+  std::vector<Anthrax::SvoHit> svo_image = world.getSvo().renderReference(camera.position, camera.forward, camera.up, camera.vertical_fov, camera.width, camera.height, camera.max_distance);
+  printDifferences("the SVO reference", countDifferences(image, toPixels(svo_image)), camera);
+  if (!frame.empty()) printDifferences(options.svo_camera, countDifferences(image, frame), camera);
+  return 0;
+}
+
+
+// Collision queries for a player-sized hitbox standing on the terrain at a few distances ahead
+// of the camera, under each LOD preset up to --lod-quality - further out the tree is coarser, so
+// each query tests fewer, bigger boxes
+static int collisionTest(BenchOptions &options, World &world)
+{
+  const std::string presets[4] = {"low", "medium", "high", "ultra"};
+  ScreenSpaceLodPolicy::Quality max_quality = ScreenSpaceLodPolicy::qualityFromString(options.lod_quality);
+  const double distances[4] = {0.0, 128.0, 512.0, 1024.0};
+  const double hitbox_size[3] = {16.0, 64.0, 8.0}; // PlayerSettings' defaults
+  const double step_motion[3] = {0.5, -0.5, 0.25}; // Walking and falling, for one 120 Hz physics step
+  const unsigned int num_spots = 32;
+  const unsigned int num_repeats = 200;
+
+  std::cout << std::setw(8) << "quality" << std::setw(10) << "distance" << std::setw(8) << "spots" << std::setw(14) << "boxes/query"
+            << std::setw(14) << "move(kq/s)" << std::setw(16) << "overlap(kq/s)" << std::setw(10) << "stuck" << std::endl;
+  for (unsigned int p = 0; p < 4 && ScreenSpaceLodPolicy::qualityFromString(presets[p]) <= max_quality; p++)
+  {
+    world.setLodPolicy(std::make_shared<ScreenSpaceLodPolicy>(ScreenSpaceLodPolicy::qualityFromString(presets[p])));
+    BenchCamera camera;
+    std::vector<unsigned char> frame;
+    if (!setUpCamera(options, world, camera, frame)) return 1;
+    Raycaster raycaster = world.getRaycaster();
+    VoxelCollider collider = world.getCollider();
+    double side[2] = {-camera.forward.getZ(), camera.forward.getX()};
+
+    for (unsigned int d = 0; d < 4; d++)
+    {
+      // Stand a hitbox on the ground at each spot along a line across the view
+      std::vector<CollisionBox> hitboxes;
+      for (unsigned int i = 0; i < num_spots; i++)
+      {
+        double lateral = 8.0 * ((double)i - num_spots / 2.0);
+        Ray ray;
+        ray.origin = Anthrax::vec3<double>(camera.position.getX() + camera.forward.getX() * distances[d] + side[0] * lateral, 1024.0,
+                                           camera.position.getZ() + camera.forward.getZ() * distances[d] + side[1] * lateral);
+        ray.direction = Anthrax::vec3<float>(0.0f, -1.0f, 0.0f);
+        ray.max_distance = 4096.0f;
+        RayHit hit = raycaster.castRay(ray);
+        if (!hit.hit) continue;
+        double position[3] = {ray.origin.getX(), 1024.0 - hit.distance + VoxelCollider::skin_, ray.origin.getZ()};
+        CollisionBox hitbox;
+        for (unsigned int a = 0; a < 3; a++)
+        {
+          hitbox.min[a] = (a == 1) ? position[a] : position[a] - hitbox_size[a] / 2.0;
+          hitbox.max[a] = hitbox.min[a] + hitbox_size[a];
+        }
+        hitboxes.push_back(hitbox);
+      }
+      if (hitboxes.empty()) continue;
+
+      uint64_t num_boxes = 0;
+      uint64_t num_stuck = 0; // Moves that ended up inside something they didn't start in
+      std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+      for (unsigned int r = 0; r < num_repeats; r++)
+      {
+        for (unsigned int i = 0; i < hitboxes.size(); i++)
+        {
+          CollisionMove move = collider.move(hitboxes[i], step_motion);
+          num_boxes += move.num_boxes;
+          if (r == 0)
+          {
+            CollisionBox moved = hitboxes[i];
+            for (unsigned int a = 0; a < 3; a++)
+            {
+              moved.min[a] += move.offset[a];
+              moved.max[a] += move.offset[a];
+            }
+            if (collider.overlapsSolid(moved) && !collider.overlapsSolid(hitboxes[i])) num_stuck++;
+          }
+        }
+      }
+      double move_us = elapsedMicroseconds(time);
+      time = std::chrono::steady_clock::now();
+      for (unsigned int r = 0; r < num_repeats; r++)
+      {
+        for (unsigned int i = 0; i < hitboxes.size(); i++)
+        {
+          collider.overlapsSolid(hitboxes[i]);
+        }
+      }
+      double overlap_us = elapsedMicroseconds(time);
+
+      uint64_t num_queries = (uint64_t)num_repeats * hitboxes.size();
+      std::cout << std::setw(8) << presets[p] << std::setw(10) << std::fixed << std::setprecision(0) << distances[d] << std::setw(8) << hitboxes.size()
+                << std::setw(14) << std::setprecision(1) << (double)num_boxes / num_queries
+                << std::setw(14) << std::setprecision(0) << num_queries / move_us * 1000.0
+                << std::setw(16) << num_queries / overlap_us * 1000.0 << std::setw(10) << num_stuck << std::endl;
+    }
+  }
+  return 0;
+}
+
+
+// Edits near the camera, a few thousand voxels a step, timed the way a frame would do them - then
+// every edited voxel is read back, from the tree, from disk and from a crashed copy's journal
+static int editTest(BenchOptions &options)
+{
+  const std::string directory = "edit_world"; // A copy, so the bench's world stays as generated
+  const std::string crash_directory = "edit_world_crash"; // edit_world as a crash would have left it
+  const unsigned int num_points = 2048; // Single voxels per step
+  const unsigned int num_boxes = 4; // 8x8x8 boxes per step
+  const int64_t region_width = 64;
+  int num_steps = std::min(options.num_steps, 16);
+
+  std::filesystem::remove_all(directory);
+  std::filesystem::remove_all(crash_directory);
+  std::filesystem::copy("world", directory, std::filesystem::copy_options::recursive);
+  std::map<std::array<int64_t, 3>, uint16_t> expected; // Final type of every voxel edited
+  double apply_us[2] = {0.0, 0.0}; // Total, max
+  double redraw_us[2] = {0.0, 0.0};
+  uint64_t nodes_edited = 0;
+  uint64_t cubes_created = 0;
+  uint64_t zones_written = 0;
+  double idle_us;
+  double commit_us;
+  double flush_us;
+  uint64_t journal_commits;
+  uint64_t journal_size;
+  unsigned int num_wrong = 0;
+  {
+    World world(directory, nullptr);
+    // Only the journal is written until the final flush, so the copy taken before it has every
+    // edit to replay
+    Octree::getZoneStore().setCheckpointInterval(3600000);
+    world.setZoneCacheBudget(options.zone_cache_mb << 20);
+    world.setLodPolicy(std::make_shared<ScreenSpaceLodPolicy>(ScreenSpaceLodPolicy::qualityFromString(options.lod_quality)));
+    BenchCamera camera;
+    std::vector<unsigned char> frame;
+    if (!setUpCamera(options, world, camera, frame)) return 1;
+    // Frames stream like the game's, so splitting what the edits broke up is spread over them
+    world.setStreamingBudget(options.stream_us ? options.stream_us : 4000);
+    Anthrax::vec3<int64_t> camera_voxel = getCameraVoxel(camera);
+    world.loadArea(camera_voxel);
+    // The same frame with nothing edited, for comparison
+    std::chrono::steady_clock::time_point idle_start = std::chrono::steady_clock::now();
+    world.loadArea(camera_voxel);
+    idle_us = elapsedMicroseconds(idle_start);
+
+    // A cube of terrain just ahead of the camera, around ground level
+    int64_t region_min[3] = {camera_voxel.getX() + (int64_t)(camera.forward.getX() * 96.0f) - region_width / 2, -region_width / 2,
+                             camera_voxel.getZ() + (int64_t)(camera.forward.getZ() * 96.0f) - region_width / 2};
+    uint64_t random = 88172645463325252ULL; // xorshift64, so every run makes the same edits
+    auto next = [&random](int64_t range)
+    {
+      random ^= random << 13;
+      random ^= random >> 7;
+      random ^= random << 17;
+      return (int64_t)(random % range);
+    };
+
+    for (int step = 0; step < num_steps; step++)
+    {
+      for (unsigned int i = 0; i < num_points + num_boxes; i++)
+      {
+        int64_t min[3];
+        for (unsigned int a = 0; a < 3; a++) min[a] = region_min[a] + next(region_width);
+        uint16_t type = (uint16_t)next(4); // Digging (air) as often as building
+        int64_t size = (i < num_points) ? 1 : 8;
+        world.setBox(Anthrax::vec3<int64_t>(min[0], min[1], min[2]), Anthrax::vec3<int64_t>(min[0] + size - 1, min[1] + size - 1, min[2] + size - 1), type);
+        for (int64_t x = min[0]; x < min[0] + size; x++)
+          for (int64_t y = min[1]; y < min[1] + size; y++)
+            for (int64_t z = min[2]; z < min[2] + size; z++)
+              expected[{x, y, z}] = type;
+      }
+
+      Anthrax::Profiler::beginFrame();
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      world.applyEdits();
+      double step_apply_us = elapsedMicroseconds(start);
+      start = std::chrono::steady_clock::now();
+      world.loadArea(camera_voxel);
+      double step_redraw_us = elapsedMicroseconds(start);
+      Anthrax::Profiler::endFrame();
+
+      apply_us[0] += step_apply_us;
+      apply_us[1] = std::max(apply_us[1], step_apply_us);
+      redraw_us[0] += step_redraw_us;
+      redraw_us[1] = std::max(redraw_us[1], step_redraw_us);
+      nodes_edited += Anthrax::Profiler::getLastFrameCounter(Anthrax::Profiler::NODES_EDITED);
+      cubes_created += Anthrax::Profiler::getLastFrameCounter(Anthrax::Profiler::CUBES_CREATED);
+      zones_written += Anthrax::Profiler::getLastFrameCounter(Anthrax::Profiler::ZONES_WRITTEN);
+    }
+
+    for (std::map<std::array<int64_t, 3>, uint16_t>::iterator itr = expected.begin(); itr != expected.end(); itr++)
+    {
+      if (world.getVoxel(Anthrax::vec3<int64_t>(itr->first[0], itr->first[1], itr->first[2])) != itr->second) num_wrong++;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!world.commitEdits()) std::cout << "Couldn't journal the edits" << std::endl;
+    commit_us = elapsedMicroseconds(start);
+    EditJournal &journal = Octree::getZoneStore().getJournal();
+    journal_commits = journal.getNumCommits();
+    journal_size = journal.getSize();
+    std::filesystem::copy(directory, crash_directory, std::filesystem::copy_options::recursive);
+
+    Anthrax::Profiler::beginFrame();
+    start = std::chrono::steady_clock::now();
+    world.flushWrites();
+    flush_us = elapsedMicroseconds(start);
+    Anthrax::Profiler::endFrame();
+    zones_written += Anthrax::Profiler::getLastFrameCounter(Anthrax::Profiler::ZONES_WRITTEN);
+    if (journal.getSize() != 8) std::cout << "The journal still has " << journal.getSize() << " bytes after flushing" << std::endl;
+  }
+
+  // Nothing of the edited world is loaded, so this reads every zone back from disk
+  unsigned int num_wrong_on_disk = 0;
+  {
+    World world(directory, nullptr);
+    for (std::map<std::array<int64_t, 3>, uint16_t>::iterator itr = expected.begin(); itr != expected.end(); itr++)
+    {
+      if (world.getVoxel(Anthrax::vec3<int64_t>(itr->first[0], itr->first[1], itr->first[2])) != itr->second) num_wrong_on_disk++;
+    }
+  }
+  // The zones in the copy are as generated, so everything comes from replaying its journal
+  unsigned int num_wrong_replayed = 0;
+  {
+    World world(crash_directory, nullptr);
+    for (std::map<std::array<int64_t, 3>, uint16_t>::iterator itr = expected.begin(); itr != expected.end(); itr++)
+    {
+      if (world.getVoxel(Anthrax::vec3<int64_t>(itr->first[0], itr->first[1], itr->first[2])) != itr->second) num_wrong_replayed++;
+    }
+  }
+
+  std::cout << num_steps << " steps of " << num_points << " voxels and " << num_boxes << " 8x8x8 boxes, "
+            << expected.size() << " distinct voxels edited" << std::endl;
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "      applyEdits: mean " << apply_us[0] / num_steps / 1000.0 << " ms, max " << apply_us[1] / 1000.0 << " ms" << std::endl;
+  std::cout << "          redraw: mean " << redraw_us[0] / num_steps / 1000.0 << " ms, max " << redraw_us[1] / 1000.0 << " ms (loadArea - "
+            << idle_us / 1000.0 << " ms with no edits)" << std::endl;
+  std::cout << "Per step: " << std::setprecision(0) << (double)nodes_edited / num_steps << " nodes edited, "
+            << (double)cubes_created / num_steps << " cubes rebuilt" << std::endl;
+  std::cout << "Journal: " << journal_commits << " commits, " << journal_size << " bytes, last commit "
+            << std::setprecision(2) << commit_us / 1000.0 << " ms" << std::endl;
+  std::cout << "Final flush: " << flush_us / 1000.0 << " ms, "
+            << zones_written << " zone writes in total" << std::endl;
+  std::cout << "Wrong voxels: " << num_wrong << " loaded, " << num_wrong_on_disk << " on disk, "
+            << num_wrong_replayed << " replayed from the journal" << std::endl;
+  return (num_wrong + num_wrong_on_disk + num_wrong_replayed > 0) ? 1 : 0;
+}
+
+
+static bool parseOptions(int argc, char **argv, BenchOptions &options)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    bool has_value = (i + 1 < argc);
+    if (arg == "--dir" && has_value) options.directory = argv[++i];
+    else if (arg == "--generate") options.force_generate = true;
+    else if (arg == "--seed" && has_value) options.seed = std::stoul(argv[++i]);
+    else if (arg == "--radius" && has_value) options.radius = std::stoi(argv[++i]);
+    else if (arg == "--steps" && has_value) options.num_steps = std::stoi(argv[++i]);
+    else if (arg == "--csv" && has_value) options.csv_file = argv[++i];
+    else if (arg == "--load-test") options.load_test = true;
+    else if (arg == "--zone-cache-mb" && has_value) options.zone_cache_mb = std::stoull(argv[++i]);
+    else if (arg == "--oscillate") options.oscillate = true;
+    else if (arg == "--lod-budget" && has_value) options.lod_budget = std::stoul(argv[++i]);
+    else if (arg == "--lod-quality" && has_value) options.lod_quality = argv[++i];
+    else if (arg == "--stream-us" && has_value) options.stream_us = std::stoull(argv[++i]);
+    else if (arg == "--svo-image" && has_value) options.svo_image = argv[++i];
+    else if (arg == "--svo-camera" && has_value) options.svo_camera = argv[++i];
+    else if (arg == "--raycast-image" && has_value) options.raycast_image = argv[++i];
+    else if (arg == "--collision-test") options.collision_test = true;
+    else if (arg == "--edit-test") options.edit_test = true;
+    else if (arg == "--scan-bench") options.scan_bench = true;
+    else if (arg == "--no-svo-dag") options.svo_dag = false;
+    else if (arg == "--brick-layer" && has_value) options.brick_layer = std::stoi(argv[++i]);
+    else if (arg == "--pyramid-depth" && has_value) options.pyramid_depth = std::stoi(argv[++i]);
+    else if (arg == "--memory-budget-mb" && has_value) options.memory_budget_mb = std::stoull(argv[++i]);
+    else if (arg == "--cube-threads" && has_value) options.cube_threads = std::stoul(argv[++i]);
+    else
+    {
+      std::cout << "Usage: roxel_bench [--dir DIR] [--generate] [--seed N] [--radius ZONES] [--steps N] [--csv FILE] [--load-test] [--zone-cache-mb MB] [--oscillate] [--lod-budget N] [--lod-quality low|medium|high|ultra|distance] [--stream-us US] [--svo-image FILE | --raycast-image FILE] [--svo-camera FRAME] [--collision-test] [--edit-test] [--scan-bench] [--brick-layer N] [--no-svo-dag] [--pyramid-depth N] [--memory-budget-mb MB] [--cube-threads N]" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+
+int main(int argc, char **argv)
+{
+  BenchOptions options;
+  if (!parseOptions(argc, argv, options)) return 1;
+  if (options.brick_layer >= 0) Octree::setBrickLayer(options.brick_layer);
+  if (options.pyramid_depth >= 0) Octree::getZoneStore().setPyramidDepth(options.pyramid_depth);
+  if (!options.csv_file.empty()) options.csv_file = std::filesystem::absolute(options.csv_file).string();
+  if (!options.svo_image.empty()) options.svo_image = std::filesystem::absolute(options.svo_image).string();
+  if (!options.svo_camera.empty()) options.svo_camera = std::filesystem::absolute(options.svo_camera).string();
+  if (!options.raycast_image.empty()) options.raycast_image = std::filesystem::absolute(options.raycast_image).string();
+
+  // Must match World's layout (see World::getZoneAddress) - zones are generated before a World exists
+  ZoneAddress zone_address(32, 8);
+  if (options.force_generate || !std::filesystem::exists(options.directory + "/world"))
+  {
+    generateWorld(options, zone_address);
+  }
+  if (options.load_test) return loadTest(options, zone_address);
+  if (options.scan_bench) return scanBench(options, zone_address);
+  // The world's LOD pyramids are built up front - otherwise the first run at a depth would build
+  // them as it went, reading every zone it passes. It's a frame of its own so the zones it reads
+  // aren't counted against the first step.
+  Anthrax::Profiler::beginFrame();
+  Octree::openZoneStore(options.directory + "/world", zone_address);
+  unsigned int num_pyramids_built = Octree::getZoneStore().buildPyramids();
+  Anthrax::Profiler::endFrame();
+  if (num_pyramids_built > 0) std::cout << "Built " << num_pyramids_built << " LOD pyramids in " << options.directory << "/world" << std::endl;
+  // World reads "voxelmap.json" and its zones relative to the working directory
+  std::filesystem::current_path(options.directory);
+  if (options.edit_test) return editTest(options);
+
+  World world("world", nullptr);
+  world.setZoneCacheBudget(options.zone_cache_mb << 20);
+  world.setMemoryBudget(options.memory_budget_mb << 20);
+  world.setSvoDeduplication(options.svo_dag);
+  world.setCubeThreads(options.cube_threads);
+  if (!options.svo_image.empty()) return svoImage(options, world);
+  if (!options.raycast_image.empty()) return raycastImage(options, world);
+  if (options.collision_test) return collisionTest(options, world);
+  if (options.lod_quality == "distance")
+  {
+    world.setLodPolicy(std::make_shared<DistanceLodPolicy>(5000.0f, 500.0f, 0.1f));
+  }
+  else
+  {
+    world.setLodPolicy(std::make_shared<ScreenSpaceLodPolicy>(ScreenSpaceLodPolicy::qualityFromString(options.lod_quality)));
+  }
+  std::shared_ptr<LodPolicy> lod_policy = world.getLodPolicy();
+  unsigned int lod_budget = options.lod_budget ? options.lod_budget : LodPolicy::unlimited_;
+  lod_policy->setBudget(lod_budget, lod_budget);
+  if (options.stream_us) world.setStreamingBudget(options.stream_us);
+  std::vector<StepResult> results;
+  ResidencyManager &residency = world.getResidency();
+  uint64_t peak_resident_bytes = 0;
+  int64_t extent = options.radius * zone_address.getZoneWidth();
+  const unsigned int steady_frames = 4;
+  for (int step = 0; step <= options.num_steps; step++)
+  {
+    StepResult result;
+    result.position = cameraPosition(step, options.num_steps, extent, options.oscillate);
+    // There's no renderer to take the camera from, so hand the LOD policy a 1080p view directly
+    LodView view = lod_policy->getView();
+    view.look_direction = cameraDirection(step, options.num_steps, options.oscillate);
+    lod_policy->setView(view);
+
+    Anthrax::Profiler::beginFrame();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (options.stream_us) world.streamLod(result.position);
+    else world.updateLod(result.position);
+    result.load_area_us = elapsedMicroseconds(start);
+    start = std::chrono::steady_clock::now();
+    world.getNewNeighbors();
+    result.neighbors_us = elapsedMicroseconds(start);
+    start = std::chrono::steady_clock::now();
+    world.getCubes();
+    result.cubes_us = elapsedMicroseconds(start);
+    Anthrax::Profiler::endFrame();
+
+    result.nodes_loaded = Anthrax::Profiler::getLastFrameCounter(Anthrax::Profiler::NODES_LOADED);
+    result.cubes_created = Anthrax::Profiler::getLastFrameCounter(Anthrax::Profiler::CUBES_CREATED);
+    result.zone_files_read = Anthrax::Profiler::getLastFrameCounter(Anthrax::Profiler::ZONE_FILES_READ);
+    result.zone_cache_hits = Anthrax::Profiler::getLastFrameCounter(Anthrax::Profiler::ZONE_CACHE_HITS);
+    result.lod_splits = Anthrax::Profiler::getLastFrameCounter(Anthrax::Profiler::LOD_SPLITS);
+    result.lod_merges = Anthrax::Profiler::getLastFrameCounter(Anthrax::Profiler::LOD_MERGES);
+    result.allocations = Anthrax::Profiler::getLastFrameCounter(Anthrax::Profiler::ALLOCATIONS);
+    result.lod_deferred = options.stream_us ? world.getLodStreamer().getNumPending() : world.getNumDeferredLodChanges();
+    result.num_nodes = world.getNodeCount();
+    result.num_cubes = world.getCubeCount();
+    peak_resident_bytes = std::max(peak_resident_bytes, residency.getResidentBytes());
+    results.push_back(result);
+  }
+
+  // Frames with the camera where it stopped - the first finishes off anything the last step left
+  // (and counts what was allocated between frames), the rest should find nothing to do
+  uint64_t steady_allocations = 0;
+  for (unsigned int frame = 0; frame <= steady_frames; frame++)
+  {
+    Anthrax::Profiler::beginFrame();
+    if (options.stream_us) world.streamLod(results.back().position);
+    else world.updateLod(results.back().position);
+    world.getNewNeighbors();
+    world.getCubes();
+    Anthrax::Profiler::endFrame();
+    if (frame > 0) steady_allocations += Anthrax::Profiler::getLastFrameCounter(Anthrax::Profiler::ALLOCATIONS);
+  }
+
+  // Report
+  std::cout << std::setw(5) << "step" << std::setw(22) << "position"
+            << std::setw(18) << "loadArea(us)" << std::setw(16) << "neighbors(us)" << std::setw(14) << "getCubes(us)"
+            << std::setw(10) << "+nodes" << std::setw(10) << "+cubes" << std::setw(8) << "zones" << std::setw(8) << "cached"
+            << std::setw(8) << "splits" << std::setw(8) << "merges" << std::setw(10) << "deferred"
+            << std::setw(10) << "nodes" << std::setw(10) << "cubes" << std::setw(10) << "allocs" << std::endl;
+  double totals[3] = {0.0, 0.0, 0.0};
+  double maximums[3] = {0.0, 0.0, 0.0};
+  uint64_t peak_nodes = 0, peak_cubes = 0;
+  uint64_t checksum = 1469598103934665603ULL; // FNV-1a over the deterministic counts
+  for (unsigned int i = 0; i < results.size(); i++)
+  {
+    StepResult &r = results[i];
+    std::string position = std::to_string(r.position.getX()) + "," + std::to_string(r.position.getY()) + "," + std::to_string(r.position.getZ());
+    std::cout << std::setw(5) << i << std::setw(22) << position << std::fixed << std::setprecision(0)
+              << std::setw(18) << r.load_area_us << std::setw(16) << r.neighbors_us << std::setw(14) << r.cubes_us
+              << std::setw(10) << r.nodes_loaded << std::setw(10) << r.cubes_created << std::setw(8) << r.zone_files_read << std::setw(8) << r.zone_cache_hits
+              << std::setw(8) << r.lod_splits << std::setw(8) << r.lod_merges << std::setw(10) << r.lod_deferred
+              << std::setw(10) << r.num_nodes << std::setw(10) << r.num_cubes << std::setw(10) << r.allocations << std::endl;
+    double times[3] = {r.load_area_us, r.neighbors_us, r.cubes_us};
+    for (unsigned int j = 0; j < 3; j++)
+    {
+      totals[j] += times[j];
+      if (times[j] > maximums[j]) maximums[j] = times[j];
+    }
+    if (r.num_nodes > peak_nodes) peak_nodes = r.num_nodes;
+    if (r.num_cubes > peak_cubes) peak_cubes = r.num_cubes;
+    uint64_t values[5] = {r.nodes_loaded, r.cubes_created, r.zone_files_read, r.num_nodes, r.num_cubes};
+    for (unsigned int j = 0; j < 5; j++)
+    {
+      checksum = (checksum ^ values[j]) * 1099511628211ULL;
+    }
+  }
+
+  const char *names[3] = {"loadAreaRecursive", "getNewNeighbors", "getCubes"};
+  std::cout << std::endl;
+  for (unsigned int j = 0; j < 3; j++)
+  {
+    std::cout << std::setw(18) << names[j] << ": total " << std::setprecision(1) << totals[j] / 1000.0 << " ms, mean "
+              << totals[j] / results.size() / 1000.0 << " ms, max " << maximums[j] / 1000.0 << " ms" << std::endl;
+  }
+  std::cout << "Peak nodes: " << peak_nodes << ", peak cubes: " << peak_cubes << std::endl;
+  std::cout << "Bricks: " << world.getBrickCount() << " at layer " << Octree::getBrickLayer() << std::endl;
+  if (options.stream_us)
+  {
+    LodStreamer &lod_streamer = world.getLodStreamer();
+    std::cout << "Streaming: " << lod_streamer.getNumRescans() << " rescans, " << lod_streamer.getNumPending() << " changes pending"
+              << (lod_streamer.isSettled() ? " (settled)" : "") << std::endl;
+  }
+  ZoneCache &zone_cache = world.getZoneCache();
+  std::cout << "Zone cache: " << zone_cache.getHits() << " hits, " << zone_cache.getMisses() << " misses, "
+            << zone_cache.size() << " zones (" << zone_cache.getBytesUsed() / 1024 << " KB) resident" << std::endl;
+  ZoneStore &zone_store = Octree::getZoneStore();
+  std::cout << "LOD pyramids: " << zone_store.getNumPyramidsRead() << " read from zones.lod, " << zone_store.getNumPyramidsBuilt() << " built, depth " << zone_store.getPyramidDepth() << std::endl;
+  uint64_t resident_bytes = residency.getResidentBytes();
+  // Voxel runs are shared between nodes rather than any one node's, so only the rest can be recounted
+  uint64_t tracked_bytes = Octree::getResidentBytes(Octree::RESIDENT_NODES) + Octree::getResidentBytes(Octree::RESIDENT_BRICKS) + Octree::getResidentBytes(Octree::RESIDENT_CUBES);
+  uint64_t counted_bytes = world.countResidentBytes();
+  std::cout << "Residency: " << resident_bytes / 1024 << " KB resident (" << peak_resident_bytes / 1024 << " KB peak";
+  if (residency.getBudget() > 0) std::cout << ", budget " << residency.getBudget() / 1024 << " KB";
+  std::cout << ") of " << residency.getTotalBytes() / 1024 << " KB on disk - nodes " << Octree::getResidentBytes(Octree::RESIDENT_NODES) / 1024
+            << " KB, voxels " << Octree::getResidentBytes(Octree::RESIDENT_VOXELS) / 1024 << " KB, bricks " << Octree::getResidentBytes(Octree::RESIDENT_BRICKS) / 1024
+            << " KB, cubes " << Octree::getResidentBytes(Octree::RESIDENT_CUBES) / 1024 << " KB; " << residency.getNumPagedOut() << " paged out, "
+            << residency.getNumDeferred() << " splits held back" << ((counted_bytes == tracked_bytes) ? "" : " - TRACKED BYTES DON'T MATCH A RECOUNT") << std::endl;
+  std::cout << "Steady state: " << (double)steady_allocations / steady_frames << " allocations per frame, over " << steady_frames << " frames" << std::endl;
+  std::cout << "Peak memory: " << peakMemoryKB() << " KB" << std::endl;
+  std::cout << "Checksum: " << std::hex << checksum << std::dec << std::endl;
+
+  if (!options.csv_file.empty())
+  {
+    std::ofstream csv(options.csv_file);
+    csv << "step,x,y,z,load_area_us,neighbors_us,cubes_us,nodes_loaded,cubes_created,zone_files_read,zone_cache_hits,lod_splits,lod_merges,lod_deferred,nodes,cubes,allocations\n";
+    for (unsigned int i = 0; i < results.size(); i++)
+    {
+      StepResult &r = results[i];
+      csv << i << "," << r.position.getX() << "," << r.position.getY() << "," << r.position.getZ() << ","
+          << r.load_area_us << "," << r.neighbors_us << "," << r.cubes_us << "," << r.nodes_loaded << ","
+          << r.cubes_created << "," << r.zone_files_read << "," << r.zone_cache_hits << ","
+          << r.lod_splits << "," << r.lod_merges << "," << r.lod_deferred << "," << r.num_nodes << "," << r.num_cubes << "," << r.allocations << "\n";
+    }
+  }
+  return 0;
+}
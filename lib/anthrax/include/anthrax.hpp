@@ -22,6 +22,8 @@
 #include "cube.hpp"
 #include "list.hpp"
 #include "voxelcachemanager.hpp"
+#include "profiler.hpp"
+#include "svo.hpp"
 
 #include "anthrax_types.hpp"
 #include <vector>
@@ -48,8 +50,18 @@ public:
   int renderFrame();
 
   void addVoxel(std::weak_ptr<Cube> cube);
+  void addVoxels(List<Cube> &cubes); // All at once, leaving cubes empty
   void setCameraPosition(vec3<float> position);
+  // Anywhere in the world: origin plus a small offset from it. Everything is drawn relative to a
+  // render origin near the camera, so floats stay exact however far out it is - once the camera
+  // is more than rebase_distance_ from it, it moves to the camera and the cubes are re-sent.
+  void setCameraPosition(vec3<int64_t> origin, vec3<float> offset);
+  vec3<int64_t> getRenderOrigin() { return render_origin_; }
   void setCameraRotation(Quaternion rotation);
+  vec3<float> getLookDirection(); // World space, unit length
+  float getFieldOfView() { return glm::radians(camera.Zoom); } // Vertical, in radians
+  unsigned int getWindowWidth() { return window_width_; }
+  unsigned int getWindowHeight() { return window_height_; }
 
   enum RenderType
   {
@@ -57,24 +69,31 @@ public:
     DYNAMIC_SHADOWS,
     RAYTRACED
   };
+  static void setRenderType(RenderType render_type) { render_type_ = render_type; }
+  static RenderType getRenderType() { return render_type_; }
+  // For RAYTRACED mode - materials must hold a cube for every type in svo
+  void setSvo(const Svo &svo, const std::map<uint16_t, Cube> &materials);
+  // Writes what's in the g-buffer with Svo's debug palette, plus the camera, for comparing against Svo::renderReference
+  bool writeDebugImage(std::string filename);
 
   //std::map<uint16_t, std::vector<Cube>> voxel_buffer_map_;
 
 private:
   void renderScene();
+  void renderSvo();
   void gBufferSetup();
   void ssaoFramebufferSetup();
   void ssaoBlurFramebufferSetup();
   void ssaoKernelSetup();
   void renderQuad();
 
-  RenderType render_type_;
+  static RenderType render_type_;
 
   std::vector<Cube> voxel_buffer_;
 
   static GLFWwindow* window;
 
-  unsigned int g_buffer_ = 0, g_position_texture_ = 0, g_normal_texture_ = 0, g_color_texture_ = 0, g_material_texture_ = 0, g_depth_rbo_ = 0;
+  unsigned int g_buffer_ = 0, g_surface_texture_ = 0, g_depth_texture_ = 0;
   unsigned int ssao_framebuffer_ = 0, ssao_texture_ = 0, ssao_noise_texture_ = 0;
   unsigned int ssao_blur_framebuffer_ = 0, ssao_blurred_texture_ = 0;
   unsigned int quad_vao_ = 0, quad_vbo_ = 0;
@@ -82,8 +101,16 @@ private:
   Shader* lighting_pass_shader_ = nullptr;
   Shader* ssao_pass_shader_ = nullptr;
   Shader* ssao_blur_pass_shader_ = nullptr;
+  Shader* svo_pass_shader_ = nullptr;
 
-  VoxelCacheManager* voxel_cache_manager_;
+  // The uploaded SVO - a buffer texture of 32-bit nodes
+  unsigned int svo_buffer_ = 0, svo_texture_ = 0;
+  unsigned int svo_layer_ = 0;
+  vec3<int64_t> svo_origin_;
+
+  VoxelCacheManager* voxel_cache_manager_ = nullptr;
+  vec3<int64_t> render_origin_ = vec3<int64_t>(0, 0, 0); // Of the renderer's space - camera.position_ is relative to it
+  static const int64_t rebase_distance_ = 4096; // Along any axis
 
   // settings
   static unsigned int window_width_;
@@ -102,6 +129,7 @@ private:
   static bool wireframe_mode_;
   static bool ambient_occlusion_;
   static bool window_size_changed_;
+  static bool debug_image_requested_;
 
 };
 
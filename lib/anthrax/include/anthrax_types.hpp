@@ -11,6 +11,7 @@
 #include "glm/gtx/quaternion.hpp"
 #include <string>
 #include <iostream>
+#include <type_traits>
 
 namespace Anthrax
 {
@@ -109,7 +110,9 @@ public:
   float getMagnitude()
   {
     if (magnitude_valid_) return magnitude_;
-    magnitude_ = sqrt(x_*x_ + y_*y_ + z_*z_);
+    // Integer coordinates across the world would overflow when squared, so they're squared in double
+    if constexpr (std::is_integral<T>::value) magnitude_ = sqrt((double)x_*x_ + (double)y_*y_ + (double)z_*z_);
+    else magnitude_ = sqrt(x_*x_ + y_*y_ + z_*z_);
     magnitude_valid_ = true;
     return magnitude_;
   }
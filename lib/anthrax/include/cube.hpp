@@ -18,9 +18,20 @@ namespace Anthrax
 {
 
 
+// A cube's position is kept as the origin of the region it's in plus a float offset from there,
+// since a float on its own can't place a voxel exactly past 2^24. It's only ever drawn relative to
+// the renderer's origin near the camera (see Anthrax::setCameraPosition), which keeps it small.
 class Cube
 {
 public:
+  static const unsigned int region_layer_ = 16; // Regions are 2^16 voxels a side
+  // The region origin for a position: its coordinates with the bits under region_layer_ cleared
+  static vec3<int64_t> getRegionOrigin(vec3<int64_t> position)
+  {
+    const int64_t mask = ~((1LL << region_layer_) - 1);
+    return vec3<int64_t>(position.getX() & mask, position.getY() & mask, position.getZ() & mask);
+  }
+
   Cube()
   {
     type_id_ = 65535;
@@ -30,6 +41,7 @@ public:
     shininess_ = 0.1;
     opacity_ = 1.0;
 
+    origin_ = vec3<int64_t>(0, 0, 0);
     position_ = glm::vec3(0.0, 0.0, 0.0);
     size_ = 1;
 
@@ -45,6 +57,7 @@ public:
     shininess_ = 0.1;
     opacity_ = 1.0;
  
+    origin_ = vec3<int64_t>(0, 0, 0);
     position_ = pos.toGLM();
     size_ = size;
 
@@ -52,8 +65,15 @@ public:
   }
 
   Cube(uint16_t type_id, vec3<float> position, int size, vec3<float> color, float reflectivity, float shininess, float opacity)
+    : Cube(type_id, vec3<int64_t>(0, 0, 0), position, size, color, reflectivity, shininess, opacity)
+  {
+  }
+
+  // position is relative to origin
+  Cube(uint16_t type_id, vec3<int64_t> origin, vec3<float> position, int size, vec3<float> color, float reflectivity, float shininess, float opacity)
   {
     type_id_ = type_id;
+    origin_ = origin;
     position_ = position.toGLM();
     size_ = size;
     color_ = color.toGLM();
@@ -64,6 +84,16 @@ public:
     is_in_cache_ = false;
   }
 
+  // material's type and lighting properties, placed somewhere else - cheaper than converting the type again
+  Cube(const Cube &material, vec3<int64_t> origin, vec3<float> position, int size) : Cube(material)
+  {
+    origin_ = origin;
+    position_ = position.toGLM();
+    size_ = size;
+
+    is_in_cache_ = false;
+  }
+
   ~Cube()
   {
   }
@@ -103,11 +133,24 @@ public:
     return opacity_;
   }
 
-  glm::vec3 getPosition()
+  glm::vec3 getPosition() // Relative to getOrigin()
   {
     return position_;
   }
 
+  vec3<int64_t> getOrigin()
+  {
+    return origin_;
+  }
+
+  // Relative to origin instead, which has to be near enough for the difference to fit a float
+  glm::vec3 getPositionFrom(vec3<int64_t> origin)
+  {
+    return glm::vec3((float)(origin_.getX() - origin.getX()) + position_.x,
+                     (float)(origin_.getY() - origin.getY()) + position_.y,
+                     (float)(origin_.getZ() - origin.getZ()) + position_.z);
+  }
+
   int getSize()
   {
     return size_;
@@ -131,6 +174,7 @@ private:
   float shininess_;
   float opacity_;
 
+  vec3<int64_t> origin_;
   glm::vec3 position_;
   int size_;
 };
@@ -0,0 +1,80 @@
+/* ---------------------------------------------------------------- *\
+ * framearena.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * A linear allocator for scratch space that only lives until the end
+ * of the frame. Allocating bumps an offset and freeing does nothing;
+ * reset() hands everything back at once. When a frame needs more than
+ * the arena holds it takes another chunk, and the next reset trades
+ * all of them for one chunk big enough for the lot, so once frames
+ * settle down the arena never goes to the global allocator.
+ *
+ * getFrameArena() is the one the main loop resets after each frame.
+ * It is for the main thread only, and nothing allocated from it may be
+ * kept past the reset. FrameVector is a std::vector in it - reserve
+ * what it needs up front, since what it grows out of isn't reused.
+\* ---------------------------------------------------------------- */
+
+#ifndef FRAMEARENA_HPP
+#define FRAMEARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Anthrax
+{
+
+class FrameArena
+{
+public:
+  FrameArena() {}
+  ~FrameArena();
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+  void *allocate(size_t num_bytes, size_t alignment = alignof(std::max_align_t));
+  template <class T>
+  T *allocate(size_t count) { return static_cast<T*>(allocate(count*sizeof(T), alignof(T))); }
+  void reset(); // Everything allocated since the last reset is gone
+  size_t getBytesUsed() const { return bytes_used_; } // Since the last reset
+  size_t getCapacity() const;
+  static FrameArena &getFrameArena();
+private:
+  struct Chunk
+  {
+    char *data;
+    size_t size;
+  };
+  std::vector<Chunk> chunks_; // Only ever more than one until the next reset
+  size_t offset_ = 0; // Into the last chunk
+  size_t bytes_used_ = 0;
+  static const size_t min_chunk_size_ = 1 << 20;
+};
+
+
+// For standard containers, e.g. FrameVector
+template <class T>
+class FrameAllocator
+{
+public:
+  typedef T value_type;
+  FrameAllocator() {}
+  template <class U>
+  FrameAllocator(const FrameAllocator<U> &) {}
+  T *allocate(size_t count) { return FrameArena::getFrameArena().allocate<T>(count); }
+  void deallocate(T *, size_t) {} // Goes with the rest of the frame's
+  template <class U>
+  bool operator==(const FrameAllocator<U> &) const { return true; }
+  template <class U>
+  bool operator!=(const FrameAllocator<U> &) const { return false; }
+};
+
+template <class T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+} // namespace Anthrax
+
+#endif // FRAMEARENA_HPP
@@ -16,11 +16,8 @@ layout (location = 0) in vec3 voxel_position;
 layout (location = 1) in int voxel_size;
 layout (location = 2) in uint render_faces;
 
-// Material settings
-layout (location = 3) in vec3 color;
-layout (location = 4) in float reflectivity;
-layout (location = 5) in float shininess;
-layout (location = 6) in float opacity;
+// Index into the material table (see VoxelCacheManager)
+layout (location = 3) in uint material;
 
 out mat4 model;
 
@@ -31,11 +28,7 @@ flat out float render_top;
 flat out float render_front;
 flat out float render_back;
 
-// Material settings
-flat out vec3 vertex_color;
-flat out float vertex_reflectivity;
-flat out float vertex_shininess;
-flat out float vertex_opacity;
+flat out uint vertex_material;
 
 
 void main()
@@ -46,12 +39,7 @@ void main()
   mat4 scale_matrix = mat4(vec4(intBitsToFloat(voxel_size), 0.0, 0.0, 0.0), vec4(0.0, intBitsToFloat(voxel_size), 0.0, 0.0), vec4(0.0, 0.0, intBitsToFloat(voxel_size), 0.0), vec4(0.0, 0.0, 0.0, 1.0));
   model = pos_matrix * scale_matrix * mat4(1.0);
 
-  // Material settings
-  //vertex_color = vec3(1.0, 1.0, 1.0);
-  vertex_color = color;
-  vertex_reflectivity = reflectivity;
-  vertex_shininess = shininess;
-  vertex_opacity = opacity;
+  vertex_material = material;
 
   // For whatever reason, opengl always interprets data as floats, even when it is specified as an int
   // So we have to do some finagling to parse this int properly
@@ -99,26 +87,17 @@ void main()
 const std::string geometry_pass_fshader = R"glsl(
 #version 330 core
 
-layout (location = 0) out vec3 g_position_texture_;
-layout (location = 1) out vec3 g_normal_texture_;
-layout (location = 2) out vec3 g_color_texture_;
-layout (location = 3) out vec3 g_material_texture_;
+// The g-buffer only holds the material index and the face index of each fragment. Position is
+// reconstructed from the depth buffer and the normal is looked up from the face index, since
+// every voxel face is axis-aligned.
+layout (location = 0) out uvec2 g_surface_texture_;
 
-in vec3 normal;
-in vec3 fragment_position;
-
-// Material settings
-flat in vec3 voxel_color;
-flat in float voxel_reflectivity;
-flat in float voxel_shininess;
-flat in float voxel_opacity;
+flat in uint voxel_material;
+flat in uint voxel_face;
 
 void main()
 {
-  g_position_texture_ = fragment_position;
-  g_normal_texture_ = normalize(normal);
-  g_color_texture_ = voxel_color;
-  g_material_texture_ = vec3(voxel_reflectivity, voxel_shininess, voxel_opacity);
+  g_surface_texture_ = uvec2(voxel_material, voxel_face);
 }
 
 
@@ -141,19 +120,10 @@ flat in float render_top[];
 flat in float render_front[];
 flat in float render_back[];
 
-out vec3 normal;
-out vec3 fragment_position;
-
-
-// Material settings (transparent)
-flat in vec3 vertex_color[];
-flat in float vertex_reflectivity[];
-flat in float vertex_shininess[];
-flat in float vertex_opacity[];
-flat out vec3 voxel_color;
-flat out float voxel_reflectivity;
-flat out float voxel_shininess;
-flat out float voxel_opacity;
+flat in uint vertex_material[];
+flat out uint voxel_material;
+// Face indices match Cube::render_face_: left, right, bottom, top, front, back
+flat out uint voxel_face;
 
 
 uniform mat4 view;
@@ -161,17 +131,13 @@ uniform mat4 projection;
 
 void drawFrontFace()
 {
-  normal = vec3(0.0, 0.0, 1.0);
-  fragment_position = (model[0] * vec4(-0.5, -0.5, 0.5, 1.0)).xyz;
+  voxel_face = 4u;
   gl_Position = projection * view * model[0] * (vec4(-0.5, -0.5, 0.5, 1.0));
   EmitVertex();
-  fragment_position = (model[0] * vec4(0.5, -0.5, 0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(0.5, -0.5, 0.5, 1.0);
   EmitVertex();
-  fragment_position = (model[0] * vec4(-0.5, 0.5, 0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(-0.5, 0.5, 0.5, 1.0);
   EmitVertex();
-  fragment_position = (model[0] * vec4(0.5, 0.5, 0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(0.5, 0.5, 0.5, 1.0);
   EmitVertex();
   EndPrimitive();
@@ -179,17 +145,13 @@ void drawFrontFace()
 
 void drawBackFace()
 {
-  normal = vec3(0.0, 0.0, -1.0);
-  fragment_position = (model[0] * vec4(0.5, 0.5, -0.5, 1.0)).xyz;
+  voxel_face = 5u;
   gl_Position = projection * view * model[0] * (vec4(0.5, 0.5, -0.5, 1.0));
   EmitVertex();
-  fragment_position = (model[0] * vec4(0.5, -0.5, -0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(0.5, -0.5, -0.5, 1.0);
   EmitVertex();
-  fragment_position = (model[0] * vec4(-0.5, 0.5, -0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(-0.5, 0.5, -0.5, 1.0);
   EmitVertex();
-  fragment_position = (model[0] * vec4(-0.5, -0.5, -0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(-0.5, -0.5, -0.5, 1.0);
   EmitVertex();
   EndPrimitive();
@@ -197,17 +159,13 @@ void drawBackFace()
 
 void drawLeftFace()
 {
-  normal = vec3(-1.0, 0.0, 0.0);
-  fragment_position = (model[0] * vec4(-0.5, -0.5, 0.5, 1.0)).xyz;
+  voxel_face = 0u;
   gl_Position = projection * view * model[0] * (vec4(-0.5, -0.5, 0.5, 1.0));
   EmitVertex();
-  fragment_position = (model[0] * vec4(-0.5, 0.5, 0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(-0.5, 0.5, 0.5, 1.0);
   EmitVertex();
-  fragment_position = (model[0] * vec4(-0.5, -0.5, -0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(-0.5, -0.5, -0.5, 1.0);
   EmitVertex();
-  fragment_position = (model[0] * vec4(-0.5, 0.5, -0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(-0.5, 0.5, -0.5, 1.0);
   EmitVertex();
   EndPrimitive();
@@ -215,17 +173,13 @@ void drawLeftFace()
 
 void drawRightFace()
 {
-  normal = vec3(1.0, 0.0, 0.0);
-  fragment_position = (model[0] * vec4(0.5, 0.5, -0.5, 1.0)).xyz;
+  voxel_face = 1u;
   gl_Position = projection * view * model[0] * (vec4(0.5, 0.5, -0.5, 1.0));
   EmitVertex();
-  fragment_position = (model[0] * vec4(0.5, 0.5, 0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(0.5, 0.5, 0.5, 1.0);
   EmitVertex();
-  fragment_position = (model[0] * vec4(0.5, -0.5, -0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(0.5, -0.5, -0.5, 1.0);
   EmitVertex();
-  fragment_position = (model[0] * vec4(0.5, -0.5, 0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(0.5, -0.5, 0.5, 1.0);
   EmitVertex();
   EndPrimitive();
@@ -233,17 +187,13 @@ void drawRightFace()
 
 void drawBottomFace()
 {
-  normal = vec3(0.0, -1.0, 0.0);
-  fragment_position = (model[0] * vec4(0.5, -0.5, -0.5, 1.0)).xyz;
+  voxel_face = 2u;
   gl_Position = projection * view * model[0] * (vec4(0.5, -0.5, -0.5, 1.0));
   EmitVertex();
-  fragment_position = (model[0] * vec4(0.5, -0.5, 0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(0.5, -0.5, 0.5, 1.0);
   EmitVertex();
-  fragment_position = (model[0] * vec4(-0.5, -0.5, -0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(-0.5, -0.5, -0.5, 1.0);
   EmitVertex();
-  fragment_position = (model[0] * vec4(-0.5, -0.5, 0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(-0.5, -0.5, 0.5, 1.0);
   EmitVertex();
   EndPrimitive();
@@ -251,17 +201,13 @@ void drawBottomFace()
 
 void drawTopFace()
 {
-  normal = vec3(0.0, 1.0, 0.0);
-  fragment_position = (model[0] * vec4(-0.5, 0.5, 0.5, 1.0)).xyz;
+  voxel_face = 3u;
   gl_Position = projection * view * model[0] * (vec4(-0.5, 0.5, 0.5, 1.0));
   EmitVertex();
-  fragment_position = (model[0] * vec4(0.5, 0.5, 0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(0.5, 0.5, 0.5, 1.0);
   EmitVertex();
-  fragment_position = (model[0] * vec4(-0.5, 0.5, -0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(-0.5, 0.5, -0.5, 1.0);
   EmitVertex();
-  fragment_position = (model[0] * vec4(0.5, 0.5, -0.5, 1.0)).xyz;
   gl_Position = projection * view * model[0] * vec4(0.5, 0.5, -0.5, 1.0);
   EmitVertex();
   EndPrimitive();
@@ -269,11 +215,7 @@ void drawTopFace()
 
 void main()
 {
-  // Transparents
-  voxel_color = vertex_color[0];
-  voxel_reflectivity = vertex_reflectivity[0];
-  voxel_shininess = vertex_shininess[0];
-  voxel_opacity = vertex_opacity[0];
+  voxel_material = vertex_material[0];
 
   if (render_left[0] == 1.0) drawLeftFace();
   if (render_right[0] == 1.0) drawRightFace();
@@ -285,6 +227,109 @@ void main()
 )glsl";
 
 
+// RAYTRACED mode - writes the same g-buffer as the geometry pass, but by ray-marching the
+// linear SVO (see svo.hpp) for every pixel instead of drawing cubes
+const std::string svo_pass_vshader = R"glsl(
+#version 330 core
+layout (location = 0) in vec2 position;
+layout (location = 1) in vec2 texture_coordinates;
+
+out vec2 tex_coords;
+
+void main()
+{
+  tex_coords = texture_coordinates;
+  gl_Position = vec4(position, 0.0, 1.0);
+}
+)glsl";
+
+
+const std::string svo_pass_fshader = R"glsl(
+#version 330 core
+layout (location = 0) out uvec2 g_surface_texture_;
+
+// Leaves have the top bit set and hold (material index + 1), or 0 if empty. Interior nodes hold
+// the index of their first child.
+uniform usamplerBuffer svo_nodes;
+uniform float svo_size; // Width of the root
+uniform vec3 svo_camera; // Camera position relative to the root's min corner, in world axes (+z forward)
+uniform vec3 camera_position; // In the renderer's space (z flipped)
+uniform mat4 inverse_view_projection;
+uniform mat4 view_projection;
+uniform float max_distance;
+
+in vec2 tex_coords;
+
+const uint LEAF_BIT = 0x80000000u;
+
+
+void main()
+{
+  vec4 far_point = inverse_view_projection * vec4(tex_coords * 2.0 - 1.0, 1.0, 1.0);
+  vec3 direction_gl = normalize(far_point.xyz / far_point.w - camera_position);
+  vec3 direction = vec3(direction_gl.xy, -direction_gl.z);
+  direction = mix(direction, sign(direction + 1e-20) * 1e-8, lessThan(abs(direction), vec3(1e-8)));
+  vec3 inverse_direction = 1.0 / direction;
+
+  // Clip the ray to the root
+  vec3 t0 = (vec3(0.0) - svo_camera) * inverse_direction;
+  vec3 t1 = (vec3(svo_size) - svo_camera) * inverse_direction;
+  vec3 t_near = min(t0, t1);
+  vec3 t_far = max(t0, t1);
+  float t = 0.0;
+  int entry_axis = -1;
+  for (int a = 0; a < 3; a++)
+  {
+    if (t_near[a] > t)
+    {
+      t = t_near[a];
+      entry_axis = a;
+    }
+  }
+  float t_end = min(min(t_far.x, t_far.y), min(t_far.z, max_distance));
+
+  for (int iteration = 0; iteration < 512 && t < t_end; iteration++)
+  {
+    vec3 p = svo_camera + direction * t;
+    // Step just over the boundary that was crossed, so the point lands in the next node
+    if (entry_axis >= 0) p[entry_axis] += (direction[entry_axis] > 0.0) ? 0.25 : -0.25;
+    p = clamp(p, vec3(0.0), vec3(svo_size - 0.001));
+
+    float size = svo_size;
+    vec3 node_min = vec3(0.0);
+    uint node = texelFetch(svo_nodes, 0).r;
+    while ((node & LEAF_BIT) == 0u)
+    {
+      size *= 0.5;
+      uvec3 high = uvec3(greaterThanEqual(p, node_min + size));
+      node_min += vec3(high) * size;
+      node = texelFetch(svo_nodes, int(node + high.x + (high.z << 1) + (high.y << 2))).r;
+    }
+
+    // Where the ray leaves this leaf. If that's not ahead of t, the ray crossed at an edge or
+    // corner and the point landed in a node the ray is already past - step over that boundary too.
+    vec3 t_exit = (node_min + step(0.0, direction) * size - svo_camera) * inverse_direction;
+    float t_next = t_exit.x;
+    int exit_axis = 0;
+    if (t_exit.y < t_next) { t_next = t_exit.y; exit_axis = 1; }
+    if (t_exit.z < t_next) { t_next = t_exit.z; exit_axis = 2; }
+
+    if ((node & 0xFFFFu) != 0u && t_next > t)
+    {
+      uint face = (entry_axis < 0) ? 0u : uint(2*entry_axis) + (direction[entry_axis] < 0.0 ? 1u : 0u);
+      g_surface_texture_ = uvec2((node & 0xFFFFu) - 1u, face);
+      vec4 clip = view_projection * vec4(camera_position + direction_gl * t, 1.0);
+      gl_FragDepth = (clip.z / clip.w) * 0.5 + 0.5;
+      return;
+    }
+    entry_axis = exit_axis;
+    t = max(t_next, t);
+  }
+  discard;
+}
+)glsl";
+
+
 const std::string ssao_pass_vshader = R"glsl(
 #version 330 core
 layout (location = 0) in vec2 position;
@@ -304,14 +349,16 @@ const std::string ssao_pass_fshader = R"glsl(
 #version 330 core
 layout (location = 0) out float occlusion_factor;
 
-uniform sampler2D g_position_texture_;
-uniform sampler2D g_normal_texture_;
+uniform sampler2D g_depth_texture_;
+uniform usampler2D g_surface_texture_;
 uniform sampler2D ssao_noise_texture_;
 
 uniform vec3 samples[128];
 
 uniform mat4 view;
 uniform mat4 projection;
+uniform mat4 inverse_view;
+uniform mat4 inverse_projection;
 uniform float do_ambient_occlusion;
 
 in vec2 tex_coords;
@@ -320,21 +367,33 @@ const float kernel_size = 128.0;
 const float radius = 5.0;
 const float bias = 0.025;
 
+const vec3 face_normals[6] = vec3[6](
+    vec3(-1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0),
+    vec3(0.0, -1.0, 0.0), vec3(0.0, 1.0, 0.0),
+    vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+
+
+// Reconstruct the view-space position of whatever was rendered at the given texture coordinates
+vec3 viewPositionFromDepth(vec2 coords)
+{
+  float depth = texture(g_depth_texture_, coords).r;
+  vec4 position = inverse_projection * vec4(vec3(coords, depth) * 2.0 - 1.0, 1.0);
+  return position.xyz / position.w;
+}
 
 
 void main()
 {
-  if (do_ambient_occlusion == 0.0)
+  if (do_ambient_occlusion == 0.0 || texture(g_depth_texture_, tex_coords).r == 1.0)
   {
     occlusion_factor = 1.0;
     return;
   }
 
   // get input for SSAO algorithm
-  vec3 frag_pos = (view * vec4(texture(g_position_texture_, tex_coords).xyz, 1.0)).xyz;
-  vec3 frag_world_pos = texture(g_position_texture_, tex_coords).xyz;
-  //vec3 normal = normalize((transpose(inverse(view)) * vec4(texture(g_normal_texture_, tex_coords).rgb, 1.0)).xyz);
-  vec3 normal = normalize(texture(g_normal_texture_, tex_coords).rgb);
+  vec3 frag_pos = viewPositionFromDepth(tex_coords);
+  vec3 frag_world_pos = (inverse_view * vec4(frag_pos, 1.0)).xyz;
+  vec3 normal = face_normals[texture(g_surface_texture_, tex_coords).g];
   vec3 random_vec = normalize(texture(ssao_noise_texture_, tex_coords).xyz);
 
   // create TBN change-of-basis matrix: from tangent-space to view-space
@@ -370,7 +429,7 @@ void main()
     offset.xyz = offset.xyz * 0.5 + 0.5; // transform to range 0.0 - 1.0
     
     // get sample depth
-    float sample_depth = (view * vec4(texture(g_position_texture_, offset.xy).xyz, 1.0)).z; // get depth value of kernel sample
+    float sample_depth = viewPositionFromDepth(offset.xy).z; // get depth value of kernel sample
     
     // range check & accumulate
     float range_check = smoothstep(0.0, 1.0, radius / abs(frag_pos.z - sample_depth));
@@ -455,22 +514,40 @@ struct DirectLight
 
 uniform DirectLight sunlight;
 uniform vec3 view_position;
+uniform mat4 inverse_view_projection;
 
-uniform sampler2D g_position_texture_;
-uniform sampler2D g_normal_texture_;
-uniform sampler2D g_color_texture_;
-uniform sampler2D g_material_texture_;
+uniform sampler2D g_depth_texture_;
+uniform usampler2D g_surface_texture_;
+// Row 0 holds (color, opacity) and row 1 holds (reflectivity, shininess) of each material
+uniform sampler2D material_texture_;
 uniform sampler2D ssao_texture_;
 
+const vec3 face_normals[6] = vec3[6](
+    vec3(-1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0),
+    vec3(0.0, -1.0, 0.0), vec3(0.0, 1.0, 0.0),
+    vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+
 void main()
 {             
+  float depth = texture(g_depth_texture_, tex_coords).r;
+  if (depth == 1.0)
+  {
+    // Nothing was drawn here
+    gl_FragColor = vec4(0.0);
+    return;
+  }
+
   // retrieve data from gbuffer
-  vec3 in_world_position = texture(g_position_texture_, tex_coords).rgb;
-  vec3 normal = texture(g_normal_texture_, tex_coords).rgb;
-  vec3 voxel_color = texture(g_color_texture_, tex_coords).rgb;
-  float voxel_reflectivity = texture(g_material_texture_, tex_coords).r;
-  float voxel_shininess = texture(g_material_texture_, tex_coords).g;
-  float voxel_opacity = texture(g_material_texture_, tex_coords).b;
+  vec4 in_world_position = inverse_view_projection * vec4(vec3(tex_coords, depth) * 2.0 - 1.0, 1.0);
+  in_world_position /= in_world_position.w;
+  uvec2 surface = texture(g_surface_texture_, tex_coords).rg;
+  vec3 normal = face_normals[surface.g];
+  vec4 material_color = texelFetch(material_texture_, ivec2(surface.r, 0), 0);
+  vec4 material_properties = texelFetch(material_texture_, ivec2(surface.r, 1), 0);
+  vec3 voxel_color = material_color.rgb;
+  float voxel_reflectivity = material_properties.r;
+  float voxel_shininess = material_properties.g;
+  float voxel_opacity = material_color.a;
   float ambient_occlusion = texture(ssao_texture_, tex_coords).r;
   
   // Calculate sunlight phong vector
@@ -481,7 +558,7 @@ void main()
   vec3 sunlight_diffuse = sunlight.diffuse * (diff * voxel_color);
 
   // Calculate specular light
-  vec3 view_direction = normalize(view_position - in_world_position);
+  vec3 view_direction = normalize(view_position - in_world_position.xyz);
   vec3 reflect_direction = reflect(normalize(sunlight.direction), normal);
   vec3 halfway_direction = normalize(normalize(-sunlight.direction) + view_direction);
   float spec = pow(max(dot(normal, halfway_direction), 0.0), voxel_shininess * 256);
@@ -18,9 +18,12 @@ class List
 public:
   List() : front_(nullptr), back_(nullptr), size_(0) {}
   ~List() { destroy_list(); }
+  List(const List &) = delete; // Both would delete the same nodes
+  List &operator=(const List &) = delete;
   size_t size() { return size_; }
   void push_back(std::weak_ptr<T> new_node);
   void push_front(std::weak_ptr<T> new_node);
+  void splice(List<T> &other); // Moves all of other's nodes onto the back, leaving other empty
   void destroy_list();
 
   template <class T1>
@@ -174,6 +177,27 @@ void List<T>::push_front(std::weak_ptr<T> new_cube)
 }
 
 
+template <class T>
+void List<T>::splice(List<T> &other)
+{
+  if (other.front_ == nullptr) return;
+  if (front_ == nullptr)
+  {
+    front_ = other.front_;
+  }
+  else
+  {
+    back_->next_node_ = other.front_;
+    other.front_->previous_node_ = back_;
+  }
+  back_ = other.back_;
+  size_ += other.size_;
+  other.front_ = nullptr;
+  other.back_ = nullptr;
+  other.size_ = 0;
+}
+
+
 template <class T>
 void List<T>::destroy_list() {
   while (front_ != nullptr)
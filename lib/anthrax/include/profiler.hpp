@@ -0,0 +1,159 @@
+/* ---------------------------------------------------------------- *\
+ * profiler.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Lightweight frame profiler. CPU scopes are timed with
+ * std::chrono, GPU scopes with GL timestamp queries that are read
+ * back a few frames later so the CPU never waits on the GPU.
+ * Everything is recorded into fixed-size ring buffers, so
+ * profiling does not allocate once it is running. The contents
+ * can be dumped as CSV or as a Chrome trace (chrome://tracing or
+ * https://ui.perfetto.dev).
+ *
+ * The ALLOCATIONS counter counts every call to the global operator
+ * new in programs that replace it with one that counts (roxel_bench
+ * links bench/allocationcounter.cpp for this), so frames that should
+ * only use the frame arena (see framearena.hpp) can be checked for
+ * any that slipped through. Elsewhere it stays at 0.
+\* ---------------------------------------------------------------- */
+
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace Anthrax
+{
+
+class Profiler
+{
+public:
+  enum Counter
+  {
+    NODES_LOADED,
+    CUBES_CREATED,
+    ZONE_FILES_READ,
+    BYTES_UPLOADED,
+    ZONE_CACHE_HITS,
+    ZONE_CACHE_MISSES,
+    LOD_SPLITS,
+    LOD_MERGES,
+    NODES_EDITED,
+    ZONES_WRITTEN,
+    ALLOCATIONS, // Calls to the global operator new, from any thread - only where it's replaced to count them
+    FRAME_ARENA_BYTES,
+    NUM_COUNTERS
+  };
+
+  static void setEnabled(bool enabled) { enabled_ = enabled; }
+  static bool isEnabled() { return enabled_; }
+
+  static void beginFrame();
+  static void endFrame();
+
+  static void beginScope(const char *name);
+  static void endScope();
+  // GPU scopes require a current GL context - initializeGpuTimers() must be called after GL is loaded
+  static void initializeGpuTimers();
+  static void beginGpuScope(const char *name);
+  static void endGpuScope();
+
+  static void addCounter(Counter counter, uint64_t amount)
+  {
+    if (enabled_) counters_[counter].fetch_add(amount, std::memory_order_relaxed);
+  }
+
+  static float getAverageFrameTime(unsigned int num_frames); // In milliseconds
+  static uint64_t getLastFrameCounter(Counter counter);
+
+  static bool dumpCSV(std::string filepath);
+  static bool dumpChromeTrace(std::string filepath);
+
+  static const char *getCounterName(Counter counter);
+
+private:
+  struct FrameRecord
+  {
+    uint64_t frame_number;
+    uint64_t start_us;
+    uint64_t duration_us;
+    uint64_t counters[NUM_COUNTERS];
+  };
+  struct TimerEvent
+  {
+    const char *name; // Must be a string literal (or otherwise outlive the profiler)
+    uint64_t frame_number;
+    uint64_t start_us;
+    uint64_t duration_us;
+    uint8_t depth;
+    bool gpu;
+  };
+  struct GpuScope
+  {
+    const char *name;
+    uint8_t depth;
+  };
+
+  static const unsigned int max_frames_ = 512;
+  static const unsigned int max_events_ = 16384;
+  static const unsigned int max_open_scopes_ = 32;
+  static const unsigned int gpu_frames_in_flight_ = 4; // Frames to wait before reading back GPU timers
+  static const unsigned int max_gpu_scopes_ = 16; // Per frame
+
+  static uint64_t now();
+  static void pushEvent(const char *name, uint64_t start_us, uint64_t duration_us, uint8_t depth, bool gpu, uint64_t frame_number);
+  static void collectGpuFrame(unsigned int slot);
+
+  static bool enabled_;
+  static std::chrono::steady_clock::time_point epoch_;
+
+  static FrameRecord frames_[max_frames_];
+  static uint64_t num_frames_; // Total frames recorded - the ring holds the last max_frames_ of them
+  static uint64_t frame_start_us_;
+
+  static TimerEvent events_[max_events_];
+  static uint64_t num_events_;
+
+  static const char *open_scope_names_[max_open_scopes_];
+  static uint64_t open_scope_starts_[max_open_scopes_];
+  static unsigned int num_open_scopes_;
+
+  static std::atomic<uint64_t> counters_[NUM_COUNTERS];
+
+  static bool gpu_timers_initialized_;
+  static unsigned int gpu_queries_[gpu_frames_in_flight_][max_gpu_scopes_][2];
+  static GpuScope gpu_scopes_[gpu_frames_in_flight_][max_gpu_scopes_];
+  static unsigned int num_gpu_scopes_[gpu_frames_in_flight_];
+  static uint64_t gpu_frame_numbers_[gpu_frames_in_flight_];
+  static uint64_t gpu_frame_starts_[gpu_frames_in_flight_];
+  static unsigned int gpu_scope_stack_[max_gpu_scopes_];
+  static unsigned int gpu_scope_depth_;
+};
+
+
+// Times the enclosing block on the CPU
+class ScopedTimer
+{
+public:
+  ScopedTimer(const char *name) { Profiler::beginScope(name); }
+  ~ScopedTimer() { Profiler::endScope(); }
+};
+
+
+// Times the GL commands issued within the enclosing block
+class ScopedGpuTimer
+{
+public:
+  ScopedGpuTimer(const char *name) { Profiler::beginGpuScope(name); }
+  ~ScopedGpuTimer() { Profiler::endGpuScope(); }
+};
+
+} // namespace Anthrax
+
+#endif // PROFILER_HPP
@@ -0,0 +1,121 @@
+/* ---------------------------------------------------------------- *\
+ * svo.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * A sparse voxel octree flattened into one array of 32-bit nodes,
+ * which is what the RAYTRACED render mode uploads and ray-marches.
+ *
+ * Each node is either a leaf (LEAF_BIT set, low 16 bits are the
+ * voxel type, 0 for empty) or an interior node (the index of its
+ * first child - all 8 children are stored next to each other, in
+ * the same order as Octree's children: x | z<<1 | y<<2). Node 0 is
+ * the root, which covers 2^layer voxels along each axis starting at
+ * voxel `origin`. Voxel p spans [p-0.5, p+0.5], so the root's min
+ * corner is at origin - 0.5.
+ *
+ * castRay() walks the array exactly the way the shader does, so
+ * renderReference() gives a CPU image to compare the GPU output
+ * against.
+ *
+ * The tree is built bottom up, a block of 8 children at a time. With
+ * deduplication on (the default), a block identical to one already
+ * stored is shared instead of stored again. Since a block's interior
+ * children are themselves shared blocks, identical subtrees anywhere
+ * in the tree end up stored once, which turns it into a DAG (nothing
+ * reading it needs to know). Each block counts the nodes pointing at
+ * it, and setVoxel() copies the shared blocks on its path before
+ * changing anything, so an edit never shows up anywhere else.
+\* ---------------------------------------------------------------- */
+
+#ifndef SVO_HPP
+#define SVO_HPP
+
+#include <array>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "anthrax_types.hpp"
+
+namespace Anthrax
+{
+
+struct SvoHit
+{
+  bool hit = false;
+  uint16_t type = 0;
+  uint8_t face = 0; // Same order as Cube::render_face_: left, right, bottom, top, front(-z), back(+z)
+  float distance = 0.0f;
+};
+
+
+class Svo
+{
+public:
+  static constexpr uint32_t LEAF_BIT = 0x80000000u;
+
+  Svo() { reset(vec3<int64_t>(0, 0, 0), 0); }
+  void reset(vec3<int64_t> origin, unsigned int layer); // Leaves just an empty root
+  void setDeduplicate(bool deduplicate) { deduplicate_ = deduplicate; } // For blocks added from then on
+  static uint32_t makeLeaf(uint16_t type) { return LEAF_BIT | type; }
+  // The node for a parent of these children (nodes from makeLeaf or earlier calls, each handed
+  // over to the parent): an empty leaf if they all are, otherwise an interior node
+  uint32_t addChildren(const uint32_t *children);
+  void setRoot(uint32_t node);
+  // Copy-on-write edit of a single voxel. Only where the tree is already down to single voxels -
+  // false if the voxel is outside the root or inside a coarser leaf, which needs a rebuild
+  bool setVoxel(vec3<int64_t> position, uint16_t type);
+
+  const std::vector<uint32_t> &getNodes() const { return nodes_; }
+  vec3<int64_t> getOrigin() const { return origin_; }
+  unsigned int getLayer() const { return layer_; }
+  std::set<uint16_t> getTypes() const; // Every non-empty leaf type
+  uint64_t getMemoryUsage() const { return nodes_.size() * sizeof(uint32_t); }
+  uint64_t getNumBlocksAdded() const { return num_blocks_added_; } // Since reset, as if nothing were shared
+  uint64_t getNumBlocks() const { return block_references_.size() - free_blocks_.size(); } // Stored
+
+  // origin is relative to the root's min corner, in world axes. direction must be unit length
+  SvoHit castRay(vec3<float> origin, vec3<float> direction, float max_distance) const;
+  // One ray per pixel, row 0 at the top, from a camera set up the same way as Camera::GetViewMatrix
+  // (forward and up in world axes) with a glm::perspective projection
+  std::vector<SvoHit> renderReference(vec3<double> camera_position, vec3<float> forward, vec3<float> up,
+                                      float vertical_fov, unsigned int width, unsigned int height, float max_distance) const;
+  // The unit direction (in world axes) of the ray through the center of each pixel, in the same order
+  static std::vector<vec3<float>> getPixelDirections(vec3<float> forward, vec3<float> up, float vertical_fov, unsigned int width, unsigned int height);
+
+  // Flat palette by type, shaded by face, so images from different renderers can be compared
+  static void getDebugColor(const SvoHit &hit, unsigned char *rgb);
+  static bool writeDebugImage(std::string filename, unsigned int width, unsigned int height, const std::vector<SvoHit> &hits, std::string comment);
+private:
+  typedef std::array<uint32_t, 8> Block;
+  struct BlockHash
+  {
+    size_t operator()(const Block &block) const
+    {
+      uint64_t hash = 1469598103934665603ULL;
+      for (unsigned int i = 0; i < 8; i++) hash = (hash ^ block[i]) * 1099511628211ULL;
+      return hash;
+    }
+  };
+
+  uint32_t newBlock(const uint32_t *children); // Takes over the children's references
+  void releaseNode(uint32_t node); // Frees its block once nothing points at it
+  void forgetBlock(uint32_t first_child); // Before it's changed in place, so nothing new shares it
+  static uint32_t getBlockId(uint32_t first_child) { return (first_child - 1) / 8; } // Blocks start after the root
+
+  std::vector<uint32_t> nodes_;
+  vec3<int64_t> origin_;
+  unsigned int layer_;
+  bool deduplicate_ = true;
+  std::unordered_map<Block, uint32_t, BlockHash> blocks_by_children_; // First child of each shared block
+  std::vector<uint32_t> block_references_; // By block id, how many nodes point at it
+  std::vector<uint32_t> free_blocks_;
+  uint64_t num_blocks_added_ = 0;
+};
+
+} // namespace Anthrax
+#endif // SVO_HPP
@@ -9,6 +9,7 @@
 #include "cube.hpp"
 #include "list.hpp"
 #include <vector>
+#include <map>
 
 #define KB(x) ((size_t) (x) << 10)
 #define MB(x) ((size_t) (x) << 20)
@@ -26,7 +27,13 @@ public:
   void initialize(size_t cache_size, bool (*cache_decision_function)(glm::vec3));
   void addCubes(Cube *new_cubes, int num_new_cubes);
   void addCube(std::weak_ptr<Cube> new_cube);
+  void addCubes(List<Cube> &new_cubes); // Splices them all onto the display list, leaving new_cubes empty
   void renderCubes();
+  unsigned int getMaterialTexture() const { return material_texture_; }
+  unsigned int getMaterialIndex(Cube *cube); // Adds the cube's material to the table the first time its type is seen
+  uint16_t getMaterialType(unsigned int material_index); // The cube type a material index was assigned to
+  // Cube positions are sent relative to this (the renderer's origin) - changing it sends them all again
+  void setOrigin(vec3<int64_t> origin);
 
   void updateCache();
 
@@ -43,7 +50,14 @@ private:
 
   List<Cube> voxel_display_list_;
 
+  // Material table - cubes reference their material by index instead of carrying it per instance
+  unsigned int material_texture_;
+  unsigned int max_num_materials_;
+  std::map<uint16_t, unsigned int> material_indices_; // Maps a cube type ID to its material index
+
   std::weak_ptr<Cube> *cache_emulator_;
+  vec3<int64_t> origin_ = vec3<int64_t>(0, 0, 0);
+  bool origin_changed_ = false; // Every cube in the cache is relative to the old one
 
   bool (*cacheDecisionFunction)(glm::vec3);
 };
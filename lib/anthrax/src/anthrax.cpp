@@ -4,6 +4,8 @@
  * Date Created: 2023-12-10
 \* ---------------------------------------------------------------- */
 
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <random>
 #include "anthrax.hpp"
@@ -24,6 +26,8 @@ float Anthrax::lastFrame;
 bool Anthrax::wireframe_mode_;
 bool Anthrax::ambient_occlusion_ = true;
 bool Anthrax::window_size_changed_ = true;
+bool Anthrax::debug_image_requested_ = false;
+Anthrax::RenderType Anthrax::render_type_ = Anthrax::NO_SHADOWS;
 
 
 Anthrax::Anthrax()
@@ -80,6 +84,7 @@ int Anthrax::startWindow()
     std::cout << "Failed to initialize GLAD" << std::endl;
     return -1;
   }
+  Profiler::initializeGpuTimers();
 
   // build and compile our shader programs
   // -------------------------------------
@@ -90,18 +95,21 @@ int Anthrax::startWindow()
 
   lighting_pass_shader_ = new Shader(Shader::ShaderInputType::CODESTRING, lighting_pass_vshader.c_str(), lighting_pass_fshader.c_str());
 
+  svo_pass_shader_ = new Shader(Shader::ShaderInputType::CODESTRING, svo_pass_vshader.c_str(), svo_pass_fshader.c_str());
+
   ssao_pass_shader_->use();
-  ssao_pass_shader_->setInt("g_position_texture_", 0);
-  ssao_pass_shader_->setInt("g_normal_texture_", 1);
+  ssao_pass_shader_->setInt("g_depth_texture_", 0);
+  ssao_pass_shader_->setInt("g_surface_texture_", 1);
   ssao_pass_shader_->setInt("ssao_noise_texture_", 2);
   ssao_blur_pass_shader_->use();
   ssao_blur_pass_shader_->setInt("ssao_texture_", 0);
   lighting_pass_shader_->use();
-  lighting_pass_shader_->setInt("g_position_texture_", 0);
-  lighting_pass_shader_->setInt("g_normal_texture_", 1);
-  lighting_pass_shader_->setInt("g_color_texture_", 2);
-  lighting_pass_shader_->setInt("g_material_texture_", 3);
-  lighting_pass_shader_->setInt("ssao_texture_", 4);
+  lighting_pass_shader_->setInt("g_depth_texture_", 0);
+  lighting_pass_shader_->setInt("g_surface_texture_", 1);
+  lighting_pass_shader_->setInt("material_texture_", 2);
+  lighting_pass_shader_->setInt("ssao_texture_", 3);
+  svo_pass_shader_->use();
+  svo_pass_shader_->setInt("svo_nodes", 0);
 
   gBufferSetup();
   ssaoFramebufferSetup();
@@ -149,38 +157,59 @@ int Anthrax::renderFrame()
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
   }
 
-  // Update the voxel cache
+  // Update the voxel cache - not needed when ray-marching, since no cubes are drawn
   // Temporary: give player position to cache manager
-  voxel_cache_manager_->view_position_ = camera.position_;
-  voxel_cache_manager_->updateCache();
+  if (render_type_ != RAYTRACED)
+  {
+    voxel_cache_manager_->view_position_ = camera.position_;
+    ScopedTimer timer("cache_update");
+    voxel_cache_manager_->updateCache();
+  }
 
   // render
   glBindFramebuffer(GL_FRAMEBUFFER, g_buffer_);
   glEnable(GL_DEPTH_TEST);
   //glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); 
+  // The surface buffer is an integer texture, so it can't be cleared by glClear
+  GLuint clear_surface[4] = {0, 0, 0, 0};
+  glClearBufferuiv(GL_COLOR, 0, clear_surface);
+  glClear(GL_DEPTH_BUFFER_BIT); 
 
   // Render the scene to the g-buffer
-  renderScene();
+  Profiler::beginGpuScope("gbuffer");
+  if (render_type_ == RAYTRACED) renderSvo();
+  else renderScene();
+  Profiler::endGpuScope();
+  if (debug_image_requested_)
+  {
+    if (writeDebugImage("frame.ppm")) std::cout << "Wrote frame.ppm" << std::endl;
+    debug_image_requested_ = false;
+  }
 
   glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
   glDisable(GL_DEPTH_TEST);
 
   // SSAO pass
+  Profiler::beginGpuScope("ssao");
   glBindFramebuffer(GL_FRAMEBUFFER, ssao_framebuffer_);
   glClear(GL_COLOR_BUFFER_BIT);
   ssao_pass_shader_->use();
   glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, g_position_texture_);
+  glBindTexture(GL_TEXTURE_2D, g_depth_texture_);
   glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, g_normal_texture_);
-  ssao_pass_shader_->setMat4("view", camera.GetViewMatrix());
+  glBindTexture(GL_TEXTURE_2D, g_surface_texture_);
+  glm::mat4 view = camera.GetViewMatrix();
   glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)window_width_ / (float)window_height_, 0.1f, (float)render_distance_);
+  ssao_pass_shader_->setMat4("view", view);
   ssao_pass_shader_->setMat4("projection", projection);
+  ssao_pass_shader_->setMat4("inverse_view", glm::inverse(view));
+  ssao_pass_shader_->setMat4("inverse_projection", glm::inverse(projection));
   ssao_pass_shader_->setFloat("do_ambient_occlusion", ambient_occlusion_ ? 1.0 : 0.0);
   renderQuad();
+  Profiler::endGpuScope();
 
   // SSAO blur pass
+  Profiler::beginGpuScope("ssao_blur");
   glBindFramebuffer(GL_FRAMEBUFFER, ssao_blur_framebuffer_);
   glClear(GL_COLOR_BUFFER_BIT);
   ssao_blur_pass_shader_->use();
@@ -188,28 +217,30 @@ int Anthrax::renderFrame()
   glBindTexture(GL_TEXTURE_2D, ssao_texture_);
   ssao_blur_pass_shader_->setFloat("blur_radius", 1.0);
   renderQuad();
+  Profiler::endGpuScope();
 
   // Go back the default framebuffer and draw the scene to the screen
   // Lighting pass
+  Profiler::beginGpuScope("lighting");
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
   glClear(GL_COLOR_BUFFER_BIT);
   lighting_pass_shader_->use();
   glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, g_position_texture_);
+  glBindTexture(GL_TEXTURE_2D, g_depth_texture_);
   glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, g_normal_texture_);
+  glBindTexture(GL_TEXTURE_2D, g_surface_texture_);
   glActiveTexture(GL_TEXTURE2);
-  glBindTexture(GL_TEXTURE_2D, g_color_texture_);
+  glBindTexture(GL_TEXTURE_2D, voxel_cache_manager_->getMaterialTexture());
   glActiveTexture(GL_TEXTURE3);
-  glBindTexture(GL_TEXTURE_2D, g_material_texture_);
-  glActiveTexture(GL_TEXTURE4);
   glBindTexture(GL_TEXTURE_2D, ssao_blurred_texture_);
   lighting_pass_shader_->setVec3("view_position", camera.position_);
+  lighting_pass_shader_->setMat4("inverse_view_projection", glm::inverse(projection * view));
   lighting_pass_shader_->setVec3("sunlight.direction", glm::vec3(glm::cos(glfwGetTime()/16), glm::sin(glfwGetTime()/16), 0.0f));
   lighting_pass_shader_->setVec3("sunlight.ambient", glm::vec3(0.5, 0.5, 0.7));
   lighting_pass_shader_->setVec3("sunlight.diffuse", glm::vec3(0.4, 0.4, 0.2));
   lighting_pass_shader_->setVec3("sunlight.specular", glm::vec3(0.3));
   renderQuad();
+  Profiler::endGpuScope();
 
   // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
   // -------------------------------------------------------------------------------
@@ -222,13 +253,11 @@ int Anthrax::renderFrame()
     delete ssao_pass_shader_;
     delete ssao_blur_pass_shader_;
     delete lighting_pass_shader_;
+    delete svo_pass_shader_;
 
     glDeleteFramebuffers(1, &g_buffer_);
-    glDeleteTextures(1, &g_position_texture_);
-    glDeleteTextures(1, &g_normal_texture_);
-    glDeleteTextures(1, &g_color_texture_);
-    glDeleteTextures(1, &g_material_texture_);
-    glDeleteRenderbuffers(1, &g_depth_rbo_);
+    glDeleteTextures(1, &g_surface_texture_);
+    glDeleteTextures(1, &g_depth_texture_);
 
     glDeleteFramebuffers(1, &ssao_framebuffer_);
     glDeleteTextures(1, &ssao_texture_);
@@ -238,6 +267,9 @@ int Anthrax::renderFrame()
     glDeleteVertexArrays(1, &quad_vao_);
     glDeleteBuffers(1, &quad_vbo_);
 
+    glDeleteTextures(1, &svo_texture_);
+    glDeleteBuffers(1, &svo_buffer_);
+
     delete voxel_cache_manager_;
     // glfw: terminate, clearing all previously allocated GLFW resources.
     glfwTerminate();
@@ -268,69 +300,144 @@ void Anthrax::renderScene()
 }
 
 
-void Anthrax::gBufferSetup()
+void Anthrax::renderSvo()
 {
-  if (g_buffer_ == 0)
+  if (svo_texture_ == 0) return; // Nothing uploaded yet
+  glm::mat4 view = camera.GetViewMatrix();
+  glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)window_width_ / (float)window_height_, 0.1f, (float)render_distance_);
+  // The camera relative to the root's min corner - both origins can be far from 0, so they're
+  // subtracted as integers first
+  vec3<float> svo_camera((float)(render_origin_.getX() - svo_origin_.getX()) + camera.position_.x + 0.5f,
+                         (float)(render_origin_.getY() - svo_origin_.getY()) + camera.position_.y + 0.5f,
+                         (float)(render_origin_.getZ() - svo_origin_.getZ()) - camera.position_.z + 0.5f);
+
+  svo_pass_shader_->use();
+  svo_pass_shader_->setFloat("svo_size", (float)(1ULL << svo_layer_));
+  svo_pass_shader_->setVec3("svo_camera", svo_camera.toGLM());
+  svo_pass_shader_->setVec3("camera_position", camera.position_);
+  svo_pass_shader_->setMat4("inverse_view_projection", glm::inverse(projection * view));
+  svo_pass_shader_->setMat4("view_projection", projection * view);
+  svo_pass_shader_->setFloat("max_distance", (float)render_distance_);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, svo_texture_);
+  renderQuad();
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+
+void Anthrax::setSvo(const Svo &svo, const std::map<uint16_t, Cube> &materials)
+{
+  // Swap voxel types for material indices (+1, so 0 can still mean empty) on the way to the GPU
+  const std::vector<uint32_t> &nodes = svo.getNodes();
+  std::vector<uint32_t> gpu_nodes(nodes.size());
+  std::map<uint16_t, uint32_t> material_indices;
+  for (std::map<uint16_t, Cube>::const_iterator itr = materials.begin(); itr != materials.end(); itr++)
   {
-    glGenFramebuffers(1, &g_buffer_);
+    Cube cube = itr->second;
+    material_indices[itr->first] = voxel_cache_manager_->getMaterialIndex(&cube) + 1;
+  }
+  for (unsigned int i = 0; i < nodes.size(); i++)
+  {
+    uint32_t node = nodes[i];
+    if ((node & Svo::LEAF_BIT) && (node & 0xFFFF))
+    {
+      std::map<uint16_t, uint32_t>::iterator itr = material_indices.find(node & 0xFFFF);
+      node = Svo::LEAF_BIT | (itr != material_indices.end() ? itr->second : 1);
+    }
+    gpu_nodes[i] = node;
   }
-  glBindFramebuffer(GL_FRAMEBUFFER, g_buffer_);
 
-  if (g_position_texture_ == 0)
+  if (svo_buffer_ == 0)
   {
-    glGenTextures(1, &g_position_texture_);
+    glGenBuffers(1, &svo_buffer_);
+    glGenTextures(1, &svo_texture_);
   }
-  if (g_normal_texture_ == 0)
+  glBindBuffer(GL_TEXTURE_BUFFER, svo_buffer_);
+  glBufferData(GL_TEXTURE_BUFFER, gpu_nodes.size() * sizeof(uint32_t), gpu_nodes.data(), GL_STATIC_DRAW);
+  glBindTexture(GL_TEXTURE_BUFFER, svo_texture_);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, svo_buffer_);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  Profiler::addCounter(Profiler::BYTES_UPLOADED, gpu_nodes.size() * sizeof(uint32_t));
+  svo_layer_ = svo.getLayer();
+  svo_origin_ = svo.getOrigin();
+}
+
+
+bool Anthrax::writeDebugImage(std::string filename)
+{
+  // Read back the g-buffer rather than the final image, so lighting and SSAO don't get in the way
+  std::vector<GLushort> surface(window_width_ * window_height_ * 2);
+  std::vector<GLfloat> depth(window_width_ * window_height_);
+  glBindFramebuffer(GL_FRAMEBUFFER, g_buffer_);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, window_width_, window_height_, GL_RG_INTEGER, GL_UNSIGNED_SHORT, surface.data());
+  glReadPixels(0, 0, window_width_, window_height_, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  std::vector<SvoHit> hits(window_width_ * window_height_);
+  for (unsigned int y = 0; y < window_height_; y++)
   {
-    glGenTextures(1, &g_normal_texture_);
+    for (unsigned int x = 0; x < window_width_; x++)
+    {
+      unsigned int source = (window_height_ - 1 - y) * window_width_ + x; // GL rows start at the bottom
+      SvoHit &hit = hits[y * window_width_ + x];
+      hit.hit = depth[source] < 1.0f;
+      hit.type = voxel_cache_manager_->getMaterialType(surface[2*source]);
+      hit.face = surface[2*source + 1];
+    }
   }
-  if (g_color_texture_ == 0)
+
+  // Enough to set up the same view in Svo::renderReference: position, forward, up (world axes) and vertical FOV
+  glm::vec3 forward = camera.rotation_ * glm::vec3(0.0f, 0.0f, 1.0f);
+  glm::vec3 up = camera.rotation_ * glm::vec3(0.0f, 1.0f, 0.0f);
+  std::string comment = "camera " + std::to_string((double)render_origin_.getX() + camera.position_.x) + " " + std::to_string((double)render_origin_.getY() + camera.position_.y)
+      + " " + std::to_string((double)render_origin_.getZ() - camera.position_.z)
+      + " " + std::to_string(forward.x) + " " + std::to_string(forward.y) + " " + std::to_string(forward.z)
+      + " " + std::to_string(up.x) + " " + std::to_string(up.y) + " " + std::to_string(up.z)
+      + " " + std::to_string(glm::radians(camera.Zoom)) + " " + std::to_string(render_distance_);
+  return Svo::writeDebugImage(filename, window_width_, window_height_, hits, comment);
+}
+
+
+void Anthrax::gBufferSetup()
+{
+  if (g_buffer_ == 0)
   {
-    glGenTextures(1, &g_color_texture_);
+    glGenFramebuffers(1, &g_buffer_);
   }
-  if (g_material_texture_ == 0)
+  glBindFramebuffer(GL_FRAMEBUFFER, g_buffer_);
+
+  if (g_surface_texture_ == 0)
   {
-    glGenTextures(1, &g_material_texture_);
+    glGenTextures(1, &g_surface_texture_);
   }
-  if (g_depth_rbo_ == 0)
+  if (g_depth_texture_ == 0)
   {
-    glGenRenderbuffers(1, &g_depth_rbo_);
+    glGenTextures(1, &g_depth_texture_);
   }
 
-  // position color buffer
-  glBindTexture(GL_TEXTURE_2D, g_position_texture_);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, window_width_, window_height_, 0, GL_RGBA, GL_FLOAT, NULL);
+  // surface buffer - material index and face index of each fragment
+  glBindTexture(GL_TEXTURE_2D, g_surface_texture_);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16UI, window_width_, window_height_, 0, GL_RG_INTEGER, GL_UNSIGNED_SHORT, NULL);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, g_position_texture_, 0);
-  // normal color buffer
-  glBindTexture(GL_TEXTURE_2D, g_normal_texture_);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, window_width_, window_height_, 0, GL_RGBA, GL_FLOAT, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, g_normal_texture_, 0);
-  // color buffer
-  glBindTexture(GL_TEXTURE_2D, g_color_texture_);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, window_width_, window_height_, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, g_color_texture_, 0);
-  // material buffer
-  glBindTexture(GL_TEXTURE_2D, g_material_texture_);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, window_width_, window_height_, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, g_material_texture_, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, g_surface_texture_, 0);
 
   // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering 
-  unsigned int attachments[4] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
-  glDrawBuffers(4, attachments);
-  // create and attach depth buffer (renderbuffer)
-  glBindRenderbuffer(GL_RENDERBUFFER, g_depth_rbo_);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, window_width_, window_height_);
-  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, g_depth_rbo_);
+  unsigned int attachments[1] = { GL_COLOR_ATTACHMENT0 };
+  glDrawBuffers(1, attachments);
+  // create and attach depth buffer - this is a texture so positions can be reconstructed from it
+  glBindTexture(GL_TEXTURE_2D, g_depth_texture_);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, window_width_, window_height_, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, g_depth_texture_, 0);
 
   // finally check if framebuffer is complete
   if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
@@ -422,7 +529,7 @@ void Anthrax::ssaoKernelSetup()
     //scale = lerp(0.1f, 1.0f, scale * scale);
     scale = 1.0f + scale * scale * (1.0f - 0.1f);
     sample *= scale;
-    ssao_pass_shader_->setVec3("samples[" + std::to_string(i) + "]", sample);
+    ssao_pass_shader_->setVec3(("samples[" + std::to_string(i) + "]").c_str(), sample);
   }
 
 
@@ -471,6 +578,26 @@ void Anthrax::key_callback(GLFWwindow *window, int key, int scancode, int action
       ambient_occlusion_ = true;
     }
   }
+
+  if (key == GLFW_KEY_F2 && action  == GLFW_PRESS)
+  {
+    render_type_ = (render_type_ == RAYTRACED) ? NO_SHADOWS : RAYTRACED;
+    std::cout << (render_type_ == RAYTRACED ? "Ray-marching the SVO" : "Rasterizing cubes") << std::endl;
+  }
+
+  if (key == GLFW_KEY_F4 && action  == GLFW_PRESS)
+  {
+    debug_image_requested_ = true;
+  }
+
+  if (key == GLFW_KEY_F3 && action  == GLFW_PRESS)
+  {
+    // Dump the most recent profiling data
+    if (Profiler::dumpCSV("profile.csv") && Profiler::dumpChromeTrace("profile.json"))
+    {
+      std::cout << "Wrote profile.csv and profile.json" << std::endl;
+    }
+  }
 }
 
 
@@ -578,9 +705,27 @@ void Anthrax::addVoxel(std::weak_ptr<Cube> cube)
   voxel_cache_manager_->addCube(cube);
 }
 
+void Anthrax::addVoxels(List<Cube> &cubes)
+{
+  voxel_cache_manager_->addCubes(cubes);
+}
+
 void Anthrax::setCameraPosition(vec3<float> position)
 {
-  camera.setPosition(glm::vec3(position.getX(), position.getY(), position.getZ()));
+  vec3<int64_t> origin((int64_t)floor(position.getX()), (int64_t)floor(position.getY()), (int64_t)floor(position.getZ()));
+  setCameraPosition(origin, vec3<float>(position.getX() - origin.getX(), position.getY() - origin.getY(), position.getZ() - origin.getZ()));
+}
+
+void Anthrax::setCameraPosition(vec3<int64_t> origin, vec3<float> offset)
+{
+  vec3<int64_t> from_render_origin = origin - render_origin_;
+  if (std::abs(from_render_origin.getX()) > rebase_distance_ || std::abs(from_render_origin.getY()) > rebase_distance_ || std::abs(from_render_origin.getZ()) > rebase_distance_)
+  {
+    render_origin_ = origin;
+    from_render_origin = vec3<int64_t>(0, 0, 0);
+    if (voxel_cache_manager_ != nullptr) voxel_cache_manager_->setOrigin(render_origin_);
+  }
+  camera.setPosition(glm::vec3(from_render_origin.getX() + offset.getX(), from_render_origin.getY() + offset.getY(), from_render_origin.getZ() + offset.getZ()));
 }
 
 void Anthrax::setCameraRotation(Quaternion rotation)
@@ -588,4 +733,16 @@ void Anthrax::setCameraRotation(Quaternion rotation)
   camera.setRotation(glm::quat(rotation.getW(), rotation.getX(), rotation.getY(), rotation.getZ()));
 }
 
+vec3<float> Anthrax::getLookDirection()
+{
+  // The camera flips z (see Camera::GetViewMatrix), so +z is forward in world space
+  glm::vec3 forward = camera.rotation_ * glm::vec3(0.0f, 0.0f, 1.0f);
+  return vec3<float>(forward.x, forward.y, forward.z);
+}
+
+float Anthrax::getTimeSinceLastFrame() const
+{
+  return deltaTime; // Seconds, measured at the start of renderFrame
+}
+
 } // namespace Anthrax
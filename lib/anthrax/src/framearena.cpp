@@ -0,0 +1,81 @@
+/* ---------------------------------------------------------------- *\
+ * framearena.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+#include "framearena.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace Anthrax
+{
+
+FrameArena::~FrameArena()
+{
+  for (unsigned int i = 0; i < chunks_.size(); i++) free(chunks_[i].data);
+}
+
+
+void *FrameArena::allocate(size_t num_bytes, size_t alignment)
+{
+  size_t start = 0;
+  if (!chunks_.empty())
+  {
+    Chunk &chunk = chunks_.back();
+    // Aligned against the address, not the offset - malloc only promises max_align_t
+    uintptr_t address = reinterpret_cast<uintptr_t>(chunk.data) + offset_;
+    start = offset_ + (alignment - address % alignment) % alignment;
+  }
+  if (chunks_.empty() || start + num_bytes > chunks_.back().size)
+  {
+    // Out of room - the next reset makes the arena big enough for this frame as a whole
+    size_t size = std::max(min_chunk_size_, num_bytes + alignment);
+    if (!chunks_.empty()) size = std::max(size, 2*chunks_.back().size);
+    char *data = static_cast<char*>(malloc(size));
+    if (data == nullptr) throw std::bad_alloc();
+    chunks_.push_back({data, size});
+    uintptr_t address = reinterpret_cast<uintptr_t>(data);
+    start = (alignment - address % alignment) % alignment;
+  }
+  offset_ = start + num_bytes;
+  bytes_used_ += num_bytes;
+  Profiler::addCounter(Profiler::FRAME_ARENA_BYTES, num_bytes);
+  return chunks_.back().data + start;
+}
+
+
+void FrameArena::reset()
+{
+  if (chunks_.size() > 1)
+  {
+    size_t size = getCapacity();
+    for (unsigned int i = 0; i < chunks_.size(); i++) free(chunks_[i].data);
+    chunks_.clear();
+    char *data = static_cast<char*>(malloc(size));
+    if (data == nullptr) throw std::bad_alloc();
+    chunks_.push_back({data, size});
+  }
+  offset_ = 0;
+  bytes_used_ = 0;
+}
+
+
+size_t FrameArena::getCapacity() const
+{
+  size_t capacity = 0;
+  for (unsigned int i = 0; i < chunks_.size(); i++) capacity += chunks_[i].size;
+  return capacity;
+}
+
+
+FrameArena &FrameArena::getFrameArena()
+{
+  static FrameArena frame_arena;
+  return frame_arena;
+}
+
+} // namespace Anthrax
@@ -0,0 +1,280 @@
+/* ---------------------------------------------------------------- *\
+ * profiler.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+#include "profiler.hpp"
+
+#include <glad/glad.h>
+#include <fstream>
+
+namespace Anthrax
+{
+
+// Initialize static member variables
+bool Profiler::enabled_ = true;
+std::chrono::steady_clock::time_point Profiler::epoch_ = std::chrono::steady_clock::now();
+Profiler::FrameRecord Profiler::frames_[max_frames_];
+uint64_t Profiler::num_frames_ = 0;
+uint64_t Profiler::frame_start_us_ = 0;
+Profiler::TimerEvent Profiler::events_[max_events_];
+uint64_t Profiler::num_events_ = 0;
+const char *Profiler::open_scope_names_[max_open_scopes_];
+uint64_t Profiler::open_scope_starts_[max_open_scopes_];
+unsigned int Profiler::num_open_scopes_ = 0;
+std::atomic<uint64_t> Profiler::counters_[NUM_COUNTERS];
+bool Profiler::gpu_timers_initialized_ = false;
+unsigned int Profiler::gpu_queries_[gpu_frames_in_flight_][max_gpu_scopes_][2];
+Profiler::GpuScope Profiler::gpu_scopes_[gpu_frames_in_flight_][max_gpu_scopes_];
+unsigned int Profiler::num_gpu_scopes_[gpu_frames_in_flight_] = {0};
+uint64_t Profiler::gpu_frame_numbers_[gpu_frames_in_flight_] = {0};
+uint64_t Profiler::gpu_frame_starts_[gpu_frames_in_flight_] = {0};
+unsigned int Profiler::gpu_scope_stack_[max_gpu_scopes_];
+unsigned int Profiler::gpu_scope_depth_ = 0;
+
+
+uint64_t Profiler::now()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch_).count();
+}
+
+
+void Profiler::beginFrame()
+{
+  frame_start_us_ = now();
+  if (!gpu_timers_initialized_) return;
+
+  // Reuse the oldest set of GPU queries - read back what they measured first
+  unsigned int slot = num_frames_ % gpu_frames_in_flight_;
+  collectGpuFrame(slot);
+  num_gpu_scopes_[slot] = 0;
+  gpu_frame_numbers_[slot] = num_frames_;
+  gpu_frame_starts_[slot] = frame_start_us_;
+  gpu_scope_depth_ = 0;
+}
+
+
+void Profiler::endFrame()
+{
+  FrameRecord &frame = frames_[num_frames_ % max_frames_];
+  frame.frame_number = num_frames_;
+  frame.start_us = frame_start_us_;
+  frame.duration_us = now() - frame_start_us_;
+  for (unsigned int i = 0; i < NUM_COUNTERS; i++)
+  {
+    frame.counters[i] = counters_[i].exchange(0, std::memory_order_relaxed);
+  }
+  num_frames_++;
+}
+
+
+void Profiler::beginScope(const char *name)
+{
+  if (num_open_scopes_ >= max_open_scopes_) return;
+  open_scope_names_[num_open_scopes_] = name;
+  open_scope_starts_[num_open_scopes_] = enabled_ ? now() : 0;
+  num_open_scopes_++;
+}
+
+
+void Profiler::endScope()
+{
+  if (num_open_scopes_ == 0) return;
+  num_open_scopes_--;
+  if (!enabled_ || open_scope_starts_[num_open_scopes_] == 0) return;
+  uint64_t start = open_scope_starts_[num_open_scopes_];
+  pushEvent(open_scope_names_[num_open_scopes_], start, now() - start, num_open_scopes_, false, num_frames_);
+}
+
+
+void Profiler::initializeGpuTimers()
+{
+  if (gpu_timers_initialized_) return;
+  for (unsigned int i = 0; i < gpu_frames_in_flight_; i++)
+  {
+    glGenQueries(2*max_gpu_scopes_, &(gpu_queries_[i][0][0]));
+  }
+  gpu_timers_initialized_ = true;
+}
+
+
+void Profiler::beginGpuScope(const char *name)
+{
+  if (!enabled_ || !gpu_timers_initialized_) return;
+  unsigned int slot = num_frames_ % gpu_frames_in_flight_;
+  if (num_gpu_scopes_[slot] >= max_gpu_scopes_ || gpu_scope_depth_ >= max_gpu_scopes_) return;
+  unsigned int scope = num_gpu_scopes_[slot]++;
+  gpu_scopes_[slot][scope].name = name;
+  gpu_scopes_[slot][scope].depth = gpu_scope_depth_;
+  gpu_scope_stack_[gpu_scope_depth_++] = scope;
+  // Timestamps (rather than GL_TIME_ELAPSED) allow scopes to be nested
+  glQueryCounter(gpu_queries_[slot][scope][0], GL_TIMESTAMP);
+}
+
+
+void Profiler::endGpuScope()
+{
+  if (!enabled_ || !gpu_timers_initialized_ || gpu_scope_depth_ == 0) return;
+  unsigned int slot = num_frames_ % gpu_frames_in_flight_;
+  unsigned int scope = gpu_scope_stack_[--gpu_scope_depth_];
+  glQueryCounter(gpu_queries_[slot][scope][1], GL_TIMESTAMP);
+}
+
+
+void Profiler::collectGpuFrame(unsigned int slot)
+{
+  unsigned int num_scopes = num_gpu_scopes_[slot];
+  if (num_scopes == 0) return;
+
+  GLint available = 0;
+  glGetQueryObjectiv(gpu_queries_[slot][num_scopes-1][1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+  {
+    // Don't stall waiting for the GPU - just drop this frame's GPU timings
+    return;
+  }
+  GLuint64 frame_base = 0;
+  for (unsigned int i = 0; i < num_scopes; i++)
+  {
+    GLuint64 begin, end;
+    glGetQueryObjectui64v(gpu_queries_[slot][i][0], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(gpu_queries_[slot][i][1], GL_QUERY_RESULT, &end);
+    if (i == 0) frame_base = begin;
+    // GPU timestamps are on their own clock, so line them up with the start of the CPU frame
+    pushEvent(gpu_scopes_[slot][i].name, gpu_frame_starts_[slot] + (begin - frame_base)/1000, (end - begin)/1000,
+        gpu_scopes_[slot][i].depth, true, gpu_frame_numbers_[slot]);
+  }
+}
+
+
+void Profiler::pushEvent(const char *name, uint64_t start_us, uint64_t duration_us, uint8_t depth, bool gpu, uint64_t frame_number)
+{
+  TimerEvent &event = events_[num_events_ % max_events_];
+  event.name = name;
+  event.frame_number = frame_number;
+  event.start_us = start_us;
+  event.duration_us = duration_us;
+  event.depth = depth;
+  event.gpu = gpu;
+  num_events_++;
+}
+
+
+float Profiler::getAverageFrameTime(unsigned int num_frames)
+{
+  if (num_frames > num_frames_) num_frames = num_frames_;
+  if (num_frames > max_frames_) num_frames = max_frames_;
+  if (num_frames == 0) return 0.0;
+  uint64_t total = 0;
+  for (uint64_t i = num_frames_ - num_frames; i < num_frames_; i++)
+  {
+    total += frames_[i % max_frames_].duration_us;
+  }
+  return (total / 1000.0f) / num_frames;
+}
+
+
+uint64_t Profiler::getLastFrameCounter(Counter counter)
+{
+  if (num_frames_ == 0) return 0;
+  return frames_[(num_frames_ - 1) % max_frames_].counters[counter];
+}
+
+
+const char *Profiler::getCounterName(Counter counter)
+{
+  switch (counter)
+  {
+    case NODES_LOADED:
+      return "nodes_loaded";
+    case CUBES_CREATED:
+      return "cubes_created";
+    case ZONE_FILES_READ:
+      return "zone_files_read";
+    case BYTES_UPLOADED:
+      return "bytes_uploaded";
+    case ZONE_CACHE_HITS:
+      return "zone_cache_hits";
+    case ZONE_CACHE_MISSES:
+      return "zone_cache_misses";
+    case LOD_SPLITS:
+      return "lod_splits";
+    case LOD_MERGES:
+      return "lod_merges";
+    case NODES_EDITED:
+      return "nodes_edited";
+    case ZONES_WRITTEN:
+      return "zones_written";
+    case ALLOCATIONS:
+      return "allocations";
+    case FRAME_ARENA_BYTES:
+      return "frame_arena_bytes";
+    default:
+      return "unknown";
+  }
+}
+
+
+bool Profiler::dumpCSV(std::string filepath)
+{
+  std::ofstream file(filepath);
+  if (!file) return false;
+
+  file << "frame,type,name,start_us,duration_us,value\n";
+  uint64_t first_frame = num_frames_ > max_frames_ ? num_frames_ - max_frames_ : 0;
+  for (uint64_t i = first_frame; i < num_frames_; i++)
+  {
+    FrameRecord &frame = frames_[i % max_frames_];
+    file << frame.frame_number << ",frame,frame," << frame.start_us << "," << frame.duration_us << ",\n";
+    for (unsigned int j = 0; j < NUM_COUNTERS; j++)
+    {
+      file << frame.frame_number << ",counter," << getCounterName(static_cast<Counter>(j)) << "," << frame.start_us << ",," << frame.counters[j] << "\n";
+    }
+  }
+  uint64_t first_event = num_events_ > max_events_ ? num_events_ - max_events_ : 0;
+  for (uint64_t i = first_event; i < num_events_; i++)
+  {
+    TimerEvent &event = events_[i % max_events_];
+    file << event.frame_number << "," << (event.gpu ? "gpu" : "cpu") << "," << event.name << "," << event.start_us << "," << event.duration_us << "," << (int)event.depth << "\n";
+  }
+  return true;
+}
+
+
+bool Profiler::dumpChromeTrace(std::string filepath)
+{
+  std::ofstream file(filepath);
+  if (!file) return false;
+
+  // CPU scopes go on thread 0 and GPU scopes on thread 1 of the same process
+  file << "{\"traceEvents\":[\n";
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+  uint64_t first_frame = num_frames_ > max_frames_ ? num_frames_ - max_frames_ : 0;
+  for (uint64_t i = first_frame; i < num_frames_; i++)
+  {
+    FrameRecord &frame = frames_[i % max_frames_];
+    file << ",\n{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":" << frame.start_us
+         << ",\"dur\":" << frame.duration_us << ",\"args\":{\"frame\":" << frame.frame_number << "}}";
+    file << ",\n{\"name\":\"counters\",\"ph\":\"C\",\"pid\":0,\"ts\":" << frame.start_us << ",\"args\":{";
+    for (unsigned int j = 0; j < NUM_COUNTERS; j++)
+    {
+      file << (j == 0 ? "" : ",") << "\"" << getCounterName(static_cast<Counter>(j)) << "\":" << frame.counters[j];
+    }
+    file << "}}";
+  }
+  uint64_t first_event = num_events_ > max_events_ ? num_events_ - max_events_ : 0;
+  for (uint64_t i = first_event; i < num_events_; i++)
+  {
+    TimerEvent &event = events_[i % max_events_];
+    file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << (event.gpu ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+         << (event.gpu ? 1 : 0) << ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us
+         << ",\"args\":{\"frame\":" << event.frame_number << "}}";
+  }
+  file << "\n]}\n";
+  return true;
+}
+
+} // namespace Anthrax
+
@@ -0,0 +1,337 @@
+/* ---------------------------------------------------------------- *\
+ * svo.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include "svo.hpp"
+
+namespace Anthrax
+{
+
+void Svo::reset(vec3<int64_t> origin, unsigned int layer)
+{
+  origin_ = origin;
+  layer_ = layer;
+  nodes_.clear();
+  nodes_.push_back(LEAF_BIT);
+  blocks_by_children_.clear();
+  block_references_.clear();
+  free_blocks_.clear();
+  num_blocks_added_ = 0;
+}
+
+
+uint32_t Svo::addChildren(const uint32_t *children)
+{
+  // Whole subtrees of air are common, so they don't get nodes of their own
+  bool is_empty = true;
+  for (unsigned int i = 0; i < 8; i++) is_empty = is_empty && (children[i] == LEAF_BIT);
+  if (is_empty) return LEAF_BIT;
+  num_blocks_added_++;
+  if (!deduplicate_) return newBlock(children);
+
+  Block block;
+  std::copy(children, children + 8, block.begin());
+  std::unordered_map<Block, uint32_t, BlockHash>::iterator itr = blocks_by_children_.find(block);
+  if (itr != blocks_by_children_.end())
+  {
+    // The stored block already holds its own references to these children
+    block_references_[getBlockId(itr->second)]++;
+    for (unsigned int i = 0; i < 8; i++) releaseNode(children[i]);
+    return itr->second;
+  }
+  uint32_t first_child = newBlock(children);
+  blocks_by_children_[block] = first_child;
+  return first_child;
+}
+
+
+void Svo::setRoot(uint32_t node)
+{
+  uint32_t old_root = nodes_[0];
+  nodes_[0] = node;
+  releaseNode(old_root);
+}
+
+
+uint32_t Svo::newBlock(const uint32_t *children)
+{
+  uint32_t first_child;
+  if (!free_blocks_.empty())
+  {
+    first_child = 1 + 8*free_blocks_.back();
+    free_blocks_.pop_back();
+  }
+  else
+  {
+    first_child = nodes_.size();
+    nodes_.resize(nodes_.size() + 8);
+    block_references_.push_back(0);
+  }
+  std::copy(children, children + 8, nodes_.begin() + first_child);
+  block_references_[getBlockId(first_child)] = 1;
+  return first_child;
+}
+
+
+void Svo::releaseNode(uint32_t node)
+{
+  if (node & LEAF_BIT) return;
+  uint32_t block_id = getBlockId(node);
+  if (--block_references_[block_id] > 0) return;
+  forgetBlock(node);
+  for (unsigned int i = 0; i < 8; i++)
+  {
+    uint32_t child = nodes_[node + i];
+    nodes_[node + i] = LEAF_BIT;
+    releaseNode(child);
+  }
+  free_blocks_.push_back(block_id);
+}
+
+
+void Svo::forgetBlock(uint32_t first_child)
+{
+  if (blocks_by_children_.empty()) return;
+  Block block;
+  std::copy(nodes_.begin() + first_child, nodes_.begin() + first_child + 8, block.begin());
+  std::unordered_map<Block, uint32_t, BlockHash>::iterator itr = blocks_by_children_.find(block);
+  if (itr != blocks_by_children_.end() && itr->second == first_child) blocks_by_children_.erase(itr);
+}
+
+
+bool Svo::setVoxel(vec3<int64_t> position, uint16_t type)
+{
+  int64_t offset[3] = {position.getX() - origin_.getX(), position.getY() - origin_.getY(), position.getZ() - origin_.getZ()};
+  int64_t root_size = 1LL << layer_;
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    if (offset[a] < 0 || offset[a] >= root_size) return false;
+  }
+  // Same child numbering as the shader: x | z<<1 | y<<2
+  unsigned int children[64];
+  for (unsigned int level = 0; level < layer_; level++)
+  {
+    unsigned int bit = layer_ - 1 - level;
+    children[level] = ((offset[0] >> bit) & 1) | (((offset[2] >> bit) & 1) << 1) | (((offset[1] >> bit) & 1) << 2);
+  }
+
+  // Check it's a single voxel before changing anything
+  uint32_t node = nodes_[0];
+  unsigned int depth = 0;
+  for (; depth < layer_ && !(node & LEAF_BIT); depth++) node = nodes_[node + children[depth]];
+  if (depth < layer_) return false;
+  if (node == makeLeaf(type)) return true;
+
+  // Copy each shared block on the way down, so only this path changes
+  uint32_t index = 0;
+  for (unsigned int level = 0; level < layer_; level++)
+  {
+    uint32_t first_child = nodes_[index];
+    uint32_t block_id = getBlockId(first_child);
+    if (block_references_[block_id] > 1)
+    {
+      uint32_t block[8];
+      std::copy(nodes_.begin() + first_child, nodes_.begin() + first_child + 8, block);
+      for (unsigned int i = 0; i < 8; i++)
+      {
+        if (!(block[i] & LEAF_BIT)) block_references_[getBlockId(block[i])]++; // The copy points at them too
+      }
+      block_references_[block_id]--;
+      first_child = newBlock(block);
+      nodes_[index] = first_child;
+    }
+    else
+    {
+      forgetBlock(first_child);
+    }
+    index = first_child + children[level];
+  }
+  nodes_[index] = makeLeaf(type);
+  return true;
+}
+
+
+std::set<uint16_t> Svo::getTypes() const
+{
+  std::set<uint16_t> types;
+  for (unsigned int i = 0; i < nodes_.size(); i++)
+  {
+    if ((nodes_[i] & LEAF_BIT) && (nodes_[i] & 0xFFFF)) types.insert(nodes_[i] & 0xFFFF);
+  }
+  return types;
+}
+
+
+SvoHit Svo::castRay(vec3<float> origin, vec3<float> direction, float max_distance) const
+{
+  // Restart traversal: find the leaf containing the current point from the root, then jump to
+  // where the ray leaves it. Mirrors svo_pass_fshader step for step.
+  SvoHit result;
+  float root_size = (float)(1ULL << layer_);
+  float o[3] = {origin.getX(), origin.getY(), origin.getZ()};
+  float d[3] = {direction.getX(), direction.getY(), direction.getZ()};
+  float inverse[3];
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    if (fabs(d[a]) < 1e-8f) d[a] = (d[a] < 0.0f) ? -1e-8f : 1e-8f;
+    inverse[a] = 1.0f / d[a];
+  }
+
+  // Clip the ray to the root
+  float t = 0.0f;
+  float t_end = max_distance;
+  int entry_axis = -1;
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    float t0 = (0.0f - o[a]) * inverse[a];
+    float t1 = (root_size - o[a]) * inverse[a];
+    if (t0 > t1) std::swap(t0, t1);
+    if (t0 > t)
+    {
+      t = t0;
+      entry_axis = a;
+    }
+    t_end = std::min(t_end, t1);
+  }
+
+  for (unsigned int iteration = 0; iteration < 512 && t < t_end; iteration++)
+  {
+    float p[3];
+    for (unsigned int a = 0; a < 3; a++)
+    {
+      p[a] = o[a] + d[a] * t;
+      // Step just over the boundary that was crossed, so the point lands in the next node
+      if ((int)a == entry_axis) p[a] += (d[a] > 0.0f) ? 0.25f : -0.25f;
+      p[a] = std::max(0.0f, std::min(root_size - 0.001f, p[a]));
+    }
+
+    float size = root_size;
+    float node_min[3] = {0.0f, 0.0f, 0.0f};
+    uint32_t node = nodes_[0];
+    while (!(node & LEAF_BIT))
+    {
+      size *= 0.5f;
+      unsigned int child = 0;
+      if (p[0] >= node_min[0] + size) { child |= 1; node_min[0] += size; }
+      if (p[2] >= node_min[2] + size) { child |= 2; node_min[2] += size; }
+      if (p[1] >= node_min[1] + size) { child |= 4; node_min[1] += size; }
+      node = nodes_[node + child];
+    }
+
+    // Where the ray leaves this leaf. If that's not ahead of t, the ray crossed at an edge or
+    // corner and the point landed in a node the ray is already past - step over that boundary too.
+    float t_exit = INFINITY;
+    int exit_axis = 0;
+    for (unsigned int a = 0; a < 3; a++)
+    {
+      float boundary = node_min[a] + (d[a] > 0.0f ? size : 0.0f);
+      float t_axis = (boundary - o[a]) * inverse[a];
+      if (t_axis < t_exit)
+      {
+        t_exit = t_axis;
+        exit_axis = a;
+      }
+    }
+    if ((node & 0xFFFF) && t_exit > t)
+    {
+      result.hit = true;
+      result.type = node & 0xFFFF;
+      result.face = (entry_axis < 0) ? 0 : 2*entry_axis + (d[entry_axis] < 0.0f ? 1 : 0);
+      result.distance = t;
+      return result;
+    }
+    entry_axis = exit_axis;
+    t = std::max(t_exit, t);
+  }
+  return result;
+}
+
+
+std::vector<SvoHit> Svo::renderReference(vec3<double> camera_position, vec3<float> forward, vec3<float> up,
+                                         float vertical_fov, unsigned int width, unsigned int height, float max_distance) const
+{
+  // Camera position relative to the root's min corner
+  vec3<float> origin((float)(camera_position.getX() - (double)origin_.getX() + 0.5),
+                     (float)(camera_position.getY() - (double)origin_.getY() + 0.5),
+                     (float)(camera_position.getZ() - (double)origin_.getZ() + 0.5));
+  std::vector<vec3<float>> directions = getPixelDirections(forward, up, vertical_fov, width, height);
+  std::vector<SvoHit> hits(directions.size());
+  for (unsigned int i = 0; i < directions.size(); i++)
+  {
+    hits[i] = castRay(origin, directions[i], max_distance);
+  }
+  return hits;
+}
+
+
+std::vector<vec3<float>> Svo::getPixelDirections(vec3<float> forward, vec3<float> up, float vertical_fov, unsigned int width, unsigned int height)
+{
+  // Build the camera basis the way glm::lookAt does, in the renderer's (z-flipped) space
+  vec3<float> forward_gl(forward.getX(), forward.getY(), -forward.getZ());
+  vec3<float> up_gl(up.getX(), up.getY(), -up.getZ());
+  forward_gl.normalize();
+  vec3<float> side_gl = cross(forward_gl, up_gl);
+  side_gl.normalize();
+  vec3<float> true_up_gl = cross(side_gl, forward_gl);
+  float tan_half_fov = tan(vertical_fov * 0.5f);
+  float aspect = (float)width / (float)height;
+
+  std::vector<vec3<float>> directions(width * height);
+  for (unsigned int y = 0; y < height; y++)
+  {
+    for (unsigned int x = 0; x < width; x++)
+    {
+      float screen_x = (2.0f * (x + 0.5f) / width - 1.0f) * tan_half_fov * aspect;
+      float screen_y = (1.0f - 2.0f * (y + 0.5f) / height) * tan_half_fov;
+      vec3<float> direction_gl = forward_gl + side_gl * screen_x + true_up_gl * screen_y;
+      vec3<float> direction(direction_gl.getX(), direction_gl.getY(), -direction_gl.getZ());
+      direction.normalize();
+      directions[y * width + x] = direction;
+    }
+  }
+  return directions;
+}
+
+
+void Svo::getDebugColor(const SvoHit &hit, unsigned char *rgb)
+{
+  if (!hit.hit)
+  {
+    rgb[0] = 0;
+    rgb[1] = 0;
+    rgb[2] = 0;
+    return;
+  }
+  // Hash the type into a color, then darken by face so edges stay visible
+  uint32_t hash = (hit.type + 1) * 2654435761u;
+  const float face_shade[6] = {0.7f, 0.8f, 0.5f, 1.0f, 0.6f, 0.9f};
+  for (unsigned int i = 0; i < 3; i++)
+  {
+    unsigned int channel = 64 + ((hash >> (8 * i)) & 0xFF) * 3 / 4;
+    rgb[i] = (unsigned char)(channel * face_shade[hit.face % 6]);
+  }
+}
+
+
+bool Svo::writeDebugImage(std::string filename, unsigned int width, unsigned int height, const std::vector<SvoHit> &hits, std::string comment)
+{
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) return false;
+  file << "P6\n";
+  if (!comment.empty()) file << "# " << comment << "\n";
+  file << width << " " << height << "\n255\n";
+  std::vector<unsigned char> pixels(width * height * 3);
+  for (unsigned int i = 0; i < width * height && i < hits.size(); i++)
+  {
+    getDebugColor(hits[i], &pixels[3*i]);
+  }
+  file.write((const char *)pixels.data(), pixels.size());
+  return file.good();
+}
+
+} // namespace Anthrax
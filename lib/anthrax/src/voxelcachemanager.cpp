@@ -5,6 +5,8 @@
 \* ---------------------------------------------------------------- */
 
 #include "voxelcachemanager.hpp"
+#include "framearena.hpp"
+#include "profiler.hpp"
 #include <string.h>
 
 #include <glm/glm.hpp>
@@ -24,6 +26,7 @@ VoxelCacheManager::~VoxelCacheManager()
   // These will be cleared anyway by a call to glfwTerminate(), so technically not necessary
   glDeleteVertexArrays(1, &voxel_vao_);
   glDeleteBuffers(1, &voxels_cache_);
+  glDeleteTextures(1, &material_texture_);
 
   free(cache_emulator_);
 }
@@ -32,7 +35,7 @@ VoxelCacheManager::~VoxelCacheManager()
 void VoxelCacheManager::initialize(size_t cache_size, bool (*cache_decision_function)(glm::vec3))
 {
   cacheDecisionFunction = cache_decision_function;
-  voxel_object_size_ = 2*sizeof(glm::vec3) + 3*sizeof(float) + 2*sizeof(int); // The size (in bytes) of all vertex attributes for a single voxel
+  voxel_object_size_ = sizeof(glm::vec3) + 3*sizeof(int); // The size (in bytes) of all vertex attributes for a single voxel
   max_num_voxels_ = cache_size / voxel_object_size_;
   voxel_cache_size_ = max_num_voxels_ * voxel_object_size_;
   // set up vertex data (and buffer(s)) and configure vertex attributes
@@ -61,18 +64,10 @@ void VoxelCacheManager::initialize(size_t cache_size, bool (*cache_decision_func
   glVertexAttribPointer(2, 1, GL_UNSIGNED_INT, GL_FALSE, voxel_object_size_, (void*)(sizeof(glm::vec3)+sizeof(int)));
   glEnableVertexAttribArray(2);
   glVertexAttribDivisor(2, 1);
-  glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, voxel_object_size_, (void*)(sizeof(glm::vec3)+2*sizeof(int)));
+  // The material index is read as a real integer, so it is given to the shader with glVertexAttribIPointer
+  glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, voxel_object_size_, (void*)(sizeof(glm::vec3)+2*sizeof(int)));
   glEnableVertexAttribArray(3);
   glVertexAttribDivisor(3, 1);
-  glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, voxel_object_size_, (void*)(2*sizeof(glm::vec3)+2*sizeof(int)));
-  glEnableVertexAttribArray(4);
-  glVertexAttribDivisor(4, 1);
-  glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, voxel_object_size_, (void*)(2*sizeof(glm::vec3)+2*sizeof(int)+sizeof(float)));
-  glEnableVertexAttribArray(5);
-  glVertexAttribDivisor(5, 1);
-  glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, voxel_object_size_, (void*)(2*sizeof(glm::vec3)+2*sizeof(int)+2*sizeof(float)));
-  glEnableVertexAttribArray(6);
-  glVertexAttribDivisor(6, 1);
 
   // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
   glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -80,6 +75,58 @@ void VoxelCacheManager::initialize(size_t cache_size, bool (*cache_decision_func
   // Set up CPU side cache emulator - this is to help control how to organize the GPU cache (removal and addition of voxels)
   cache_emulator_ = reinterpret_cast<std::weak_ptr<Cube>*>(calloc(sizeof(std::weak_ptr<Cube>), max_num_voxels_));
 
+  // Set up the material table - each material takes up one column of the texture
+  max_num_materials_ = 1024;
+  glGenTextures(1, &material_texture_);
+  glBindTexture(GL_TEXTURE_2D, material_texture_);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, max_num_materials_, 2, 0, GL_RGBA, GL_FLOAT, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+
+unsigned int VoxelCacheManager::getMaterialIndex(Cube *cube)
+{
+  std::map<uint16_t, unsigned int>::iterator itr = material_indices_.find(cube->getTypeID());
+  if (itr != material_indices_.end())
+  {
+    return itr->second;
+  }
+  if (material_indices_.size() >= max_num_materials_)
+  {
+    // Material table is full - fall back to the first material
+    return 0;
+  }
+
+  // First time seeing this type, so add its material to the table
+  unsigned int material_index = material_indices_.size();
+  material_indices_[cube->getTypeID()] = material_index;
+  glm::vec3 color = cube->getColor();
+  float material[8] = { color.x, color.y, color.z, cube->getOpacity(),
+                        cube->getReflectivity(), cube->getShininess(), 0.0f, 0.0f };
+  glBindTexture(GL_TEXTURE_2D, material_texture_);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, material_index, 0, 1, 1, GL_RGBA, GL_FLOAT, &material[0]);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, material_index, 1, 1, 1, GL_RGBA, GL_FLOAT, &material[4]);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return material_index;
+}
+
+
+uint16_t VoxelCacheManager::getMaterialType(unsigned int material_index)
+{
+  for (std::map<uint16_t, unsigned int>::iterator itr = material_indices_.begin(); itr != material_indices_.end(); itr++)
+  {
+    if (itr->second == material_index) return itr->first;
+  }
+  return 0;
+}
+
+
+void VoxelCacheManager::setOrigin(vec3<int64_t> origin)
+{
+  origin_ = origin;
+  origin_changed_ = true;
 }
 
 
@@ -133,6 +180,12 @@ void VoxelCacheManager::addCube(std::weak_ptr<Cube> new_cube)
 }
 
 
+void VoxelCacheManager::addCubes(List<Cube> &new_cubes)
+{
+  voxel_display_list_.splice(new_cubes);
+}
+
+
 void VoxelCacheManager::renderCubes()
 {
   glBindVertexArray(voxel_vao_);
@@ -158,13 +211,24 @@ void VoxelCacheManager::updateCache()
       itr++;
     }
   }
+  if (origin_changed_)
+  {
+    // Everything has to be sent again relative to the new origin
+    for (unsigned int i = 0; i < max_num_voxels_; i++)
+    {
+      if (auto tmp = cache_emulator_[i].lock()) tmp->is_in_cache_ = false;
+      cache_emulator_[i].reset();
+    }
+    origin_changed_ = false;
+  }
   // Iterate through the cache to find values that are no longer needed to make space for new ones
-  std::vector<unsigned int> replaceable_cache_indices;
+  FrameVector<unsigned int> replaceable_cache_indices;
+  replaceable_cache_indices.reserve(max_num_voxels_);
   for (unsigned int i = 0; i < max_num_voxels_; i++)
   {
     if (auto tmp = cache_emulator_[i].lock())
     {
-      if (!cacheDecisionFunction(tmp->getPosition()))
+      if (!cacheDecisionFunction(tmp->getPositionFrom(origin_)))
       {
         replaceable_cache_indices.push_back(i);
       }
@@ -186,16 +250,13 @@ void VoxelCacheManager::updateCache()
       if (!(current_cube->is_in_cache_))
       {
 
-        if (cacheDecisionFunction(current_cube->getPosition()))
+        if (cacheDecisionFunction(current_cube->getPositionFrom(origin_)))
         {
           // Only add this cube to the cache if it fits these criteria
 
 
           // Get cube material settings
-          glm::vec3 color = current_cube->getColor();
-          GLfloat reflectivity = current_cube->getReflectivity();
-          GLfloat shininess = current_cube->getShininess();
-          GLfloat opacity = current_cube->getOpacity();
+          GLuint material = getMaterialIndex(current_cube.get());
 
           /*
           // set cube position and scale
@@ -204,7 +265,7 @@ void VoxelCacheManager::updateCache()
           model = glm::scale(model, glm::vec3(current_cube.getSize()));
           */
 
-          glm::vec3 position = current_cube->getPosition();
+          glm::vec3 position = current_cube->getPositionFrom(origin_);
           position.z = -position.z;
           GLint size = current_cube->getSize();
 
@@ -222,11 +283,7 @@ void VoxelCacheManager::updateCache()
           glBufferSubData(GL_ARRAY_BUFFER, cache_location*voxel_object_size_, sizeof(glm::vec3), &position);
           glBufferSubData(GL_ARRAY_BUFFER, cache_location*voxel_object_size_ + sizeof(glm::vec3), sizeof(int), &size);
           glBufferSubData(GL_ARRAY_BUFFER, cache_location*voxel_object_size_ + sizeof(glm::vec3) + sizeof(int), sizeof(int), &render_faces);
-
-          glBufferSubData(GL_ARRAY_BUFFER, cache_location*voxel_object_size_ + sizeof(glm::vec3) + 2*sizeof(int), sizeof(glm::vec3), &color);
-          glBufferSubData(GL_ARRAY_BUFFER, cache_location*voxel_object_size_ + 2*sizeof(glm::vec3) + 2*sizeof(int), sizeof(float), &reflectivity);
-          glBufferSubData(GL_ARRAY_BUFFER, cache_location*voxel_object_size_ + 2*sizeof(glm::vec3) + 2*sizeof(int) + sizeof(float), sizeof(float), &shininess);
-          glBufferSubData(GL_ARRAY_BUFFER, cache_location*voxel_object_size_ + 2*sizeof(glm::vec3) + 2*sizeof(int) + 2*sizeof(float), sizeof(float), &opacity);
+          glBufferSubData(GL_ARRAY_BUFFER, cache_location*voxel_object_size_ + sizeof(glm::vec3) + 2*sizeof(int), sizeof(int), &material);
 
           // Now emulate this in the CPU cache emulator
           if (auto element_to_be_replaced = cache_emulator_[cache_location].lock())
@@ -235,6 +292,7 @@ void VoxelCacheManager::updateCache()
           }
           cache_emulator_[cache_location] = current_cube;
           current_cube->is_in_cache_ = true;
+          Profiler::addCounter(Profiler::BYTES_UPLOADED, voxel_object_size_);
 
           num_voxels_added++;
         }
@@ -249,11 +307,13 @@ void VoxelCacheManager::updateCache()
     }
   }
   // Remove all unused cache elements - they could be blocking smaller sub-cubes
-  uint8_t tmp[voxel_object_size_] = {0};
+  uint8_t *tmp = FrameArena::getFrameArena().allocate<uint8_t>(voxel_object_size_);
+  memset(tmp, 0, voxel_object_size_);
   while (num_voxels_added < replaceable_cache_indices.size())
   {
     int cache_location = replaceable_cache_indices[num_voxels_added];
-    glBufferSubData(GL_ARRAY_BUFFER, cache_location*voxel_object_size_, voxel_object_size_, &tmp);
+    glBufferSubData(GL_ARRAY_BUFFER, cache_location*voxel_object_size_, voxel_object_size_, tmp);
+    Profiler::addCounter(Profiler::BYTES_UPLOADED, voxel_object_size_);
 
     // Now emulate this in the CPU cache emulator
     if (auto element_to_be_replaced = cache_emulator_[cache_location].lock())
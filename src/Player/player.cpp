@@ -5,11 +5,17 @@
 \* ---------------------------------------------------------------- */
 #include "player.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 Player::Player(Anthrax::Anthrax *anthrax_handle)
 {
   anthrax_handle_ = anthrax_handle;
   head_rotation_ = Anthrax::Quaternion(1.0, 0.0, 0.0, 0.0);
-  head_position_ = Anthrax::vec3<float>(0.0, 0.0, 0.0);
+  head_position_ = Anthrax::vec3<double>(0.0, 0.0, 0.0);
+  previous_position_ = head_position_;
+  velocity_ = Anthrax::vec3<float>(0.0, 0.0, 0.0);
+  walk_velocity_ = Anthrax::vec3<float>(0.0, 0.0, 0.0);
   left_direction_ = Anthrax::vec3<float>(-1.0, 0.0, 0.0);
   right_direction_ = Anthrax::vec3<float>(1.0, 0.0, 0.0);
   forward_direction_ = Anthrax::vec3<float>(0.0, 0.0, 1.0);
@@ -73,8 +79,7 @@ void Player::processInput()
   if (anthrax_handle_->getKeyPress(Anthrax::Key::LCTRL))
     roll = true;
   move_vector.normalizeHorizontals();
-  move_vector = move_vector*move_multiplier*speed_multiplier_;
-  head_position_ += move_vector;
+  walk_velocity_ = move_vector*(move_multiplier*speed_multiplier_*settings_->getWalkSpeed());
 
   // Mouse Inputs
   if (!mouse_paused_)
@@ -116,12 +121,63 @@ void Player::processInput()
 }
 
 
-void Player::update()
+void Player::update(float frame_seconds)
+{
+  // Physics runs in fixed steps however long the frame took, so movement and collisions come out
+  // the same at any frame rate
+  time_accumulator_ += std::min(std::max(frame_seconds, 0.0f), max_frame_seconds_);
+  while (time_accumulator_ >= physics_step_)
+  {
+    previous_position_ = head_position_;
+    step(physics_step_);
+    time_accumulator_ -= physics_step_;
+  }
+  // Draw the camera partway between the last two steps, by how far into the next one the frame is
+  float alpha = time_accumulator_ / physics_step_;
+  Anthrax::vec3<double> camera_position = previous_position_ + (head_position_ - previous_position_)*alpha;
+  // Whole voxels and what's left over, so the renderer can keep it exact relative to its own origin
+  Anthrax::vec3<int64_t> camera_voxel(floor(camera_position.getX()), floor(camera_position.getY()), floor(camera_position.getZ()));
+  Anthrax::vec3<float> camera_offset(camera_position.getX() - camera_voxel.getX(), camera_position.getY() - camera_voxel.getY(), camera_position.getZ() - camera_voxel.getZ());
+  anthrax_handle_->setCameraPosition(camera_voxel, camera_offset);
+  anthrax_handle_->setCameraRotation(head_rotation_);
+}
+
+
+void Player::step(float seconds)
 {
   Anthrax::vec3<float> net_force = forces_->netForce();
   Anthrax::vec3<float> acceleration = net_force/settings_->getMass();
-  head_position_ += acceleration;
+  velocity_ += acceleration*seconds;
+  Anthrax::vec3<float> motion = (velocity_ + walk_velocity_)*seconds;
+  if (settings_->getNoclip())
+  {
+    head_position_ += Anthrax::vec3<double>(motion.getX(), motion.getY(), motion.getZ());
+    return;
+  }
+
+  double wanted[3] = {motion.getX(), motion.getY(), motion.getZ()};
+  CollisionMove result = collider_.move(getHitbox(), wanted);
+  head_position_ += Anthrax::vec3<double>(result.offset[0], result.offset[1], result.offset[2]);
+  // Whatever stopped the player takes the momentum along that axis
+  if (result.blocked[0]) velocity_.setX(0.0);
+  if (result.blocked[1]) velocity_.setY(0.0);
+  if (result.blocked[2]) velocity_.setZ(0.0);
+  can_jump_ = result.blocked[1] && wanted[1] < 0.0;
   // std::cout << "<" << head_position_.getX() << ", " << head_position_.getY() << ", " << head_position_.getZ() << ">" << std::endl;
-  anthrax_handle_->setCameraPosition(head_position_);
-  anthrax_handle_->setCameraRotation(head_rotation_);
+}
+
+
+CollisionBox Player::getHitbox()
+{
+  CollisionBox hitbox;
+  double position[3] = {head_position_.getX(), head_position_.getY(), head_position_.getZ()};
+  double half_extents[3] = {settings_->getHitboxWidth() / 2.0, 0.0, settings_->getHitboxDepth() / 2.0};
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    hitbox.min[a] = position[a] - half_extents[a];
+    hitbox.max[a] = position[a] + half_extents[a];
+  }
+  hitbox.min[1] = position[1] - settings_->getEyeHeight();
+  hitbox.max[1] = hitbox.min[1] + settings_->getHitboxHeight();
+  return hitbox;
 }
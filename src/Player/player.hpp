@@ -9,21 +9,27 @@
 #include "anthrax.hpp"
 #include "playersettings.hpp"
 #include "force.hpp"
+#include "World/collider.hpp"
 
 class Player
 {
 public:
   Player(Anthrax::Anthrax *anthrax_handle);
   ~Player();
-  Anthrax::vec3<float> getPosition() { return head_position_; }
+  Anthrax::vec3<double> getPosition() { return head_position_; }
   void processInput();
   bool updateForce(std::string name, Anthrax::vec3<float> vector);
-  void update();
+  void setCollider(VoxelCollider collider) { collider_ = collider; }
+  void update(float frame_seconds); // Runs as many physics steps as fit in the time since the last update
 private:
+  void step(float seconds);
+  CollisionBox getHitbox(); // Axis-aligned around the head, whichever way it's facing
   Anthrax::Anthrax *anthrax_handle_;
-  Anthrax::vec3<float> head_position_;
+  Anthrax::vec3<double> head_position_; // In double, so it's still exact to well under a voxel at the edge of the world
   Anthrax::Quaternion head_rotation_;
-  Anthrax::vec3<float> velocity_;
+  Anthrax::vec3<double> previous_position_; // As of the physics step before last, for interpolating the camera
+  Anthrax::vec3<float> velocity_; // From forces
+  Anthrax::vec3<float> walk_velocity_; // From input
   Anthrax::vec3<float> left_direction_; // The direction to move in when moving left
   Anthrax::vec3<float> right_direction_; // The direction to move in when moving right
   Anthrax::vec3<float> forward_direction_; // The direction to move in when moving forwards
@@ -40,5 +46,9 @@ private:
   PlayerSettings *settings_;
   bool can_jump_;
   ForceMap *forces_;
+  VoxelCollider collider_;
+  const float physics_step_ = 1.0f / 120.0f; // Seconds
+  const float max_frame_seconds_ = 0.25f; // A longer frame only catches up this much, so a stall can't snowball
+  float time_accumulator_ = 0.0f; // Time not yet simulated
 };
 #endif // PLAYER_HPP
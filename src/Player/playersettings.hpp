@@ -24,11 +24,19 @@ public:
     eye_height_ = hitbox_height_*5/5.5;
     fov_ = 70;
     mass_ = 1;
+    walk_speed_ = 60;
   }
   float getMass() const
   {
     return mass_;
   }
+  bool getNoclip() const { return noclip_; }
+  void setNoclip(bool noclip) { noclip_ = noclip; }
+  float getEyeHeight() const { return eye_height_; } // Above the bottom of the hitbox
+  float getHitboxHeight() const { return hitbox_height_; }
+  float getHitboxWidth() const { return hitbox_width_; } // Along x
+  float getHitboxDepth() const { return hitbox_depth_; } // Along z
+  float getWalkSpeed() const { return walk_speed_; } // Voxels per second
 private:
   bool noclip_;
   float eye_height_;
@@ -37,5 +45,6 @@ private:
   float hitbox_depth_;
   float fov_;
   float mass_;
+  float walk_speed_;
 };
 #endif // PLAYERSETTINGS_HPP
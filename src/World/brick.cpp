@@ -0,0 +1,248 @@
+/* ---------------------------------------------------------------- *\
+ * brick.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "brick.hpp"
+#include "octree.hpp"
+
+#include <algorithm>
+#include <map>
+
+
+namespace
+{
+
+// Bits [min, max)
+inline uint64_t bitRange(unsigned int min, unsigned int max)
+{
+  uint64_t below_max = (max >= 64) ? ~0ULL : ((1ULL << max) - 1);
+  return below_max & ~((1ULL << min) - 1);
+}
+
+} // namespace
+
+
+Brick::Brick(const VoxelSet &voxel_set, unsigned int layer)
+{
+  layer_ = layer;
+  width_ = 1u << layer_;
+  voxels_.assign(width_*width_*width_, 0);
+
+  // Runs are in child order (x | z<<1 | y<<2 per level, coarsest first), so the voxel at index i
+  // has its x in bits 0, 3, 6... of i, z in bits 1, 4, 7... and y in 2, 5, 8...
+  uint32_t index = 0;
+  for (unsigned int run = 0; run < voxel_set.getNumRuns() && index < voxels_.size(); run++)
+  {
+    uint16_t type = voxel_set.getRunType(run);
+    uint32_t end = std::min(index + (uint32_t)voxel_set.getRunLength(run), (uint32_t)voxels_.size());
+    for (; index < end; index++)
+    {
+      unsigned int x = 0, y = 0, z = 0;
+      for (unsigned int bit = 0; bit < layer_; bit++)
+      {
+        x |= ((index >> (3*bit)) & 1) << bit;
+        z |= ((index >> (3*bit + 1)) & 1) << bit;
+        y |= ((index >> (3*bit + 2)) & 1) << bit;
+      }
+      voxels_[x + width_*(y + width_*z)] = type;
+    }
+  }
+
+  // The pyramid above, each level counted straight from the voxels since the most common type of a
+  // block isn't always the most common of its eight parts'
+  unsigned int size = 0;
+  for (unsigned int level = 1; level <= layer_; level++)
+  {
+    level_offsets_[level] = size;
+    unsigned int blocks_width = width_ >> level;
+    size += blocks_width*blocks_width*blocks_width;
+  }
+  blocks_.resize(size);
+  for (unsigned int level = 1; level <= layer_; level++)
+  {
+    unsigned int blocks_width = width_ >> level;
+    for (unsigned int z = 0; z < blocks_width; z++)
+    for (unsigned int y = 0; y < blocks_width; y++)
+    for (unsigned int x = 0; x < blocks_width; x++)
+    {
+      blocks_[getBlockIndex(level, x, y, z)] = countBlock(level, x, y, z);
+    }
+  }
+
+  solid_rows_.assign(width_*width_, 0);
+  for (unsigned int row = 0; row < solid_rows_.size(); row++)
+  {
+    const uint16_t *voxels = &voxels_[width_*row];
+    uint64_t bits = 0;
+    for (unsigned int x = 0; x < width_; x++) bits |= (uint64_t)(voxels[x] != 0) << x;
+    solid_rows_[row] = bits;
+  }
+
+  // Faces in Octree's order: +x, -x, +y, -y, +z, -z
+  for (unsigned int face = 0; face < 6; face++)
+  {
+    std::vector<uint64_t> air = getPlaneAir(face);
+    if (planeHasAir(air, 0, width_, 0, width_)) transparent_faces_ |= 1 << face;
+  }
+}
+
+
+uint32_t Brick::countBlock(unsigned int level, unsigned int x, unsigned int y, unsigned int z) const
+{
+  // Same rules as VoxelSet's voxel type: air doesn't count, and ties go to the lowest type
+  const unsigned int max_types = 64;
+  int amounts[max_types] = {};
+  std::map<uint16_t, int> more_amounts; // Types past max_types
+  unsigned int size = 1u << level;
+  uint16_t first = getVoxel(x*size, y*size, z*size);
+  bool is_mixed = false;
+  for (unsigned int k = z*size; k < (z + 1)*size; k++)
+  for (unsigned int j = y*size; j < (y + 1)*size; j++)
+  {
+    const uint16_t *row = &voxels_[width_*(j + width_*k)];
+    for (unsigned int i = x*size; i < (x + 1)*size; i++)
+    {
+      is_mixed = is_mixed || (row[i] != first);
+      if (row[i] < max_types) amounts[row[i]]++;
+      else more_amounts[row[i]]++;
+    }
+  }
+  if (!is_mixed) return first;
+  uint16_t largest_voxel_type = 0;
+  int num_most_voxels = 0;
+  for (unsigned int type = 1; type < max_types; type++)
+  {
+    if (amounts[type] <= num_most_voxels) continue;
+    num_most_voxels = amounts[type];
+    largest_voxel_type = type;
+  }
+  for (std::map<uint16_t, int>::iterator itr = more_amounts.begin(); itr != more_amounts.end(); itr++)
+  {
+    if (itr->second <= num_most_voxels) continue;
+    num_most_voxels = itr->second;
+    largest_voxel_type = itr->first;
+  }
+  return largest_voxel_type | mixed_;
+}
+
+
+bool Brick::hasAir(const unsigned int *min, const unsigned int *max) const
+{
+  uint64_t columns = bitRange(min[0], max[0]);
+  for (unsigned int z = min[2]; z < max[2]; z++)
+  for (unsigned int y = min[1]; y < max[1]; y++)
+  {
+    if ((~solid_rows_[y + width_*z] & columns) != 0) return true;
+  }
+  return false;
+}
+
+
+std::vector<uint64_t> Brick::getPlaneAir(uint8_t face) const
+{
+  unsigned int axis = face / 2;
+  unsigned int layer = (face % 2 == 0) ? width_ - 1 : 0;
+  uint64_t row_mask = getRowMask();
+  std::vector<uint64_t> air(width_, 0);
+  for (unsigned int i = 0; i < width_; i++)
+  {
+    if (axis == 1) air[i] = ~solid_rows_[layer + width_*i] & row_mask;
+    else if (axis == 2) air[i] = ~solid_rows_[i + width_*layer] & row_mask;
+    else
+    {
+      // Across the rows rather than along them, so a bit at a time
+      for (unsigned int y = 0; y < width_; y++) air[i] |= (~solid_rows_[y + width_*i] >> layer & 1) << y;
+    }
+  }
+  return air;
+}
+
+
+bool Brick::planeHasAir(const std::vector<uint64_t> &plane, unsigned int row_min, unsigned int row_max, unsigned int bit_min, unsigned int bit_max)
+{
+  uint64_t bits = bitRange(bit_min, bit_max);
+  for (unsigned int row = row_min; row < row_max; row++)
+  {
+    if ((plane[row] & bits) != 0) return true;
+  }
+  return false;
+}
+
+
+void Brick::getVisibleFaces(const std::vector<uint64_t> *border_air, std::vector<uint64_t> *visible) const
+{
+  for (unsigned int face = 0; face < 6; face++) visible[face].assign(solid_rows_.size(), 0);
+  uint64_t last_bit = 1ULL << (width_ - 1);
+  for (unsigned int z = 0; z < width_; z++)
+  for (unsigned int y = 0; y < width_; y++)
+  {
+    unsigned int index = y + width_*z;
+    uint64_t solid = solid_rows_[index];
+    if (solid == 0) continue;
+    // A face shows where the voxel is solid and the one past it isn't - along x that's the row
+    // shifted by one, with the border's bit shifted in at the end
+    uint64_t past[6];
+    past[0] = (solid << 1) | (((border_air[0][z] >> y) & 1) ? 0 : 1);
+    past[1] = (solid >> 1) | (((border_air[1][z] >> y) & 1) ? 0 : last_bit);
+    past[2] = (y > 0) ? solid_rows_[index - 1] : ~border_air[2][z];
+    past[3] = (y + 1 < width_) ? solid_rows_[index + 1] : ~border_air[3][z];
+    past[4] = (z > 0) ? solid_rows_[index - width_] : ~border_air[4][y];
+    past[5] = (z + 1 < width_) ? solid_rows_[index + width_] : ~border_air[5][y];
+    for (unsigned int face = 0; face < 6; face++) visible[face][index] = solid & ~past[face];
+  }
+}
+
+
+OctreeCell::OctreeCell(Octree *cell_node)
+{
+  node = cell_node;
+  layer = node->getLayer();
+}
+
+
+bool OctreeCell::isLeaf() const
+{
+  const Brick *brick = node->getBrick();
+  if (brick == nullptr) return node->isLeaf() || node->isUniform();
+  if (layer == node->getLayer()) return false; // The node itself, which is the brick
+  return !Brick::isMixed(brick->getBlock(layer, block[0], block[1], block[2])) || !node->brickBlockIsSplit(layer, block);
+}
+
+
+uint16_t OctreeCell::getVoxelType() const
+{
+  const Brick *brick = node->getBrick();
+  if (brick == nullptr || layer == node->getLayer()) return node->getVoxelType();
+  return Brick::getType(brick->getBlock(layer, block[0], block[1], block[2]));
+}
+
+
+bool OctreeCell::getChild(unsigned int child, OctreeCell *cell) const
+{
+  if (node->getBrick() == nullptr)
+  {
+    Octree *child_node = node->getChild(child);
+    if (child_node == nullptr) return false;
+    *cell = OctreeCell(child_node);
+    return true;
+  }
+  if (layer == 0) return false;
+  cell->node = node;
+  cell->layer = layer - 1;
+  cell->block[0] = 2*block[0] + (child & 1);
+  cell->block[1] = 2*block[1] + ((child >> 2) & 1);
+  cell->block[2] = 2*block[2] + ((child >> 1) & 1);
+  return true;
+}
+
+
+void OctreeCell::getCorner(int64_t *corner) const
+{
+  unsigned int node_layer = node->getLayer();
+  int64_t half = (node_layer > 0) ? (1LL << (node_layer - 1)) : 0;
+  Anthrax::vec3<int64_t> center = node->getCenter();
+  corner[0] = center.getX() - half + ((int64_t)block[0] << layer);
+  corner[1] = center.getY() - half + ((int64_t)block[1] << layer);
+  corner[2] = center.getZ() - half + ((int64_t)block[2] << layer);
+}
@@ -0,0 +1,103 @@
+/* ---------------------------------------------------------------- *\
+ * brick.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Near the camera the octree would be split all the way down to
+ * single voxels - one node and one cube per voxel. Instead, a node
+ * at the brick layer (see Octree::setBrickLayer) that would split
+ * keeps its voxels as a Brick: a flat array of voxel types, x
+ * fastest, with a pyramid of the blocks above it (2, 4, ... voxels a
+ * side), each with its most common type and whether it's all that
+ * type. The node has no children. The LOD policy still picks which
+ * blocks would have been split (Octree keeps that per brick), and
+ * the node's cubes are made straight from the brick, one per solid
+ * block at that cut with a face showing - the cubes the subtree
+ * would have made.
+ *
+ * OctreeCell lets tree walks (ray casts, collision, the SVO) step
+ * down through a brick's blocks as if they were nodes.
+\* ---------------------------------------------------------------- */
+
+#ifndef BRICK_HPP
+#define BRICK_HPP
+
+#include <cstdint>
+#include <vector>
+#include "voxelset.hpp"
+
+class Octree;
+
+class Brick
+{
+public:
+  static const uint32_t mixed_ = 0x10000; // Set on a block of more than one type
+  static bool isMixed(uint32_t block) { return (block & mixed_) != 0; }
+  static uint16_t getType(uint32_t block) { return block & 0xFFFF; } // Most common type, not counting air
+
+  Brick(const VoxelSet &voxel_set, unsigned int layer); // voxel_set in the node's run order
+  unsigned int getLayer() const { return layer_; }
+  unsigned int getWidth() const { return width_; }
+  uint16_t getVoxel(unsigned int x, unsigned int y, unsigned int z) const { return voxels_[x + width_*(y + width_*z)]; }
+  // The block 2^level voxels a side at (x, y, z), counted in blocks - its type, with mixed_ set if
+  // it isn't all that type
+  uint32_t getBlock(unsigned int level, unsigned int x, unsigned int y, unsigned int z) const
+  {
+    if (level == 0) return getVoxel(x, y, z);
+    return blocks_[getBlockIndex(level, x, y, z)];
+  }
+  // Every block of levels 1 to the brick's layer has its own index below getNumBlocks()
+  uint32_t getBlockIndex(unsigned int level, unsigned int x, unsigned int y, unsigned int z) const
+  {
+    unsigned int blocks_width = width_ >> level;
+    return level_offsets_[level] + x + blocks_width*(y + blocks_width*z);
+  }
+  uint32_t getNumBlocks() const { return blocks_.size(); }
+  bool hasAir(const unsigned int *min, const unsigned int *max) const; // In voxels [min, max)
+  bool faceIsTransparent(uint8_t face) const { return (transparent_faces_ >> face) & 1; } // Same order as Octree's
+  uint64_t getMemoryUsage() const
+  {
+    return sizeof(Brick) + voxels_.capacity()*sizeof(uint16_t) + blocks_.capacity()*sizeof(uint32_t) + solid_rows_.capacity()*sizeof(uint64_t);
+  }
+
+  // Faces are found 64 voxels at a time from bitmasks: a row is one bit per voxel along x, and a
+  // brick has a row for each (y, z), numbered y + width*z
+  uint64_t getRowMask() const { return (width_ == 64) ? ~0ULL : ((1ULL << width_) - 1); } // The bits a row uses
+  // Air in the outermost layer of voxels on one side (Octree's face order), as width rows: on an x
+  // side row z has a bit per y, on a y side row z has a bit per x, and on a z side row y does
+  std::vector<uint64_t> getPlaneAir(uint8_t face) const;
+  static bool planeHasAir(const std::vector<uint64_t> &plane, unsigned int row_min, unsigned int row_max, unsigned int bit_min, unsigned int bit_max);
+  // Rows of the voxels with each face showing, in neighbors_ order (-x, +x, -y, +y, -z, +z), given
+  // the air just outside each side in that order and getPlaneAir's layout
+  void getVisibleFaces(const std::vector<uint64_t> *border_air, std::vector<uint64_t> *visible) const;
+private:
+  uint32_t countBlock(unsigned int level, unsigned int x, unsigned int y, unsigned int z) const;
+
+  unsigned int layer_;
+  unsigned int width_;
+  std::vector<uint16_t> voxels_;
+  std::vector<uint32_t> blocks_; // Levels 1 to layer_, each x fastest
+  unsigned int level_offsets_[32]; // Into blocks_
+  std::vector<uint64_t> solid_rows_;
+  uint8_t transparent_faces_ = 0; // A bit per face
+};
+
+
+// A loaded node, or a block of voxels inside a node's brick
+struct OctreeCell
+{
+  Octree *node = nullptr;
+  unsigned int layer = 0; // Of the cell - only below the node's own inside its brick
+  unsigned int block[3] = {0, 0, 0}; // Inside the brick, counted in cells of this size
+
+  OctreeCell() {}
+  explicit OctreeCell(Octree *cell_node);
+  bool isLeaf() const; // Drawn as one cube: a single type, not split for LOD, or nothing loaded under it
+  uint16_t getVoxelType() const;
+  bool getChild(unsigned int child, OctreeCell *cell) const; // Same numbering as Octree's - false if not loaded
+  void getCorner(int64_t *corner) const; // Its lowest voxel
+};
+
+#endif // BRICK_HPP
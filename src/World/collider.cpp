@@ -0,0 +1,195 @@
+/* ---------------------------------------------------------------- *\
+ * collider.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "collider.hpp"
+#include "octree.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// Each level leaves at most 7 siblings waiting
+const unsigned int max_stack_size = 8 * 33;
+
+CollisionBox getBounds(const OctreeCell &cell)
+{
+  int64_t corner[3];
+  cell.getCorner(corner);
+  CollisionBox bounds;
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    bounds.min[a] = (double)corner[a] - 0.5;
+    bounds.max[a] = (double)(corner[a] + (1LL << cell.layer)) - 0.5;
+  }
+  return bounds;
+}
+
+
+// The smallest node holding the whole region, so a query doesn't walk down from the root past
+// nodes it would always descend into
+Octree *findStartNode(Octree *root, const CollisionBox &region)
+{
+  const unsigned int child_bit[3] = {1, 4, 2};
+  Octree *node = root;
+  while (!node->isLeaf() && !node->isUniform())
+  {
+    Anthrax::vec3<int64_t> center = node->getCenter();
+    int64_t axes[3] = {center.getX(), center.getY(), center.getZ()};
+    unsigned int child = 0;
+    for (unsigned int a = 0; a < 3; a++)
+    {
+      // The upper children start at the center voxel
+      double middle = (double)axes[a] - 0.5;
+      if (region.min[a] >= middle) child |= child_bit[a];
+      else if (region.max[a] > middle) return node; // Straddles the split
+    }
+    if (node->getChild(child) == nullptr) return node;
+    node = node->getChild(child);
+  }
+  return node;
+}
+
+} // namespace
+
+
+bool CollisionBox::overlaps(const CollisionBox &other) const
+{
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    if (min[a] >= other.max[a] || other.min[a] >= max[a]) return false;
+  }
+  return true;
+}
+
+
+void VoxelCollider::getSolidBoxes(const CollisionBox &region, std::vector<CollisionBox> &boxes) const
+{
+  if (root_ == nullptr) return;
+  // Bricks are walked through their blocks, so a player standing in one is tested against voxels
+  OctreeCell stack[max_stack_size];
+  unsigned int stack_size = 0;
+  stack[stack_size++] = OctreeCell(findStartNode(root_.get(), region));
+  while (stack_size > 0)
+  {
+    OctreeCell cell = stack[--stack_size];
+    CollisionBox bounds = getBounds(cell);
+    if (!bounds.overlaps(region)) continue;
+    if (cell.isLeaf())
+    {
+      if (cell.getVoxelType() != 0) boxes.push_back(bounds);
+      continue;
+    }
+    for (unsigned int i = 0; i < 8; i++)
+    {
+      if (cell.getChild(i, &stack[stack_size])) stack_size++;
+    }
+  }
+}
+
+
+bool VoxelCollider::overlapsSolid(const CollisionBox &box) const
+{
+  std::vector<CollisionBox> solids;
+  getSolidBoxes(box, solids);
+  return !solids.empty();
+}
+
+
+double VoxelCollider::sweep(const CollisionBox &box, const double *motion, int *axis) const
+{
+  CollisionBox region = box;
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    region.min[a] += std::min(motion[a], 0.0);
+    region.max[a] += std::max(motion[a], 0.0);
+  }
+  std::vector<CollisionBox> solids;
+  getSolidBoxes(region, solids);
+  int hit_axis;
+  double t = sweep(box, motion, solids, &hit_axis);
+  if (axis != nullptr) *axis = hit_axis;
+  return t;
+}
+
+
+double VoxelCollider::sweep(const CollisionBox &box, const double *motion, const std::vector<CollisionBox> &solids, int *axis)
+{
+  double t_hit = 1.0;
+  *axis = -1;
+  for (unsigned int i = 0; i < solids.size(); i++)
+  {
+    const CollisionBox &solid = solids[i];
+    // When the box's faces first reach the solid's along each axis, and when they pass it
+    double t_enter = -INFINITY;
+    double t_leave = INFINITY;
+    int enter_axis = -1;
+    bool missed = false;
+    for (unsigned int a = 0; a < 3 && !missed; a++)
+    {
+      if (motion[a] == 0.0)
+      {
+        missed = (box.max[a] <= solid.min[a] || box.min[a] >= solid.max[a]);
+        continue;
+      }
+      double t0 = (solid.min[a] - box.max[a]) / motion[a];
+      double t1 = (solid.max[a] - box.min[a]) / motion[a];
+      if (t0 > t1) std::swap(t0, t1);
+      if (t0 > t_enter)
+      {
+        t_enter = t0;
+        enter_axis = a;
+      }
+      t_leave = std::min(t_leave, t1);
+    }
+    // A negative entry time means the box already overlaps it - let the box move out
+    if (missed || enter_axis < 0 || t_enter >= t_leave || t_enter < 0.0 || t_enter >= t_hit) continue;
+    t_hit = t_enter;
+    *axis = enter_axis;
+  }
+  return t_hit;
+}
+
+
+CollisionMove VoxelCollider::move(const CollisionBox &box, const double *motion) const
+{
+  CollisionMove result;
+  // Sliding only ever shortens the motion along each axis, so everything the box can reach is
+  // inside the box swept by the whole motion - gather that once
+  CollisionBox region = box;
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    region.min[a] += std::min(motion[a], 0.0) - skin_;
+    region.max[a] += std::max(motion[a], 0.0) + skin_;
+  }
+  std::vector<CollisionBox> solids;
+  getSolidBoxes(region, solids);
+  result.num_boxes = solids.size();
+
+  double remaining[3] = {motion[0], motion[1], motion[2]};
+  // Each pass stops one axis, so three passes are enough to use up the motion
+  for (unsigned int pass = 0; pass < 3; pass++)
+  {
+    CollisionBox current = box;
+    for (unsigned int a = 0; a < 3; a++)
+    {
+      current.min[a] += result.offset[a];
+      current.max[a] += result.offset[a];
+    }
+    int axis;
+    double t = sweep(current, remaining, solids, &axis);
+    for (unsigned int a = 0; a < 3; a++) result.offset[a] += remaining[a] * t;
+    if (axis < 0) break;
+
+    // Back off to leave the gap, but never further than this pass moved
+    double back_off = std::min(skin_, fabs(remaining[axis] * t));
+    result.offset[axis] -= (remaining[axis] > 0.0) ? back_off : -back_off;
+    result.blocked[axis] = true;
+    for (unsigned int a = 0; a < 3; a++) remaining[a] *= (1.0 - t);
+    remaining[axis] = 0.0;
+  }
+  return result;
+}
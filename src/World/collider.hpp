@@ -0,0 +1,69 @@
+/* ---------------------------------------------------------------- *\
+ * collider.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Sweeps axis-aligned boxes (the player's hitbox) through the
+ * loaded octree and stops them at solid voxels.
+ *
+ * The octree is queried hierarchically: only nodes overlapping the
+ * region the box passes through are visited, and a leaf or uniform
+ * node is a single box however many voxels it holds, so a move
+ * through a solid zone or a zone of air costs one test rather than
+ * one per voxel. Coarse LOD leaves collide as the cube drawn for
+ * them, the same way Raycaster hits them.
+ *
+ * A box that already overlaps something solid (spawned inside the
+ * terrain, or caught by a node that just split into a different
+ * shape) isn't stopped by it, so it can always move back out.
+ *
+ * The tree must not change during a query.
+\* ---------------------------------------------------------------- */
+
+#ifndef COLLIDER_HPP
+#define COLLIDER_HPP
+
+#include <memory>
+#include <vector>
+
+class Octree;
+
+struct CollisionBox
+{
+  double min[3]; // World position of the faces - voxel p spans [p-0.5, p+0.5]
+  double max[3];
+  bool overlaps(const CollisionBox &other) const; // Faces that only touch don't count
+};
+
+struct CollisionMove
+{
+  double offset[3] = {0.0, 0.0, 0.0}; // How far the box actually moved
+  bool blocked[3] = {false, false, false}; // Per axis, whether something stopped the motion along it
+  unsigned int num_boxes = 0; // Solid boxes the move was tested against
+};
+
+
+class VoxelCollider
+{
+public:
+  VoxelCollider() {} // Collides with nothing
+  VoxelCollider(std::shared_ptr<Octree> root) { root_ = root; }
+  // Appends every solid leaf or uniform node overlapping region
+  void getSolidBoxes(const CollisionBox &region, std::vector<CollisionBox> &boxes) const;
+  bool overlapsSolid(const CollisionBox &box) const;
+  // The fraction of motion the box can travel before it touches something solid, 1 if nothing
+  // is in the way. axis (if given) is set to the axis of the face it touches, -1 for none
+  double sweep(const CollisionBox &box, const double *motion, int *axis = nullptr) const;
+  // Moves the box by up to motion, sliding along whatever it runs into. It's left a small gap
+  // short of anything it touches, so the next move starts clear.
+  CollisionMove move(const CollisionBox &box, const double *motion) const;
+
+  static constexpr double skin_ = 1.0 / 256.0; // The gap move() leaves, in voxels
+private:
+  static double sweep(const CollisionBox &box, const double *motion, const std::vector<CollisionBox> &solids, int *axis);
+  std::shared_ptr<Octree> root_;
+};
+
+#endif // COLLIDER_HPP
@@ -10,6 +10,7 @@
 #include <string>
 #include <fstream>
 #include <cstring>
+#include <mutex>
 #include "nlohmann/json.hpp"
 #include "cube.hpp"
 #include <iostream>
@@ -32,9 +33,16 @@ public:
   }
   Anthrax::Cube convert(int id, Anthrax::vec3<float> position, int size)
   {
+    return convert(id, Anthrax::vec3<int64_t>(0, 0, 0), position, size);
+  }
+  Anthrax::Cube convert(int id, Anthrax::vec3<int64_t> origin, Anthrax::vec3<float> position, int size) // position relative to origin
+  {
+    // Safe from any thread - the map's operator[] adds ids it hasn't seen
+    std::lock_guard<std::mutex> lock(mutex_);
     std::string id_string = std::to_string(id);
     std::vector<float> color = conversion_map_[id_string]["color"];
     return Anthrax::Cube(id,
+        origin,
         position,
         size,
         Anthrax::vec3<float>(color[0], color[1], color[2]),
@@ -44,6 +52,7 @@ public:
   }
 private:
   json conversion_map_;
+  std::mutex mutex_;
 };
 
 #endif // CUBECONVERT_HPP
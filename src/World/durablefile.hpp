@@ -0,0 +1,59 @@
+/* ---------------------------------------------------------------- *\
+ * durablefile.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Getting a file onto the disk so it survives a crash or power
+ * loss, not just into the page cache. Files that are rewritten
+ * (zones, region archives, the zone index, the edit journal) are
+ * written next to the original and swapped in with replace(), so
+ * after a crash there's either the old file or the whole new one.
+ *
+ * Without fsync (Windows), replace() is still atomic against other
+ * readers but makes no promise about power loss.
+\* ---------------------------------------------------------------- */
+
+#ifndef DURABLEFILE_HPP
+#define DURABLEFILE_HPP
+
+#include <filesystem>
+#include <string>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+class DurableFile
+{
+public:
+  // Flushes a closed file (or a directory, for the entries in it) to disk
+  static bool sync(std::string path)
+  {
+#ifndef WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool synced = (fsync(fd) == 0);
+    close(fd);
+    return synced;
+#else
+    return true;
+#endif
+  }
+
+  // Swaps tmp_filepath in for filepath once its contents are on disk, then makes the rename
+  // itself durable
+  static bool replace(std::string tmp_filepath, std::string filepath)
+  {
+    if (!sync(tmp_filepath)) return false;
+    std::error_code error;
+    std::filesystem::rename(tmp_filepath, filepath, error);
+    if (error) return false;
+    std::string directory = std::filesystem::path(filepath).parent_path().string();
+    return sync(directory.empty() ? "." : directory);
+  }
+};
+
+#endif // DURABLEFILE_HPP
@@ -0,0 +1,345 @@
+/* ---------------------------------------------------------------- *\
+ * editjournal.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "editjournal.hpp"
+#include "durablefile.hpp"
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+uint32_t crc32(const char *data, size_t size)
+{
+  static const std::array<uint32_t, 256> table = []()
+  {
+    std::array<uint32_t, 256> values;
+    for (uint32_t i = 0; i < 256; i++)
+    {
+      uint32_t value = i;
+      for (unsigned int bit = 0; bit < 8; bit++) value = (value & 1) ? (0xEDB88320u ^ (value >> 1)) : (value >> 1);
+      values[i] = value;
+    }
+    return values;
+  }();
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < size; i++) crc = table[(crc ^ (uint8_t)data[i]) & 0xFF] ^ (crc >> 8);
+  return crc ^ 0xFFFFFFFFu;
+}
+
+
+template <typename T>
+void put(std::vector<char> &bytes, T value)
+{
+  const char *data = reinterpret_cast<const char*>(&value);
+  bytes.insert(bytes.end(), data, data + sizeof(T));
+}
+
+
+template <typename T>
+bool get(const char *&data, const char *end, T *value)
+{
+  if (end - data < (ptrdiff_t)sizeof(T)) return false;
+  memcpy(value, data, sizeof(T));
+  data += sizeof(T);
+  return true;
+}
+
+
+// The record in [data, end), or false if it's cut short or corrupt
+bool parseRecord(const char *data, const char *end, EditJournal::Record *record)
+{
+  uint16_t path_length;
+  uint32_t num_ranges;
+  if (!get(data, end, &path_length) || end - data < path_length) return false;
+  record->path.assign(data, path_length);
+  data += path_length;
+  if (!get(data, end, &num_ranges) || (uint64_t)(end - data) != (uint64_t)num_ranges * 10) return false;
+  record->ranges.resize(num_ranges);
+  for (uint32_t i = 0; i < num_ranges; i++)
+  {
+    get(data, end, &record->ranges[i].start);
+    get(data, end, &record->ranges[i].count);
+    get(data, end, &record->ranges[i].type);
+  }
+  return true;
+}
+
+} // namespace
+
+
+bool EditJournal::open(std::string filepath, std::vector<Record> &records)
+{
+  close();
+  filepath_ = filepath;
+  records.clear();
+
+  std::vector<char> contents;
+  std::ifstream file(filepath_, std::ios::binary | std::ios::ate);
+  if (file)
+  {
+    contents.resize(file.tellg());
+    file.seekg(0);
+    file.read(contents.data(), contents.size());
+  }
+  uint32_t version = 0;
+  if (contents.size() >= 8) memcpy(&version, contents.data() + 4, 4);
+  bool is_valid = (contents.size() >= 8 && strncmp(contents.data(), "RXJL", 4) == 0 && version == version_);
+  if (!contents.empty() && !is_valid) std::cout << filepath_ << " is not a valid edit journal, starting a new one" << std::endl;
+
+  size_t offset = 8;
+  size_t valid_end = is_valid ? 8 : 0;
+  while (is_valid && offset + 8 <= contents.size())
+  {
+    uint32_t size, crc;
+    memcpy(&size, contents.data() + offset, 4);
+    memcpy(&crc, contents.data() + offset + 4, 4);
+    const char *payload = contents.data() + offset + 8;
+    if (size > contents.size() - offset - 8 || crc32(payload, size) != crc) break;
+    Record record;
+    if (!parseRecord(payload, payload + size, &record)) break;
+    records.push_back(record);
+    entries_.push_back({++last_sequence_, std::vector<char>(contents.begin() + offset, contents.begin() + offset + 8 + size)});
+    offset += 8 + size;
+    valid_end = offset;
+  }
+  committed_sequence_ = last_sequence_;
+
+  // Opening a world mustn't write to it, so a journal that's missing, or that a crash left part of
+  // a record at the end of, is only replaced with one holding what's whole when there's something
+  // to write (see run())
+  if (is_valid && valid_end == contents.size())
+  {
+    file_ = fopen(filepath_.c_str(), "ab");
+    if (file_ == nullptr)
+    {
+      std::cout << "Couldn't open " << filepath_ << std::endl;
+      return false;
+    }
+    file_size_ = contents.size();
+  }
+  else if (valid_end > 0)
+  {
+    std::cout << "Dropping " << contents.size() - valid_end << " bytes of a torn record from " << filepath_ << std::endl;
+  }
+  is_open_ = true;
+  thread_ = std::thread(&EditJournal::run, this);
+  return true;
+}
+
+
+void EditJournal::close()
+{
+  if (thread_.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      is_stopping_ = true;
+    }
+    work_ready_.notify_all();
+    thread_.join(); // Writes out whatever is left first
+    is_stopping_ = false;
+  }
+  if (file_ != nullptr) fclose(file_);
+  file_ = nullptr;
+  file_size_ = 0;
+  is_open_ = false;
+  is_failing_ = false;
+  buffer_.clear();
+  entries_.clear();
+  last_sequence_ = 0;
+  committed_sequence_ = 0;
+  checkpoint_sequence_ = 0;
+}
+
+
+uint64_t EditJournal::append(std::string path, const std::vector<VoxelRange> &ranges)
+{
+  std::vector<char> payload;
+  payload.reserve(6 + path.size() + 10*ranges.size());
+  put(payload, (uint16_t)path.size());
+  payload.insert(payload.end(), path.begin(), path.end());
+  put(payload, (uint32_t)ranges.size());
+  for (unsigned int i = 0; i < ranges.size(); i++)
+  {
+    put(payload, ranges[i].start);
+    put(payload, ranges[i].count);
+    put(payload, ranges[i].type);
+  }
+  std::vector<char> bytes;
+  bytes.reserve(8 + payload.size());
+  put(bytes, (uint32_t)payload.size());
+  put(bytes, crc32(payload.data(), payload.size()));
+  bytes.insert(bytes.end(), payload.begin(), payload.end());
+
+  uint64_t sequence;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!is_open_) return 0; // There's nowhere for it to go
+    buffer_.insert(buffer_.end(), bytes.begin(), bytes.end());
+    sequence = ++last_sequence_;
+    entries_.push_back({sequence, std::move(bytes)});
+  }
+  work_ready_.notify_one();
+  return sequence;
+}
+
+
+bool EditJournal::commit()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!thread_.joinable()) return false;
+  uint64_t sequence = last_sequence_;
+  uint64_t num_attempts = num_attempts_;
+  // Done, or a write since this was called failed - it's retried, but not waited for
+  work_done_.wait(lock, [&]() { return !is_busy_ && ((buffer_.empty() && checkpoint_sequence_ == 0) || (is_failing_ && num_attempts_ > num_attempts)); });
+  return committed_sequence_ >= sequence;
+}
+
+
+void EditJournal::checkpoint(uint64_t sequence)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!thread_.joinable() || sequence <= checkpoint_sequence_) return;
+    if (entries_.empty() || entries_.front().sequence > sequence) return; // Already dropped
+    checkpoint_sequence_ = sequence;
+  }
+  work_ready_.notify_one();
+}
+
+
+uint64_t EditJournal::getLastSequence()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return last_sequence_;
+}
+
+
+uint64_t EditJournal::getCommittedSequence()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return committed_sequence_;
+}
+
+
+uint64_t EditJournal::getNumCommits()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_commits_;
+}
+
+
+uint64_t EditJournal::getSize()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t size = 8;
+  for (unsigned int i = 0; i < entries_.size(); i++) size += entries_[i].bytes.size();
+  return size;
+}
+
+
+void EditJournal::run()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true)
+  {
+    work_ready_.wait(lock, [this]() { return is_stopping_ || !buffer_.empty() || checkpoint_sequence_ != 0; });
+    if (buffer_.empty() && checkpoint_sequence_ == 0) break; // Stopping, and nothing left
+    if (is_failing_ && !is_stopping_)
+    {
+      // Give whatever made the last write fail a moment before trying again
+      work_ready_.wait_for(lock, std::chrono::milliseconds(retry_interval_ms_), [this]() { return is_stopping_; });
+    }
+    is_busy_ = true;
+    uint64_t sequence = last_sequence_; // Everything up to here goes out with this commit
+    std::vector<char> bytes;
+    bytes.swap(buffer_);
+    bool written;
+    if (checkpoint_sequence_ != 0 || file_ == nullptr)
+    {
+      // A new journal with just the records still needed - the buffered ones are among them. Also
+      // how the journal is first made, and how it's mended if a failed append couldn't be undone.
+      while (!entries_.empty() && entries_.front().sequence <= checkpoint_sequence_) entries_.pop_front();
+      checkpoint_sequence_ = 0;
+      std::vector<char> contents;
+      for (unsigned int i = 0; i < entries_.size(); i++) contents.insert(contents.end(), entries_[i].bytes.begin(), entries_[i].bytes.end());
+      lock.unlock();
+      written = rewrite(contents);
+      if (written)
+      {
+        // Appends have to go to the new file
+        if (file_ != nullptr) fclose(file_);
+        file_ = fopen(filepath_.c_str(), "ab");
+        if (file_ == nullptr) std::cout << "Couldn't reopen " << filepath_ << std::endl;
+        file_size_ = 8 + contents.size();
+      }
+      lock.lock();
+    }
+    else
+    {
+      lock.unlock();
+      written = (fwrite(bytes.data(), 1, bytes.size(), file_) == bytes.size() && fflush(file_) == 0);
+#ifndef WIN32
+      written = written && (fsync(fileno(file_)) == 0);
+#endif
+      if (written) file_size_ += bytes.size();
+      else
+      {
+        // Cut off whatever part of the batch made it, or every record after it would be dropped as
+        // torn when the journal is next opened. If that can't be done, the next try replaces the file.
+        fclose(file_);
+        bool truncated = false;
+#ifndef WIN32
+        truncated = (truncate(filepath_.c_str(), file_size_) == 0);
+#endif
+        file_ = truncated ? fopen(filepath_.c_str(), "ab") : nullptr;
+      }
+      lock.lock();
+    }
+    num_attempts_++;
+    if (written)
+    {
+      committed_sequence_ = sequence;
+      num_commits_++;
+      is_failing_ = false;
+    }
+    else
+    {
+      // The file is as it was, so the batch goes back to be tried again
+      std::cout << "Failed to write " << bytes.size() << " bytes to " << filepath_ << std::endl;
+      buffer_.insert(buffer_.begin(), bytes.begin(), bytes.end());
+      is_failing_ = true;
+      if (is_stopping_)
+      {
+        std::cout << "Giving up on the edits since sequence " << committed_sequence_ << " in " << filepath_ << std::endl;
+        buffer_.clear();
+        checkpoint_sequence_ = 0;
+      }
+    }
+    is_busy_ = false;
+    work_done_.notify_all();
+  }
+}
+
+
+bool EditJournal::rewrite(std::vector<char> &contents)
+{
+  std::string tmp_filepath = filepath_ + ".tmp";
+  std::ofstream file(tmp_filepath, std::ios::binary | std::ios::trunc);
+  uint32_t version = version_;
+  file.write("RXJL", 4);
+  file.write(reinterpret_cast<const char*>(&version), 4);
+  file.write(contents.data(), contents.size());
+  file.close();
+  return file && DurableFile::replace(tmp_filepath, filepath_);
+}
@@ -0,0 +1,110 @@
+/* ---------------------------------------------------------------- *\
+ * editjournal.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * The write-ahead journal of voxel edits for a world (edits.jnl).
+ * Every edit ZoneStore saves is appended here first, so it's on disk
+ * long before the zone it changed is rewritten - ZoneStore only
+ * rewrites zones every so often, and a crash in between loses
+ * nothing. Opening the journal hands back the edits in it to be
+ * replayed over the zones on disk.
+ *
+ * Appends are buffered and a background thread writes whatever has
+ * piled up in one write and one fsync (a group commit), so a frame's
+ * worth of edits costs one sync rather than one each. Once the
+ * zones an edit touched are safely on disk, checkpoint() drops it:
+ * the records still needed are written to a new journal, which is
+ * renamed over the old one.
+ *
+ * Replaying a record over a zone that already has it is harmless -
+ * a record sets voxels, it doesn't add to them - so the journal only
+ * has to keep everything after the last checkpoint, in order.
+ *
+ * File format (little endian):
+ *  Header - "RXJL", uint32 version
+ *  Records - uint32 payload size, uint32 CRC-32 of the payload, then
+ *   the payload: uint16 path length, the zone's path, uint32 number
+ *   of ranges, then per range uint32 start, uint32 count and uint16
+ *   voxel type (see VoxelRange)
+ * A record cut short by a crash fails its size or CRC check, and it
+ * and anything after it are dropped when the journal is opened.
+\* ---------------------------------------------------------------- */
+
+#ifndef EDITJOURNAL_HPP
+#define EDITJOURNAL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "voxelset.hpp"
+
+class EditJournal
+{
+public:
+  struct Record
+  {
+    std::string path; // Of the zone, as used by ZoneStore
+    std::vector<VoxelRange> ranges; // In the zone's run order
+  };
+
+  EditJournal() {}
+  ~EditJournal() { close(); }
+  EditJournal(const EditJournal&) = delete;
+  EditJournal& operator=(const EditJournal&) = delete;
+  // records gets what's in the journal, oldest first - their sequence numbers are 1 to records.size().
+  // Nothing is written until there's something to commit, which creates the journal if there isn't
+  // one.
+  bool open(std::string filepath, std::vector<Record> &records);
+  void close(); // Commits everything appended first
+  uint64_t append(std::string path, const std::vector<VoxelRange> &ranges); // Returns the record's sequence number
+  // Blocks until everything appended, and any checkpoint asked for, is on disk, or until a write fails.
+  // Returns whether everything appended before the call is on disk.
+  bool commit();
+  // Drops every record up to and including sequence - the zones they edited must be on disk
+  void checkpoint(uint64_t sequence);
+  uint64_t getLastSequence();
+  uint64_t getCommittedSequence(); // Everything up to here is on disk
+  uint64_t getNumCommits(); // Successful syncs, however many records each held
+  uint64_t getSize(); // Of the records kept since the last checkpoint, in bytes
+private:
+  struct Entry
+  {
+    uint64_t sequence;
+    std::vector<char> bytes; // As written, header included
+  };
+  void run();
+  bool rewrite(std::vector<char> &contents); // Replaces the file with a new one holding contents (records, no header)
+
+  std::string filepath_;
+  FILE *file_ = nullptr; // Only touched by the thread once it's started - null until the journal is (re)written
+  uint64_t file_size_ = 0; // Up to the end of the last record written whole
+  bool is_open_ = false;
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable work_ready_;
+  std::condition_variable work_done_;
+  std::vector<char> buffer_; // Appended, not written yet
+  std::deque<Entry> entries_; // Every record since the last checkpoint, for rewriting the file
+  uint64_t last_sequence_ = 0;
+  uint64_t committed_sequence_ = 0;
+  uint64_t checkpoint_sequence_ = 0; // Asked for, but not done yet - 0 for none
+  uint64_t num_commits_ = 0;
+  uint64_t num_attempts_ = 0; // Including the failed ones
+  bool is_failing_ = false; // The last write failed - the batch waits to be tried again
+  bool is_busy_ = false;
+  bool is_stopping_ = false;
+
+  static const uint32_t version_ = 1;
+  static const unsigned int retry_interval_ms_ = 100;
+};
+
+#endif // EDITJOURNAL_HPP
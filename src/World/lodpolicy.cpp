@@ -0,0 +1,242 @@
+/* ---------------------------------------------------------------- *\
+ * lodpolicy.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "lodpolicy.hpp"
+#include "octree.hpp"
+#include "profiler.hpp"
+#include "residency.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+
+ScreenSpaceLodPolicy::ScreenSpaceLodPolicy(Quality quality)
+{
+  hysteresis_ = 0.1f;
+  switch (quality)
+  {
+    case LOW:
+      max_error_pixels_ = 8.0f;
+      max_distance_ = 3000.0f;
+      outside_view_weight_ = 0.25f;
+      hysteresis_ = 0.2f;
+      setBudget(1024, 1024);
+      break;
+    case MEDIUM:
+      max_error_pixels_ = 4.0f;
+      max_distance_ = 5000.0f;
+      outside_view_weight_ = 0.25f;
+      setBudget(2048, 2048);
+      break;
+    case HIGH:
+      max_error_pixels_ = 2.0f;
+      max_distance_ = 8000.0f;
+      outside_view_weight_ = 0.5f;
+      setBudget(4096, 4096);
+      break;
+    case ULTRA:
+      max_error_pixels_ = 1.0f;
+      max_distance_ = 12000.0f;
+      outside_view_weight_ = 1.0f;
+      setBudget(8192, 8192);
+      break;
+  }
+}
+
+
+ScreenSpaceLodPolicy::ScreenSpaceLodPolicy(float max_error_pixels, float max_distance, float outside_view_weight, float hysteresis)
+{
+  max_error_pixels_ = max_error_pixels;
+  max_distance_ = max_distance;
+  outside_view_weight_ = outside_view_weight;
+  hysteresis_ = hysteresis;
+}
+
+
+ScreenSpaceLodPolicy::Quality ScreenSpaceLodPolicy::qualityFromString(std::string name)
+{
+  if (name == "low") return LOW;
+  if (name == "high") return HIGH;
+  if (name == "ultra") return ULTRA;
+  return MEDIUM;
+}
+
+
+LodPolicy::Decision ScreenSpaceLodPolicy::decide(Anthrax::vec3<int64_t> node_center, unsigned int layer, bool is_split)
+{
+  if (layer == 0) return KEEP;
+  float distance = getDistance(node_center, layer);
+  float error = getScreenError(node_center, layer);
+  if (!is_split)
+  {
+    return (distance < max_distance_ && error > max_error_pixels_) ? SPLIT : KEEP;
+  }
+  // Only merge once the node is clearly past the split thresholds
+  bool keep = distance < max_distance_ * (1.0f + hysteresis_) && error * (1.0f + hysteresis_) > max_error_pixels_;
+  return keep ? KEEP : MERGE;
+}
+
+
+float ScreenSpaceLodPolicy::getPriority(Anthrax::vec3<int64_t> node_center, unsigned int layer)
+{
+  return getScreenError(node_center, layer);
+}
+
+
+float ScreenSpaceLodPolicy::getScreenError(Anthrax::vec3<int64_t> node_center, unsigned int layer)
+{
+  float distance = getDistance(node_center, layer);
+  if (distance < 1.0f) distance = 1.0f;
+  float tan_half_fov = tan(view_.vertical_fov * 0.5f);
+  // Projected width of the node at its closest point - the node is drawn as one cube, so
+  // this is how far off its children could be on screen
+  float error = (float)(1ULL << layer) / distance * (view_.viewport_height / (2.0f * tan_half_fov));
+
+  if (outside_view_weight_ < 1.0f)
+  {
+    Anthrax::vec3<int64_t> offset = node_center - view_.position;
+    Anthrax::vec3<float> to_node((float)offset.getX(), (float)offset.getY(), (float)offset.getZ());
+    float length = to_node.getMagnitude();
+    float radius = getBoundingRadius(layer);
+    if (length > radius)
+    {
+      // Compare against the cone around the screen's diagonal, which contains the whole frustum
+      float aspect = (float)view_.viewport_width / (float)view_.viewport_height;
+      float half_cone = atan(tan_half_fov * sqrt(1.0f + aspect * aspect));
+      float cos_angle = Anthrax::dot(to_node, view_.look_direction) / length;
+      float angle = acos(std::max(-1.0f, std::min(1.0f, cos_angle)));
+      if (angle - asin(radius / length) > half_cone) error *= outside_view_weight_;
+    }
+  }
+  return error;
+}
+
+
+void LodQueue::requestSplit(std::shared_ptr<Octree> node, float priority)
+{
+  // A node that's already waiting is only queued again if it became more important, since
+  // the entry already in the queue may be buried
+  std::weak_ptr<Octree> key = node;
+  QueuedMap::iterator itr = queued_.find(key);
+  if (itr != queued_.end() && itr->second >= priority) return;
+  queued_[key] = priority;
+  splits_.push_back({key, priority});
+  std::push_heap(splits_.begin(), splits_.end(), HigherPriority());
+}
+
+
+void LodQueue::requestMerge(std::shared_ptr<Octree> node, float priority)
+{
+  std::weak_ptr<Octree> key = node;
+  if (queued_.find(key) != queued_.end()) return;
+  queued_[key] = priority;
+  merges_.push_back({key, priority});
+  std::push_heap(merges_.begin(), merges_.end(), LowerPriority());
+}
+
+
+bool LodQueue::isCurrent(const Request &request)
+{
+  QueuedMap::iterator itr = queued_.find(request.node);
+  return itr != queued_.end() && itr->second == request.priority;
+}
+
+
+void LodQueue::apply(LodPolicy &lod_policy, uint64_t time_budget_us, ResidencyManager *residency)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::chrono::microseconds time_budget(time_budget_us);
+  bool is_timed = time_budget_us != UINT64_MAX; // An unlimited budget would overflow once converted to the clock's units
+  num_splits_ = 0;
+  num_merges_ = 0;
+  prune();
+
+  // Merges first, least important first - they free memory and can make pending splits moot
+  while (!merges_.empty() && num_merges_ < lod_policy.getMaxMerges())
+  {
+    std::pop_heap(merges_.begin(), merges_.end(), LowerPriority());
+    Request request = merges_.back();
+    merges_.pop_back();
+    if (!isCurrent(request)) continue; // Superseded by a split request
+    queued_.erase(request.node);
+    std::shared_ptr<Octree> node = request.node.lock();
+    if (node == nullptr || node->isLeaf()) continue; // An ancestor was merged first
+    if (lod_policy.decide(node->getCenter(), node->getLayer(), true) != LodPolicy::MERGE) continue; // The view moved back
+    node->merge();
+    node->updateAncestorFaces();
+    num_merges_++;
+    if (is_timed && std::chrono::steady_clock::now() - start >= time_budget) break;
+  }
+
+  // Splitting a node evaluates its new children, which can request more splits - those are
+  // queued here too, so with an unlimited budget a single frame still refines all the way down
+  while (!splits_.empty() && num_splits_ < lod_policy.getMaxSplits() && !(is_timed && std::chrono::steady_clock::now() - start >= time_budget))
+  {
+    std::pop_heap(splits_.begin(), splits_.end(), HigherPriority());
+    Request request = splits_.back();
+    splits_.pop_back();
+    if (!isCurrent(request)) continue; // Requeued with a different priority since
+    std::shared_ptr<Octree> node = request.node.lock();
+    if (node == nullptr || !node->isLeaf() || lod_policy.decide(node->getCenter(), node->getLayer(), false) != LodPolicy::SPLIT)
+    {
+      queued_.erase(request.node);
+      continue;
+    }
+    float priority = lod_policy.getPriority(node->getCenter(), node->getLayer());
+    if (priority < request.priority && !splits_.empty() && priority < splits_.front().priority)
+    {
+      // Queued for an older view and no longer the most important - try again in order
+      request.priority = priority;
+      queued_[request.node] = priority;
+      splits_.push_back(request);
+      std::push_heap(splits_.begin(), splits_.end(), HigherPriority());
+      continue;
+    }
+    if (residency != nullptr && !residency->allowSplit(priority))
+    {
+      // Out of memory for now - everything left is less important, so it all waits
+      splits_.push_back(request);
+      std::push_heap(splits_.begin(), splits_.end(), HigherPriority());
+      break;
+    }
+    queued_.erase(request.node);
+    node->split(*this);
+    node->updateAncestorFaces();
+    num_splits_++;
+  }
+
+  Anthrax::Profiler::addCounter(Anthrax::Profiler::LOD_SPLITS, num_splits_);
+  Anthrax::Profiler::addCounter(Anthrax::Profiler::LOD_MERGES, num_merges_);
+}
+
+
+void LodQueue::prune()
+{
+  // Splits residency holds back are never popped, so the requests behind them for nodes merged or
+  // paged out since, and the entries superseded by a re-request, would pile up as long as a queue is
+  // kept. Checked once the queue has doubled since the last prune, so a settled queue costs nothing.
+  if (splits_.size() + merges_.size() < 2*pruned_size_ + min_prune_size_) return;
+  for (QueuedMap::iterator itr = queued_.begin(); itr != queued_.end();)
+  {
+    if (itr->first.expired()) itr = queued_.erase(itr);
+    else itr++;
+  }
+  auto is_stale = [this](const Request &request) { return !isCurrent(request); };
+  splits_.erase(std::remove_if(splits_.begin(), splits_.end(), is_stale), splits_.end());
+  std::make_heap(splits_.begin(), splits_.end(), HigherPriority());
+  merges_.erase(std::remove_if(merges_.begin(), merges_.end(), is_stale), merges_.end());
+  std::make_heap(merges_.begin(), merges_.end(), LowerPriority());
+  pruned_size_ = splits_.size() + merges_.size();
+}
+
+
+void LodQueue::clear()
+{
+  splits_.clear();
+  merges_.clear();
+  queued_.clear();
+  pruned_size_ = 0;
+}
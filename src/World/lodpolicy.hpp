@@ -0,0 +1,193 @@
+/* ---------------------------------------------------------------- *\
+ * lodpolicy.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Level of detail selection. A LodPolicy decides whether a node
+ * should be split into its children or merged back into a single
+ * cube, and how important that change is, given the current view. Splitting and merging
+ * use separate thresholds (hysteresis) so a camera sitting right on
+ * a boundary doesn't make nodes flip back and forth every frame.
+ *
+ * Octree doesn't act on these decisions directly - it files them
+ * with a LodQueue, which applies the most important ones each
+ * frame up to the policy's split/merge budget and leaves the rest
+ * for later frames. LodStreamer (see lodstreamer.hpp) drives a
+ * queue incrementally under a per-frame time budget.
+\* ---------------------------------------------------------------- */
+
+#ifndef LODPOLICY_HPP
+#define LODPOLICY_HPP
+
+#include <climits>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "anthrax_types.hpp"
+
+class Octree;
+class ResidencyManager;
+
+// Where the world is being looked at from
+struct LodView
+{
+  Anthrax::vec3<int64_t> position;
+  Anthrax::vec3<float> look_direction = Anthrax::vec3<float>(0.0f, 0.0f, 1.0f); // Unit length
+  float vertical_fov = 0.785398163f; // Radians
+  unsigned int viewport_width = 1920; // Pixels
+  unsigned int viewport_height = 1080;
+};
+
+class LodPolicy
+{
+public:
+  enum Decision
+  {
+    MERGE, // Should not have children, but does
+    KEEP,
+    SPLIT // Should have children, but doesn't
+  };
+
+  virtual ~LodPolicy() {}
+  virtual Decision decide(Anthrax::vec3<int64_t> node_center, unsigned int layer, bool is_split) = 0;
+  // How much visible error leaving the node as it is causes - larger is more important
+  virtual float getPriority(Anthrax::vec3<int64_t> node_center, unsigned int layer)
+  {
+    float distance = getDistance(node_center, layer);
+    return (float)(1ULL << layer) / (distance > 1.0f ? distance : 1.0f);
+  }
+
+  void setView(LodView view) { view_ = view; }
+  LodView getView() { return view_; }
+  void setBudget(unsigned int max_splits, unsigned int max_merges) { max_splits_ = max_splits; max_merges_ = max_merges; }
+  unsigned int getMaxSplits() { return max_splits_; }
+  unsigned int getMaxMerges() { return max_merges_; }
+  static const unsigned int unlimited_ = UINT_MAX;
+protected:
+  // Distance from the view to the closest point of the node's bounding sphere
+  float getDistance(Anthrax::vec3<int64_t> node_center, unsigned int layer)
+  {
+    float distance = (node_center - view_.position).getMagnitude() - getBoundingRadius(layer);
+    return distance > 0.0f ? distance : 0.0f;
+  }
+  static float getBoundingRadius(unsigned int layer) { return (1LL << layer) * 0.866025403784f; }
+
+  LodView view_;
+  unsigned int max_splits_ = 4096; // Per frame
+  unsigned int max_merges_ = 4096;
+};
+
+
+// The original distance-only rule (split while distance < max_distance and
+// layer > distance / layer_distance), with merges delayed until the node is
+// (1 + hysteresis) times further away than where it split
+class DistanceLodPolicy : public LodPolicy
+{
+public:
+  DistanceLodPolicy(float max_distance, float layer_distance, float hysteresis)
+  {
+    max_distance_ = max_distance;
+    layer_distance_ = layer_distance;
+    hysteresis_ = hysteresis;
+  }
+  Decision decide(Anthrax::vec3<int64_t> node_center, unsigned int layer, bool is_split) override
+  {
+    float distance = getDistance(node_center, layer);
+    if (!is_split) return wantsSplit(distance, layer) ? SPLIT : KEEP;
+    return wantsSplit(distance / (1.0f + hysteresis_), layer) ? KEEP : MERGE;
+  }
+private:
+  bool wantsSplit(float distance, unsigned int layer) { return distance < max_distance_ && layer > (uint64_t)distance / layer_distance_; }
+
+  float max_distance_;
+  float layer_distance_;
+  float hysteresis_;
+};
+
+
+// Splits a node while its width, projected onto the screen, is more than
+// max_error_pixels - so the error left by drawing it as one cube stays
+// under that many pixels. Depends on the view's field of view and
+// resolution, so zooming in refines distant nodes. Nodes entirely outside
+// the view cone have their error scaled by outside_view_weight, so they
+// stay coarser and are refined last (1 to treat them like visible nodes).
+class ScreenSpaceLodPolicy : public LodPolicy
+{
+public:
+  enum Quality
+  {
+    LOW,
+    MEDIUM,
+    HIGH,
+    ULTRA
+  };
+
+  ScreenSpaceLodPolicy(Quality quality);
+  ScreenSpaceLodPolicy(float max_error_pixels, float max_distance, float outside_view_weight, float hysteresis);
+  Decision decide(Anthrax::vec3<int64_t> node_center, unsigned int layer, bool is_split) override;
+  float getPriority(Anthrax::vec3<int64_t> node_center, unsigned int layer) override;
+  static Quality qualityFromString(std::string name); // "low", "medium", "high" or "ultra", defaulting to MEDIUM
+private:
+  float getScreenError(Anthrax::vec3<int64_t> node_center, unsigned int layer); // Pixels
+
+  float max_error_pixels_;
+  float max_distance_;
+  float outside_view_weight_;
+  float hysteresis_;
+};
+
+
+// Pending splits and merges. Requests stay queued until they're applied
+// or found to be stale - each one is checked against the policy's current
+// view again before it's applied, and re-queued if its priority has
+// dropped, so a queue filled before the camera moved still works on
+// whatever is most important now.
+class LodQueue
+{
+public:
+  LodQueue() {}
+  void requestSplit(std::shared_ptr<Octree> node, float priority);
+  void requestMerge(std::shared_ptr<Octree> node, float priority);
+  // Stops when the policy's split/merge budget or time_budget_us runs out, whichever is first. Splits
+  // residency won't allow yet stay queued.
+  void apply(LodPolicy &lod_policy, uint64_t time_budget_us = UINT64_MAX, ResidencyManager *residency = nullptr);
+  void clear();
+  unsigned int getNumPending() { return queued_.size(); }
+  unsigned int getNumSplits() { return num_splits_; } // By the last apply
+  unsigned int getNumMerges() { return num_merges_; }
+private:
+  struct Request
+  {
+    std::weak_ptr<Octree> node; // Also its key in queued_, which stays unique after the node is gone
+    float priority;
+  };
+  struct HigherPriority
+  {
+    bool operator()(const Request &a, const Request &b) const { return a.priority < b.priority; }
+  };
+  struct LowerPriority
+  {
+    bool operator()(const Request &a, const Request &b) const { return a.priority > b.priority; }
+  };
+  typedef std::map<std::weak_ptr<Octree>, float, std::owner_less<std::weak_ptr<Octree>>> QueuedMap;
+  bool isCurrent(const Request &request);
+  void prune();
+
+  // Heaps rather than priority_queues, so prune() can filter them in place
+  std::vector<Request> splits_; // Most important on top
+  std::vector<Request> merges_; // Least important on top
+  // Priority of each node's current request - older entries for it are skipped. Keyed by the node's
+  // control block rather than its address, as a node merged or paged out while queued can have its
+  // address reused by a new one.
+  QueuedMap queued_;
+  size_t pruned_size_ = 0; // Requests left after the last prune()
+  static const size_t min_prune_size_ = 1024;
+  unsigned int num_splits_ = 0;
+  unsigned int num_merges_ = 0;
+};
+
+#endif // LODPOLICY_HPP
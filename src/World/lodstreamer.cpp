@@ -0,0 +1,65 @@
+/* ---------------------------------------------------------------- *\
+ * lodstreamer.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "lodstreamer.hpp"
+#include "octree.hpp"
+
+#include <chrono>
+
+
+void LodStreamer::update(std::shared_ptr<Octree> root, LodPolicy &lod_policy, ResidencyManager *residency)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  LodView view = lod_policy.getView();
+  if (!has_scanned_ || viewMoved(view))
+  {
+    // Preempt whatever walk was in progress - it was ranking nodes for a view we're no longer at
+    scan_queue_ = std::priority_queue<ScanEntry>();
+    scan_queue_.push({root, 0.0f});
+    scan_view_ = view;
+    has_scanned_ = true;
+    num_rescans_++;
+  }
+
+  if (!scan_queue_.empty())
+  {
+    // Let the walk have the whole budget if there's nothing to apply yet
+    scan(lod_policy, lod_queue_.getNumPending() == 0 ? time_budget_us_ : (uint64_t)(time_budget_us_ * scan_fraction_));
+  }
+  uint64_t elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  if (elapsed_us < time_budget_us_) lod_queue_.apply(lod_policy, time_budget_us_ - elapsed_us, residency);
+}
+
+
+bool LodStreamer::viewMoved(LodView view)
+{
+  Anthrax::vec3<int64_t> offset = view.position - scan_view_.position;
+  if (offset.getMagnitude() > rescan_distance_) return true;
+  if (Anthrax::dot(view.look_direction, scan_view_.look_direction) < rescan_angle_cos_) return true;
+  return view.vertical_fov != scan_view_.vertical_fov
+      || view.viewport_width != scan_view_.viewport_width
+      || view.viewport_height != scan_view_.viewport_height;
+}
+
+
+void LodStreamer::scan(LodPolicy &lod_policy, uint64_t time_budget_us)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::chrono::microseconds time_budget(time_budget_us);
+  unsigned int num_visited = 0;
+  while (!scan_queue_.empty())
+  {
+    // Reading the clock costs more than visiting a node, so only check every so often
+    if (++num_visited % 256 == 0 && std::chrono::steady_clock::now() - start >= time_budget) return;
+    std::shared_ptr<Octree> node = scan_queue_.top().node.lock();
+    scan_queue_.pop();
+    if (node == nullptr || !node->evaluateLod(lod_queue_)) continue; // Merged away since it was queued, or a leaf
+    for (unsigned int i = 0; i < 8; i++)
+    {
+      std::shared_ptr<Octree> child = node->getChildPointer(i).lock();
+      if (child != nullptr) scan_queue_.push({child, lod_policy.getPriority(child->getCenter(), child->getLayer())});
+    }
+  }
+}
@@ -0,0 +1,64 @@
+/* ---------------------------------------------------------------- *\
+ * lodstreamer.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Spreads LOD refinement across frames under a time budget. Each
+ * frame, a slice of the budget goes to walking the octree for nodes
+ * that need splitting or merging (picking up where the last frame
+ * stopped), and the rest to applying the queued changes in priority
+ * order, most visible first.
+ *
+ * Once the camera has moved far enough or turned far enough, the walk
+ * starts over from the root for the new view. Requests already queued
+ * aren't thrown away - LodQueue re-checks and re-ranks each one
+ * against the new view as it comes up, so near, in-view detail still
+ * arrives first.
+\* ---------------------------------------------------------------- */
+
+#ifndef LODSTREAMER_HPP
+#define LODSTREAMER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include "lodpolicy.hpp"
+
+class LodStreamer
+{
+public:
+  LodStreamer() {}
+  void update(std::shared_ptr<Octree> root, LodPolicy &lod_policy, ResidencyManager *residency = nullptr); // One frame's worth of work
+  void setTimeBudget(uint64_t time_budget_us) { time_budget_us_ = time_budget_us; }
+  uint64_t getTimeBudget() { return time_budget_us_; }
+  void setRescanDistance(float distance) { rescan_distance_ = distance; }
+  unsigned int getNumPending() { return lod_queue_.getNumPending(); }
+  unsigned int getNumSplits() { return lod_queue_.getNumSplits(); } // In the last update
+  unsigned int getNumMerges() { return lod_queue_.getNumMerges(); }
+  uint64_t getNumRescans() { return num_rescans_; }
+  bool isSettled() { return scan_queue_.empty() && lod_queue_.getNumPending() == 0; } // Nothing left to do for the current view
+private:
+  bool viewMoved(LodView view);
+  void scan(LodPolicy &lod_policy, uint64_t time_budget_us);
+
+  struct ScanEntry
+  {
+    std::weak_ptr<Octree> node;
+    float priority;
+    bool operator<(const ScanEntry &other) const { return priority < other.priority; }
+  };
+
+  LodQueue lod_queue_;
+  std::priority_queue<ScanEntry> scan_queue_; // Nodes still to be visited by the current walk
+  LodView scan_view_; // The view the current walk started with
+  bool has_scanned_ = false;
+  uint64_t time_budget_us_ = 4000; // Per frame
+  float scan_fraction_ = 0.25f; // Share of the budget reserved for walking while a walk is in progress
+  float rescan_distance_ = 16.0f; // Voxels
+  float rescan_angle_cos_ = 0.985f; // About 10 degrees
+  uint64_t num_rescans_ = 0;
+};
+
+#endif // LODSTREAMER_HPP
@@ -6,7 +6,9 @@
 #include "octree.hpp"
 #include <iostream>
 #include <algorithm>
+#include <thread>
 #include "cubeconvert.hpp"
+#include "profiler.hpp"
 
 
 Octree::Octree(std::weak_ptr<Octree> parent, unsigned int layer, unsigned int file_layer, std::string path, Anthrax::vec3<int64_t> center)
@@ -17,13 +19,13 @@ Octree::Octree(std::weak_ptr<Octree> parent, unsigned int layer, unsigned int fi
   center_ = center;
   is_uniform_ = false;
   path_ = path;
+  Anthrax::Profiler::addCounter(Anthrax::Profiler::NODES_LOADED, 1);
 
   if (layer_ == file_layer_)
   {
-    voxel_set_ = VoxelSet(1 << (3*layer_));
-    voxel_set_.readFile(path_ + ".zn");
-    is_uniform_ = voxel_set_.isUniform();
-    splitVoxelSet();
+    // Drawn from the zone's pyramid until something needs its voxels
+    pyramid_ = zone_store_.loadPyramid(path_.substr(path_.find_last_of('/') + 1));
+    applyPyramid();
   }
   else if (layer_ == 0)
   {
@@ -41,10 +43,26 @@ Octree::Octree(std::weak_ptr<Octree> parent, unsigned int layer, unsigned int fi
   file_layer_ = file_layer;
   center_ = center;
   path_ = path;
-  voxel_set_ = voxel_set;
+  voxel_set_ = std::move(voxel_set);
+  has_voxel_set_ = true;
+  voxel_type_ = voxel_set_.getVoxelType();
   is_uniform_ = voxel_set_.isUniform();
-  if (layer_ != 0)
-    splitVoxelSet();
+  Anthrax::Profiler::addCounter(Anthrax::Profiler::NODES_LOADED, 1);
+  is_leaf_ = true;
+  cube_pointer_ = nullptr;
+}
+
+
+Octree::Octree(std::weak_ptr<Octree> parent, unsigned int layer, unsigned int file_layer, std::string path, Anthrax::vec3<int64_t> center, std::shared_ptr<const ZonePyramid> pyramid)
+{
+  parent_ = parent;
+  layer_ = layer;
+  file_layer_ = file_layer;
+  center_ = center;
+  path_ = path;
+  pyramid_ = pyramid;
+  applyPyramid();
+  Anthrax::Profiler::addCounter(Anthrax::Profiler::NODES_LOADED, 1);
   is_leaf_ = true;
   cube_pointer_ = nullptr;
 }
@@ -52,6 +70,7 @@ Octree::Octree(std::weak_ptr<Octree> parent, unsigned int layer, unsigned int fi
 
 Octree::~Octree()
 {
+  for (unsigned int i = 0; i < NUM_RESIDENT_KINDS; i++) resident_bytes_total_[i] -= resident_bytes_[i];
   for (unsigned int i = 0; i < 8; i++)
   {
     if (children_[i] != nullptr)
@@ -70,35 +89,58 @@ Octree::~Octree()
 
 void Octree::splitVoxelSet()
 {
-  /*
-  VoxelSet halves[2];
-  voxel_set_.bisect(&(halves[0]), &(halves[1]));
-  VoxelSet quarters[4];
-  halves[0].bisect(&(quarters[0]), &(quarters[1]));
-  halves[1].bisect(&(quarters[2]), &(quarters[3]));
-
-  quarters[0].bisect(&(voxel_set_quadrants_[0]), &(voxel_set_quadrants_[1]));
-  quarters[1].bisect(&(voxel_set_quadrants_[2]), &(voxel_set_quadrants_[3]));
-  quarters[2].bisect(&(voxel_set_quadrants_[4]), &(voxel_set_quadrants_[5]));
-  quarters[3].bisect(&(voxel_set_quadrants_[6]), &(voxel_set_quadrants_[7]));
-  */
-  // Split in half
-  voxel_set_.bisect(&(voxel_set_quadrants_[2]), &(voxel_set_quadrants_[3]));
-  // Split in quarters
-  voxel_set_quadrants_[2].bisect(&(voxel_set_quadrants_[4]), &(voxel_set_quadrants_[5]));
-  voxel_set_quadrants_[3].bisect(&(voxel_set_quadrants_[6]), &(voxel_set_quadrants_[7]));
-  // Split in eighths
-  voxel_set_quadrants_[4].bisect(&(voxel_set_quadrants_[0]), &(voxel_set_quadrants_[1]));
-  voxel_set_quadrants_[5].bisect(&(voxel_set_quadrants_[2]), &(voxel_set_quadrants_[3]));
-  voxel_set_quadrants_[6].bisect(&(voxel_set_quadrants_[4]), &(voxel_set_quadrants_[5]));
-  voxel_set_quadrants_[7].bisect(&(voxel_set_quadrants_[6]), &(voxel_set_quadrants_[7]));
+  if (quadrants_split_) return;
+  ensureVoxelSet();
+  // Each quadrant only views its part of the node's runs, so they're found directly rather than by
+  // bisecting into halves and quarters first
+  for (unsigned int i = 0; i < 8; i++) voxel_set_quadrants_[i] = voxel_set_.getQuadrant(i);
+  quadrants_split_ = true;
+  updateResidentBytes();
   return;
 }
 
 
+void Octree::ensureVoxelSet()
+{
+  if (has_voxel_set_ || layer_ > file_layer_) return;
+  if (layer_ == file_layer_)
+  {
+    voxel_set_ = zone_store_.loadZone(path_.substr(path_.find_last_of('/') + 1));
+  }
+  else
+  {
+    // Its part of the parent's, which may have to be loaded first too
+    std::shared_ptr<Octree> parent = parent_.lock();
+    parent->splitVoxelSet();
+    voxel_set_ = parent->voxel_set_quadrants_[path_.back() - '0'];
+  }
+  has_voxel_set_ = true;
+  updateResidentBytes();
+}
+
+
+void Octree::applyPyramid()
+{
+  // The digits of the path under the zone's are the node's number within its level
+  unsigned int depth = file_layer_ - layer_;
+  uint32_t index = 0;
+  for (unsigned int i = path_.size() - depth; i < path_.size(); i++) index = (index << 3) | (path_[i] - '0');
+  const ZonePyramid::Node &node = pyramid_->getNode(depth, index);
+  voxel_type_ = node.voxel_type;
+  is_uniform_ = node.isUniform();
+}
+
+
 void Octree::setCubeSettingsFile(std::string file)
 {
   cube_converter_.setFile(file);
+  for (unsigned int i = 0; i < cube_batches_.size(); i++) cube_batches_[i]->materials.clear();
+}
+
+
+void Octree::openZoneStore(std::string directory, ZoneAddress zone_address)
+{
+  zone_store_.open(directory, zone_address);
 }
 
 
@@ -108,244 +150,379 @@ void Octree::setAnthraxPointer(Anthrax::Anthrax *anthrax_instance)
 }
 
 
-void Octree::setLoadDecisionFunction(bool (*load_decision_function)(uint64_t, int))
+void Octree::setLodPolicy(std::shared_ptr<LodPolicy> lod_policy)
+{
+  lod_policy_ = lod_policy;
+}
+
+
+void Octree::loadAreaRecursive(LodQueue &lod_queue)
 {
-  loadDecisionFunction = load_decision_function;
+  if (!evaluateLod(lod_queue)) return;
+
+  // Keep the children up to date even if a merge is pending, since it may be deferred
+  for (unsigned int i = 0; i < 8; i++)
+  {
+    if (children_[i] != nullptr)
+      children_[i]->loadAreaRecursive(lod_queue);
+  }
+  updateFaceTransparency();
 }
 
 
-void Octree::loadAreaRecursive(Anthrax::vec3<int64_t> load_center)
+bool Octree::evaluateLod(LodQueue &lod_queue)
 {
   if (is_uniform_) 
   {
     is_leaf_ = true;
-    if (voxel_set_.getVoxelType() != 0)
-    {
-      for (unsigned int i = 0; i < 6; i++)
-      {
-        transparent_face_[i] = false;
-      }
-    }
-    return;
+    updateLeafFaces();
+    return false;
   }
 
+  // Splits and merges are only requested here - lod_queue decides which happen and when
+  LodPolicy::Decision decision = lod_policy_->decide(center_, layer_, !is_leaf_);
+  if (is_leaf_)
+  {
+    if (decision == LodPolicy::SPLIT) lod_queue.requestSplit(shared_from_this(), lod_policy_->getPriority(center_, layer_));
+    updateLeafFaces();
+    return false;
+  }
+  if (decision == LodPolicy::MERGE) lod_queue.requestMerge(shared_from_this(), lod_policy_->getPriority(center_, layer_));
+  if (brick_ != nullptr && updateBrickLod(OctreeCell(this), true))
+  {
+    // Blocks split and merge straight away - redrawing one brick is cheap next to a node's worth
+    brick_cubes_.clear();
+    brick_meshed_ = false;
+    num_brick_lod_changes_++;
+    updateResidentBytes();
+  }
+  return true;
+}
 
-  bool was_leaf = is_leaf_;
-  is_leaf_ = true;
-  Anthrax::vec3<int64_t> quadrant_centers[8];
 
-  float distance = (center_ - load_center).getMagnitude() - ((1LL << layer_) * 0.866025403784);
-  if (distance < 0) distance = 0;
-  if (loadDecisionFunction(distance, layer_))
+bool Octree::updateBrickLod(const OctreeCell &cell, bool was_split)
+{
+  bool changed = false;
+  OctreeCell child;
+  for (unsigned int i = 0; i < 8; i++)
   {
+    // Single voxels and blocks of one type have nothing to split into
+    if (!cell.getChild(i, &child) || child.layer == 0) continue;
+    if (!Brick::isMixed(brick_->getBlock(child.layer, child.block[0], child.block[1], child.block[2]))) continue;
+    uint32_t index = brick_->getBlockIndex(child.layer, child.block[0], child.block[1], child.block[2]);
+    bool is_split = was_split && brick_split_[index]; // A merged block's children start over
+    int64_t corner[3];
+    child.getCorner(corner);
+    int64_t half = 1LL << (child.layer - 1);
+    Anthrax::vec3<int64_t> center(corner[0] + half, corner[1] + half, corner[2] + half);
+    LodPolicy::Decision decision = lod_policy_->decide(center, child.layer, is_split);
+    bool should_split = is_split ? (decision != LodPolicy::MERGE) : (decision == LodPolicy::SPLIT);
+    if (should_split != brick_split_[index]) changed = true;
+    brick_split_[index] = should_split;
+    if (should_split) changed = updateBrickLod(child, true) || changed;
+  }
+  return changed;
+}
+
+
+void Octree::split(LodQueue &lod_queue)
+{
+  if (is_uniform_ || !is_leaf_) return;
+  if (layer_ == brick_layer_ && layer_ <= file_layer_)
+  {
+    // Everything under here at full resolution, without the nodes
+    ensureVoxelSet();
+    brick_ = std::make_shared<Brick>(voxel_set_, layer_);
+    brick_split_.assign(brick_->getNumBlocks(), false);
+    updateBrickLod(OctreeCell(this), true);
+    brick_meshed_ = false;
     is_leaf_ = false;
+    cube_pointer_.reset();
+    updateResidentBytes();
+    updateFaceTransparency();
+    markNeighborsDirty();
+    return;
+  }
+  createChildren();
+  is_leaf_ = false;
+  if (cube_pointer_ != nullptr)
+  {
+    cube_pointer_.reset();
+    cube_pointer_ = nullptr;
+  }
+  updateResidentBytes();
+  for (unsigned int i = 0; i < 8; i++)
+  {
+    children_[i]->loadAreaRecursive(lod_queue);
+  }
+  updateFaceTransparency();
+}
 
-    // Iterate through all 8 quadrants to find the centers of each
-    int64_t quadrant_width = (1LL << (layer_-1)); // 2^(layer_-1)
-    for (unsigned int i = 0; i < 8; i++)
-    {
-      if (children_[i] != nullptr)
-      {
-        // Don't need to calculate the center since it won't be used anyway
-        continue;
-      }
-      // Approximate the distance of the closest point to the center of the desired loading area
-      if (i%2 == 0)
-      {
-        if (layer_ == 1)
-          quadrant_centers[i].setX(center_.getX() - (quadrant_width >> 1) - 1);
-        else
-          quadrant_centers[i].setX(center_.getX() - (quadrant_width >> 1));
-      }
-      else
-      {
-        quadrant_centers[i].setX(center_.getX() + (quadrant_width >> 1));
-      }
 
-      if (i < 4)
-      {
-        if (layer_ == 1)
-          quadrant_centers[i].setY(center_.getY() - (quadrant_width >> 1) - 1);
-        else
-          quadrant_centers[i].setY(center_.getY() - (quadrant_width >> 1));
-      }
-      else
-      {
-        quadrant_centers[i].setY(center_.getY() + (quadrant_width >> 1));
-      }
-   
-      if (i == 0 || i == 1 || i == 4 || i == 5)
-      {
-        if (layer_ == 1)
-          quadrant_centers[i].setZ(center_.getZ() - (quadrant_width >> 1) - 1);
-        else
-          quadrant_centers[i].setZ(center_.getZ() - (quadrant_width >> 1));
-      }
-      else
-      {
-        quadrant_centers[i].setZ(center_.getZ() + (quadrant_width >> 1));
-      }
-    }
+void Octree::merge()
+{
+  bool was_brick = (brick_ != nullptr);
+  deleteChildren();
+  updateLeafFaces();
+  if (was_brick) markNeighborsDirty();
+}
+
+
+void Octree::pageOut()
+{
+  if (layer_ > file_layer_) return;
+  if (!is_leaf_) merge();
+  voxel_set_ = VoxelSet();
+  for (unsigned int i = 0; i < 8; i++) voxel_set_quadrants_[i] = VoxelSet();
+  has_voxel_set_ = false;
+  quadrants_split_ = false;
+  if (layer_ == file_layer_) zone_store_.evictZone(path_.substr(path_.find_last_of('/') + 1));
+  updateResidentBytes();
+}
+
+
+std::shared_ptr<Octree> Octree::getZoneNode()
+{
+  if (layer_ > file_layer_) return nullptr;
+  std::shared_ptr<Octree> node = shared_from_this();
+  while (node != nullptr && node->layer_ < file_layer_) node = node->parent_.lock();
+  return node;
+}
+
+
+void Octree::markNeighborsDirty()
+{
+  for (unsigned int i = 0; i < 6; i++)
+  {
+    // neighbors_[i] touches this node with its face i
+    if (std::shared_ptr<Octree> neighbor = neighbors_[i].lock()) neighbor->markFaceDirty(i);
   }
+}
 
-  if (is_leaf_)
+
+void Octree::updateAncestorFaces()
+{
+  std::shared_ptr<Octree> ancestor = parent_.lock();
+  while (ancestor != nullptr && !ancestor->is_leaf_)
+  {
+    ancestor->updateFaceTransparency();
+    ancestor = ancestor->parent_.lock();
+  }
+}
+
+
+bool Octree::setVoxels(const std::vector<VoxelRange> &ranges)
+{
+  // Children still drawn from the pyramid take their voxels from this node's before they change,
+  // or they'd get the edit twice
+  ensureVoxelSet();
+  for (unsigned int i = 0; i < 8; i++)
   {
+    if (children_[i] != nullptr) children_[i]->ensureVoxelSet();
+  }
+  uint16_t old_type = voxel_type_;
+  if (!voxel_set_.setRanges(ranges)) return false;
+  Anthrax::Profiler::addCounter(Anthrax::Profiler::NODES_EDITED, 1);
+  if (layer_ == file_layer_) pyramid_ = std::make_shared<ZonePyramid>(voxel_set_, layer_, zone_store_.getPyramidDepth());
+  is_uniform_ = voxel_set_.isUniform();
+  if (pyramid_ != nullptr) applyPyramid();
+  else voxel_type_ = voxel_set_.getVoxelType();
+
+  if (layer_ > 0)
+  {
+    // Hand each quadrant the part of the ranges inside it
+    uint32_t quadrant_size = 1u << (3*(layer_ - 1));
+    std::vector<VoxelRange> quadrant_ranges;
+    unsigned int r = 0;
     for (unsigned int i = 0; i < 8; i++)
     {
-      if (children_[i] != nullptr)
+      uint32_t quadrant_start = i * quadrant_size;
+      uint32_t quadrant_end = quadrant_start + quadrant_size;
+      quadrant_ranges.clear();
+      for (; r < ranges.size() && ranges[r].start < quadrant_end; r++)
       {
-        // The current layer was not a leaf before (has children) but now it is
-        // delete children
-        children_[i].reset();
-        children_[i] = nullptr;
+        uint32_t start = std::max(ranges[r].start, quadrant_start);
+        uint32_t end = std::min(ranges[r].start + ranges[r].count, quadrant_end);
+        quadrant_ranges.push_back({start - quadrant_start, end - start, ranges[r].type});
+        if (ranges[r].start + ranges[r].count > quadrant_end) break; // Carries on into the next quadrant
       }
+      if (quadrant_ranges.empty()) continue;
+      if (quadrants_split_) voxel_set_quadrants_[i].setRanges(quadrant_ranges);
+      if (children_[i] == nullptr) continue;
+      if (children_[i]->pyramid_ != nullptr) children_[i]->pyramid_ = pyramid_;
+      children_[i]->setVoxels(quadrant_ranges);
     }
+  }
 
-    if (voxel_set_.getVoxelType() != 0)
-    {
-      for (unsigned int i = 0; i < 6; i++)
-      {
-        transparent_face_[i] = false;
-      }
-    }
-    return;
+  uint8_t old_faces = transparent_faces_;
+  if (brick_ != nullptr)
+  {
+    // Neighbouring bricks look at this one's voxels, not just its faces
+    if (!is_uniform_) brick_ = std::make_shared<Brick>(voxel_set_, layer_);
+    brick_cubes_.clear();
+    brick_meshed_ = false;
+    markNeighborsDirty();
   }
-  else if (was_leaf && !is_leaf_)
+  if (is_uniform_ && !is_leaf_) deleteChildren(); // Nothing left to split on
+  if (is_leaf_)
   {
-    if (cube_pointer_ != nullptr)
-    {
-      cube_pointer_.reset();
-      cube_pointer_ = nullptr;
-    }
+    // Coarse leaves are drawn as their dominant type, which the edit may not have changed
+    if (voxel_type_ != old_type) cube_pointer_.reset();
+    updateLeafFaces();
+  }
+  else
+  {
+    updateFaceTransparency();
+  }
+  uint8_t changed_faces = transparent_faces_ ^ old_faces;
+  for (unsigned int i = 0; i < 6; i++)
+  {
+    if (((changed_faces >> i) & 1) == 0) continue;
+    // The neighbour on the other side of face i touches it with its own face i^1
+    if (std::shared_ptr<Octree> neighbor = neighbors_[i^1].lock()) neighbor->markFaceDirty(i^1);
   }
+  updateResidentBytes();
+  return true;
+}
+
 
-  if (!is_leaf_)
+void Octree::markFaceDirty(uint8_t face)
+{
+  neighbors_changed_ = true;
+  if (is_leaf_) return;
+  // Same face order as transparent_faces_ - even faces are on the positive side of their axis
+  const unsigned int axis_bit[3] = {1, 4, 2};
+  unsigned int bit = axis_bit[face/2];
+  bool positive = (face % 2 == 0);
+  for (unsigned int i = 0; i < 8; i++)
   {
-    if (layer_ <= file_layer_)
+    if (children_[i] != nullptr && ((i & bit) != 0) == positive) children_[i]->markFaceDirty(face);
+  }
+}
+
+
+void Octree::createChildren()
+{
+  Anthrax::vec3<int64_t> quadrant_centers[8];
+
+  // Iterate through all 8 quadrants to find the centers of each
+  int64_t quadrant_width = (1LL << (layer_-1)); // 2^(layer_-1)
+  for (unsigned int i = 0; i < 8; i++)
+  {
+    if (children_[i] != nullptr)
     {
-      for (unsigned int i = 0; i < 8; i++)
-      {
-        if (children_[i] == nullptr)
-        {
-          //children_[i] = std::make_shared<Octree>(Octree(this, layer_ - 1, file_layer_, path_ + std::to_string(i), quadrant_centers[i], voxel_set_.getQuadrant(i)));
-          children_[i] = std::make_shared<Octree>(Octree(weak_from_this(), layer_ - 1, file_layer_, path_ + std::to_string(i), quadrant_centers[i], voxel_set_quadrants_[i]));
-        }
-      }
+      // Don't need to calculate the center since it won't be used anyway
+      continue;
+    }
+    if (i%2 == 0)
+    {
+      if (layer_ == 1)
+        quadrant_centers[i].setX(center_.getX() - (quadrant_width >> 1) - 1);
+      else
+        quadrant_centers[i].setX(center_.getX() - (quadrant_width >> 1));
     }
     else
     {
-      for (unsigned int i = 0; i < 8; i++)
-      {
-        if (children_[i] == nullptr)
-        {
-          children_[i] = std::make_shared<Octree>(Octree(weak_from_this(), layer_ - 1, file_layer_, path_ + std::to_string(i), quadrant_centers[i]));
-        }
-      }
+      quadrant_centers[i].setX(center_.getX() + (quadrant_width >> 1));
     }
 
-    for (unsigned int i = 0; i < 8; i++)
+    if (i < 4)
     {
-      if (children_[i] != nullptr)
-        children_[i]->loadAreaRecursive(load_center);
+      if (layer_ == 1)
+        quadrant_centers[i].setY(center_.getY() - (quadrant_width >> 1) - 1);
+      else
+        quadrant_centers[i].setY(center_.getY() - (quadrant_width >> 1));
     }
-  }
-
-  // Check each face and set transparent_face_ values accordingly
-  bool is_transparent = false;
-  // Right face
-  for (int i = 1; i < 8; i+=2)
-  {
-    if (!children_[i] || children_[i]->faceIsTransparent(0))
+    else
     {
-      is_transparent = true;
-      break;
+      quadrant_centers[i].setY(center_.getY() + (quadrant_width >> 1));
     }
-  }
-  if (transparent_face_[0] != is_transparent)
-  {
-    if (auto tmp = neighbors_[1].lock()) tmp->neighbors_changed_ = true;
-    //if (neighbors_[1] != nullptr) neighbors_[1]->neighbors_changed_ = true;
-    transparent_face_[0] = is_transparent;
-  }
-  // Left face
-  is_transparent = false;
-  for (int i = 0; i < 8; i+=2)
-  {
-    if (!children_[i] || children_[i]->faceIsTransparent(1))
+ 
+    if (i == 0 || i == 1 || i == 4 || i == 5)
     {
-      is_transparent = true;
-      break;
+      if (layer_ == 1)
+        quadrant_centers[i].setZ(center_.getZ() - (quadrant_width >> 1) - 1);
+      else
+        quadrant_centers[i].setZ(center_.getZ() - (quadrant_width >> 1));
     }
-  }
-  if (transparent_face_[1] != is_transparent)
-  {
-    if (auto tmp = neighbors_[0].lock()) tmp->neighbors_changed_ = true;
-    //if (neighbors_[0] != nullptr) neighbors_[0]->neighbors_changed_ = true;
-    transparent_face_[1] = is_transparent;
-  }
-  // Top face
-  is_transparent = false;
-  for (int i = 4; i < 8; i++)
-  {
-    if (!children_[i] || children_[i]->faceIsTransparent(2))
+    else
     {
-      is_transparent = true;
-      break;
+      quadrant_centers[i].setZ(center_.getZ() + (quadrant_width >> 1));
     }
   }
-  if (transparent_face_[2] != is_transparent)
-  {
-    if (auto tmp = neighbors_[3].lock()) tmp->neighbors_changed_ = true;
-    //if (neighbors_[3] != nullptr) neighbors_[3]->neighbors_changed_ = true;
-    transparent_face_[2] = is_transparent;
-  }
-  // Bottom face
-  is_transparent = false;
-  for (int i = 0; i < 4; i++)
+
+  if (layer_ <= file_layer_)
   {
-    if (!children_[i] || children_[i]->faceIsTransparent(3))
+    // Within the pyramid's depth the children are drawn from it, so the voxels can wait
+    bool from_pyramid = (pyramid_ != nullptr && file_layer_ - (layer_ - 1) <= pyramid_->getDepth());
+    if (!from_pyramid) splitVoxelSet();
+    for (unsigned int i = 0; i < 8; i++)
     {
-      is_transparent = true;
-      break;
+      if (children_[i] == nullptr)
+      {
+        //children_[i] = std::make_shared<Octree>(Octree(weak_from_this(), layer_ - 1, file_layer_, path_ + std::to_string(i), quadrant_centers[i], voxel_set_.getQuadrant(i)));
+        if (from_pyramid) children_[i] = std::make_shared<Octree>(weak_from_this(), layer_ - 1, file_layer_, path_ + std::to_string(i), quadrant_centers[i], pyramid_);
+        else children_[i] = std::make_shared<Octree>(weak_from_this(), layer_ - 1, file_layer_, path_ + std::to_string(i), quadrant_centers[i], voxel_set_quadrants_[i]);
+        children_[i]->updateResidentBytes();
+      }
     }
   }
-  if (transparent_face_[3] != is_transparent)
-  {
-    if (auto tmp = neighbors_[2].lock()) tmp->neighbors_changed_ = true;
-    //if (neighbors_[2] != nullptr) neighbors_[2]->neighbors_changed_ = true;
-    transparent_face_[3] = is_transparent;
-  }
-  // Back face
-  is_transparent = false;
-  for (int i = 2; i < 8; i+=(i%2)*2+1)
+  else
   {
-    if (!children_[i] || children_[i]->faceIsTransparent(4))
+    for (unsigned int i = 0; i < 8; i++)
     {
-      is_transparent = true;
-      break;
+      if (children_[i] == nullptr)
+      {
+        children_[i] = std::make_shared<Octree>(weak_from_this(), layer_ - 1, file_layer_, path_ + std::to_string(i), quadrant_centers[i]);
+        children_[i]->updateResidentBytes();
+      }
     }
   }
-  if (transparent_face_[4] != is_transparent)
+}
+
+
+void Octree::updateLeafFaces()
+{
+  // A leaf is drawn as a single cube, so its faces are either all solid or all air
+  transparent_faces_ = (voxel_type_ == 0) ? 0x3F : 0;
+}
+
+
+void Octree::updateFaceTransparency()
+{
+  if (brick_ != nullptr)
   {
-    if (auto tmp = neighbors_[5].lock()) tmp->neighbors_changed_ = true;
-    //if (neighbors_[5] != nullptr) neighbors_[5]->neighbors_changed_ = true;
-    transparent_face_[4] = is_transparent;
+    uint8_t transparent_faces = 0;
+    for (unsigned int i = 0; i < 6; i++) transparent_faces |= brick_->faceIsTransparent(i) << i;
+    setTransparentFaces(transparent_faces);
+    return;
   }
-  // Front face
-  is_transparent = false;
-  for (int i = 0; i < 6; i+=(i%2)*2+1)
+  // A face is see-through if any child along it is, or is missing. Gather each face's bit from
+  // every child as a mask over the children, then test all six faces against their children at once
+  uint8_t transparent_children[6] = {0, 0, 0, 0, 0, 0};
+  for (unsigned int i = 0; i < 8; i++)
   {
-    if (!children_[i] || children_[i]->faceIsTransparent(5))
-    {
-      is_transparent = true;
-      break;
-    }
+    uint8_t child_faces = (children_[i] != nullptr) ? children_[i]->transparent_faces_ : 0x3F;
+    for (unsigned int j = 0; j < 6; j++) transparent_children[j] |= ((child_faces >> j) & 1) << i;
   }
-  if (transparent_face_[5] != is_transparent)
+  uint8_t transparent_faces = 0;
+  for (unsigned int j = 0; j < 6; j++)
   {
-    if (auto tmp = neighbors_[4].lock()) tmp->neighbors_changed_ = true;
-    //if (neighbors_[4] != nullptr) neighbors_[4]->neighbors_changed_ = true;
-    transparent_face_[5] = is_transparent;
+    if ((transparent_children[j] & face_children_[j]) != 0) transparent_faces |= 1 << j;
+  }
+  setTransparentFaces(transparent_faces);
+}
+
+
+void Octree::setTransparentFaces(uint8_t transparent_faces)
+{
+  uint8_t changed = transparent_faces_ ^ transparent_faces;
+  transparent_faces_ = transparent_faces;
+  for (unsigned int i = 0; i < 6; i++)
+  {
+    // The neighbour on the other side of face i is neighbors_[i^1]
+    if (((changed >> i) & 1) == 0) continue;
+    if (auto tmp = neighbors_[i^1].lock()) tmp->neighbors_changed_ = true;
   }
 }
 
@@ -428,283 +605,415 @@ void Octree::loadChildren()
   if (is_uniform_) 
   {
     is_leaf_ = true;
-    if (voxel_set_.getVoxelType() != 0)
-    {
-      for (unsigned int i = 0; i < 6; i++)
-      {
-        transparent_face_[i] = false;
-      }
-    }
+    updateLeafFaces();
     return;
   }
 
-
   bool was_leaf = is_leaf_;
   is_leaf_ = false;
-  Anthrax::vec3<int64_t> quadrant_centers[8];
+  if (was_leaf)
+  {
+    if (cube_pointer_ != nullptr)
+    {
+      cube_pointer_.reset();
+      cube_pointer_ = nullptr;
+    }
+  }
+  createChildren();
+  updateResidentBytes();
+  updateFaceTransparency();
+}
 
-  // Iterate through all 8 quadrants to find the centers of each
-  int64_t quadrant_width = (1LL << (layer_-1)); // 2^(layer_-1)
+
+void Octree::deleteChildren()
+{
+  is_leaf_ = true;
+  brick_.reset();
+  brick_cubes_.clear();
+  brick_meshed_ = false;
+  brick_split_.clear();
   for (unsigned int i = 0; i < 8; i++)
   {
     if (children_[i] != nullptr)
     {
-      // Don't need to calculate the center since it won't be used anyway
-      continue;
-    }
-    // Approximate the distance of the closest point to the center of the desired loading area
-    if (i%2 == 0)
-    {
-      if (layer_ == 1)
-        quadrant_centers[i].setX(center_.getX() - (quadrant_width >> 1) - 1);
-      else
-        quadrant_centers[i].setX(center_.getX() - (quadrant_width >> 1));
-    }
-    else
-    {
-      quadrant_centers[i].setX(center_.getX() + (quadrant_width >> 1));
+      children_[i].reset();
+      children_[i] = nullptr;
     }
+  }
+  updateResidentBytes();
+  return;
+}
 
-    if (i < 4)
-    {
-      if (layer_ == 1)
-        quadrant_centers[i].setY(center_.getY() - (quadrant_width >> 1) - 1);
-      else
-        quadrant_centers[i].setY(center_.getY() - (quadrant_width >> 1));
-    }
-    else
-    {
-      quadrant_centers[i].setY(center_.getY() + (quadrant_width >> 1));
-    }
- 
-    if (i == 0 || i == 1 || i == 4 || i == 5)
-    {
-      if (layer_ == 1)
-        quadrant_centers[i].setZ(center_.getZ() - (quadrant_width >> 1) - 1);
-      else
-        quadrant_centers[i].setZ(center_.getZ() - (quadrant_width >> 1));
-    }
-    else
-    {
-      quadrant_centers[i].setZ(center_.getZ() + (quadrant_width >> 1));
+
+
+void Octree::setNeighbors(std::weak_ptr<Octree> *neighbors)
+{
+  //std::copy(neighbors, neighbors+6, neighbors_);
+  for (unsigned int i = 0; i < 6; i++)
+  {
+    //if (neighbors_[i] != neighbors[i]) neighbors_changed_[i] = true;
+    neighbors_[i] = neighbors[i];
+  }
+}
+
+
+void Octree::getCubes(unsigned int num_threads)
+{
+  if (num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+  // The job lists and batches are kept from call to call, so once they've grown to fit, a frame
+  // doesn't allocate any
+  std::vector<Octree*> &jobs = cube_jobs_;
+  jobs.clear();
+  if (num_threads > 1 && !is_leaf_ && brick_ == nullptr)
+  {
+    // Take the tree apart a layer at a time until there are enough subtrees to go around
+    std::vector<Octree*> &inner = cube_job_layers_[0];
+    std::vector<Octree*> &next = cube_job_layers_[1];
+    inner.assign(1, this);
+    while (!inner.empty() && jobs.size() + inner.size() < num_threads * cube_jobs_per_thread_)
+    {
+      next.clear();
+      for (unsigned int i = 0; i < inner.size(); i++)
+      {
+        for (unsigned int j = 0; j < 8; j++)
+        {
+          Octree *child = inner[i]->children_[j].get();
+          if (child == nullptr) continue;
+          if (child->is_leaf_ || child->brick_ != nullptr) jobs.push_back(child);
+          else next.push_back(child);
+        }
+      }
+      inner.swap(next);
     }
+    jobs.insert(jobs.end(), inner.begin(), inner.end());
   }
+  else
+  {
+    jobs.push_back(this);
+  }
+  num_threads = std::max(1u, std::min(num_threads, (unsigned int)jobs.size()));
+  while (cube_batches_.size() < num_threads) cube_batches_.push_back(std::unique_ptr<CubeBatch>(new CubeBatch()));
 
-  if (was_leaf)
+  // Nothing the threads write is shared: each builds into its own batch, and a node's cubes
+  // only ever come from the thread that has its subtree
+  cube_workers_.run(num_threads, jobs.size(), [](unsigned int thread, unsigned int job) {
+        cube_jobs_[job]->emitCubes(*cube_batches_[thread]);
+      });
+  for (unsigned int i = 0; i < num_threads; i++)
   {
-    if (cube_pointer_ != nullptr)
+    CubeBatch &batch = *cube_batches_[i];
+    if (anthrax_instance_ != nullptr) anthrax_instance_->addVoxels(batch.new_cubes);
+    Anthrax::Profiler::addCounter(Anthrax::Profiler::CUBES_CREATED, batch.num_cubes_created);
+    batch.num_cubes_created = 0;
+  }
+}
+
+
+const Anthrax::Cube &Octree::CubeBatch::getMaterial(uint16_t type)
+{
+  std::map<uint16_t, Anthrax::Cube>::iterator itr = materials.find(type);
+  if (itr == materials.end())
+  {
+    itr = materials.emplace(type, cube_converter_.convert(type, Anthrax::vec3<float>(0.0f, 0.0f, 0.0f), 1)).first;
+  }
+  return itr->second;
+}
+
+
+void Octree::emitCubes(CubeBatch &batch)
+{
+  if (is_leaf_)
+  {
+    // Take into account that some existing cube pointers may have updated neighbors, so redraw them
+    if (neighbors_changed_ && cube_pointer_ != nullptr)
     {
       cube_pointer_.reset();
       cube_pointer_ = nullptr;
     }
-  }
 
-  if (layer_ <= file_layer_)
-  {
-    for (unsigned int i = 0; i < 8; i++)
+    bool render_face[6] = {false};
+    bool render_cube = false;
+    for (unsigned int i = 0; i < 6; i++)
     {
-      if (children_[i] == nullptr)
+      if (neighbors_[i].expired() || neighbors_[i].lock()->faceIsTransparent(i))
       {
-        //children_[i] = std::make_shared<Octree>(Octree(weak_from_this(), layer_ - 1, file_layer_, path_ + std::to_string(i), quadrant_centers[i], voxel_set_.getQuadrant(i)));
-        children_[i] = std::make_shared<Octree>(Octree(weak_from_this(), layer_ - 1, file_layer_, path_ + std::to_string(i), quadrant_centers[i], voxel_set_quadrants_[i]));
+        render_face[i] = true;
+        render_cube = true;
       }
+      //render_face[i] = neighbors_[i]->faceIsTransparent(i%2 == 0 ? i+1 : i-1);
     }
-  }
-  else
-  {
-    for (unsigned int i = 0; i < 8; i++)
+    neighbors_changed_ = false; // Its faces are up to date now, whether or not it draws a cube
+    if (!render_cube) // No faces are visible, so don't draw this cube
     {
-      if (children_[i] == nullptr)
-      {
-        children_[i] = std::make_shared<Octree>(Octree(weak_from_this(), layer_ - 1, file_layer_, path_ + std::to_string(i), quadrant_centers[i]));
-      }
+      cube_pointer_.reset();
+      cube_pointer_ = nullptr;
+      updateResidentBytes();
+      return;
     }
-  }
-  //if (was_leaf == is_leaf_) return;
 
-  // Check each face and set transparent_face_ values accordingly
-  bool is_transparent = false;
-  // Right face
-  for (int i = 1; i < 8; i+=2)
-  {
-    if (!children_[i] || children_[i]->faceIsTransparent(0))
+    if (!cube_pointer_)
     {
-      is_transparent = true;
-      break;
+      if (voxel_type_ == 0)
+      {
+        updateResidentBytes();
+        return;
+      }
+      // From its region's origin, so it's placed exactly however far out in the world it is
+      Anthrax::vec3<int64_t> origin = Anthrax::Cube::getRegionOrigin(center_);
+      Anthrax::vec3<float> center(center_.getX() - origin.getX(), center_.getY() - origin.getY(), center_.getZ() - origin.getZ());
+      if (!(layer_ == 0)) center = center - Anthrax::vec3<float>(0.5, 0.5, 0.5);
+
+      // One allocation for the cube and its count, since it lives exactly as long as this leaf draws it
+      cube_pointer_ = std::make_shared<Anthrax::Cube>(batch.getMaterial(voxel_type_), origin, center, 1 << layer_);
+      cube_pointer_->setFaces(render_face);
+      if (anthrax_instance_ != nullptr) batch.new_cubes.push_back(cube_pointer_); // No renderer when running headless
+      batch.num_cubes_created++;
     }
+    updateResidentBytes();
   }
-  if (transparent_face_[0] != is_transparent)
+  else if (brick_ != nullptr)
   {
-    if (auto tmp = neighbors_[1].lock()) tmp->neighbors_changed_ = true;
-    //if (neighbors_[1] != nullptr) neighbors_[1]->neighbors_changed_ = true;
-    transparent_face_[0] = is_transparent;
+    getBrickCubes(batch);
   }
-  // Left face
-  is_transparent = false;
-  for (int i = 0; i < 8; i+=2)
+  else
   {
-    if (!children_[i] || children_[i]->faceIsTransparent(1))
+    for (unsigned int i = 0; i < 8; i++)
     {
-      is_transparent = true;
-      break;
+      if (children_[i] != nullptr)
+      {
+        children_[i]->emitCubes(batch);
+      }
     }
   }
-  if (transparent_face_[1] != is_transparent)
-  {
-    if (auto tmp = neighbors_[0].lock()) tmp->neighbors_changed_ = true;
-    //if (neighbors_[0] != nullptr) neighbors_[0]->neighbors_changed_ = true;
-    transparent_face_[1] = is_transparent;
-  }
-  // Top face
-  is_transparent = false;
-  for (int i = 4; i < 8; i++)
+}
+
+
+void Octree::getBrickCubes(CubeBatch &batch)
+{
+  if (neighbors_changed_)
   {
-    if (!children_[i] || children_[i]->faceIsTransparent(2))
-    {
-      is_transparent = true;
-      break;
-    }
+    brick_cubes_.clear();
+    brick_meshed_ = false;
+    neighbors_changed_ = false;
   }
-  if (transparent_face_[2] != is_transparent)
+  if (brick_meshed_) return;
+
+  // What's just past each side: a same-sized brick's own voxels, otherwise the whole side is
+  // see-through or not, as a leaf's would be
+  unsigned int width = brick_->getWidth();
+  std::vector<uint64_t> border_air[6];
+  for (unsigned int i = 0; i < 6; i++)
   {
-    if (auto tmp = neighbors_[3].lock()) tmp->neighbors_changed_ = true;
-    //if (neighbors_[3] != nullptr) neighbors_[3]->neighbors_changed_ = true;
-    transparent_face_[2] = is_transparent;
+    std::shared_ptr<Octree> neighbor = neighbors_[i].lock();
+    if (neighbor != nullptr && neighbor->brick_ != nullptr && neighbor->layer_ == layer_) border_air[i] = neighbor->brick_->getPlaneAir(i);
+    else border_air[i].assign(width, (neighbor == nullptr || neighbor->faceIsTransparent(i)) ? brick_->getRowMask() : 0);
   }
-  // Bottom face
-  is_transparent = false;
-  for (int i = 0; i < 4; i++)
+  std::vector<uint64_t> visible[6];
+  brick_->getVisibleFaces(border_air, visible);
+  batch.brick_cubes.clear();
+  addBrickCubes(OctreeCell(this), border_air, visible, batch);
+  if (!batch.brick_cubes.empty())
   {
-    if (!children_[i] || children_[i]->faceIsTransparent(3))
+    // The brick's cubes come and go together, so they share one block - each pointer owns the
+    // whole block, and the renderer sees them all expire when the brick is remeshed
+    std::shared_ptr<std::vector<Anthrax::Cube>> block = std::make_shared<std::vector<Anthrax::Cube>>(batch.brick_cubes);
+    brick_cubes_.reserve(block->size());
+    for (unsigned int i = 0; i < block->size(); i++)
     {
-      is_transparent = true;
-      break;
+      brick_cubes_.push_back(std::shared_ptr<Anthrax::Cube>(block, &(*block)[i]));
+      if (anthrax_instance_ != nullptr) batch.new_cubes.push_back(brick_cubes_.back());
     }
+    batch.num_cubes_created += block->size();
   }
-  if (transparent_face_[3] != is_transparent)
-  {
-    if (auto tmp = neighbors_[2].lock()) tmp->neighbors_changed_ = true;
-    //if (neighbors_[2] != nullptr) neighbors_[2]->neighbors_changed_ = true;
-    transparent_face_[3] = is_transparent;
-  }
-  // Back face
-  is_transparent = false;
-  for (int i = 2; i < 8; i+=(i%2)*2+1)
+  brick_meshed_ = true;
+  updateResidentBytes();
+}
+
+
+void Octree::addBrickCubes(const OctreeCell &cell, const std::vector<uint64_t> *border_air, const std::vector<uint64_t> *visible, CubeBatch &batch)
+{
+  // The blocks a brick is made of are the nodes it stands in for, so they get the same cubes
+  if (!cell.isLeaf())
   {
-    if (!children_[i] || children_[i]->faceIsTransparent(4))
+    OctreeCell child;
+    for (unsigned int i = 0; i < 8; i++)
     {
-      is_transparent = true;
-      break;
+      if (cell.getChild(i, &child)) addBrickCubes(child, border_air, visible, batch);
     }
+    return;
   }
-  if (transparent_face_[4] != is_transparent)
+  uint16_t type = cell.getVoxelType();
+  if (type == 0) return;
+  bool render_face[6] = {false};
+  bool render_cube = false;
+  unsigned int row = cell.block[1] + brick_->getWidth()*cell.block[2];
+  for (unsigned int i = 0; i < 6; i++)
   {
-    if (auto tmp = neighbors_[5].lock()) tmp->neighbors_changed_ = true;
-    //if (neighbors_[5] != nullptr) neighbors_[5]->neighbors_changed_ = true;
-    transparent_face_[4] = is_transparent;
+    // Single voxels are read straight from the brick's face masks
+    if (cell.layer == 0) render_face[i] = (visible[i][row] >> cell.block[0]) & 1;
+    else render_face[i] = brickFaceIsVisible(cell, i, border_air);
+    render_cube = render_cube || render_face[i];
   }
-  // Front face
-  is_transparent = false;
-  for (int i = 0; i < 6; i+=(i%2)*2+1)
+  if (!render_cube) return;
+
+  int64_t corner[3];
+  cell.getCorner(corner);
+  Anthrax::vec3<int64_t> origin = Anthrax::Cube::getRegionOrigin(Anthrax::vec3<int64_t>(corner[0], corner[1], corner[2]));
+  float offset = 0.5f * ((1 << cell.layer) - 1);
+  Anthrax::vec3<float> center(corner[0] - origin.getX() + offset, corner[1] - origin.getY() + offset, corner[2] - origin.getZ() + offset);
+  batch.brick_cubes.push_back(Anthrax::Cube(batch.getMaterial(type), origin, center, 1 << cell.layer));
+  batch.brick_cubes.back().setFaces(render_face);
+}
+
+
+bool Octree::brickFaceIsVisible(const OctreeCell &cell, uint8_t face, const std::vector<uint64_t> *border_air)
+{
+  // The layer of voxels just past the face, in brick coordinates
+  unsigned int axis = face / 2;
+  bool positive = (face % 2 == 1);
+  unsigned int width = brick_->getWidth();
+  unsigned int min[3], max[3];
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    min[a] = cell.block[a] << cell.layer;
+    max[a] = min[a] + (1u << cell.layer);
+  }
+  if (positive ? max[axis] < width : min[axis] > 0)
+  {
+    min[axis] = positive ? max[axis] : min[axis] - 1;
+    max[axis] = min[axis] + 1;
+    return brick_->hasAir(min, max);
+  }
+  // Past the edge, in Brick::getPlaneAir's layout
+  if (axis == 0) return Brick::planeHasAir(border_air[face], min[2], max[2], min[1], max[1]);
+  if (axis == 1) return Brick::planeHasAir(border_air[face], min[2], max[2], min[0], max[0]);
+  return Brick::planeHasAir(border_air[face], min[1], max[1], min[0], max[0]);
+}
+
+
+uint32_t Octree::writeSvo(Anthrax::Svo &svo)
+{
+  return writeSvo(svo, OctreeCell(this));
+}
+
+
+uint32_t Octree::writeSvo(Anthrax::Svo &svo, const OctreeCell &cell)
+{
+  if (cell.isLeaf()) return Anthrax::Svo::makeLeaf(cell.getVoxelType());
+  uint32_t children[8];
+  OctreeCell child;
+  for (unsigned int i = 0; i < 8; i++)
   {
-    if (!children_[i] || children_[i]->faceIsTransparent(5))
-    {
-      is_transparent = true;
-      break;
-    }
+    children[i] = cell.getChild(i, &child) ? writeSvo(svo, child) : Anthrax::Svo::makeLeaf(0);
   }
-  if (transparent_face_[5] != is_transparent)
+  return svo.addChildren(children);
+}
+
+
+std::shared_ptr<Octree> Octree::findNode(Anthrax::vec3<int64_t> position, unsigned int layer)
+{
+  std::shared_ptr<Octree> node = shared_from_this();
+  while (node->layer_ > layer && !node->is_leaf_)
   {
-    if (auto tmp = neighbors_[4].lock()) tmp->neighbors_changed_ = true;
-    //if (neighbors_[4] != nullptr) neighbors_[4]->neighbors_changed_ = true;
-    transparent_face_[5] = is_transparent;
+    // Same quadrant numbering as the zone files: x | z<<1 | y<<2
+    unsigned int quadrant = (position.getX() >= node->center_.getX() ? 1 : 0)
+                          | (position.getZ() >= node->center_.getZ() ? 2 : 0)
+                          | (position.getY() >= node->center_.getY() ? 4 : 0);
+    if (node->children_[quadrant] == nullptr) break;
+    node = node->children_[quadrant];
   }
+  return node;
 }
 
 
-void Octree::deleteChildren()
+uint64_t Octree::countResidentBytes()
 {
-  is_leaf_ = true;
+  uint32_t resident_bytes[NUM_RESIDENT_KINDS];
+  measureResidentBytes(resident_bytes);
+  uint64_t num_bytes = 0;
+  for (unsigned int i = 0; i < NUM_RESIDENT_KINDS; i++) num_bytes += resident_bytes[i];
   for (unsigned int i = 0; i < 8; i++)
   {
     if (children_[i] != nullptr)
     {
-      children_[i].reset();
-      children_[i] = nullptr;
+      num_bytes += children_[i]->countResidentBytes();
     }
   }
-  return;
+  return num_bytes;
 }
 
 
+uint64_t Octree::getResidentBytes()
+{
+  uint64_t num_bytes = 0;
+  for (unsigned int i = 0; i < NUM_RESIDENT_KINDS; i++) num_bytes += getResidentBytes((ResidentKind)i);
+  return num_bytes;
+}
+
 
-void Octree::setNeighbors(std::weak_ptr<Octree> *neighbors)
+void Octree::updateResidentBytes()
 {
-  //std::copy(neighbors, neighbors+6, neighbors_);
-  for (unsigned int i = 0; i < 6; i++)
+  uint32_t resident_bytes[NUM_RESIDENT_KINDS];
+  measureResidentBytes(resident_bytes);
+  for (unsigned int i = 0; i < NUM_RESIDENT_KINDS; i++)
   {
-    //if (neighbors_[i] != neighbors[i]) neighbors_changed_[i] = true;
-    neighbors_[i] = neighbors[i];
+    if (resident_bytes[i] == resident_bytes_[i]) continue; // Most calls, and the totals are shared between threads
+    resident_bytes_total_[i] += resident_bytes[i];
+    resident_bytes_total_[i] -= resident_bytes_[i];
+    resident_bytes_[i] = resident_bytes[i];
   }
 }
 
 
-void Octree::getCubes()
+void Octree::measureResidentBytes(uint32_t *resident_bytes)
 {
-  if (is_leaf_)
+  // The voxel sets' own members are part of the node, and the runs they view are shared with other
+  // nodes, so they're counted by VoxelSet instead
+  resident_bytes[RESIDENT_NODES] = sizeof(Octree) + path_.capacity() + brick_split_.capacity()/8;
+  resident_bytes[RESIDENT_VOXELS] = 0;
+  resident_bytes[RESIDENT_BRICKS] = (brick_ != nullptr) ? brick_->getMemoryUsage() : 0;
+  resident_bytes[RESIDENT_CUBES] = ((cube_pointer_ != nullptr) ? sizeof(Anthrax::Cube) : 0) +
+      brick_cubes_.capacity()*sizeof(std::shared_ptr<Anthrax::Cube>) + brick_cubes_.size()*sizeof(Anthrax::Cube);
+}
+
+
+uint64_t Octree::countNodes()
+{
+  uint64_t num_nodes = 1;
+  for (unsigned int i = 0; i < 8; i++)
   {
-    if (cube_pointer_ != nullptr)
+    if (children_[i] != nullptr)
     {
-      // Take into account that some existing cube pointers may have updated neighbors, so redraw them
-      if (neighbors_changed_)
-      {
-        cube_pointer_.reset();
-        cube_pointer_ = nullptr;
-        neighbors_changed_ = false;
-      }
+      num_nodes += children_[i]->countNodes();
     }
+  }
+  return num_nodes;
+}
 
-    bool render_face[6] = {false};
-    bool render_cube = false;
-    for (unsigned int i = 0; i < 6; i++)
-    {
-      if (neighbors_[i].expired() || neighbors_[i].lock()->faceIsTransparent(i))
-      {
-        render_face[i] = true;
-        render_cube = true;
-      }
-      //render_face[i] = neighbors_[i]->faceIsTransparent(i%2 == 0 ? i+1 : i-1);
-    }
-    if (!render_cube) // No faces are visible, so don't draw this cube
-    {
-      cube_pointer_.reset();
-      cube_pointer_ = nullptr;
-      return;
-    }
 
-    if (!cube_pointer_)
+uint64_t Octree::countCubes()
+{
+  uint64_t num_cubes = ((cube_pointer_ != nullptr) ? 1 : 0) + brick_cubes_.size();
+  for (unsigned int i = 0; i < 8; i++)
+  {
+    if (children_[i] != nullptr)
     {
-      if (voxel_set_.getVoxelType() == 0) return;
-      Anthrax::vec3<float> center;
-      center.setX(floor(center_.getX()));
-      center.setY(floor(center_.getY()));
-      center.setZ(floor(center_.getZ()));
-      if (!(layer_ == 0)) center = center - Anthrax::vec3<float>(0.5, 0.5, 0.5);
-
-      cube_pointer_.reset(new Anthrax::Cube());
-      *cube_pointer_ = cube_converter_.convert(voxel_set_.getVoxelType(), center, 1 << layer_);
-      cube_pointer_->setFaces(render_face);
-      anthrax_instance_->addVoxel(cube_pointer_);
+      num_cubes += children_[i]->countCubes();
     }
   }
-  else
+  return num_cubes;
+}
+
+
+uint64_t Octree::countBricks()
+{
+  uint64_t num_bricks = (brick_ != nullptr) ? 1 : 0;
+  for (unsigned int i = 0; i < 8; i++)
   {
-    for (unsigned int i = 0; i < 8; i++)
+    if (children_[i] != nullptr)
     {
-      if (children_[i] != nullptr)
-      {
-        children_[i]->getCubes();
-      }
+      num_bricks += children_[i]->countBricks();
     }
   }
+  return num_bricks;
 }
@@ -8,46 +8,109 @@
 
 #include "anthrax_types.hpp"
 #include "anthrax.hpp"
+#include "brick.hpp"
 #include "voxelset.hpp"
 #include "cube.hpp"
 #include "cubeconvert.hpp"
+#include "zonestore.hpp"
+#include "lodpolicy.hpp"
+#include "workerpool.hpp"
+#include <algorithm>
+#include <atomic>
 #include <map>
 
 class Octree : public std::enable_shared_from_this<Octree>
 {
 public:
+  // What the loaded tree's memory goes on, for ResidencyManager
+  enum ResidentKind
+  {
+    RESIDENT_NODES, // The nodes themselves
+    RESIDENT_VOXELS, // Their voxel sets' runs - shared between nodes and the zone cache, so counted for all of them at once
+    RESIDENT_BRICKS,
+    RESIDENT_CUBES,
+    NUM_RESIDENT_KINDS
+  };
+
   Octree() : Octree(std::weak_ptr<Octree>(), 0, 1) {}
   Octree(std::weak_ptr<Octree> parent, unsigned int layer, unsigned int file_layer) : Octree(parent, layer, file_layer, "", Anthrax::vec3<int64_t>(0, 0, 0)) {}
   Octree(std::weak_ptr<Octree> parent, unsigned int layer, unsigned int file_layer, std::string path, Anthrax::vec3<int64_t> center);
   Octree(std::weak_ptr<Octree> parent, unsigned int layer, unsigned int file_layer, std::string path, Anthrax::vec3<int64_t> center, VoxelSet voxel_set);
+  // Below the zone layer, within the pyramid's depth - its voxels aren't loaded until something needs them
+  Octree(std::weak_ptr<Octree> parent, unsigned int layer, unsigned int file_layer, std::string path, Anthrax::vec3<int64_t> center, std::shared_ptr<const ZonePyramid> pyramid);
   ~Octree();
   unsigned int getLayer() const { return layer_; }
   std::weak_ptr<Octree> getParentPointer() { return parent_; }
   std::weak_ptr<Octree> getChildPointer(int child) { return children_[child]; }
-  void splitVoxelSet();
+  Octree *getChild(unsigned int child) const { return children_[child].get(); } // For walks that don't outlive the tree changing, like ray casts
+  void splitVoxelSet(); // Into voxel_set_quadrants_, once
   void setCubeSettingsFile(std::string file);
+  static void openZoneStore(std::string directory, ZoneAddress zone_address);
+  static ZoneStore &getZoneStore() { return zone_store_; }
+  static CubeConvert &getCubeConverter() { return cube_converter_; }
   void setAnthraxPointer(Anthrax::Anthrax *anthrax_instance);
-  void setLoadDecisionFunction(bool (*loadDecisionFunction)(uint64_t, int));
+  static void setLodPolicy(std::shared_ptr<LodPolicy> lod_policy);
+  static std::shared_ptr<LodPolicy> getLodPolicy() { return lod_policy_; }
+  // Nodes at this layer become bricks instead of splitting (see brick.hpp) - 0 turns bricks off.
+  // Affects splits from then on.
+  static void setBrickLayer(unsigned int brick_layer) { brick_layer_ = std::min(brick_layer, max_brick_layer_); }
+  static unsigned int getBrickLayer() { return brick_layer_; }
+  static uint64_t getNumBrickLodChanges() { return num_brick_lod_changes_; } // Bricks remeshed for the LOD, ever
   void loadChildren();
   void deleteChildren();
-  void loadAreaRecursive(Anthrax::vec3<int64_t> load_center);
+  void loadAreaRecursive(LodQueue &lod_queue); // Against the LOD policy's current view
+  bool evaluateLod(LodQueue &lod_queue); // Just this node - returns true if its children need evaluating too
+  void split(LodQueue &lod_queue);
+  void merge();
+  // Merges it and drops its voxels, which come back from the zone store (or its pyramid) when they're
+  // next needed. Only does anything at or below the zone layer. A zone's node takes the zone out of
+  // the zone cache too, since its runs are shared with the cache's copy and would otherwise stay.
+  // Call updateAncestorFaces() afterwards.
+  void pageOut();
+  std::shared_ptr<Octree> getZoneNode(); // The node at the zone layer this one is part of (itself there), null above it
+  bool canPageOut() const { return layer_ <= file_layer_ && (!is_leaf_ || has_voxel_set_ || quadrants_split_); }
+  void updateAncestorFaces(); // After this node's faces changed
+  // Sets voxels of this node (ranges in its own run order, sorted and not overlapping) and of the
+  // loaded nodes under it. Only the cubes of nodes whose voxels or neighbouring faces changed are
+  // rebuilt. Call updateAncestorFaces() afterwards. Returns true if any voxel changed.
+  bool setVoxels(const std::vector<VoxelRange> &ranges);
+  void markFaceDirty(uint8_t face); // The neighbour against this face changed - redraw the leaves along it
   void getNewNeighbors();
   void setNeighbors(std::weak_ptr<Octree> *neighbors);
-  void getCubes();
+  // Builds the cubes this subtree is missing, on num_threads threads (0 for one per core). Each
+  // thread takes whole subtrees and keeps what it builds to itself, and the renderer gets each
+  // thread's cubes in one splice once they're all done.
+  void getCubes(unsigned int num_threads);
+  uint32_t writeSvo(Anthrax::Svo &svo); // Adds this subtree to svo, returning its root node
+  std::shared_ptr<Octree> findNode(Anthrax::vec3<int64_t> position, unsigned int layer); // Loaded node at layer containing position, or the leaf above it
+  uint64_t countNodes();
+  uint64_t countCubes();
+  uint64_t countBricks();
+  uint64_t countResidentBytes(); // Of this subtree, counted from scratch - should match what's tracked, less the voxels
+  // Of every node - the voxels are every voxel set's runs (VoxelSet::getStorageBytes()), as they aren't any one node's
+  static uint64_t getResidentBytes(ResidentKind kind) { return (kind == RESIDENT_VOXELS) ? VoxelSet::getStorageBytes() : resident_bytes_total_[kind].load(); }
+  static uint64_t getResidentBytes();
   Anthrax::vec3<int64_t> getCenter() const { return center_; }
   bool isUniform() { return is_uniform_; }
   bool isLeaf() { return is_leaf_; }
-  uint16_t getVoxelType() { return voxel_set_.getVoxelType(); }
-  bool faceIsTransparent(uint8_t face) { return transparent_face_[face]; }
+  uint16_t getVoxelType() { return voxel_type_; }
+  const VoxelSet &getVoxelSet() { ensureVoxelSet(); return voxel_set_; } // Empty above the zone layer
+  std::shared_ptr<const ZonePyramid> getPyramid() { return pyramid_; } // Its zone's, if it's within the pyramid's depth
+  const Brick *getBrick() const { return brick_.get(); } // nullptr unless it's split into a brick
+  // Whether the LOD policy has a block of the brick split, as it would have the node there
+  bool brickBlockIsSplit(unsigned int level, const unsigned int *block) const { return brick_split_[brick_->getBlockIndex(level, block[0], block[1], block[2])]; }
+  bool faceIsTransparent(uint8_t face) { return (transparent_faces_ >> face) & 1; }
 
   bool neighbors_changed_ = false;
-  static bool (*loadDecisionFunction)(uint64_t, int);
-  bool parent_load_checked = false; // Only for use in World
 private:
   unsigned int layer_; // The location of this layer - layer 0 will always be a leaf 
   unsigned int file_layer_; // The layer at which files need to be read in
   VoxelSet voxel_set_; // Container for voxel data
   VoxelSet voxel_set_quadrants_[8];
+  bool has_voxel_set_ = false; // Nodes built from a pyramid load voxel_set_ when they first need it
+  bool quadrants_split_ = false;
+  std::shared_ptr<const ZonePyramid> pyramid_; // The zone's, from the zone's node down to the pyramid's depth
+  uint16_t voxel_type_ = 0; // Drawn as - from pyramid_ if there is one, otherwise voxel_set_'s
   std::string path_; // The path to get from the top layer to this one - formatted as "[0-7]*"
   bool is_uniform_; // True if all voxels in all subtrees are of the same type
   bool is_leaf_; // True if this octree has no children
@@ -55,11 +118,54 @@ private:
   std::shared_ptr<Octree> children_[8];
   std::weak_ptr<Octree> neighbors_[6];
   Anthrax::vec3<int64_t> center_; // The center of the octree - used to find the quadrant of any given location
-  bool transparent_face_[6] = {true, true, true, true, true, true}; // List of which faces are partially or completely transparent - any adjacent faces on adjacent blocks must be drawn. This list matches inversely to Anthrax::Cube::render_face_ variables to avoid extra calculations, so the list goes in order as follows: {right(+x normal), left(-x normal, top(+y normal, bottom(-y normal), back(+z normal), front(-z normal)}
+  uint8_t transparent_faces_ = 0x3F; // A bit set for each face that's partially or completely transparent - any adjacent faces on adjacent blocks must be drawn. The bits match inversely to Anthrax::Cube::render_face_ variables to avoid extra calculations, so they go in order from bit 0 as follows: {right(+x normal), left(-x normal, top(+y normal, bottom(-y normal), back(+z normal), front(-z normal)}
   
   std::shared_ptr<Anthrax::Cube> cube_pointer_;
+  std::shared_ptr<Brick> brick_; // Takes the place of children at the brick layer
+  std::vector<std::shared_ptr<Anthrax::Cube>> brick_cubes_;
+  bool brick_meshed_ = false; // brick_cubes_ is up to date - it can be empty if nothing shows
+  std::vector<bool> brick_split_; // By Brick::getBlockIndex
+  uint32_t resident_bytes_[NUM_RESIDENT_KINDS] = {}; // Counted in resident_bytes_total_ - never by the constructors, but once the node is in the tree
+
+  // What one thread of getCubes() builds
+  struct CubeBatch
+  {
+    Anthrax::List<Anthrax::Cube> new_cubes; // For the renderer
+    std::vector<Anthrax::Cube> brick_cubes; // Of the brick being meshed - reused from brick to brick
+    std::map<uint16_t, Anthrax::Cube> materials; // Each type converted once, to copy from - kept until the voxel map changes
+    uint64_t num_cubes_created = 0;
+    const Anthrax::Cube &getMaterial(uint16_t type);
+  };
+
+  void createChildren();
+  void ensureVoxelSet();
+  void applyPyramid(); // Takes the type and uniformity from pyramid_
+  void updateLeafFaces();
+  void updateFaceTransparency();
+  void setTransparentFaces(uint8_t transparent_faces); // Tells the neighbours against any that changed
+  bool updateBrickLod(const OctreeCell &cell, bool was_split); // True if any block split or merged
+  void emitCubes(CubeBatch &batch); // getCubes() for one thread
+  void getBrickCubes(CubeBatch &batch);
+  void addBrickCubes(const OctreeCell &cell, const std::vector<uint64_t> *border_air, const std::vector<uint64_t> *visible, CubeBatch &batch);
+  static uint32_t writeSvo(Anthrax::Svo &svo, const OctreeCell &cell);
+  bool brickFaceIsVisible(const OctreeCell &cell, uint8_t face, const std::vector<uint64_t> *border_air); // face in neighbors_ order
+  void markNeighborsDirty(); // Their faces against this node need redrawing
+  void updateResidentBytes(); // After anything it holds changed size
+  void measureResidentBytes(uint32_t *resident_bytes);
 
   static CubeConvert cube_converter_;
+  static ZoneStore zone_store_;
+  static std::shared_ptr<LodPolicy> lod_policy_;
   static Anthrax::Anthrax *anthrax_instance_;
+  static unsigned int brick_layer_;
+  static uint64_t num_brick_lod_changes_;
+  static std::atomic<uint64_t> resident_bytes_total_[NUM_RESIDENT_KINDS]; // getCubes() updates it from every thread
+  static std::vector<Octree*> cube_jobs_; // getCubes()'s subtrees
+  static std::vector<Octree*> cube_job_layers_[2]; // For finding them
+  static std::vector<std::unique_ptr<CubeBatch>> cube_batches_; // One per thread
+  static WorkerPool cube_workers_;
+  static const uint8_t face_children_[6]; // The children along each face, a bit per child
+  static const unsigned int max_brick_layer_ = 6; // 64^3 voxels, one Brick row mask per 64
+  static const unsigned int cube_jobs_per_thread_ = 8; // Subtrees getCubes() splits the tree into, so threads finish together
 };
 #endif // OCTREE_HPP
@@ -0,0 +1,414 @@
+/* ---------------------------------------------------------------- *\
+ * raycaster.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "raycaster.hpp"
+#include "octree.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+
+// Enough for a full-depth walk: each level leaves at most 7 siblings waiting
+const unsigned int max_stack_size = 8 * 33;
+
+// Cell corners relative to anchor. Both come straight from integers, so the planes near the
+// anchor are exact even when the cell is far too wide for a float to hold its other side.
+template<class T>
+inline void getBounds(const OctreeCell &cell, const Anthrax::vec3<int64_t> &anchor, T *node_min, T *node_max)
+{
+  int64_t corner[3];
+  cell.getCorner(corner);
+  int64_t anchor_axes[3] = {anchor.getX(), anchor.getY(), anchor.getZ()};
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    node_min[a] = (T)(corner[a] - anchor_axes[a]) - (T)0.5;
+    node_max[a] = (T)(corner[a] - anchor_axes[a] + (1LL << cell.layer)) - (T)0.5;
+  }
+}
+
+
+inline float getInverse(float direction)
+{
+  if (fabs(direction) < 1e-8f) direction = (direction < 0.0f) ? -1e-8f : 1e-8f;
+  return 1.0f / direction;
+}
+
+
+// Child order that visits a node's children front to back for a ray going this way
+inline unsigned int getChildMask(float dx, float dy, float dz)
+{
+  return (dx < 0.0f ? 1 : 0) | (dz < 0.0f ? 2 : 0) | (dy < 0.0f ? 4 : 0);
+}
+
+
+// Axis of the face the ray entered the box through, or -1 if it starts inside
+inline int getEntryAxis(const float *node_min, const float *node_max, const float *origin, const float *inverse_direction)
+{
+  int entry_axis = -1;
+  float t_near = 0.0f;
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    float t0 = (node_min[a] - origin[a]) * inverse_direction[a];
+    float t1 = (node_max[a] - origin[a]) * inverse_direction[a];
+    if (std::min(t0, t1) > t_near)
+    {
+      t_near = std::min(t0, t1);
+      entry_axis = a;
+    }
+  }
+  return entry_axis;
+}
+
+
+RayHit makeHit(const OctreeCell &cell, int entry_axis, float distance, const Anthrax::vec3<int64_t> &anchor, const float *origin, const float *direction)
+{
+  RayHit hit;
+  if (cell.node == nullptr) return hit;
+  hit.hit = true;
+  hit.type = cell.getVoxelType();
+  hit.face = (entry_axis < 0) ? 0 : 2*entry_axis + (direction[entry_axis] < 0.0f ? 1 : 0);
+  hit.distance = distance;
+  hit.layer = cell.layer;
+
+  // Step half a voxel in from the face, then clamp to the cell in case the ray clipped an edge
+  float node_min[3], node_max[3];
+  getBounds(cell, anchor, node_min, node_max);
+  int64_t voxel[3];
+  int64_t anchor_axes[3] = {anchor.getX(), anchor.getY(), anchor.getZ()};
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    float point = origin[a] + direction[a] * distance;
+    if ((int)a == entry_axis) point += (direction[a] > 0.0f) ? 0.5f : -0.5f;
+    point = std::max(node_min[a] + 0.5f, std::min(node_max[a] - 0.5f, point));
+    voxel[a] = anchor_axes[a] + (int64_t)floor(point + 0.5f);
+  }
+  hit.voxel = Anthrax::vec3<int64_t>(voxel[0], voxel[1], voxel[2]);
+  return hit;
+}
+
+
+// The smallest node holding the whole box (corners relative to anchor). Rays that stay inside it
+// can start there instead of descending from the root, which is most of the way down for any
+// ray of a sensible length.
+Octree *findStartNode(Octree *root, const Anthrax::vec3<int64_t> &anchor, const double *box_min, const double *box_max)
+{
+  const unsigned int child_bit[3] = {1, 4, 2};
+  Octree *node = root;
+  while (!node->isLeaf() && !node->isUniform())
+  {
+    Anthrax::vec3<int64_t> center = node->getCenter();
+    int64_t offset[3] = {center.getX() - anchor.getX(), center.getY() - anchor.getY(), center.getZ() - anchor.getZ()};
+    unsigned int child = 0;
+    for (unsigned int a = 0; a < 3; a++)
+    {
+      // The upper children start at the center voxel
+      double middle = (double)offset[a] - 0.5;
+      if (box_min[a] >= middle) child |= child_bit[a];
+      else if (box_max[a] > middle) return node; // Straddles the split
+    }
+    if (node->getChild(child) == nullptr) return node;
+    node = node->getChild(child);
+  }
+  return node;
+}
+
+} // namespace
+
+
+WorkerPool Raycaster::workers_;
+std::mutex Raycaster::workers_mutex_;
+
+
+void RayPacket::load(const Ray *rays, unsigned int count)
+{
+  num_rays = std::min(count, width);
+  if (num_rays > 0)
+  {
+    anchor = Anthrax::vec3<int64_t>((int64_t)floor(rays[0].origin.getX()), (int64_t)floor(rays[0].origin.getY()), (int64_t)floor(rays[0].origin.getZ()));
+  }
+  for (unsigned int i = 0; i < width; i++)
+  {
+    hit_cell[i] = OctreeCell();
+    hit_axis[i] = -1;
+    if (i >= num_rays)
+    {
+      // Unused lanes can never pass the distance test
+      for (unsigned int a = 0; a < 3; a++)
+      {
+        origin[a][i] = 0.0f;
+        direction[a][i] = 1.0f;
+        inverse_direction[a][i] = 1.0f;
+      }
+      distance[i] = -INFINITY;
+      continue;
+    }
+    origin[0][i] = (float)(rays[i].origin.getX() - (double)anchor.getX());
+    origin[1][i] = (float)(rays[i].origin.getY() - (double)anchor.getY());
+    origin[2][i] = (float)(rays[i].origin.getZ() - (double)anchor.getZ());
+    direction[0][i] = rays[i].direction.getX();
+    direction[1][i] = rays[i].direction.getY();
+    direction[2][i] = rays[i].direction.getZ();
+    for (unsigned int a = 0; a < 3; a++)
+    {
+      inverse_direction[a][i] = getInverse(direction[a][i]);
+    }
+    distance[i] = rays[i].max_distance;
+  }
+}
+
+
+RayHit RayPacket::getHit(unsigned int ray)
+{
+  float ray_origin[3] = {origin[0][ray], origin[1][ray], origin[2][ray]};
+  float ray_direction[3] = {direction[0][ray], direction[1][ray], direction[2][ray]};
+  return makeHit(hit_cell[ray], hit_axis[ray], distance[ray], anchor, ray_origin, ray_direction);
+}
+
+
+RayHit Raycaster::castRay(const Ray &ray) const
+{
+  Anthrax::vec3<int64_t> anchor((int64_t)floor(ray.origin.getX()), (int64_t)floor(ray.origin.getY()), (int64_t)floor(ray.origin.getZ()));
+  float origin[3] = {(float)(ray.origin.getX() - (double)anchor.getX()),
+                     (float)(ray.origin.getY() - (double)anchor.getY()),
+                     (float)(ray.origin.getZ() - (double)anchor.getZ())};
+  float direction[3] = {ray.direction.getX(), ray.direction.getY(), ray.direction.getZ()};
+  float inverse_direction[3] = {getInverse(direction[0]), getInverse(direction[1]), getInverse(direction[2])};
+  unsigned int mask = getChildMask(direction[0], direction[1], direction[2]);
+  const unsigned int child_bit[3] = {1, 4, 2}; // Per axis, matching the x | z<<1 | y<<2 child numbering
+
+  // Where the ray enters and leaves each node's slab along each axis. Children split their
+  // parent's slabs in half, so theirs come from the parent's without another box test. Doubles,
+  // since the halving starts from the root's slabs billions of voxels out.
+  struct StackEntry
+  {
+    OctreeCell cell;
+    double t_enter[3];
+    double t_leave[3];
+  };
+  StackEntry stack[max_stack_size];
+  unsigned int stack_size = 0;
+  double closest = ray.max_distance;
+  OctreeCell hit_cell;
+  double hit_enter[3];
+
+  double box_min[3], box_max[3];
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    double end = origin[a] + (double)direction[a] * ray.max_distance;
+    box_min[a] = std::min((double)origin[a], end);
+    box_max[a] = std::max((double)origin[a], end);
+  }
+  StackEntry root;
+  root.cell = OctreeCell(findStartNode(root_.get(), anchor, box_min, box_max));
+  double node_min[3], node_max[3];
+  getBounds(root.cell, anchor, node_min, node_max);
+  double t_near = 0.0, t_far = closest;
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    double t0 = (node_min[a] - origin[a]) * inverse_direction[a];
+    double t1 = (node_max[a] - origin[a]) * inverse_direction[a];
+    root.t_enter[a] = std::min(t0, t1);
+    root.t_leave[a] = std::max(t0, t1);
+    t_near = std::max(t_near, root.t_enter[a]);
+    t_far = std::min(t_far, root.t_leave[a]);
+  }
+  if (t_near < t_far) stack[stack_size++] = root;
+
+  while (stack_size > 0)
+  {
+    StackEntry entry = stack[--stack_size];
+    if (entry.cell.isLeaf())
+    {
+      // Children are visited nearest first, so the first solid box found is the closest
+      if (entry.cell.getVoxelType() == 0) continue;
+      closest = std::max(std::max(entry.t_enter[0], entry.t_enter[1]), std::max(entry.t_enter[2], 0.0));
+      hit_cell = entry.cell;
+      for (unsigned int a = 0; a < 3; a++) hit_enter[a] = entry.t_enter[a];
+      break;
+    }
+    double t_middle[3];
+    for (unsigned int a = 0; a < 3; a++) t_middle[a] = 0.5 * (entry.t_enter[a] + entry.t_leave[a]);
+    // Pushed furthest first so the nearest is popped next
+    for (int i = 7; i >= 0; i--)
+    {
+      StackEntry next;
+      if (!entry.cell.getChild(i ^ mask, &next.cell)) continue;
+      for (unsigned int a = 0; a < 3; a++)
+      {
+        // i counts in the order the ray meets the halves, so a clear bit is the half it enters first
+        bool second_half = (i & child_bit[a]) != 0;
+        next.t_enter[a] = second_half ? t_middle[a] : entry.t_enter[a];
+        next.t_leave[a] = second_half ? entry.t_leave[a] : t_middle[a];
+      }
+      t_near = std::max(std::max(next.t_enter[0], next.t_enter[1]), std::max(next.t_enter[2], 0.0));
+      t_far = std::min(std::min(next.t_leave[0], next.t_leave[1]), std::min(next.t_leave[2], closest));
+      if (t_near < t_far) stack[stack_size++] = next;
+    }
+  }
+
+  int entry_axis = -1;
+  if (hit_cell.node != nullptr)
+  {
+    double t_entry = 0.0;
+    for (unsigned int a = 0; a < 3; a++)
+    {
+      if (hit_enter[a] > t_entry)
+      {
+        t_entry = hit_enter[a];
+        entry_axis = a;
+      }
+    }
+  }
+  return makeHit(hit_cell, entry_axis, (float)closest, anchor, origin, direction);
+}
+
+
+void Raycaster::castPacket(RayPacket &packet) const
+{
+  const unsigned int width = RayPacket::width;
+  double box_min[3] = {INFINITY, INFINITY, INFINITY};
+  double box_max[3] = {-INFINITY, -INFINITY, -INFINITY};
+  for (unsigned int i = 0; i < packet.num_rays; i++)
+  {
+    for (unsigned int a = 0; a < 3; a++)
+    {
+      double end = packet.origin[a][i] + (double)packet.direction[a][i] * packet.distance[i];
+      box_min[a] = std::min(box_min[a], std::min((double)packet.origin[a][i], end));
+      box_max[a] = std::max(box_max[a], std::max((double)packet.origin[a][i], end));
+    }
+  }
+  OctreeCell stack[max_stack_size];
+  unsigned int stack_size = 0;
+  if (packet.num_rays == 0) return;
+  stack[stack_size++] = OctreeCell(findStartNode(root_.get(), packet.anchor, box_min, box_max));
+
+  while (stack_size > 0)
+  {
+    OctreeCell cell = stack[--stack_size];
+    float node_min[3], node_max[3];
+    getBounds(cell, packet.anchor, node_min, node_max);
+
+    // Test the node against every ray at once - no branches, so this vectorizes
+    alignas(32) float t_near[width];
+    alignas(32) int active[width];
+    int any_active = 0;
+    for (unsigned int i = 0; i < width; i++)
+    {
+      float t0x = (node_min[0] - packet.origin[0][i]) * packet.inverse_direction[0][i];
+      float t1x = (node_max[0] - packet.origin[0][i]) * packet.inverse_direction[0][i];
+      float t0y = (node_min[1] - packet.origin[1][i]) * packet.inverse_direction[1][i];
+      float t1y = (node_max[1] - packet.origin[1][i]) * packet.inverse_direction[1][i];
+      float t0z = (node_min[2] - packet.origin[2][i]) * packet.inverse_direction[2][i];
+      float t1z = (node_max[2] - packet.origin[2][i]) * packet.inverse_direction[2][i];
+      float enter = std::max(std::max(std::min(t0x, t1x), std::min(t0y, t1y)), std::max(std::min(t0z, t1z), 0.0f));
+      float leave = std::min(std::min(std::max(t0x, t1x), std::max(t0y, t1y)), std::min(std::max(t0z, t1z), packet.distance[i]));
+      t_near[i] = enter;
+      active[i] = (enter < leave) ? 1 : 0;
+      any_active |= active[i];
+    }
+    if (!any_active) continue;
+
+    if (cell.isLeaf())
+    {
+      if (cell.getVoxelType() == 0) continue;
+      for (unsigned int i = 0; i < width; i++)
+      {
+        if (!active[i]) continue;
+        packet.distance[i] = t_near[i];
+        packet.hit_cell[i] = cell;
+      }
+      continue;
+    }
+
+    // Front to back for the first ray that's still looking - the rest of the packet is
+    // assumed to be going roughly the same way, and is still correct (only slower) if not
+    unsigned int lead = 0;
+    while (!active[lead]) lead++;
+    unsigned int mask = getChildMask(packet.direction[0][lead], packet.direction[1][lead], packet.direction[2][lead]);
+    for (int i = 7; i >= 0; i--)
+    {
+      if (cell.getChild(i ^ mask, &stack[stack_size])) stack_size++;
+    }
+  }
+
+  for (unsigned int i = 0; i < packet.num_rays; i++)
+  {
+    if (packet.hit_cell[i].node == nullptr) continue;
+    float node_min[3], node_max[3];
+    getBounds(packet.hit_cell[i], packet.anchor, node_min, node_max);
+    float origin[3] = {packet.origin[0][i], packet.origin[1][i], packet.origin[2][i]};
+    float inverse_direction[3] = {packet.inverse_direction[0][i], packet.inverse_direction[1][i], packet.inverse_direction[2][i]};
+    packet.hit_axis[i] = getEntryAxis(node_min, node_max, origin, inverse_direction);
+  }
+}
+
+
+std::vector<RayHit> Raycaster::castRays(const std::vector<Ray> &rays, unsigned int num_threads) const
+{
+  std::vector<RayHit> hits(rays.size());
+  if (num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+  // A job is a run of packets, so threads don't fight over the job counter
+  const unsigned int packets_per_job = 16;
+  const unsigned int rays_per_job = packets_per_job * RayPacket::width;
+  unsigned int num_jobs = (rays.size() + rays_per_job - 1) / rays_per_job;
+  std::lock_guard<std::mutex> lock(workers_mutex_);
+  workers_.run(num_threads, num_jobs, [&](unsigned int, unsigned int job) {
+        RayPacket packet;
+        for (unsigned int first = job * rays_per_job; first < rays.size() && first < (job + 1) * rays_per_job; first += RayPacket::width)
+        {
+          packet.load(&rays[first], rays.size() - first);
+          castPacket(packet);
+          for (unsigned int i = 0; i < packet.num_rays; i++)
+          {
+            hits[first + i] = packet.getHit(i);
+          }
+        }
+      });
+  return hits;
+}
+
+
+bool Raycaster::hasLineOfSight(Anthrax::vec3<double> from, Anthrax::vec3<double> to) const
+{
+  double dx = to.getX() - from.getX();
+  double dy = to.getY() - from.getY();
+  double dz = to.getZ() - from.getZ();
+  double length = sqrt(dx*dx + dy*dy + dz*dz);
+  if (length == 0.0) return true;
+  Ray ray;
+  ray.origin = from;
+  ray.direction = Anthrax::vec3<float>((float)(dx / length), (float)(dy / length), (float)(dz / length));
+  ray.max_distance = (float)length;
+  return !castRay(ray).hit;
+}
+
+
+std::vector<Anthrax::SvoHit> Raycaster::renderReference(Anthrax::vec3<double> camera_position, Anthrax::vec3<float> forward, Anthrax::vec3<float> up,
+                                                        float vertical_fov, unsigned int width, unsigned int height, float max_distance,
+                                                        unsigned int num_threads) const
+{
+  std::vector<Anthrax::vec3<float>> directions = Anthrax::Svo::getPixelDirections(forward, up, vertical_fov, width, height);
+  std::vector<Ray> rays(directions.size());
+  for (unsigned int i = 0; i < rays.size(); i++)
+  {
+    rays[i].origin = camera_position;
+    rays[i].direction = directions[i];
+    rays[i].max_distance = max_distance;
+  }
+  // Consecutive pixels along a row make coherent packets
+  std::vector<RayHit> hits = castRays(rays, num_threads);
+  std::vector<Anthrax::SvoHit> image(hits.size());
+  for (unsigned int i = 0; i < hits.size(); i++)
+  {
+    image[i].hit = hits[i].hit;
+    image[i].type = hits[i].type;
+    image[i].face = hits[i].face;
+    image[i].distance = hits[i].distance;
+  }
+  return image;
+}
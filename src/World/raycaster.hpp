@@ -0,0 +1,100 @@
+/* ---------------------------------------------------------------- *\
+ * raycaster.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Casts rays through the loaded octree on the CPU, for gameplay
+ * queries (picking the voxel under the crosshair, line of sight)
+ * and for reference images on machines without a GPU.
+ *
+ * Nodes are visited front to back, nearest child first. A leaf or
+ * uniform node is a single box however many voxels it holds, so a
+ * ray crosses a zone of air in one step, and coarse LOD leaves are
+ * hit as the cube that's drawn for them. Bricks are walked through
+ * their blocks (see OctreeCell), the same boxes their cubes are.
+ *
+ * castRays() traces rays in packets of RayPacket::width, testing a
+ * node against every ray of the packet at once - the arrays are laid
+ * out so that loop vectorizes - and spreads the packets over worker
+ * threads. Rays next to each other in the list should be going
+ * roughly the same way (neighbouring pixels, for example), since a
+ * packet descends into a node if any of its rays do.
+ *
+ * The tree must not change while rays are being cast.
+\* ---------------------------------------------------------------- */
+
+#ifndef RAYCASTER_HPP
+#define RAYCASTER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "anthrax_types.hpp"
+#include "brick.hpp"
+#include "svo.hpp"
+#include "workerpool.hpp"
+
+struct Ray
+{
+  Anthrax::vec3<double> origin; // World position - voxel p spans [p-0.5, p+0.5]
+  Anthrax::vec3<float> direction; // Unit length
+  float max_distance = 10000.0f;
+};
+
+struct RayHit
+{
+  bool hit = false;
+  uint16_t type = 0;
+  uint8_t face = 0; // Same order as Anthrax::SvoHit
+  float distance = 0.0f;
+  Anthrax::vec3<int64_t> voxel = Anthrax::vec3<int64_t>(0, 0, 0); // The voxel hit - for a coarse node, the one just inside its face where the ray entered
+  unsigned int layer = 0; // Of the node that was hit, 0 for a single voxel
+};
+
+// Rays traced together, one array per component so each node test runs
+// across the whole packet. Origins are relative to anchor to keep float
+// precision far from the world's center.
+struct RayPacket
+{
+  static const unsigned int width = 8;
+
+  void load(const Ray *rays, unsigned int num_rays); // Up to width rays
+  RayHit getHit(unsigned int ray);
+
+  Anthrax::vec3<int64_t> anchor;
+  unsigned int num_rays = 0;
+  alignas(32) float origin[3][width];
+  alignas(32) float direction[3][width];
+  alignas(32) float inverse_direction[3][width];
+  alignas(32) float distance[width]; // The ray's max_distance until something is hit, then the distance to it
+  OctreeCell hit_cell[width]; // No node if nothing was hit
+  int hit_axis[width]; // Axis of the face the ray entered hit_cell through, -1 if it started inside
+};
+
+
+class Raycaster
+{
+public:
+  Raycaster(std::shared_ptr<Octree> root) { root_ = root; }
+  RayHit castRay(const Ray &ray) const;
+  void castPacket(RayPacket &packet) const;
+  // num_threads 0 uses every core
+  std::vector<RayHit> castRays(const std::vector<Ray> &rays, unsigned int num_threads = 0) const;
+  // True if nothing solid lies between the two points - an end inside a solid voxel counts as blocked
+  bool hasLineOfSight(Anthrax::vec3<double> from, Anthrax::vec3<double> to) const;
+  // Same camera and output as Anthrax::Svo::renderReference, so the two can be compared pixel for pixel
+  std::vector<Anthrax::SvoHit> renderReference(Anthrax::vec3<double> camera_position, Anthrax::vec3<float> forward, Anthrax::vec3<float> up,
+                                               float vertical_fov, unsigned int width, unsigned int height, float max_distance,
+                                               unsigned int num_threads = 0) const;
+private:
+  std::shared_ptr<Octree> root_;
+  // castRays' threads, kept between calls - every Raycaster is a short-lived view, so they're shared,
+  // and one castRays at a time gets them
+  static WorkerPool workers_;
+  static std::mutex workers_mutex_;
+};
+
+#endif // RAYCASTER_HPP
@@ -0,0 +1,243 @@
+/* ---------------------------------------------------------------- *\
+ * regionarchive.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "regionarchive.hpp"
+#include "durablefile.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+RegionArchive::RegionArchive(std::string filepath)
+{
+#ifndef WIN32
+  int fd = open(filepath.c_str(), O_RDONLY);
+  if (fd < 0) return;
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == 0 && (uint64_t)file_stat.st_size >= header_size_)
+  {
+    void *mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping != MAP_FAILED)
+    {
+      data_ = static_cast<const char*>(mapping);
+      file_size_ = file_stat.st_size;
+    }
+  }
+  close(fd); // The mapping holds its own reference to the file
+#else
+  std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+  if (!file) return;
+  file_size_ = file.tellg();
+  if (file_size_ < header_size_) return;
+  buffer_.resize(file_size_);
+  file.seekg(0);
+  file.read(buffer_.data(), file_size_);
+  data_ = buffer_.data();
+#endif
+  if (data_ == nullptr) return;
+
+  uint32_t header[4];
+  memcpy(header, data_, 16);
+  if (strncmp(data_, "RXRG", 4) != 0 || header[1] != version_ || header[2] != region_depth_ || header[3] != num_slots_)
+  {
+    std::cout << filepath << " is not a valid region archive" << std::endl;
+#ifndef WIN32
+    munmap(const_cast<char*>(data_), file_size_);
+#endif
+    data_ = nullptr;
+    return;
+  }
+  slots_.resize(num_slots_);
+  for (unsigned int i = 0; i < num_slots_; i++)
+  {
+    const char *entry = data_ + 16 + 16*i;
+    memcpy(&slots_[i].offset, entry, 8);
+    memcpy(&slots_[i].size, entry + 8, 4);
+    memcpy(&slots_[i].voxel_type, entry + 12, 2);
+    memcpy(&slots_[i].flags, entry + 14, 2);
+  }
+}
+
+
+RegionArchive::~RegionArchive()
+{
+#ifndef WIN32
+  if (data_ != nullptr) munmap(const_cast<char*>(data_), file_size_);
+#endif
+}
+
+
+const char *RegionArchive::getData(uint64_t offset, uint32_t size)
+{
+  if (data_ == nullptr || offset + size > file_size_) return nullptr;
+  return data_ + offset;
+}
+
+
+bool RegionArchive::appendZones(std::string filepath, const std::vector<ZoneData> &zones)
+{
+  std::vector<Slot> slots;
+  if (!readHeader(filepath, slots))
+  {
+    // New archive - start with every slot empty
+    slots.assign(num_slots_, {0, 0, 0, 0});
+    std::ofstream new_file(filepath, std::ios::binary | std::ios::trunc);
+    writeHeader(new_file, slots);
+    if (!new_file) return false;
+  }
+
+  std::fstream file(filepath, std::ios::binary | std::ios::in | std::ios::out);
+  file.seekp(0, std::ios::end);
+  for (unsigned int i = 0; i < zones.size(); i++)
+  {
+    const ZoneData &zone = zones[i];
+    Slot &slot = slots[zone.slot];
+    slot = {0, 0, zone.is_uniform ? zone.voxel_type : (uint16_t)0, (uint16_t)(PRESENT | (zone.is_uniform ? UNIFORM : 0))};
+    if (zone.is_uniform) continue;
+    slot.offset = file.tellp();
+    slot.size = zone.data.size();
+    file.write(zone.data.data(), zone.data.size());
+  }
+  file.flush(); // The data has to land before the slots that point at it
+
+  // The slots are the only part of the file ever overwritten
+  for (unsigned int i = 0; i < zones.size(); i++)
+  {
+    Slot &slot = slots[zones[i].slot];
+    file.seekp(16 + 16*zones[i].slot);
+    file.write(reinterpret_cast<const char*>(&slot.offset), 8);
+    file.write(reinterpret_cast<const char*>(&slot.size), 4);
+    file.write(reinterpret_cast<const char*>(&slot.voxel_type), 2);
+    file.write(reinterpret_cast<const char*>(&slot.flags), 2);
+  }
+  return file.good();
+}
+
+
+uint64_t RegionArchive::compact(std::string filepath)
+{
+  uint64_t old_size = std::filesystem::exists(filepath) ? std::filesystem::file_size(filepath) : 0;
+  std::vector<Slot> slots;
+  if (old_size == 0 || !replaceZones(filepath, std::vector<ZoneData>(), slots)) return 0;
+  return old_size - std::filesystem::file_size(filepath);
+}
+
+
+bool RegionArchive::replaceZones(std::string filepath, const std::vector<ZoneData> &zones, std::vector<Slot> &slots)
+{
+  // Rewrite the archive with only the data its slots point at, in slot order, with zones in place
+  // of what was in their slots
+  std::vector<const ZoneData*> replacements(num_slots_, nullptr);
+  for (unsigned int i = 0; i < zones.size(); i++) replacements[zones[i].slot] = &zones[i];
+  std::vector<char> contents;
+  {
+    RegionArchive archive(filepath);
+    if (archive.isOpen()) slots = archive.slots_;
+    else slots.assign(num_slots_, {0, 0, 0, 0}); // New archive
+    uint64_t offset = header_size_;
+    for (unsigned int i = 0; i < num_slots_; i++)
+    {
+      const char *data;
+      uint32_t size;
+      if (replacements[i] != nullptr)
+      {
+        const ZoneData &zone = *replacements[i];
+        slots[i] = {0, 0, zone.is_uniform ? zone.voxel_type : (uint16_t)0, (uint16_t)(PRESENT | (zone.is_uniform ? UNIFORM : 0))};
+        data = zone.data.data();
+        size = zone.is_uniform ? 0 : zone.data.size();
+      }
+      else
+      {
+        size = slots[i].size;
+        data = archive.getData(slots[i].offset, size);
+      }
+      if (!slots[i].isPresent() || slots[i].isUniform() || data == nullptr)
+      {
+        slots[i].offset = 0;
+        slots[i].size = 0;
+        continue;
+      }
+      contents.insert(contents.end(), data, data + size);
+      slots[i].offset = offset;
+      slots[i].size = size;
+      offset += size;
+    }
+  }
+
+  std::string tmp_filepath = filepath + ".tmp";
+  std::ofstream file(tmp_filepath, std::ios::binary | std::ios::trunc);
+  writeHeader(file, slots);
+  file.write(contents.data(), contents.size());
+  file.close();
+  if (!file) return false;
+  return DurableFile::replace(tmp_filepath, filepath);
+}
+
+
+bool RegionArchive::readHeader(std::string filepath, std::vector<Slot> &slots)
+{
+  std::ifstream file(filepath, std::ios::binary);
+  if (!file) return false;
+  char magic[4];
+  uint32_t header[3];
+  file.read(magic, 4);
+  file.read(reinterpret_cast<char*>(header), 12);
+  if (!file || strncmp(magic, "RXRG", 4) != 0 || header[0] != version_ || header[1] != region_depth_ || header[2] != num_slots_) return false;
+  slots.resize(num_slots_);
+  for (unsigned int i = 0; i < num_slots_; i++)
+  {
+    file.read(reinterpret_cast<char*>(&slots[i].offset), 8);
+    file.read(reinterpret_cast<char*>(&slots[i].size), 4);
+    file.read(reinterpret_cast<char*>(&slots[i].voxel_type), 2);
+    file.read(reinterpret_cast<char*>(&slots[i].flags), 2);
+  }
+  return file.good();
+}
+
+
+unsigned int RegionArchive::slotFromPath(std::string zone_path)
+{
+  unsigned int slot = 0;
+  for (unsigned int i = zone_path.size() - region_depth_; i < zone_path.size(); i++)
+  {
+    slot = (slot << 3) | (zone_path[i] - '0');
+  }
+  return slot;
+}
+
+
+std::string RegionArchive::zonePath(std::string region_path, unsigned int slot)
+{
+  std::string zone_path = region_path;
+  for (int i = region_depth_ - 1; i >= 0; i--)
+  {
+    zone_path += std::to_string((slot >> (3*i)) & 7);
+  }
+  return zone_path;
+}
+
+
+void RegionArchive::writeHeader(std::ostream &file, std::vector<Slot> &slots)
+{
+  uint32_t header[3] = {version_, region_depth_, num_slots_};
+  file.write("RXRG", 4);
+  file.write(reinterpret_cast<const char*>(header), 12);
+  for (unsigned int i = 0; i < num_slots_; i++)
+  {
+    file.write(reinterpret_cast<const char*>(&slots[i].offset), 8);
+    file.write(reinterpret_cast<const char*>(&slots[i].size), 4);
+    file.write(reinterpret_cast<const char*>(&slots[i].voxel_type), 2);
+    file.write(reinterpret_cast<const char*>(&slots[i].flags), 2);
+  }
+}
@@ -0,0 +1,102 @@
+/* ---------------------------------------------------------------- *\
+ * regionarchive.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * A region archive (.rgn) packs a 2^4 cube of zones into a single
+ * file, named after the path of the region (the zone path minus its
+ * last 4 digits). The last 4 digits of a zone's path select its slot
+ * in the archive, so slots are in Morton order like everything else.
+ *
+ * File format (little endian):
+ *  Header - "RXRG", uint32 version, uint32 region depth,
+ *   uint32 number of slots, then one 16-byte slot per zone:
+ *   uint64 byte offset of the zone's runs, uint32 size in bytes,
+ *   uint16 voxel type (only meaningful for uniform zones),
+ *   uint16 flags
+ *  Data - the zones' runs, in the same format as a .zn file
+ *
+ * appendZones() only ever appends zone data to the end of the file
+ * and then points the zone's slot at it, so the old data stays valid
+ * for anything still reading it. The superseded data is reclaimed by
+ * compact(). replaceZones() instead writes a compacted copy with the
+ * new zones in it and renames it over the archive, which is what the
+ * game saves edits with - a crash never leaves a slot half written.
+ *
+ * Readers map the whole archive and hand out slices of it, so
+ * loading a zone doesn't need a read or a copy.
+\* ---------------------------------------------------------------- */
+
+#ifndef REGIONARCHIVE_HPP
+#define REGIONARCHIVE_HPP
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class RegionArchive
+{
+public:
+  enum Flags : uint16_t
+  {
+    PRESENT = 1, // The zone exists - empty slots are air
+    UNIFORM = 2 // The whole zone is voxel_type and has no data
+  };
+
+  struct Slot
+  {
+    uint64_t offset;
+    uint32_t size;
+    uint16_t voxel_type;
+    uint16_t flags;
+    bool isPresent() const { return flags & PRESENT; }
+    bool isUniform() const { return flags & UNIFORM; }
+  };
+
+  struct ZoneData
+  {
+    unsigned int slot;
+    std::vector<char> data; // Runs in .zn format, empty for uniform zones
+    bool is_uniform;
+    uint16_t voxel_type;
+  };
+
+  RegionArchive(std::string filepath);
+  ~RegionArchive();
+  RegionArchive(const RegionArchive&) = delete;
+  RegionArchive& operator=(const RegionArchive&) = delete;
+  bool isOpen() { return data_ != nullptr; }
+  const Slot &getSlot(unsigned int slot) { return slots_[slot]; }
+  const char *getData(uint64_t offset, uint32_t size); // nullptr if the range is outside the file
+  uint64_t getFileSize() { return file_size_; }
+
+  static bool appendZones(std::string filepath, const std::vector<ZoneData> &zones);
+  static uint64_t compact(std::string filepath); // Returns the bytes reclaimed
+  // Creates the archive if it doesn't exist. slots is set to the new archive's slots.
+  static bool replaceZones(std::string filepath, const std::vector<ZoneData> &zones, std::vector<Slot> &slots);
+  static bool readHeader(std::string filepath, std::vector<Slot> &slots);
+
+  static std::string regionPath(std::string zone_path) { return zone_path.substr(0, zone_path.size() - region_depth_); }
+  static unsigned int slotFromPath(std::string zone_path);
+  static std::string zonePath(std::string region_path, unsigned int slot);
+
+  static const unsigned int region_depth_ = 4; // A region is 2^region_depth_ zones wide
+  static const unsigned int num_slots_ = 1 << (3*region_depth_);
+  static const uint64_t header_size_ = 16 + 16*num_slots_;
+private:
+  static void writeHeader(std::ostream &file, std::vector<Slot> &slots);
+
+  std::vector<Slot> slots_;
+  const char *data_ = nullptr; // The whole file
+  uint64_t file_size_ = 0;
+#ifdef WIN32
+  std::vector<char> buffer_; // No mmap - the file is read in whole instead
+#endif
+
+  static const uint32_t version_ = 1;
+};
+
+#endif // REGIONARCHIVE_HPP
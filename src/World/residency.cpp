@@ -0,0 +1,109 @@
+/* ---------------------------------------------------------------- *\
+ * residency.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "residency.hpp"
+#include "octree.hpp"
+
+#include <algorithm>
+#include <cfloat>
+
+
+uint64_t ResidencyManager::getResidentBytes()
+{
+  // The zone cache's zones are voxel set runs, which Octree already counts
+  return Octree::getResidentBytes();
+}
+
+
+uint64_t ResidencyManager::getTotalBytes()
+{
+  ZoneIndex &zone_index = Octree::getZoneStore().getIndex();
+  uint64_t num_bytes = 0;
+  for (unsigned int i = 0; i < zone_index.size(); i++) num_bytes += zone_index.getEntry(i).size;
+  return num_bytes;
+}
+
+
+bool ResidencyManager::allowSplit(float priority)
+{
+  if (budget_bytes_ == 0) return true;
+  if (priority <= priority_floor_)
+  {
+    num_deferred_++;
+    return false;
+  }
+  if (getResidentBytes() >= budget_bytes_)
+  {
+    // Worth paging something less important out for, if there is anything
+    max_deferred_priority_ = std::max(max_deferred_priority_, priority);
+    num_deferred_++;
+    return false;
+  }
+  return true;
+}
+
+
+unsigned int ResidencyManager::update(std::shared_ptr<Octree> root, LodPolicy &lod_policy)
+{
+  if (budget_bytes_ == 0) return 0;
+  float max_deferred_priority = max_deferred_priority_;
+  max_deferred_priority_ = 0.0f;
+  uint64_t resident_bytes = getResidentBytes();
+  uint64_t low_watermark = (uint64_t)(budget_bytes_ * low_watermark_);
+  if (resident_bytes < low_watermark)
+  {
+    // Room to spare, so let less important detail back in a little at a time
+    priority_floor_ *= floor_decay_;
+    return 0;
+  }
+  bool over_budget = resident_bytes > budget_bytes_;
+  if (!over_budget && max_deferred_priority == 0.0f) return 0;
+
+  // Over the budget anything can go, otherwise only what's less important than what's waiting
+  float max_priority = over_budget ? FLT_MAX : max_deferred_priority;
+  std::vector<Candidate> candidates;
+  findCandidates(root, lod_policy, candidates);
+  std::sort(candidates.begin(), candidates.end());
+  unsigned int num_paged_out = 0;
+  for (unsigned int i = 0; i < candidates.size() && resident_bytes > low_watermark; i++)
+  {
+    if (candidates[i].priority >= max_priority) break;
+    std::shared_ptr<Octree> node = candidates[i].node.lock();
+    if (node == nullptr || !node->canPageOut()) continue; // Under something paged out already
+    uint64_t storage_bytes = VoxelSet::getStorageBytes();
+    node->pageOut();
+    node->updateAncestorFaces();
+    priority_floor_ = std::max(priority_floor_, candidates[i].priority);
+    num_paged_out++;
+    if (VoxelSet::getStorageBytes() >= storage_bytes)
+    {
+      // Its runs are its zone's (and the zone cache's) too, so only the nodes went - the voxels only
+      // go with the whole zone, if that isn't more important than what's allowed to go
+      std::shared_ptr<Octree> zone = node->getZoneNode();
+      float zone_priority = (zone != nullptr) ? lod_policy.getPriority(zone->getCenter(), zone->getLayer()) : FLT_MAX;
+      if (zone != nullptr && zone != node && zone->canPageOut() && zone_priority < max_priority)
+      {
+        zone->pageOut();
+        zone->updateAncestorFaces();
+        num_paged_out++;
+      }
+    }
+    resident_bytes = getResidentBytes();
+  }
+  num_paged_out_ += num_paged_out;
+  return num_paged_out;
+}
+
+
+void ResidencyManager::findCandidates(std::shared_ptr<Octree> node, LodPolicy &lod_policy, std::vector<Candidate> &candidates)
+{
+  if (node->canPageOut()) candidates.push_back({node, lod_policy.getPriority(node->getCenter(), node->getLayer())});
+  if (node->getLayer() <= min_page_layer_) return;
+  for (unsigned int i = 0; i < 8; i++)
+  {
+    std::shared_ptr<Octree> child = node->getChildPointer(i).lock();
+    if (child != nullptr) findCandidates(child, lod_policy, candidates);
+  }
+}
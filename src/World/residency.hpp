@@ -0,0 +1,77 @@
+/* ---------------------------------------------------------------- *\
+ * residency.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Keeps the loaded world inside a memory budget. Octree counts the
+ * bytes each node holds as it changes (the node, its brick and its
+ * cubes), and VoxelSet counts the runs every voxel set views - the
+ * nodes' and the zone cache's share them, so they're counted once -
+ * so how much is resident is always known without a walk.
+ *
+ * While there's a budget, LodQueue asks here before each split:
+ * splits are held back once the budget is used up, and those less
+ * important than anything that had to be paged out are held back
+ * too, so the LOD doesn't split straight back into what was just
+ * dropped. Once a frame, anything over the budget - or in the way of
+ * a held-back split more important than what's loaded - is paged
+ * out, least important first by the LOD policy's priority (which
+ * already ranks nodes behind the camera and far away lowest), until
+ * usage is down to low_watermark_ of the budget. Paging out merges
+ * the node and drops its voxels (see Octree::pageOut()). Nodes under
+ * a zone's share its runs, so when paging one out doesn't free any,
+ * the whole zone is paged out and dropped from the zone cache; the zone
+ * files, zones.lod and the edit journal already hold everything
+ * needed to load it again, so nothing extra is written.
+ *
+ * Only nodes at or below the zone layer are paged out - the few
+ * above it are what finds the zones - and none smaller than
+ * min_page_layer_, so finding what to page out doesn't have to
+ * visit every node.
+\* ---------------------------------------------------------------- */
+
+#ifndef RESIDENCY_HPP
+#define RESIDENCY_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "lodpolicy.hpp"
+
+class ResidencyManager
+{
+public:
+  ResidencyManager() {}
+  void setBudget(uint64_t budget_bytes) { budget_bytes_ = budget_bytes; } // 0 for no budget
+  uint64_t getBudget() { return budget_bytes_; }
+  uint64_t getResidentBytes(); // Every node's, plus every voxel set's runs (the zone cache's among them)
+  uint64_t getTotalBytes(); // Of the world on disk - every zone in the index
+  // Whether a split of this priority can go ahead now - counts it as deferred if not
+  bool allowSplit(float priority);
+  // Pages out whatever is over the budget. Returns the number of nodes paged out.
+  unsigned int update(std::shared_ptr<Octree> root, LodPolicy &lod_policy);
+  uint64_t getNumPagedOut() { return num_paged_out_; } // Ever
+  uint64_t getNumDeferred() { return num_deferred_; } // Splits held back, ever
+  float getPriorityFloor() { return priority_floor_; }
+private:
+  struct Candidate
+  {
+    std::weak_ptr<Octree> node;
+    float priority;
+    bool operator<(const Candidate &other) const { return priority < other.priority; }
+  };
+  void findCandidates(std::shared_ptr<Octree> node, LodPolicy &lod_policy, std::vector<Candidate> &candidates);
+
+  uint64_t budget_bytes_ = 0;
+  float priority_floor_ = 0.0f; // Splits no more important than this wait - raised by paging out
+  float max_deferred_priority_ = 0.0f; // Of the splits held back since the last update
+  uint64_t num_paged_out_ = 0;
+  uint64_t num_deferred_ = 0;
+  const float low_watermark_ = 0.85f; // Of the budget - paging out stops here, and the floor only drops below it
+  const float floor_decay_ = 0.9f; // Per update while under the low watermark
+  static const unsigned int min_page_layer_ = 5; // 32^3 voxels
+};
+
+#endif // RESIDENCY_HPP
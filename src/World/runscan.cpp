@@ -0,0 +1,157 @@
+/* ---------------------------------------------------------------- *\
+ * runscan.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "runscan.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RUNSCAN_X86
+#include <immintrin.h>
+#endif
+
+std::atomic<RunScan::FindPrefix> RunScan::find_prefix_(&RunScan::findFirstPrefix);
+std::atomic<RunScan::Level> RunScan::level_(RunScan::NUM_LEVELS); // Not picked yet
+
+namespace
+{
+
+size_t findPrefixScalar(const int *counts, size_t num_counts, int target, int *sum)
+{
+  int total = 0;
+  size_t i = 0;
+  while (total < target && i < num_counts) total += counts[i++];
+  *sum = total;
+  return i;
+}
+
+
+#ifdef RUNSCAN_X86
+// The vector kernels stop at the block the target is in and leave the last few runs to this
+size_t finishScalar(const int *counts, size_t i, size_t num_counts, int total, int target, int *sum)
+{
+  while (total < target && i < num_counts) total += counts[i++];
+  *sum = total;
+  return i;
+}
+
+
+__attribute__((target("sse2")))
+size_t findPrefixSse2(const int *counts, size_t num_counts, int target, int *sum)
+{
+  if (target <= 0)
+  {
+    *sum = 0;
+    return 0;
+  }
+  size_t i = 0;
+  __m128i base = _mm_setzero_si128(); // Sum of every block before this one, in every lane
+  __m128i threshold = _mm_set1_epi32(target - 1);
+  for (; i + 4 <= num_counts; i += 4)
+  {
+    __m128i sums = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counts + i));
+    sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 4));
+    sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 8));
+    sums = _mm_add_epi32(sums, base);
+    if (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(sums, threshold))) != 0) break;
+    base = _mm_shuffle_epi32(sums, 0xFF);
+  }
+  return finishScalar(counts, i, num_counts, _mm_cvtsi128_si32(base), target, sum);
+}
+
+
+__attribute__((target("avx2")))
+size_t findPrefixAvx2(const int *counts, size_t num_counts, int target, int *sum)
+{
+  if (target <= 0)
+  {
+    *sum = 0;
+    return 0;
+  }
+  size_t i = 0;
+  __m256i base = _mm256_setzero_si256();
+  __m256i threshold = _mm256_set1_epi32(target - 1);
+  const __m256i low_last = _mm256_setr_epi32(0, 0, 0, 0, 3, 3, 3, 3);
+  const __m256i last = _mm256_set1_epi32(7);
+  for (; i + 8 <= num_counts; i += 8)
+  {
+    __m256i sums = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(counts + i));
+    // The shifts only work within each 128-bit half, so the low half's total is added to the high
+    // half afterwards
+    sums = _mm256_add_epi32(sums, _mm256_slli_si256(sums, 4));
+    sums = _mm256_add_epi32(sums, _mm256_slli_si256(sums, 8));
+    sums = _mm256_add_epi32(sums, _mm256_blend_epi32(_mm256_setzero_si256(), _mm256_permutevar8x32_epi32(sums, low_last), 0xF0));
+    sums = _mm256_add_epi32(sums, base);
+    if (_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(sums, threshold))) != 0) break;
+    base = _mm256_permutevar8x32_epi32(sums, last);
+  }
+  return finishScalar(counts, i, num_counts, _mm_cvtsi128_si32(_mm256_castsi256_si128(base)), target, sum);
+}
+#endif
+
+} // namespace
+
+
+size_t RunScan::findFirstPrefix(const int *counts, size_t num_counts, int target, int *sum)
+{
+  getLevel();
+  return findPrefix(counts, num_counts, target, sum);
+}
+
+
+RunScan::Level RunScan::getLevel()
+{
+  Level level = level_.load(std::memory_order_relaxed);
+  if (level != NUM_LEVELS) return level;
+  setLevel(getBestLevel());
+  return level_.load(std::memory_order_relaxed);
+}
+
+
+RunScan::Level RunScan::getBestLevel()
+{
+#ifdef RUNSCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return AVX2;
+  if (__builtin_cpu_supports("sse2")) return SSE2;
+#endif
+  return SCALAR;
+}
+
+
+bool RunScan::setLevel(Level level)
+{
+  FindPrefix find_prefix = nullptr;
+  switch (level)
+  {
+    case SCALAR:
+      find_prefix = &findPrefixScalar;
+      break;
+#ifdef RUNSCAN_X86
+    case SSE2:
+      if (getBestLevel() >= SSE2) find_prefix = &findPrefixSse2;
+      break;
+    case AVX2:
+      if (getBestLevel() >= AVX2) find_prefix = &findPrefixAvx2;
+      break;
+#endif
+    default:
+      break;
+  }
+  if (find_prefix == nullptr) return false;
+  find_prefix_.store(find_prefix, std::memory_order_relaxed);
+  level_.store(level, std::memory_order_relaxed);
+  return true;
+}
+
+
+const char *RunScan::getLevelName(Level level)
+{
+  switch (level)
+  {
+    case SCALAR: return "scalar";
+    case SSE2: return "sse2";
+    case AVX2: return "avx2";
+    default: return "none";
+  }
+}
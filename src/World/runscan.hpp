@@ -0,0 +1,56 @@
+/* ---------------------------------------------------------------- *\
+ * runscan.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * The search at the heart of splitting a VoxelSet: summing its run
+ * lengths until they reach a given voxel. Noisy zones have tens of
+ * thousands of runs, so this is done with SIMD where the CPU has it -
+ * each step sums 4 (SSE2) or 8 (AVX2) run lengths at once as a
+ * prefix sum within the register and checks them all against the
+ * target with one compare. The widest kernel the CPU supports is
+ * picked the first time one is needed; setLevel() overrides that,
+ * for comparing them (see roxel_bench --scan-bench).
+ *
+ * Run lengths are summed as 32-bit ints, like VoxelSet's
+ * total_num_voxels_, so a set's runs can't overflow them.
+\* ---------------------------------------------------------------- */
+
+#ifndef RUNSCAN_HPP
+#define RUNSCAN_HPP
+
+#include <atomic>
+#include <cstddef>
+
+class RunScan
+{
+public:
+  enum Level
+  {
+    SCALAR,
+    SSE2,
+    AVX2,
+    NUM_LEVELS
+  };
+
+  // The fewest of counts[0, num_counts) whose sum reaches target (0 for target <= 0), with that sum
+  // in *sum. Runs out at num_counts, with *sum the total, if they never do.
+  static size_t findPrefix(const int *counts, size_t num_counts, int target, int *sum)
+  {
+    return find_prefix_.load(std::memory_order_relaxed)(counts, num_counts, target, sum);
+  }
+  static Level getLevel();
+  static Level getBestLevel(); // The widest the CPU supports
+  static bool setLevel(Level level); // false if the CPU doesn't support it
+  static const char *getLevelName(Level level);
+private:
+  typedef size_t (*FindPrefix)(const int*, size_t, int, int*);
+  static size_t findFirstPrefix(const int *counts, size_t num_counts, int target, int *sum); // Picks a kernel, then runs it
+
+  static std::atomic<FindPrefix> find_prefix_; // Any thread splitting a set may be the first
+  static std::atomic<Level> level_;
+};
+
+#endif // RUNSCAN_HPP
@@ -4,19 +4,37 @@
  * Date Created: 2023-12-13
 \* ---------------------------------------------------------------- */
 #include "voxelset.hpp"
+#include "profiler.hpp"
+#include "runscan.hpp"
 
 #include <fstream>
 #include <cstring>
 #include <cmath>
 #include <iostream>
+#include <climits>
+#include <mutex>
+
+std::atomic<uint64_t> VoxelSet::storage_bytes_{0};
+
+
+VoxelSet::Runs::Runs(std::vector<int> &&num_voxels, std::vector<uint16_t> &&voxel_type)
+  : num_voxels(std::move(num_voxels)), voxel_type(std::move(voxel_type))
+{
+  storage_bytes_ += sizeof(Runs) + this->num_voxels.capacity()*sizeof(int) + this->voxel_type.capacity()*sizeof(uint16_t);
+}
+
+
+VoxelSet::Runs::~Runs()
+{
+  storage_bytes_ -= sizeof(Runs) + num_voxels.capacity()*sizeof(int) + voxel_type.capacity()*sizeof(uint16_t);
+}
+
 
 VoxelSet::VoxelSet(int total_num_voxels)
 {
   total_num_voxels_ = total_num_voxels;
   //num_counter_bytes_ = ceil(3*layer_/8);
   num_counter_bytes_ = 4;
-  num_voxels_ = std::vector<int>();
-  voxel_type_ = std::vector<uint16_t>();
   is_uniform_ = false;
   calculateVoxelType();
 }
@@ -24,211 +42,321 @@ VoxelSet::VoxelSet(int total_num_voxels)
 
 VoxelSet::VoxelSet(int total_num_voxels, std::vector<int> num_voxels, std::vector<uint16_t> voxel_type)
 {
-  total_num_voxels_ = total_num_voxels;
   num_counter_bytes_ = 4;
-  num_voxels_ = num_voxels;
-  voxel_type_ = voxel_type;
-  is_uniform_ = (voxel_type_.size() == 1);
-  calculateVoxelType();
-}
-
-
-VoxelSet& VoxelSet::operator=(const VoxelSet& set)
-{
-  this->total_num_voxels_ = set.total_num_voxels_;
-  this->num_counter_bytes_ = set.num_counter_bytes_;
-  this->num_voxels_ = set.num_voxels_;
-  this->voxel_type_ = set.voxel_type_;
-  this->is_uniform_ = set.is_uniform_;
-  this->calculateVoxelType();
-  return *this;
+  setRuns(total_num_voxels, std::move(num_voxels), std::move(voxel_type));
 }
 
 
 void VoxelSet::calculateVoxelType()
 {
-  if (num_voxels_.size() == 0)
+  if (num_runs_ == 0)
   {
     average_voxel_type_ = 0;
     return;
   }
-  std::map<uint16_t, int> voxel_amounts;
-  for (unsigned int i = 0; i < num_voxels_.size(); i++)
+  // Sets hold a handful of low-numbered types, so count them in a flat table indexed by type rather
+  // than a map - this runs every time a set is split or edited
+  const unsigned int max_types = 64;
+  int amounts[max_types] = {};
+  std::map<uint16_t, int> more_amounts; // Types past max_types
+  auto count = [&](uint16_t voxel_type, int num_voxels)
   {
-    if (voxel_type_[i] != 0) voxel_amounts[voxel_type_[i]] += num_voxels_[i];
-  }
+    if (voxel_type < max_types) amounts[voxel_type] += num_voxels;
+    else more_amounts[voxel_type] += num_voxels;
+  };
+  // Only the ends are trimmed, so the runs between come straight from the shared ones
+  const int *num_voxels = runs_->num_voxels.data() + first_run_;
+  const uint16_t *voxel_type = runs_->voxel_type.data() + first_run_;
+  count(voxel_type[0], getRunLength(0));
+  for (unsigned int i = 1; i + 1 < num_runs_; i++) count(voxel_type[i], num_voxels[i]);
+  if (num_runs_ > 1) count(voxel_type[num_runs_ - 1], last_length_);
+  // Air doesn't count, and ties go to the lowest type
   uint16_t largest_voxel_type = 0;
   int num_most_voxels = 0;
-  for (std::map<uint16_t, int>::iterator itr = voxel_amounts.begin(); itr != voxel_amounts.end(); itr++)
+  for (unsigned int type = 1; type < max_types; type++)
   {
-    if (itr->second > num_most_voxels)
-    {
-      num_most_voxels = itr->second;
-      largest_voxel_type = itr->first;
-    }
+    if (amounts[type] <= num_most_voxels) continue;
+    num_most_voxels = amounts[type];
+    largest_voxel_type = type;
+  }
+  for (std::map<uint16_t, int>::iterator itr = more_amounts.begin(); itr != more_amounts.end(); itr++)
+  {
+    if (itr->second <= num_most_voxels) continue;
+    num_most_voxels = itr->second;
+    largest_voxel_type = itr->first;
   }
   average_voxel_type_ = largest_voxel_type;
-  if (average_voxel_type_ != 3 && average_voxel_type_ != 0) std::cout << average_voxel_type_ << std::endl;
 }
 
 
-uint16_t VoxelSet::getVoxelType()
+void VoxelSet::readFile(std::string input_filepath)
 {
-  calculateVoxelType();
-  return average_voxel_type_;
+  std::ifstream file(input_filepath, std::ios::binary | std::ios::ate);
+  if (!file)
+  {
+    // Zones that don't exist on disk are air - never write to the world directory here
+    setAir();
+    return;
+  }
+  readFile(input_filepath, 0, file.tellg());
 }
 
-void VoxelSet::readFile(std::string input_filepath)
+
+void VoxelSet::readFile(std::string input_filepath, uint64_t offset, uint32_t size)
 {
+  // Read the whole slice in one go and parse it from memory
   std::ifstream file(input_filepath, std::ios::binary);
-
+  std::vector<char> buffer(size);
+  file.seekg(offset);
+  file.read(buffer.data(), size);
   if (!file)
   {
-    // File doesn't yet exist
-    generateAirFile(input_filepath);
-    file.open(input_filepath, std::ios::binary);
+    std::cout << "Failed to read " << size << " bytes at " << offset << " from " << input_filepath << std::endl;
+    setAir();
+    return;
   }
-  char num_voxels_buffer[4];;
-  char voxel_type_buffer[2];
-  
-  int num_voxels;
-  uint16_t voxel_type;
-  int counter = 0;
-  while (!file.eof())
+  readMemory(buffer.data(), size);
+}
+
+
+void VoxelSet::readMemory(const char *data, uint32_t size)
+{
+  // Same layout as a .zn file
+  Anthrax::Profiler::addCounter(Anthrax::Profiler::ZONE_FILES_READ, 1);
+  unsigned int num_runs = size / 6; // 4 bytes of count + 2 bytes of type per run
+  std::vector<int> num_voxels(num_runs);
+  std::vector<uint16_t> voxel_type(num_runs);
+  for (unsigned int i = 0; i < num_runs; i++)
   {
-    file.read(reinterpret_cast<char*>(&num_voxels), 4);
-    if (file.eof()) break;
-    file.read(reinterpret_cast<char*>(&voxel_type), 2);
-    num_voxels_.push_back(num_voxels);
-    voxel_type_.push_back(voxel_type);
+    memcpy(&num_voxels[i], data + 6*i, 4);
+    memcpy(&voxel_type[i], data + 6*i + 4, 2);
   }
+  setRuns(total_num_voxels_, std::move(num_voxels), std::move(voxel_type));
+}
+
+
+const std::shared_ptr<const VoxelSet::Runs> &VoxelSet::getAirRuns()
+{
+  static const std::shared_ptr<const Runs> air_runs = std::make_shared<const Runs>(std::vector<int>(1, INT_MAX), std::vector<uint16_t>(1, 0));
+  return air_runs;
+}
+
+
+std::shared_ptr<const VoxelSet::Runs> VoxelSet::getUniformRuns(uint16_t voxel_type)
+{
+  if (voxel_type == 0) return getAirRuns();
+  // Sets are built on the zone writer's and worker threads too
+  static std::mutex mutex;
+  static std::map<uint16_t, std::shared_ptr<const Runs>> uniform_runs; // By type
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<const Runs> &runs = uniform_runs[voxel_type];
+  if (runs == nullptr) runs = std::make_shared<const Runs>(std::vector<int>(1, INT_MAX), std::vector<uint16_t>(1, voxel_type));
+  return runs;
+}
+
+
+void VoxelSet::setUniform(uint16_t voxel_type)
+{
+  runs_ = getUniformRuns(voxel_type);
+  first_run_ = 0;
+  num_runs_ = 1;
+  first_skip_ = 0;
+  last_length_ = total_num_voxels_;
+  is_uniform_ = true;
+  average_voxel_type_ = voxel_type;
+}
+
+
+void VoxelSet::writeFile(std::string output_filepath)
+{
+  std::vector<char> bytes = toBytes();
+  std::ofstream file(output_filepath, std::ios::binary);
+  file.write(bytes.data(), bytes.size());
   file.close();
-  if (voxel_type_.size() == 1)
-  {
-    is_uniform_ = true;
-  }
-  calculateVoxelType();
 }
 
 
-VoxelSet VoxelSet::getQuadrant(int quadrant)
+std::vector<char> VoxelSet::toBytes()
 {
-  //int set_length = 1 << (3*layer_); // 2^(3*layer_)
-  int quadrant_set_length = total_num_voxels_ >> 3; // set_length/8 because there are 8 quadrants
-  int start = quadrant * quadrant_set_length;
-  int end = start + quadrant_set_length - 1;
+  std::vector<char> bytes(6*num_runs_);
+  for (unsigned int i = 0; i < num_runs_; i++)
+  {
+    int32_t num_voxels = getRunLength(i);
+    uint16_t voxel_type = getRunType(i);
+    memcpy(&bytes[6*i], &num_voxels, 4);
+    memcpy(&bytes[6*i + 4], &voxel_type, 2);
+  }
+  return bytes;
+}
 
-  int index = 0;
-  int counter = 0;
-  std::vector<int> new_num_voxels = std::vector<int>();
-  std::vector<uint16_t> new_voxel_type  = std::vector<uint16_t>();
 
-  // Move to starting position
-  while (counter < start)
+bool VoxelSet::compact()
+{
+  // Merge adjacent runs of the same type and drop empty ones - returns true if anything changed
+  std::vector<int> new_num_voxels;
+  std::vector<uint16_t> new_voxel_type;
+  for (unsigned int i = 0; i < num_runs_; i++)
   {
-    int next_section_size = num_voxels_[index];
-    if (next_section_size == 0)
+    int num_voxels = getRunLength(i);
+    if (num_voxels == 0) continue;
+    if (!new_voxel_type.empty() && new_voxel_type.back() == getRunType(i))
     {
-      index++;
-      continue;
-    }
-    if (counter + next_section_size <= start)
-    {
-      index++;
-      counter += next_section_size;
-      continue;
-    }
-    if (counter + next_section_size > start)
-    {
-      int first_section_size = (counter + next_section_size - start);
-      if (first_section_size >= quadrant_set_length)
-      {
-        new_num_voxels.push_back(quadrant_set_length);
-        new_voxel_type.push_back(voxel_type_[index]);
-        counter = start + first_section_size;
-        break;
-      }
-      new_num_voxels.push_back(first_section_size);
-      new_voxel_type.push_back(voxel_type_[index]);
-      index++;
-      counter += next_section_size;
+      new_num_voxels.back() += num_voxels;
       continue;
     }
+    new_num_voxels.push_back(num_voxels);
+    new_voxel_type.push_back(getRunType(i));
   }
+  if (new_num_voxels.size() == num_runs_) return false;
+  setRuns(total_num_voxels_, std::move(new_num_voxels), std::move(new_voxel_type));
+  return true;
+}
+
+
+bool VoxelSet::findRun(int index, unsigned int *run, int *run_start) const
+{
+  // The run holding voxel index and where it starts, or the last run if they end before it - the
+  // search is over the shared runs, so the ends are trimmed back to this set's after
+  if (num_runs_ == 0) return false;
+  const int *num_voxels = runs_->num_voxels.data() + first_run_;
+  int sum;
+  size_t end = RunScan::findPrefix(num_voxels, num_runs_, index + first_skip_ + 1, &sum);
+  if (end == 0) return false;
+  sum -= first_skip_;
+  if (end == num_runs_) sum -= num_voxels[num_runs_ - 1] - (num_runs_ == 1 ? first_skip_ : 0) - last_length_;
+  *run = end - 1;
+  *run_start = sum - getRunLength(end - 1);
+  return sum > index;
+}
+
+
+uint16_t VoxelSet::getVoxel(uint32_t index) const
+{
+  unsigned int run;
+  int run_start;
+  if (!findRun(index, &run, &run_start)) return 0;
+  return getRunType(run);
+}
+
 
-  // Iterate forwards until end position is reached
-  while (counter < end + 1)
+bool VoxelSet::setRanges(const std::vector<VoxelRange> &ranges)
+{
+  std::vector<int> new_num_voxels;
+  std::vector<uint16_t> new_voxel_type;
+  new_num_voxels.reserve(num_runs_ + 2*ranges.size());
+  new_voxel_type.reserve(num_runs_ + 2*ranges.size());
+  bool changed = false;
+  // Appends a run, merging it into the last one if they're the same type
+  auto append = [&](int num_voxels, uint16_t voxel_type)
   {
-    /*
-    if (index > new_voxel_type.size())
+    if (num_voxels <= 0) return;
+    if (!new_voxel_type.empty() && new_voxel_type.back() == voxel_type)
     {
-      // .zn file has incorrect number of elements
-      index--;
-      continue;
+      new_num_voxels.back() += num_voxels;
+      return;
     }
-    */
-    int next_section_size = num_voxels_[index];
-    if (next_section_size == 0)
+    new_num_voxels.push_back(num_voxels);
+    new_voxel_type.push_back(voxel_type);
+  };
+
+  unsigned int run = 0;
+  int run_start = 0; // Index of the first voxel of run
+  int run_used = 0; // Voxels of run already copied or overwritten
+  for (unsigned int r = 0; r < ranges.size(); r++)
+  {
+    int start = ranges[r].start;
+    int end = std::min((int)(ranges[r].start + ranges[r].count), total_num_voxels_);
+    // Copy the runs up to the range
+    while (run < num_runs_ && run_start + getRunLength(run) <= start)
     {
-      index++;
-      continue;
+      append(getRunLength(run) - run_used, getRunType(run));
+      run_start += getRunLength(run);
+      run_used = 0;
+      run++;
     }
-    if (counter + next_section_size <= end + 1)
+    if (run < num_runs_) append(start - run_start - run_used, getRunType(run));
+    append(end - start, ranges[r].type);
+    // Skip the runs it covers, leaving the rest of the last one
+    while (run < num_runs_ && run_start + getRunLength(run) <= end)
     {
-      new_num_voxels.push_back(next_section_size);
-      new_voxel_type.push_back(voxel_type_[index]);
-      index++;
-      counter += next_section_size;
-      continue;
+      if (getRunType(run) != ranges[r].type) changed = true;
+      run_start += getRunLength(run);
+      run_used = 0;
+      run++;
     }
-    if (counter + next_section_size > end + 1)
+    if (run < num_runs_)
     {
-      new_num_voxels.push_back(end + 1 - counter);
-      new_voxel_type.push_back(voxel_type_[index]);
-      counter += next_section_size;
-      continue;
+      if (end > run_start && getRunType(run) != ranges[r].type) changed = true;
+      run_used = std::max(run_used, end - run_start);
     }
   }
-  return VoxelSet(total_num_voxels_ >> 3, new_num_voxels, new_voxel_type);
+  for (; run < num_runs_; run++)
+  {
+    append(getRunLength(run) - run_used, getRunType(run));
+    run_used = 0;
+  }
+  if (!changed) return false;
+
+  setRuns(total_num_voxels_, std::move(new_num_voxels), std::move(new_voxel_type));
+  return true;
 }
 
 
-void VoxelSet::bisect(VoxelSet *first, VoxelSet *second)
+VoxelSet VoxelSet::getRange(int start, int num_voxels) const
 {
-  //int set_length = 1 << (3*layer_); // 2^(3*layer_)
-  int half_length = total_num_voxels_ >> 1;
-
-  std::vector<int>::iterator num_vox_itr = num_voxels_.begin();
-  std::vector<uint16_t>::iterator vox_type_itr = voxel_type_.begin();
-  int counter = 0;
-
-  while (counter < half_length)
+  // Voxels [start, start + num_voxels) of this set, viewing the same runs
+  VoxelSet range(num_voxels);
+  unsigned int first;
+  int first_start;
+  if (num_voxels <= 0) return range;
+  if (!findRun(start, &first, &first_start))
   {
-    int current_section_size = *num_vox_itr;
-    if (!current_section_size == 0)
-    {
-      counter += current_section_size;
-    }
-    num_vox_itr++;
-    vox_type_itr++;
+    range.setAir();
+    return range;
   }
+  unsigned int last;
+  int last_start;
+  findRun(start + num_voxels - 1, &last, &last_start);
+  range.runs_ = runs_;
+  range.first_run_ = first_run_ + first;
+  range.num_runs_ = last - first + 1;
+  range.first_skip_ = start - first_start + (first == 0 ? first_skip_ : 0);
+  range.last_length_ = std::min(start + num_voxels, last_start + getRunLength(last)) - std::max(start, last_start);
+  range.is_uniform_ = (range.num_runs_ == 1);
+  range.calculateVoxelType();
+  return range;
+}
 
-  std::vector<int> first_num_voxels(num_voxels_.begin(), num_vox_itr);
-  std::vector<uint16_t> first_voxel_type(voxel_type_.begin(), vox_type_itr);
-  std::vector<int> second_num_voxels(num_vox_itr, num_voxels_.end());
-  std::vector<uint16_t> second_voxel_type(vox_type_itr, voxel_type_.end());
-  if (half_length != counter)
-  {
-    first_num_voxels[first_num_voxels.size()-1] += half_length - counter;
 
-    std::vector<int> tmp = { counter - half_length };
-    second_num_voxels.insert(second_num_voxels.begin(), tmp.begin(), tmp.end());
-    std::vector<uint16_t> tmp1 = { first_voxel_type[first_voxel_type.size()-1] };
-    second_voxel_type.insert(second_voxel_type.begin(), tmp1.begin(), tmp1.end());
-  }
-  *first = VoxelSet(half_length, first_num_voxels, first_voxel_type);
-  *second = VoxelSet(half_length, second_num_voxels, second_voxel_type);
-  return;
+VoxelSet VoxelSet::getQuadrant(int quadrant)
+{
+  int quadrant_set_length = total_num_voxels_ >> 3; // There are 8 quadrants
+  return getRange(quadrant * quadrant_set_length, quadrant_set_length);
+}
+
+
+void VoxelSet::bisect(VoxelSet *first, VoxelSet *second)
+{
+  int half_length = total_num_voxels_ >> 1;
+  // Either half may be this set, so both are taken before either is replaced
+  VoxelSet first_half = getRange(0, half_length);
+  VoxelSet second_half = getRange(half_length, half_length);
+  *first = std::move(first_half);
+  *second = std::move(second_half);
+}
+
+
+void VoxelSet::setRuns(int total_num_voxels, std::vector<int> &&num_voxels, std::vector<uint16_t> &&voxel_type)
+{
+  total_num_voxels_ = total_num_voxels;
+  num_counter_bytes_ = 4;
+  first_run_ = 0;
+  num_runs_ = num_voxels.size();
+  first_skip_ = 0;
+  last_length_ = num_voxels.empty() ? 0 : num_voxels.back();
+  runs_ = std::make_shared<const Runs>(std::move(num_voxels), std::move(voxel_type));
+  is_uniform_ = (num_runs_ == 1);
+  calculateVoxelType();
 }
 
 
@@ -248,7 +376,7 @@ void VoxelSet::bisectOld(VoxelSet *first, VoxelSet *second)
 
   while (counter < half_length)
   {
-    int current_section_size = num_voxels_[index];
+    int current_section_size = getRunLength(index);
     if (current_section_size == 0)
     {
       index++;
@@ -257,7 +385,7 @@ void VoxelSet::bisectOld(VoxelSet *first, VoxelSet *second)
     if (counter + current_section_size <= half_length)
     {
       new_num_voxels.push_back(current_section_size);
-      new_voxel_type.push_back(voxel_type_[index]);
+      new_voxel_type.push_back(getRunType(index));
       index++;
       counter += current_section_size;
       continue;
@@ -265,10 +393,10 @@ void VoxelSet::bisectOld(VoxelSet *first, VoxelSet *second)
     if (counter + current_section_size > half_length)
     {
       new_num_voxels.push_back(half_length - counter);
-      new_voxel_type.push_back(voxel_type_[index]);
+      new_voxel_type.push_back(getRunType(index));
 
       next_first_num_voxels = current_section_size + counter - half_length;
-      next_first_voxel_type = voxel_type_[index];
+      next_first_voxel_type = getRunType(index);
 
       index++;
       counter += current_section_size;
@@ -289,7 +417,7 @@ void VoxelSet::bisectOld(VoxelSet *first, VoxelSet *second)
 
   while (counter < set_length)
   {
-    int current_section_size = num_voxels_[index];
+    int current_section_size = getRunLength(index);
     if (current_section_size == 0)
     {
       index++;
@@ -298,7 +426,7 @@ void VoxelSet::bisectOld(VoxelSet *first, VoxelSet *second)
     if (counter + current_section_size <= set_length)
     {
       new_num_voxels.push_back(current_section_size);
-      new_voxel_type.push_back(voxel_type_[index]);
+      new_voxel_type.push_back(getRunType(index));
       index++;
       counter += current_section_size;
       continue;
@@ -306,23 +434,10 @@ void VoxelSet::bisectOld(VoxelSet *first, VoxelSet *second)
     if (counter + current_section_size > set_length)
     {
       new_num_voxels.push_back(set_length - counter);
-      new_voxel_type.push_back(voxel_type_[index]);
+      new_voxel_type.push_back(getRunType(index));
       counter += current_section_size;
       continue;
     }
   }
   *second = VoxelSet(total_num_voxels_ >> 1, new_num_voxels, new_voxel_type);
 }
-
-
-
-void VoxelSet::generateAirFile(std::string filepath)
-{
-  std::ofstream file(filepath, std::ios::binary);
-  uint32_t num_voxels = total_num_voxels_;
-  uint16_t voxel_type = 0;
-
-  file.write(reinterpret_cast<const char*>(&num_voxels), 4);
-  file.write(reinterpret_cast<const char*>(&voxel_type), 2);
-  file.close();
-}
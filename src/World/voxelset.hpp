@@ -12,29 +12,89 @@
 #include <string>
 #include <filesystem>
 #include <map>
+#include <memory>
+#include <atomic>
+#include <cstdint>
 
+// Voxels [start, start + count) of a set, in its run order (see world.hpp), all set to type
+struct VoxelRange
+{
+  uint32_t start;
+  uint32_t count;
+  uint16_t type;
+};
+
+// A view of a window of runs held by a shared, immutable buffer, so copies, moves, bisect() and
+// getQuadrant() only take a reference to the runs and trim the ends instead of copying them. Only
+// reading in runs, compact() and setRanges() build a new buffer, which this set alone views until
+// it's copied - the old one goes once nothing views it any more.
 class VoxelSet
 {
 public:
-  VoxelSet() { VoxelSet(0); }
+  VoxelSet() : VoxelSet(0) {}
   VoxelSet(int total_num_voxels);
   VoxelSet(int total_num_voxels, std::vector<int> num_voxels, std::vector<uint16_t> voxel_type);
-  VoxelSet& operator=(const VoxelSet& set);
   void calculateVoxelType();
-  uint16_t getVoxelType();
+  uint16_t getVoxelType() const { return average_voxel_type_; } // Kept up to date by everything that changes the runs
   void readFile(std::string filepath);
+  void readFile(std::string filepath, uint64_t offset, uint32_t size);
+  void readMemory(const char *data, uint32_t size);
+  void writeFile(std::string filepath);
+  std::vector<char> toBytes();
   bool isUniform() { return is_uniform_; }
+  // All voxel_type, viewing one run shared by every set of that type, so nothing is allocated once a
+  // type has been used
+  void setUniform(uint16_t voxel_type);
+  void setAir() { setUniform(0); }
+  unsigned int getNumRuns() const { return num_runs_; }
+  int getRunLength(unsigned int run) const
+  {
+    if (run + 1 == num_runs_) return last_length_;
+    if (run == 0) return runs_->num_voxels[first_run_] - first_skip_;
+    return runs_->num_voxels[first_run_ + run];
+  }
+  uint16_t getRunType(unsigned int run) const { return runs_->voxel_type[first_run_ + run]; }
+  int getNumVoxels() { return total_num_voxels_; }
+  // What this set's runs would take on their own - other sets may share them, so the bytes actually
+  // held are getStorageBytes()
+  uint64_t getMemoryUsage() { return sizeof(VoxelSet) + num_runs_*(sizeof(int) + sizeof(uint16_t)); }
+  static uint64_t getStorageBytes() { return storage_bytes_.load(); } // Held by every set's runs, once however many view them
+  bool compact();
+  uint16_t getVoxel(uint32_t index) const;
+  // Splices the ranges (sorted by start, not overlapping) into the runs, merging them with their
+  // neighbours. The runs are rebuilt and swapped in, so copies of this set never see the edit.
+  // Returns true if any voxel changed.
+  bool setRanges(const std::vector<VoxelRange> &ranges);
   VoxelSet getQuadrant(int quadrant);
   void bisect(VoxelSet *first, VoxelSet *second);
   void bisectOld(VoxelSet *first, VoxelSet *second);
 private:
+  // Never changed once a set views them
+  struct Runs
+  {
+    Runs(std::vector<int> &&num_voxels, std::vector<uint16_t> &&voxel_type);
+    ~Runs();
+    Runs(const Runs &) = delete;
+    Runs &operator=(const Runs &) = delete;
+    std::vector<int> num_voxels; // Stores the number of same-type voxels in order (more info in world.hpp)
+    std::vector<uint16_t> voxel_type; // Stores the type of voxel at a certain index
+  };
+
   int total_num_voxels_;
   int num_counter_bytes_;
-  std::vector<uint16_t> voxel_type_; // Stores the type of voxel at a certain index
-  std::vector<int> num_voxels_; // Stores the number of same-type voxels in order (more info in world.hpp)
+  std::shared_ptr<const Runs> runs_;
+  uint32_t first_run_ = 0; // Of runs_, this set's first
+  uint32_t num_runs_ = 0;
+  int first_skip_ = 0; // Voxels of the first run before this set starts
+  int last_length_ = 0; // Of the last run, up to where this set ends
   bool is_uniform_;
   uint16_t average_voxel_type_;
+  static std::atomic<uint64_t> storage_bytes_; // Runs are freed on whichever thread lets go of them last
 
-  void generateAirFile(std::string filepath);
+  static const std::shared_ptr<const Runs> &getAirRuns(); // One run of air longer than any set
+  static std::shared_ptr<const Runs> getUniformRuns(uint16_t voxel_type); // Likewise, of any type
+  bool findRun(int index, unsigned int *run, int *run_start) const;
+  VoxelSet getRange(int start, int num_voxels) const;
+  void setRuns(int total_num_voxels, std::vector<int> &&num_voxels, std::vector<uint16_t> &&voxel_type);
 };
 #endif // VOXELSET_HPP
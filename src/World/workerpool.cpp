@@ -0,0 +1,79 @@
+/* ---------------------------------------------------------------- *\
+ * workerpool.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "workerpool.hpp"
+
+#include <algorithm>
+
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_stopping_ = true;
+  }
+  work_ready_.notify_all();
+  for (unsigned int i = 0; i < threads_.size(); i++)
+  {
+    threads_[i].join();
+  }
+}
+
+
+void WorkerPool::run(unsigned int num_threads, unsigned int num_jobs, const std::function<void(unsigned int, unsigned int)> &job)
+{
+  num_threads = std::min(num_threads, num_jobs);
+  if (num_threads <= 1)
+  {
+    for (unsigned int i = 0; i < num_jobs; i++) job(0, i);
+    return;
+  }
+  while (threads_.size() + 1 < num_threads)
+  {
+    threads_.push_back(std::thread(&WorkerPool::work, this, threads_.size() + 1));
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = &job;
+    num_jobs_ = num_jobs;
+    next_job_ = 0;
+    num_workers_ = num_threads - 1;
+    num_busy_ = num_workers_;
+    run_number_++;
+  }
+  work_ready_.notify_all();
+  takeJobs(0);
+  std::unique_lock<std::mutex> lock(mutex_);
+  work_done_.wait(lock, [this]() { return num_busy_ == 0; });
+  job_ = nullptr;
+}
+
+
+void WorkerPool::work(unsigned int thread)
+{
+  uint64_t run_number = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true)
+  {
+    work_ready_.wait(lock, [&]() { return is_stopping_ || run_number_ != run_number; });
+    if (is_stopping_) break;
+    run_number = run_number_;
+    if (thread > num_workers_) continue; // Not needed for this one
+    lock.unlock();
+    takeJobs(thread);
+    lock.lock();
+    num_busy_--;
+    if (num_busy_ == 0) work_done_.notify_one();
+  }
+}
+
+
+void WorkerPool::takeJobs(unsigned int thread)
+{
+  for (unsigned int i = next_job_++; i < num_jobs_; i = next_job_++)
+  {
+    (*job_)(thread, i);
+  }
+}
@@ -0,0 +1,56 @@
+/* ---------------------------------------------------------------- *\
+ * workerpool.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Threads kept around for work that's split up every frame, so a
+ * frame doesn't pay for starting them (or allocate their state).
+ * run() hands out jobs to the calling thread and as many of the
+ * pool's as it needs - each thread takes the next job until there are
+ * none left - and returns once they're all done. Threads are started
+ * the first time a run needs them and parked between runs.
+ *
+ * One run at a time, from one thread.
+\* ---------------------------------------------------------------- */
+
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool
+{
+public:
+  WorkerPool() {}
+  ~WorkerPool();
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+  // Calls job(thread, i) for every i in [0, num_jobs) across num_threads threads, numbered from 0
+  // (the calling thread) so each can keep its own results
+  void run(unsigned int num_threads, unsigned int num_jobs, const std::function<void(unsigned int, unsigned int)> &job);
+private:
+  void work(unsigned int thread);
+  void takeJobs(unsigned int thread);
+
+  std::vector<std::thread> threads_; // Thread i + 1
+  std::mutex mutex_;
+  std::condition_variable work_ready_;
+  std::condition_variable work_done_;
+  const std::function<void(unsigned int, unsigned int)> *job_ = nullptr;
+  unsigned int num_jobs_ = 0;
+  std::atomic<unsigned int> next_job_{0};
+  unsigned int num_workers_ = 0; // Of threads_, taking part in this run
+  unsigned int num_busy_ = 0;
+  uint64_t run_number_ = 0;
+  bool is_stopping_ = false;
+};
+
+#endif // WORKERPOOL_HPP
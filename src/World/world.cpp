@@ -5,129 +5,363 @@
 \* ---------------------------------------------------------------- */
 #include "world.hpp"
 #include "cubeconvert.hpp"
+#include "profiler.hpp"
 
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <map>
+
+namespace
+{
+
+int64_t floorDiv(int64_t value, int64_t divisor)
+{
+  return (value >= 0) ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+
+// Paints [start, start + count) with type over the ranges (by start, each holding its end and
+// type), trimming whatever was there before
+void paintRange(std::map<uint32_t, std::pair<uint32_t, uint16_t>> &ranges, uint32_t start, uint32_t count, uint16_t type)
+{
+  uint32_t end = start + count;
+  std::map<uint32_t, std::pair<uint32_t, uint16_t>>::iterator itr = ranges.lower_bound(start);
+  if (itr != ranges.begin())
+  {
+    std::map<uint32_t, std::pair<uint32_t, uint16_t>>::iterator previous = std::prev(itr);
+    if (previous->second.first > start)
+    {
+      // Starts before, so keep its head - and its tail too if it runs past the end
+      if (previous->second.first > end) ranges[end] = previous->second;
+      previous->second.first = start;
+    }
+  }
+  while (itr != ranges.end() && itr->first < end)
+  {
+    if (itr->second.first > end) ranges[end] = itr->second;
+    itr = ranges.erase(itr);
+  }
+  ranges[start] = std::make_pair(end, type);
+}
+
+} // namespace
 
 // Allocate space for static member variables
 CubeConvert Octree::cube_converter_;
+ZoneStore Octree::zone_store_;
 Anthrax::Anthrax *Octree::anthrax_instance_;
-bool (*Octree::loadDecisionFunction)(uint64_t, int);
+std::shared_ptr<LodPolicy> Octree::lod_policy_;
+unsigned int Octree::brick_layer_ = 3;
+uint64_t Octree::num_brick_lod_changes_ = 0;
+std::atomic<uint64_t> Octree::resident_bytes_total_[Octree::NUM_RESIDENT_KINDS];
+std::vector<Octree*> Octree::cube_jobs_;
+std::vector<Octree*> Octree::cube_job_layers_[2];
+std::vector<std::unique_ptr<Octree::CubeBatch>> Octree::cube_batches_;
+WorkerPool Octree::cube_workers_;
+const uint8_t Octree::face_children_[6] = {0xAA, 0x55, 0xF0, 0x0F, 0xCC, 0x33}; // +x, -x, +y, -y, +z, -z
 
 World::World(std::string directory, Anthrax::Anthrax *anthrax_instance)
 {
   directory_ = directory;
-  octree_ = std::make_shared<Octree>(Octree(std::make_shared<Octree>(), num_layers_, zone_depth_, directory_ + "/", Anthrax::vec3<int64_t>(0, 0, 0)));
+  // Has to happen before any nodes are created - zones missing from the index are treated as air
+  Octree::openZoneStore(directory_, getZoneAddress());
+  octree_ = std::make_shared<Octree>(std::make_shared<Octree>(), num_layers_, zone_depth_, directory_ + "/", Anthrax::vec3<int64_t>(0, 0, 0));
   octree_->setCubeSettingsFile("voxelmap.json");
 
   anthrax_instance_ = anthrax_instance;
   octree_->setAnthraxPointer(anthrax_instance_);
-  octree_->setLoadDecisionFunction([](uint64_t distance, int layer) {
-      return (distance < 5000 && layer > distance / 500);
-      });
-  leaves_.push_back(octree_);
-  current_leaf_itr_ = leaves_.begin();
+  Octree::setLodPolicy(std::make_shared<ScreenSpaceLodPolicy>(ScreenSpaceLodPolicy::MEDIUM));
+}
+
+
+World::~World()
+{
+  applyEdits();
+  flushWrites();
 }
 
 
 void World::loadAreaRecursive(Anthrax::vec3<int64_t> center)
 {
-  octree_->loadAreaRecursive(center);
-  octree_->getNewNeighbors();
-  octree_->getCubes();
+  applyEdits();
+  updateLod(center);
+  getNewNeighbors();
+  getCubes();
+  Octree::getZoneStore().flushWrites();
   return;
 }
 
 
+void World::updateView(Anthrax::vec3<int64_t> center)
+{
+  // Without a renderer, keep whatever direction/projection was last set on the policy
+  std::shared_ptr<LodPolicy> lod_policy = Octree::getLodPolicy();
+  LodView view = lod_policy->getView();
+  view.position = center;
+  if (anthrax_instance_ != nullptr)
+  {
+    view.look_direction = anthrax_instance_->getLookDirection();
+    view.vertical_fov = anthrax_instance_->getFieldOfView();
+    view.viewport_width = anthrax_instance_->getWindowWidth();
+    view.viewport_height = anthrax_instance_->getWindowHeight();
+  }
+  lod_policy->setView(view);
+}
+
+
+void World::updateLod(Anthrax::vec3<int64_t> center)
+{
+  Anthrax::ScopedTimer timer("lod_update");
+  updateView(center);
+  uint64_t brick_lod_changes = Octree::getNumBrickLodChanges();
+  octree_->loadAreaRecursive(lod_queue_);
+  lod_queue_.apply(*Octree::getLodPolicy(), UINT64_MAX, &residency_);
+  unsigned int num_paged_out = residency_.update(octree_, *Octree::getLodPolicy());
+  if (lod_queue_.getNumSplits() + lod_queue_.getNumMerges() + num_paged_out > 0 || Octree::getNumBrickLodChanges() != brick_lod_changes) svo_dirty_ = true;
+}
+
+
+void World::getNewNeighbors()
+{
+  Anthrax::ScopedTimer timer("neighbor_linking");
+  octree_->getNewNeighbors();
+}
+
+
 void World::loadArea(Anthrax::vec3<int64_t> center)
 {
-  //Anthrax::List<Octree>::iterator current_leaf_itr = leaves_.begin();
+  applyEdits();
+  streamLod(center);
+  Octree::getZoneStore().flushWrites();
+  if (anthrax_instance_ != nullptr && anthrax_instance_->getRenderType() == Anthrax::Anthrax::RAYTRACED)
+  {
+    // Nothing is drawn from cubes in this mode - leaves that change get their cubes once rasterizing resumes
+    updateSvo(center);
+    return;
+  }
+  getNewNeighbors();
+  getCubes();
+}
+
+
+void World::setBox(Anthrax::vec3<int64_t> min, Anthrax::vec3<int64_t> max, uint16_t type)
+{
+  // Clamped to the world, which is centered on the origin, so its extents can't overflow later on
+  const int64_t world_min = -(1LL << (num_layers_ - 1));
+  const int64_t world_max = (1LL << (num_layers_ - 1)) - 1;
+  int64_t box_min[3] = {min.getX(), min.getY(), min.getZ()};
+  int64_t box_max[3] = {max.getX(), max.getY(), max.getZ()};
+  VoxelEdit edit;
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    if (box_min[a] > box_max[a] || box_max[a] < world_min || box_min[a] > world_max) return; // Inverted or outside the world
+    edit.min[a] = std::max(box_min[a], world_min);
+    edit.max[a] = std::min(box_max[a], world_max);
+  }
+  edit.type = type;
+  edits_.push_back(edit);
+}
+
 
+void World::applyEdits()
+{
+  if (edits_.empty()) return;
+  Anthrax::ScopedTimer timer("voxel_edits");
+  editSvo();
+  ZoneAddress zone_address = getZoneAddress();
+  int64_t zone_width = zone_address.getZoneWidth();
 
-  int count = 0;
-  //current_leaf_itr_ = nullptr;
-  Anthrax::List<Octree>::iterator prev_itr = nullptr;
-  while (count < 1000 && current_leaf_itr_ != nullptr)
+  // Gather every edit into one set of ranges per zone, so each zone's runs are spliced once
+  std::map<std::array<int64_t, 3>, std::map<uint32_t, std::pair<uint32_t, uint16_t>>> zones; // By corner
+  std::vector<std::pair<uint64_t, uint64_t>> index_ranges;
+  for (unsigned int e = 0; e < edits_.size(); e++)
   {
-    if (prev_itr == current_leaf_itr_)
+    const VoxelEdit &edit = edits_[e];
+    int64_t first_zone[3];
+    int64_t last_zone[3];
+    for (unsigned int a = 0; a < 3; a++)
     {
-      current_leaf_itr_++;
+      first_zone[a] = floorDiv(edit.min[a], zone_width);
+      last_zone[a] = floorDiv(edit.max[a], zone_width);
     }
-    prev_itr = current_leaf_itr_;
-    if (auto current_leaf = (*current_leaf_itr_).lock())
+    for (int64_t zx = first_zone[0]; zx <= last_zone[0]; zx++)
+    for (int64_t zy = first_zone[1]; zy <= last_zone[1]; zy++)
+    for (int64_t zz = first_zone[2]; zz <= last_zone[2]; zz++)
     {
-      auto parent = current_leaf->getParentPointer().lock();
-      float distance = (current_leaf->getCenter() - center).getMagnitude() - ((1LL << current_leaf->getLayer()) * 0.866025403784);
-      if (distance < 0) distance = 0;
-      //std::cout << current_leaf->getCenter().getX() << " " << current_leaf->getCenter().getY() << std::endl;
-      if (current_leaf->loadDecisionFunction(distance, current_leaf->getLayer()))
+      int64_t corner[3] = {zx * zone_width, zy * zone_width, zz * zone_width};
+      int64_t min[3];
+      int64_t max[3];
+      for (unsigned int a = 0; a < 3; a++)
       {
-        // Load this leaf's children
-        current_leaf->loadChildren();
-        if (!(current_leaf->isLeaf()))
-        {
-          for (unsigned int i = 0; i < 8; i++)
-          {
-            leaves_.push_back(current_leaf->getChildPointer(i));
-          }
-          current_leaf_itr_ = leaves_.erase(current_leaf_itr_);
-        }
-        // This leaf is loaded, so we don't need to check the parent in the future
-        if (!(current_leaf->parent_load_checked) && parent != nullptr)
-        {
-          for (unsigned int i = 0; i < 8; i++)
-          {
-            parent->getChildPointer(i).lock()->parent_load_checked = true;
-          }
-        }
-        // Now we are done with this leaf
-        current_leaf->parent_load_checked = false;
-        count++;
+        min[a] = std::max(edit.min[a] - corner[a], (int64_t)0);
+        max[a] = std::min(edit.max[a] - corner[a], zone_width - 1);
       }
-      else
+      std::map<uint32_t, std::pair<uint32_t, uint16_t>> &zone_ranges = zones[{corner[0], corner[1], corner[2]}];
+      index_ranges.clear();
+      zone_address.getIndexRanges(min, max, index_ranges);
+      for (unsigned int r = 0; r < index_ranges.size(); r++)
       {
-        // This leaf's children should not be loaded - check the parent to see if this leaf should remain loaded
-        if (!(current_leaf->parent_load_checked))
-        {
-          for (unsigned int i = 0; i < 8; i++)
-          {
-            parent->getChildPointer(i).lock()->parent_load_checked = true;
-          }
-          distance = (parent->getCenter() - center).getMagnitude() - ((1LL << parent->getLayer()) * 0.866025403784);
-          if (distance < 0) distance = 0;
-          if (!(parent->loadDecisionFunction(distance, parent->getLayer())))
-          {
-            parent->deleteChildren();
-            leaves_.push_back(parent);
-            current_leaf_itr_ = leaves_.erase(current_leaf_itr_);
-            count++;
-          }
-        }
-        else
-        {
-          current_leaf->parent_load_checked = false;
-          current_leaf_itr_++;
-          count++;
-        }
+        paintRange(zone_ranges, index_ranges[r].first, index_ranges[r].second, edit.type);
       }
     }
+  }
+  edits_.clear();
+
+  ZoneStore &zone_store = Octree::getZoneStore();
+  std::vector<VoxelRange> ranges;
+  for (std::map<std::array<int64_t, 3>, std::map<uint32_t, std::pair<uint32_t, uint16_t>>>::iterator itr = zones.begin(); itr != zones.end(); itr++)
+  {
+    ranges.clear();
+    for (std::map<uint32_t, std::pair<uint32_t, uint16_t>>::iterator range = itr->second.begin(); range != itr->second.end(); range++)
+    {
+      ranges.push_back({range->first, range->second.first - range->first, range->second.second});
+    }
+    Anthrax::vec3<int64_t> corner(itr->first[0], itr->first[1], itr->first[2]);
+    std::string path = zone_address.pathFromPosition(corner);
+    std::shared_ptr<Octree> node = octree_->findNode(corner, zone_depth_);
+    if (node->getLayer() == zone_depth_)
+    {
+      if (!node->setVoxels(ranges)) continue;
+      node->updateAncestorFaces();
+      zone_store.saveZone(path, node->getVoxelSet(), ranges, node->getPyramid());
+    }
     else
     {
-      current_leaf_itr_ = leaves_.erase(current_leaf_itr_);
-      continue;
+      // Not loaded, so there's nothing to redraw
+      VoxelSet voxel_set = zone_store.loadZone(path);
+      if (!voxel_set.setRanges(ranges)) continue;
+      zone_store.saveZone(path, voxel_set, ranges);
+    }
+  }
+}
+
+
+void World::editSvo()
+{
+  // Small edits where the SVO is already down to single voxels are made in place, copying only
+  // the blocks on each voxel's path - anything else changes what LOD it was built from
+  if (svo_dirty_ || svo_.getNodes().size() <= 1) return;
+  for (unsigned int e = 0; e < edits_.size() && !svo_dirty_; e++)
+  {
+    const VoxelEdit &edit = edits_[e];
+    // Stops as soon as it's too big, so three axes of up to the world's width can't overflow it
+    int64_t volume = 1;
+    for (unsigned int a = 0; a < 3 && volume <= max_svo_edit_voxels_; a++) volume *= edit.max[a] - edit.min[a] + 1;
+    if (volume > max_svo_edit_voxels_)
+    {
+      svo_dirty_ = true;
+      break;
+    }
+    for (int64_t x = edit.min[0]; x <= edit.max[0] && !svo_dirty_; x++)
+    for (int64_t y = edit.min[1]; y <= edit.max[1] && !svo_dirty_; y++)
+    for (int64_t z = edit.min[2]; z <= edit.max[2] && !svo_dirty_; z++)
+    {
+      if (!svo_.setVoxel(Anthrax::vec3<int64_t>(x, y, z), edit.type)) svo_dirty_ = true;
     }
   }
-  if (current_leaf_itr_ == nullptr)
+  svo_edited_ = true;
+}
+
+
+uint16_t World::getVoxel(Anthrax::vec3<int64_t> position)
+{
+  ZoneAddress zone_address = getZoneAddress();
+  int64_t zone_width = zone_address.getZoneWidth();
+  int64_t offset[3] = {position.getX(), position.getY(), position.getZ()};
+  for (unsigned int a = 0; a < 3; a++) offset[a] -= floorDiv(offset[a], zone_width) * zone_width;
+  uint64_t index = zone_address.voxelIndex(offset[0], offset[1], offset[2]);
+
+  // A loaded node holds its own copy of its part of the zone, in the same order
+  std::shared_ptr<Octree> node = octree_->findNode(position, 0);
+  if (node->getLayer() <= zone_depth_)
   {
-    current_leaf_itr_ = leaves_.begin();
-    std::cout << "POOP" << std::endl;
+    return node->getVoxelSet().getVoxel(index & ((1ULL << (3*node->getLayer())) - 1));
   }
+  return Octree::getZoneStore().loadZone(zone_address.pathFromPosition(position)).getVoxel(index);
+}
 
-  octree_->getNewNeighbors();
-  octree_->getCubes();
+
+void World::streamLod(Anthrax::vec3<int64_t> center)
+{
+  Anthrax::ScopedTimer timer("lod_stream");
+  updateView(center);
+  uint64_t brick_lod_changes = Octree::getNumBrickLodChanges();
+  lod_streamer_.update(octree_, *Octree::getLodPolicy(), &residency_);
+  unsigned int num_paged_out = residency_.update(octree_, *Octree::getLodPolicy());
+  if (lod_streamer_.getNumSplits() + lod_streamer_.getNumMerges() + num_paged_out > 0 || Octree::getNumBrickLodChanges() != brick_lod_changes) svo_dirty_ = true;
+}
+
+
+void World::setMemoryBudget(uint64_t budget_bytes)
+{
+  residency_.setBudget(budget_bytes);
+  // The zone cache counts against it too, so it can't be allowed to take most of it
+  ZoneCache &zone_cache = Octree::getZoneStore().getCache();
+  if (budget_bytes > 0 && zone_cache.getBudget() > budget_bytes / zone_cache_share_) zone_cache.setBudget(budget_bytes / zone_cache_share_);
+}
+
+
+void World::updateSvo(Anthrax::vec3<int64_t> center)
+{
+  // The root is 2x2x2 nodes of svo_layer_, around the node corner closest to the center, so the
+  // center always has at least half a node's width of the tree around it
+  int64_t width = 1LL << svo_layer_;
+  int64_t origin[3];
+  int64_t position[3] = {center.getX(), center.getY(), center.getZ()};
+  for (unsigned int a = 0; a < 3; a++)
+  {
+    int64_t shifted = position[a] + width / 2;
+    int64_t corner = (shifted >= 0 ? shifted / width : -((-shifted + width - 1) / width)); // Floor division
+    origin[a] = (corner - 1) * width;
+  }
+  Anthrax::vec3<int64_t> svo_origin(origin[0], origin[1], origin[2]);
+  bool is_current = !svo_dirty_ && svo_.getNodes().size() > 1 && svo_origin.getX() == svo_.getOrigin().getX()
+      && svo_origin.getY() == svo_.getOrigin().getY() && svo_origin.getZ() == svo_.getOrigin().getZ();
+  if (is_current && !svo_edited_) return;
+
+  if (!is_current)
+  {
+    Anthrax::ScopedTimer timer("svo_build");
+    svo_.reset(svo_origin, svo_layer_ + 1);
+    uint32_t children[8];
+    for (unsigned int i = 0; i < 8; i++)
+    {
+      Anthrax::vec3<int64_t> corner(origin[0] + ((i & 1) ? width : 0), origin[1] + ((i & 4) ? width : 0), origin[2] + ((i & 2) ? width : 0));
+      std::shared_ptr<Octree> node = octree_->findNode(corner, svo_layer_);
+      if (node->getLayer() == svo_layer_) children[i] = node->writeSvo(svo_);
+      else children[i] = Anthrax::Svo::makeLeaf(node->getVoxelType()); // Only loaded coarser than the root's children
+    }
+    svo_.setRoot(svo_.addChildren(children));
+    svo_dirty_ = false;
+  }
+  svo_edited_ = false;
+
+  if (anthrax_instance_ != nullptr)
+  {
+    std::map<uint16_t, Anthrax::Cube> materials;
+    std::set<uint16_t> types = svo_.getTypes();
+    for (std::set<uint16_t>::iterator itr = types.begin(); itr != types.end(); itr++)
+    {
+      materials[*itr] = Octree::getCubeConverter().convert(*itr, Anthrax::vec3<float>(0.0f, 0.0f, 0.0f), 1);
+    }
+    anthrax_instance_->setSvo(svo_, materials);
+  }
+}
+
+
+RayHit World::castRay(Anthrax::vec3<double> origin, Anthrax::vec3<float> direction, float max_distance)
+{
+  Ray ray;
+  ray.origin = origin;
+  ray.direction = direction;
+  ray.max_distance = max_distance;
+  return getRaycaster().castRay(ray);
 }
 
 
 void World::getCubes()
 {
-  octree_->getCubes();
+  Anthrax::ScopedTimer timer("cube_emission");
+  octree_->getCubes(num_cube_threads_);
 }
@@ -44,32 +44,120 @@
  * are stored in order: number of voxels in set
  * ( ceil((zone_depth_)/8)*8 bits)
  * and voxel type (16 bits).
+ *
+ * The zones that exist are listed in the world's zone index
+ * (zones.idx, see zoneindex.hpp), along with which of them are a
+ * single voxel type. Zones missing from the index are air and are
+ * never created on disk. Packed worlds keep their zones in region
+ * archives (.rgn, see regionarchive.hpp) instead of one file each.
+ *
+ * Edits (setVoxel/setBox) are queued and applied together at the
+ * start of the next frame: every zone they touch gets one splice of
+ * its runs, and only the cubes whose voxels or neighbours changed
+ * are rebuilt. Each edited zone's edit is journaled (see
+ * editjournal.hpp) and the zone is written back in the background
+ * every few seconds (see zonestore.hpp) - call commitEdits() to make
+ * sure the edits will survive a crash, or flushWrites() to have the
+ * zones themselves on disk.
+ *
+ * With a memory budget (setMemoryBudget), the parts of the tree
+ * that matter least to the view are paged back out to the zones on
+ * disk once it's used up, so how much of the world is loaded stays
+ * within a fixed amount of RAM however far the camera travels.
 \* ---------------------------------------------------------------- */
 #ifndef WORLD_HPP
 #define WORLD_HPP
 
+#include <set>
 #include <string>
+#include <vector>
+#include "collider.hpp"
+#include "lodstreamer.hpp"
 #include "octree.hpp"
+#include "raycaster.hpp"
+#include "residency.hpp"
+#include "zoneaddress.hpp"
 #include "anthrax_types.hpp"
 #include "anthrax.hpp"
 
 class World
 {
 public:
-  World(std::string directory, Anthrax::Anthrax *anthrax_instance);
-  void loadAreaRecursive(Anthrax::vec3<int64_t> center);
-  void loadArea(Anthrax::vec3<int64_t> center);
+  World(std::string directory, Anthrax::Anthrax *anthrax_instance); // anthrax_instance may be nullptr to run without a renderer
+  ~World();
+  void loadAreaRecursive(Anthrax::vec3<int64_t> center); // Brings the whole tree up to date at once
+  void loadArea(Anthrax::vec3<int64_t> center); // Like loadAreaRecursive, but refines within the streaming time budget
+  // The individual steps of loadAreaRecursive/loadArea
+  void updateLod(Anthrax::vec3<int64_t> center);
+  void streamLod(Anthrax::vec3<int64_t> center);
+  void getNewNeighbors();
   void getCubes();
+  uint64_t getNodeCount() { return octree_->countNodes(); }
+  uint64_t getCubeCount() { return octree_->countCubes(); }
+  uint64_t getBrickCount() { return octree_->countBricks(); }
+  uint64_t countResidentBytes() { return octree_->countResidentBytes(); } // From scratch, to check what's tracked
+  void setBrickLayer(unsigned int brick_layer) { Octree::setBrickLayer(brick_layer); } // 0 turns bricks off
+  void setCubeThreads(unsigned int num_threads) { num_cube_threads_ = num_threads; } // For getCubes, 0 for one per core
+  ZoneAddress getZoneAddress() const { return ZoneAddress(num_layers_, zone_depth_); }
+  void setZoneCacheBudget(uint64_t budget_bytes) { Octree::getZoneStore().getCache().setBudget(budget_bytes); }
+  ZoneCache &getZoneCache() { return Octree::getZoneStore().getCache(); }
+  void setLodPolicy(std::shared_ptr<LodPolicy> lod_policy) { Octree::setLodPolicy(lod_policy); }
+  std::shared_ptr<LodPolicy> getLodPolicy() { return Octree::getLodPolicy(); }
+  unsigned int getNumDeferredLodChanges() { return lod_queue_.getNumPending(); } // Splits/merges left over from the last updateLod
+  void setStreamingBudget(uint64_t time_budget_us) { lod_streamer_.setTimeBudget(time_budget_us); } // Per frame, for loadArea
+  LodStreamer &getLodStreamer() { return lod_streamer_; }
+  // Keeps the loaded nodes and the zone cache under budget_bytes (see residency.hpp), shrinking the
+  // zone cache's own budget to fit - 0 for no budget
+  void setMemoryBudget(uint64_t budget_bytes);
+  ResidencyManager &getResidency() { return residency_; }
+  // Rebuilds the linear SVO for the RAYTRACED render mode if the LOD or the root's position changed,
+  // and hands it to the renderer if that or an edit changed it
+  void updateSvo(Anthrax::vec3<int64_t> center);
+  const Anthrax::Svo &getSvo() { return svo_; }
+  void setSvoDeduplication(bool deduplicate) { svo_.setDeduplicate(deduplicate); svo_dirty_ = true; } // On by default, see svo.hpp
+  // Against the currently loaded LOD - coarse nodes are hit as the cube drawn for them
+  RayHit castRay(Anthrax::vec3<double> origin, Anthrax::vec3<float> direction, float max_distance);
+  bool hasLineOfSight(Anthrax::vec3<double> from, Anthrax::vec3<double> to) { return getRaycaster().hasLineOfSight(from, to); }
+  Raycaster getRaycaster() { return Raycaster(octree_); }
+  VoxelCollider getCollider() { return VoxelCollider(octree_); } // Against the currently loaded LOD, like castRay
+  // Queued until applyEdits() (loadArea/loadAreaRecursive call it), later edits win
+  void setVoxel(Anthrax::vec3<int64_t> position, uint16_t type) { setBox(position, position, type); }
+  // Inclusive, clamped to the world - ignored if min is past max on any axis
+  void setBox(Anthrax::vec3<int64_t> min, Anthrax::vec3<int64_t> max, uint16_t type);
+  void applyEdits();
+  unsigned int getNumQueuedEdits() { return edits_.size(); }
+  uint16_t getVoxel(Anthrax::vec3<int64_t> position); // Full resolution, as of the last applyEdits()
+  bool commitEdits() { applyEdits(); return Octree::getZoneStore().commitJournal(); } // Blocks until every edit is journaled, false if one couldn't be
+  void flushWrites() { Octree::getZoneStore().flushWrites(true); } // Blocks until every edited zone is on disk
 private:
+  struct VoxelEdit
+  {
+    int64_t min[3];
+    int64_t max[3];
+    uint16_t type;
+  };
+
   const unsigned int num_layers_ = 32; // Number of layers in the octree - total world size in one axis is equal to 2^num_layers_
   const unsigned int zone_depth_ = 8; // Layer number of a zone - this determines the size of a zone 
                                       // A zone is a single file. The size of a zone in one axis is
                                       // equal to 2^zone_depth_.
+  void updateView(Anthrax::vec3<int64_t> center); // Hands the camera to the LOD policy
+  void editSvo(); // Applies edits_ to the SVO in place, or marks it for a rebuild
+
   std::string directory_; // Location on disk containing this world's files
   std::shared_ptr<Octree> octree_; // Container for all voxels
 
-  Anthrax::List<Octree> leaves_;
-  Anthrax::List<Octree>::iterator current_leaf_itr_;
+  LodStreamer lod_streamer_;
+  LodQueue lod_queue_; // For updateLod - kept across frames so the splits residency holds back aren't queued again each frame
+  ResidencyManager residency_;
+  const uint64_t zone_cache_share_ = 4; // The zone cache gets at most 1/4 of a memory budget
+  Anthrax::Svo svo_;
+  const unsigned int svo_layer_ = 15; // The SVO's root is twice this layer wide, enough to cover the render distance
+  bool svo_dirty_ = true;
+  bool svo_edited_ = false; // Changed in place since it was last handed to the renderer
+  const int64_t max_svo_edit_voxels_ = 4096; // Per edit - past this a rebuild is cheaper
   Anthrax::Anthrax *anthrax_instance_;
+  unsigned int num_cube_threads_ = 0;
+  std::vector<VoxelEdit> edits_;
 };
 #endif // WORLD_HPP
@@ -0,0 +1,183 @@
+/* ---------------------------------------------------------------- *\
+ * worldgenerator.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "worldgenerator.hpp"
+
+#include <vector>
+
+
+WorldGenerator::WorldGenerator(uint32_t seed, ZoneAddress zone_address) : zone_address_(zone_address)
+{
+  seed_ = seed;
+}
+
+
+VoxelSet WorldGenerator::generateZone(std::string path)
+{
+  Anthrax::vec3<int64_t> corner = zone_address_.cornerFromPath(path);
+  int64_t width = zone_address_.getZoneWidth();
+  uint64_t total_num_voxels = zone_address_.getVoxelsPerZone();
+
+  // Build a heightmap of the zone's columns first - the terrain only depends on (x, z)
+  std::vector<int64_t> heights(width*width);
+  int64_t min_height = INT64_MAX, max_height = INT64_MIN;
+  for (int64_t z = 0; z < width; z++)
+  {
+    for (int64_t x = 0; x < width; x++)
+    {
+      int64_t height = getHeight(corner.getX() + x, corner.getZ() + z);
+      heights[z*width + x] = height;
+      if (height < min_height) min_height = height;
+      if (height > max_height) max_height = height;
+    }
+  }
+
+  std::vector<int> num_voxels;
+  std::vector<uint16_t> voxel_type;
+  if (corner.getY() >= max_height)
+  {
+    // Completely above the terrain
+    num_voxels.push_back(total_num_voxels);
+    voxel_type.push_back(AIR);
+    return VoxelSet(total_num_voxels, num_voxels, voxel_type);
+  }
+  if (!caves_ && corner.getY() + width <= min_height - 4)
+  {
+    // Completely below the surface layers
+    num_voxels.push_back(total_num_voxels);
+    voxel_type.push_back(STONE);
+    return VoxelSet(total_num_voxels, num_voxels, voxel_type);
+  }
+
+  // Walk the zone in file order, run-length encoding as we go
+  for (uint64_t i = 0; i < total_num_voxels; i++)
+  {
+    Anthrax::vec3<int64_t> offset = zone_address_.voxelOffset(i);
+    int64_t height = heights[offset.getZ()*width + offset.getX()];
+    int64_t y = corner.getY() + offset.getY();
+    uint16_t type;
+    if (y >= height) type = AIR;
+    else if (y == height - 1) type = GRASS;
+    else if (y >= height - 4) type = DIRT;
+    else type = STONE;
+    if (caves_ && y < height - cave_roof_depth_ && isCave(corner.getX() + offset.getX(), y, corner.getZ() + offset.getZ()))
+    {
+      type = AIR;
+    }
+
+    if (!voxel_type.empty() && voxel_type.back() == type)
+    {
+      num_voxels.back()++;
+    }
+    else
+    {
+      num_voxels.push_back(1);
+      voxel_type.push_back(type);
+    }
+  }
+  return VoxelSet(total_num_voxels, num_voxels, voxel_type);
+}
+
+
+uint16_t WorldGenerator::getVoxelType(int64_t x, int64_t y, int64_t z)
+{
+  int64_t height = getHeight(x, z);
+  if (y >= height) return AIR;
+  if (caves_ && y < height - cave_roof_depth_ && isCave(x, y, z)) return AIR;
+  if (y == height - 1) return GRASS;
+  if (y >= height - 4) return DIRT;
+  return STONE;
+}
+
+
+bool WorldGenerator::isCave(int64_t x, int64_t y, int64_t z)
+{
+  // Stretch the noise horizontally so caves form tunnels rather than blobs
+  float noise = 0.7f*valueNoise(x, 2*y, z, 2*cave_cell_size_) + 0.3f*valueNoise(x, 2*y, z, cave_cell_size_/2);
+  return noise > cave_threshold_;
+}
+
+
+int64_t WorldGenerator::getHeight(int64_t x, int64_t z)
+{
+  // A few octaves of value noise
+  float noise = 0.5f*valueNoise(x, z, 256) + 0.3f*valueNoise(x, z, 64) + 0.2f*valueNoise(x, z, 16);
+  return base_height_ + (int64_t)(noise*amplitude_);
+}
+
+
+float WorldGenerator::valueNoise(int64_t x, int64_t z, int64_t cell_size)
+{
+  int64_t cell_x = floorDivide(x, cell_size);
+  int64_t cell_z = floorDivide(z, cell_size);
+  float fx = (float)(x - cell_x*cell_size) / cell_size;
+  float fz = (float)(z - cell_z*cell_size) / cell_size;
+  // Smoothstep between the corners
+  fx = fx*fx*(3.0f - 2.0f*fx);
+  fz = fz*fz*(3.0f - 2.0f*fz);
+
+  uint32_t salt = (uint32_t)cell_size;
+  float c00 = (hash(cell_x, cell_z, salt) & 0xFFFF) / 65535.0f;
+  float c10 = (hash(cell_x + 1, cell_z, salt) & 0xFFFF) / 65535.0f;
+  float c01 = (hash(cell_x, cell_z + 1, salt) & 0xFFFF) / 65535.0f;
+  float c11 = (hash(cell_x + 1, cell_z + 1, salt) & 0xFFFF) / 65535.0f;
+  float top = c00 + (c10 - c00)*fx;
+  float bottom = c01 + (c11 - c01)*fx;
+  return top + (bottom - top)*fz;
+}
+
+
+float WorldGenerator::valueNoise(int64_t x, int64_t y, int64_t z, int64_t cell_size)
+{
+  int64_t cell_x = floorDivide(x, cell_size);
+  int64_t cell_y = floorDivide(y, cell_size);
+  int64_t cell_z = floorDivide(z, cell_size);
+  float fx = (float)(x - cell_x*cell_size) / cell_size;
+  float fy = (float)(y - cell_y*cell_size) / cell_size;
+  float fz = (float)(z - cell_z*cell_size) / cell_size;
+  fx = fx*fx*(3.0f - 2.0f*fx);
+  fy = fy*fy*(3.0f - 2.0f*fy);
+  fz = fz*fz*(3.0f - 2.0f*fz);
+
+  // Trilinear interpolation between the 8 corners of the cell, indexed like octree quadrants
+  uint32_t salt = (uint32_t)cell_size;
+  float corners[8];
+  for (int i = 0; i < 8; i++)
+  {
+    corners[i] = (hash(cell_x + (i & 1), cell_y + ((i >> 2) & 1), cell_z + ((i >> 1) & 1), salt) & 0xFFFF) / 65535.0f;
+  }
+  float x00 = corners[0] + (corners[1] - corners[0])*fx;
+  float x10 = corners[2] + (corners[3] - corners[2])*fx;
+  float x01 = corners[4] + (corners[5] - corners[4])*fx;
+  float x11 = corners[6] + (corners[7] - corners[6])*fx;
+  float bottom = x00 + (x10 - x00)*fz;
+  float top = x01 + (x11 - x01)*fz;
+  return bottom + (top - bottom)*fy;
+}
+
+
+int64_t WorldGenerator::floorDivide(int64_t value, int64_t divisor)
+{
+  // Floor division so negative coordinates line up with positive ones
+  return (value >= 0) ? value / divisor : (value - divisor + 1) / divisor;
+}
+
+
+uint32_t WorldGenerator::hash(int64_t x, int64_t z, uint32_t salt)
+{
+  uint64_t h = (uint64_t)x*0x9E3779B97F4A7C15ULL ^ (uint64_t)z*0xC2B2AE3D27D4EB4FULL ^ ((uint64_t)(seed_ ^ salt) << 32);
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  return (uint32_t)h;
+}
+
+
+uint32_t WorldGenerator::hash(int64_t x, int64_t y, int64_t z, uint32_t salt)
+{
+  return hash(x ^ ((uint64_t)y*0xD6E8FEB86659FD93ULL), z, salt + 0x5BD1E995);
+}
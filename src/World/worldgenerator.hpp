@@ -0,0 +1,59 @@
+/* ---------------------------------------------------------------- *\
+ * worldgenerator.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Deterministic procedural terrain. Given the same seed, the same
+ * zone always produces exactly the same voxels, which is what the
+ * benchmark relies on.
+\* ---------------------------------------------------------------- */
+
+#ifndef WORLDGENERATOR_HPP
+#define WORLDGENERATOR_HPP
+
+#include <cstdint>
+#include <string>
+#include "voxelset.hpp"
+#include "zoneaddress.hpp"
+
+class WorldGenerator
+{
+public:
+  enum VoxelType : uint16_t
+  {
+    AIR = 0,
+    GRASS = 1,
+    DIRT = 2,
+    STONE = 3
+  };
+
+  WorldGenerator(uint32_t seed, ZoneAddress zone_address);
+  VoxelSet generateZone(std::string path);
+  uint16_t getVoxelType(int64_t x, int64_t y, int64_t z);
+  int64_t getHeight(int64_t x, int64_t z);
+
+  bool isCave(int64_t x, int64_t y, int64_t z);
+
+  void setTerrainHeight(int64_t base_height, int64_t amplitude) { base_height_ = base_height; amplitude_ = amplitude; }
+  void setCaves(bool caves) { caves_ = caves; } // Off by default - caves make every underground zone non-uniform
+
+private:
+  float valueNoise(int64_t x, int64_t z, int64_t cell_size);
+  float valueNoise(int64_t x, int64_t y, int64_t z, int64_t cell_size);
+  uint32_t hash(int64_t x, int64_t z, uint32_t salt);
+  uint32_t hash(int64_t x, int64_t y, int64_t z, uint32_t salt);
+  static int64_t floorDivide(int64_t value, int64_t divisor);
+
+  uint32_t seed_;
+  ZoneAddress zone_address_;
+  int64_t base_height_ = 0;
+  int64_t amplitude_ = 48;
+  bool caves_ = false;
+  const int64_t cave_cell_size_ = 32;
+  const float cave_threshold_ = 0.7f; // Noise values above this are carved out
+  const int64_t cave_roof_depth_ = 6; // Caves never break through this many voxels below the surface
+};
+
+#endif // WORLDGENERATOR_HPP
@@ -0,0 +1,141 @@
+/* ---------------------------------------------------------------- *\
+ * zoneaddress.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Conversions between world positions, octree paths and voxel
+ * indices within a zone file. These follow the quadrant layout
+ * described in world.hpp: within a quadrant number, bit 0 selects
+ * +X, bit 1 selects +Z and bit 2 selects +Y. Anything that reads
+ * or writes zones outside of Octree should go through here rather
+ * than re-deriving the ordering.
+\* ---------------------------------------------------------------- */
+
+#ifndef ZONEADDRESS_HPP
+#define ZONEADDRESS_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "anthrax_types.hpp"
+
+class ZoneAddress
+{
+public:
+  ZoneAddress(unsigned int num_layers, unsigned int zone_depth)
+  {
+    num_layers_ = num_layers;
+    zone_depth_ = zone_depth;
+  }
+
+  unsigned int getZoneDepth() const { return zone_depth_; }
+  unsigned int getPathLength() const { return num_layers_ - zone_depth_; }
+  int64_t getZoneWidth() const { return 1LL << zone_depth_; }
+  uint64_t getVoxelsPerZone() const { return 1ULL << (3*zone_depth_); }
+
+  // Path (as used by Octree, "[0-7]*") of the zone containing a world position
+  std::string pathFromPosition(Anthrax::vec3<int64_t> position) const
+  {
+    uint64_t offset = 1ULL << (num_layers_ - 1); // The world is centered on the origin
+    uint64_t x = position.getX() + offset;
+    uint64_t y = position.getY() + offset;
+    uint64_t z = position.getZ() + offset;
+    std::string path;
+    for (int bit = num_layers_ - 1; bit >= (int)zone_depth_; bit--)
+    {
+      path += std::to_string(quadrant((x >> bit) & 1, (y >> bit) & 1, (z >> bit) & 1));
+    }
+    return path;
+  }
+
+  // Smallest corner (in world coordinates) of the node at the given path
+  Anthrax::vec3<int64_t> cornerFromPath(std::string path) const
+  {
+    int64_t x = 0, y = 0, z = 0;
+    int bit = num_layers_ - 1;
+    for (unsigned int i = 0; i < path.size(); i++, bit--)
+    {
+      int digit = path[i] - '0';
+      if (digit & 1) x |= 1LL << bit;
+      if (digit & 4) y |= 1LL << bit;
+      if (digit & 2) z |= 1LL << bit;
+    }
+    int64_t offset = 1LL << (num_layers_ - 1);
+    return Anthrax::vec3<int64_t>(x - offset, y - offset, z - offset);
+  }
+
+  // Position of a voxel within its zone from its index in the zone file
+  Anthrax::vec3<int64_t> voxelOffset(uint64_t index) const
+  {
+    int64_t x = 0, y = 0, z = 0;
+    for (unsigned int bit = 0; bit < zone_depth_; bit++)
+    {
+      int digit = (index >> (3*bit)) & 7;
+      x |= (int64_t)(digit & 1) << bit;
+      z |= (int64_t)((digit >> 1) & 1) << bit;
+      y |= (int64_t)((digit >> 2) & 1) << bit;
+    }
+    return Anthrax::vec3<int64_t>(x, y, z);
+  }
+
+  // Index in the zone file of a voxel at the given offset within its zone
+  uint64_t voxelIndex(int64_t x, int64_t y, int64_t z) const
+  {
+    uint64_t index = 0;
+    for (unsigned int bit = 0; bit < zone_depth_; bit++)
+    {
+      index |= (uint64_t)quadrant((x >> bit) & 1, (y >> bit) & 1, (z >> bit) & 1) << (3*bit);
+    }
+    return index;
+  }
+
+  // The box of voxels [min, max] (offsets within a zone, inclusive) as ranges of zone file
+  // indices, in order. Every aligned cube the box covers whole is one range, and neighbouring
+  // ranges are merged.
+  void getIndexRanges(const int64_t *min, const int64_t *max, std::vector<std::pair<uint64_t, uint64_t>> &ranges) const
+  {
+    int64_t corner[3] = {0, 0, 0};
+    addIndexRanges(min, max, corner, zone_depth_, 0, ranges);
+  }
+
+  static int quadrant(int x_bit, int y_bit, int z_bit)
+  {
+    return x_bit | (z_bit << 1) | (y_bit << 2);
+  }
+
+private:
+  // Ranges for the part of the box inside the cube of 2^layer voxels at corner, whose first voxel
+  // has the given index
+  static void addIndexRanges(const int64_t *min, const int64_t *max, const int64_t *corner, unsigned int layer, uint64_t first_index,
+                             std::vector<std::pair<uint64_t, uint64_t>> &ranges)
+  {
+    int64_t width = 1LL << layer;
+    bool is_inside = true;
+    for (unsigned int a = 0; a < 3; a++)
+    {
+      if (max[a] < corner[a] || min[a] >= corner[a] + width) return;
+      if (min[a] > corner[a] || max[a] < corner[a] + width - 1) is_inside = false;
+    }
+    if (is_inside)
+    {
+      uint64_t count = 1ULL << (3*layer);
+      if (!ranges.empty() && ranges.back().first + ranges.back().second == first_index) ranges.back().second += count;
+      else ranges.push_back(std::make_pair(first_index, count));
+      return;
+    }
+    int64_t half = width >> 1;
+    for (int digit = 0; digit < 8; digit++)
+    {
+      int64_t child_corner[3] = {corner[0] + ((digit & 1) ? half : 0), corner[1] + ((digit & 4) ? half : 0), corner[2] + ((digit & 2) ? half : 0)};
+      addIndexRanges(min, max, child_corner, layer - 1, first_index + ((uint64_t)digit << (3*(layer - 1))), ranges);
+    }
+  }
+
+  unsigned int num_layers_;
+  unsigned int zone_depth_;
+};
+
+#endif // ZONEADDRESS_HPP
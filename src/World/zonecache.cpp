@@ -0,0 +1,74 @@
+/* ---------------------------------------------------------------- *\
+ * zonecache.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "zonecache.hpp"
+#include "profiler.hpp"
+
+
+bool ZoneCache::find(ZoneIndex::Key key, VoxelSet *voxel_set)
+{
+  std::map<ZoneIndex::Key, std::list<CacheEntry>::iterator>::iterator itr = lookup_.find(key);
+  if (itr == lookup_.end())
+  {
+    num_misses_++;
+    Anthrax::Profiler::addCounter(Anthrax::Profiler::ZONE_CACHE_MISSES, 1);
+    return false;
+  }
+  // Move to the front - it's now the most recently used
+  entries_.splice(entries_.begin(), entries_, itr->second);
+  *voxel_set = itr->second->voxel_set;
+  num_hits_++;
+  Anthrax::Profiler::addCounter(Anthrax::Profiler::ZONE_CACHE_HITS, 1);
+  return true;
+}
+
+
+void ZoneCache::insert(ZoneIndex::Key key, VoxelSet voxel_set)
+{
+  erase(key);
+  uint64_t num_bytes = voxel_set.getMemoryUsage();
+  if (num_bytes > budget_bytes_) return; // Would evict everything else and still not fit
+  entries_.push_front({key, voxel_set, num_bytes});
+  lookup_[key] = entries_.begin();
+  bytes_used_ += num_bytes;
+  evict();
+}
+
+
+void ZoneCache::erase(ZoneIndex::Key key)
+{
+  std::map<ZoneIndex::Key, std::list<CacheEntry>::iterator>::iterator itr = lookup_.find(key);
+  if (itr == lookup_.end()) return;
+  bytes_used_ -= itr->second->num_bytes;
+  entries_.erase(itr->second);
+  lookup_.erase(itr);
+}
+
+
+void ZoneCache::clear()
+{
+  entries_.clear();
+  lookup_.clear();
+  bytes_used_ = 0;
+}
+
+
+void ZoneCache::setBudget(uint64_t budget_bytes)
+{
+  budget_bytes_ = budget_bytes;
+  evict();
+}
+
+
+void ZoneCache::evict()
+{
+  while (bytes_used_ > budget_bytes_ && !entries_.empty())
+  {
+    CacheEntry &entry = entries_.back();
+    bytes_used_ -= entry.num_bytes;
+    lookup_.erase(entry.key);
+    entries_.pop_back();
+  }
+}
@@ -0,0 +1,56 @@
+/* ---------------------------------------------------------------- *\
+ * zonecache.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Least-recently-used cache of decoded zones, keyed by their zone
+ * index key. Octree drops a zone's VoxelSet as soon as the node is
+ * collapsed, so without this, moving back and forth across a LOD
+ * boundary reads and decodes the same zone again every time. The
+ * cache is bounded by a byte budget rather than a number of zones,
+ * since a zone can be anywhere from one run to millions.
+\* ---------------------------------------------------------------- */
+
+#ifndef ZONECACHE_HPP
+#define ZONECACHE_HPP
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include "voxelset.hpp"
+#include "zoneindex.hpp"
+
+class ZoneCache
+{
+public:
+  ZoneCache() {}
+  bool find(ZoneIndex::Key key, VoxelSet *voxel_set); // Fills in voxel_set and returns true on a hit
+  void insert(ZoneIndex::Key key, VoxelSet voxel_set);
+  void erase(ZoneIndex::Key key);
+  void clear();
+  void setBudget(uint64_t budget_bytes);
+  uint64_t getBudget() { return budget_bytes_; }
+  uint64_t getBytesUsed() { return bytes_used_; }
+  unsigned int size() { return entries_.size(); }
+  uint64_t getHits() { return num_hits_; }
+  uint64_t getMisses() { return num_misses_; }
+private:
+  struct CacheEntry
+  {
+    ZoneIndex::Key key;
+    VoxelSet voxel_set;
+    uint64_t num_bytes;
+  };
+  void evict();
+
+  std::list<CacheEntry> entries_; // Most recently used at the front
+  std::map<ZoneIndex::Key, std::list<CacheEntry>::iterator> lookup_;
+  uint64_t budget_bytes_ = 256ULL << 20;
+  uint64_t bytes_used_ = 0;
+  uint64_t num_hits_ = 0;
+  uint64_t num_misses_ = 0;
+};
+
+#endif // ZONECACHE_HPP
@@ -0,0 +1,191 @@
+/* ---------------------------------------------------------------- *\
+ * zoneindex.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "zoneindex.hpp"
+#include "durablefile.hpp"
+#include "regionarchive.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+
+bool ZoneIndex::readFile(std::string filepath)
+{
+  entries_.clear();
+  std::ifstream file(filepath, std::ios::binary);
+  if (!file) return false;
+
+  char magic[4];
+  uint32_t version;
+  uint64_t num_entries;
+  file.read(magic, 4);
+  file.read(reinterpret_cast<char*>(&version), 4);
+  file.read(reinterpret_cast<char*>(&num_entries), 8);
+  if (!file || strncmp(magic, "RXZI", 4) != 0 || version != version_) return false;
+
+  entries_.resize(num_entries);
+  for (uint64_t i = 0; i < num_entries; i++)
+  {
+    Entry &entry = entries_[i];
+    file.read(reinterpret_cast<char*>(&entry.key.high), 8);
+    file.read(reinterpret_cast<char*>(&entry.key.low), 8);
+    file.read(reinterpret_cast<char*>(&entry.offset), 8);
+    file.read(reinterpret_cast<char*>(&entry.size), 4);
+    file.read(reinterpret_cast<char*>(&entry.voxel_type), 2);
+    file.read(reinterpret_cast<char*>(&entry.flags), 2);
+  }
+  if (!file)
+  {
+    entries_.clear();
+    return false;
+  }
+  // Written sorted, but don't trust that blindly - a lookup on an unsorted table silently misses
+  is_sorted_ = std::is_sorted(entries_.begin(), entries_.end(), [](const Entry &a, const Entry &b) { return a.key < b.key; });
+  sort();
+  return true;
+}
+
+
+bool ZoneIndex::writeFile(std::string filepath)
+{
+  sort();
+  // Write next to the original and swap it in so readers never see a half-written index
+  std::string tmp_filepath = filepath + ".tmp";
+  std::ofstream file(tmp_filepath, std::ios::binary);
+  uint32_t version = version_;
+  uint64_t num_entries = entries_.size();
+  file.write("RXZI", 4);
+  file.write(reinterpret_cast<const char*>(&version), 4);
+  file.write(reinterpret_cast<const char*>(&num_entries), 8);
+  for (unsigned int i = 0; i < entries_.size(); i++)
+  {
+    Entry &entry = entries_[i];
+    file.write(reinterpret_cast<const char*>(&entry.key.high), 8);
+    file.write(reinterpret_cast<const char*>(&entry.key.low), 8);
+    file.write(reinterpret_cast<const char*>(&entry.offset), 8);
+    file.write(reinterpret_cast<const char*>(&entry.size), 4);
+    file.write(reinterpret_cast<const char*>(&entry.voxel_type), 2);
+    file.write(reinterpret_cast<const char*>(&entry.flags), 2);
+  }
+  file.close();
+  return file && DurableFile::replace(tmp_filepath, filepath);
+}
+
+
+unsigned int ZoneIndex::scanDirectory(std::string directory, unsigned int path_length)
+{
+  // For worlds without an index - one pass over the directory instead of one probe per zone.
+  // Region archives carry their own headers, but the uniformity of loose .zn files isn't known
+  // without reading them, so those are all left non-uniform.
+  std::vector<std::string> region_paths;
+  std::error_code error;
+  for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(directory, error))
+  {
+    std::string path = entry.path().stem().string();
+    if (path.find_first_not_of("01234567") != std::string::npos) continue;
+    if (entry.path().extension() == ".zn" && path.size() == path_length)
+    {
+      insert(path, 0, entry.file_size(), false, 0);
+    }
+    else if (entry.path().extension() == ".rgn" && path.size() == path_length - RegionArchive::region_depth_)
+    {
+      region_paths.push_back(path);
+    }
+  }
+  // Archived zones are inserted last so they take precedence over any leftover .zn files
+  for (unsigned int i = 0; i < region_paths.size(); i++)
+  {
+    std::vector<RegionArchive::Slot> slots;
+    if (!RegionArchive::readHeader(directory + "/" + region_paths[i] + ".rgn", slots)) continue;
+    for (unsigned int slot = 0; slot < slots.size(); slot++)
+    {
+      if (!slots[slot].isPresent()) continue;
+      insert(RegionArchive::zonePath(region_paths[i], slot), slots[slot].offset, slots[slot].size, slots[slot].isUniform(), slots[slot].voxel_type, true);
+    }
+  }
+  sort();
+  return entries_.size();
+}
+
+
+void ZoneIndex::insert(std::string path, uint64_t offset, uint32_t size, bool is_uniform, uint16_t voxel_type, bool is_archived)
+{
+  Entry entry;
+  entry.key = keyFromPath(path);
+  entry.offset = offset;
+  entry.size = size;
+  entry.voxel_type = is_uniform ? voxel_type : 0;
+  entry.flags = (is_uniform ? UNIFORM : 0) | (is_archived ? ARCHIVED : 0);
+  if (!entries_.empty() && !(entries_.back().key < entry.key)) is_sorted_ = false;
+  entries_.push_back(entry);
+}
+
+
+const ZoneIndex::Entry *ZoneIndex::find(std::string path)
+{
+  sort();
+  Key key = keyFromPath(path);
+  std::vector<Entry>::iterator itr = std::lower_bound(entries_.begin(), entries_.end(), key,
+      [](const Entry &entry, const Key &key) { return entry.key < key; });
+  if (itr == entries_.end() || !(itr->key == key)) return nullptr;
+  return &(*itr);
+}
+
+
+unsigned int ZoneIndex::getNumUniform()
+{
+  unsigned int num_uniform = 0;
+  for (unsigned int i = 0; i < entries_.size(); i++)
+  {
+    if (entries_[i].isUniform()) num_uniform++;
+  }
+  return num_uniform;
+}
+
+
+ZoneIndex::Key ZoneIndex::keyFromPath(std::string path)
+{
+  // The last 21 digits fill the low word, anything before them the high word
+  Key key = {0, 0};
+  unsigned int num_digits = path.size();
+  for (unsigned int i = 0; i < num_digits; i++)
+  {
+    uint64_t digit = path[i] - '0';
+    unsigned int position = num_digits - 1 - i; // Digits from the end
+    if (position < 21) key.low |= digit << (3*position);
+    else key.high |= digit << (3*(position - 21));
+  }
+  return key;
+}
+
+
+std::string ZoneIndex::pathFromKey(Key key, unsigned int path_length)
+{
+  std::string path(path_length, '0');
+  for (unsigned int position = 0; position < path_length; position++)
+  {
+    uint64_t digit = (position < 21) ? (key.low >> (3*position)) & 7 : (key.high >> (3*(position - 21))) & 7;
+    path[path_length - 1 - position] = '0' + digit;
+  }
+  return path;
+}
+
+
+void ZoneIndex::sort()
+{
+  if (is_sorted_) return;
+  std::stable_sort(entries_.begin(), entries_.end(), [](const Entry &a, const Entry &b) { return a.key < b.key; });
+  // Keep the last entry written for a key, so re-inserting a zone updates it
+  std::vector<Entry> unique_entries;
+  for (unsigned int i = 0; i < entries_.size(); i++)
+  {
+    if (i + 1 < entries_.size() && entries_[i].key == entries_[i + 1].key) continue;
+    unique_entries.push_back(entries_[i]);
+  }
+  entries_ = unique_entries;
+  is_sorted_ = true;
+}
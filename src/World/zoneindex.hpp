@@ -0,0 +1,81 @@
+/* ---------------------------------------------------------------- *\
+ * zoneindex.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Per-world table of the zones that exist on disk (zones.idx in the
+ * world directory). Entries are sorted by the zone's Morton key -
+ * the path digits packed 3 bits at a time, which is already a
+ * Morton code because each digit interleaves one bit of x, z and y.
+ * A lookup is a binary search over the table, so the runtime never
+ * has to probe the filesystem to find out whether a zone exists.
+ * Zones that aren't in the index are air.
+ *
+ * File format (little endian):
+ *  "RXZI", uint32 version, uint64 number of entries, then one
+ *  32-byte entry per zone in key order:
+ *   uint64 key high, uint64 key low, uint64 byte offset of the
+ *   zone's runs within its data file (its .zn file, or its region
+ *   archive if ARCHIVED is set), uint32 size in bytes,
+ *   uint16 voxel type (only meaningful for uniform zones),
+ *   uint16 flags
+\* ---------------------------------------------------------------- */
+
+#ifndef ZONEINDEX_HPP
+#define ZONEINDEX_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ZoneIndex
+{
+public:
+  enum Flags : uint16_t
+  {
+    UNIFORM = 1, // The whole zone is voxel_type - its data never needs to be read
+    ARCHIVED = 2 // The zone's data is in its region archive rather than its own .zn file
+  };
+
+  struct Key
+  {
+    uint64_t high;
+    uint64_t low;
+    bool operator<(const Key &other) const { return (high != other.high) ? high < other.high : low < other.low; }
+    bool operator==(const Key &other) const { return high == other.high && low == other.low; }
+  };
+
+  struct Entry
+  {
+    Key key;
+    uint64_t offset;
+    uint32_t size;
+    uint16_t voxel_type;
+    uint16_t flags;
+    bool isUniform() const { return flags & UNIFORM; }
+    bool isArchived() const { return flags & ARCHIVED; }
+  };
+
+  ZoneIndex() {}
+  bool readFile(std::string filepath);
+  bool writeFile(std::string filepath);
+  unsigned int scanDirectory(std::string directory, unsigned int path_length);
+  void insert(std::string path, uint64_t offset, uint32_t size, bool is_uniform, uint16_t voxel_type, bool is_archived = false);
+  const Entry *find(std::string path);
+  unsigned int size() { return entries_.size(); }
+  const Entry &getEntry(unsigned int index) { sort(); return entries_[index]; }
+  unsigned int getNumUniform();
+  static Key keyFromPath(std::string path);
+  static std::string pathFromKey(Key key, unsigned int path_length);
+private:
+  void sort();
+
+  std::vector<Entry> entries_;
+  bool is_sorted_ = true;
+
+  static const uint32_t version_ = 1;
+};
+
+#endif // ZONEINDEX_HPP
@@ -0,0 +1,138 @@
+/* ---------------------------------------------------------------- *\
+ * zonepyramid.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "zonepyramid.hpp"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+
+namespace
+{
+
+// A node's voxels, counted up from its cells
+struct Tally
+{
+  std::map<uint16_t, uint64_t> weights; // Solid types only
+  uint64_t num_solid = 0;
+  uint16_t first_type = 0;
+  bool is_counted = false;
+  bool is_mixed = false;
+
+  void addType(uint16_t type)
+  {
+    if (!is_counted) first_type = type;
+    is_counted = true;
+    is_mixed = is_mixed || (type != first_type);
+  }
+};
+
+} // namespace
+
+
+ZonePyramid::ZonePyramid(uint16_t voxel_type, unsigned int depth)
+{
+  depth_ = depth;
+  nodes_.assign(1, {voxel_type, (uint8_t)((voxel_type == 0) ? 0 : 255), UNIFORM});
+}
+
+
+ZonePyramid::ZonePyramid(const VoxelSet &voxel_set, unsigned int zone_layer, unsigned int depth)
+{
+  depth_ = std::min(depth, getMaxDepth(zone_layer));
+  unsigned int cell_layer = std::min(cell_layer_, zone_layer);
+  uint32_t voxels_per_cell = 1u << (3*cell_layer);
+  uint32_t num_voxels = 1u << (3*zone_layer);
+  // Cells are in the zone's run order too, so the node a cell is in is the top bits of its number
+  unsigned int cell_shift = 3*(zone_layer - cell_layer - depth_);
+  std::vector<Tally> tallies(getNumNodes(depth_));
+  Tally *deepest = &tallies[getLevelOffset(depth_)];
+
+  std::vector<std::pair<uint16_t, uint32_t>> cell_types; // The cell being counted
+  uint32_t index = 0;
+  for (unsigned int run = 0; run < voxel_set.getNumRuns() && index < num_voxels; run++)
+  {
+    uint16_t type = voxel_set.getRunType(run);
+    uint32_t remaining = std::min((uint32_t)voxel_set.getRunLength(run), num_voxels - index);
+    while (remaining > 0)
+    {
+      uint32_t cell_end = (index / voxels_per_cell + 1) * voxels_per_cell;
+      uint32_t count = std::min(remaining, cell_end - index);
+      if (!cell_types.empty() && cell_types.back().first == type) cell_types.back().second += count;
+      else cell_types.push_back({type, count});
+      index += count;
+      remaining -= count;
+      if (index != cell_end) continue;
+
+      uint32_t num_air = 0;
+      for (unsigned int i = 0; i < cell_types.size(); i++)
+      {
+        if (cell_types[i].first == 0) num_air += cell_types[i].second;
+      }
+      uint64_t weight = (num_air > 0 && num_air < voxels_per_cell) ? surface_weight_ : 1;
+      Tally &tally = deepest[(index / voxels_per_cell - 1) >> cell_shift];
+      for (unsigned int i = 0; i < cell_types.size(); i++)
+      {
+        tally.addType(cell_types[i].first);
+        if (cell_types[i].first == 0) continue;
+        tally.num_solid += cell_types[i].second;
+        tally.weights[cell_types[i].first] += weight * cell_types[i].second;
+      }
+      cell_types.clear();
+    }
+  }
+
+  // Each level up is the sum of the one under it
+  for (unsigned int level = depth_; level > 0; level--)
+  {
+    Tally *children = &tallies[getLevelOffset(level)];
+    Tally *parents = &tallies[getLevelOffset(level - 1)];
+    for (uint32_t i = 0; i < (1u << (3*level)); i++)
+    {
+      Tally &parent = parents[i >> 3];
+      parent.addType(children[i].first_type);
+      parent.is_mixed = parent.is_mixed || children[i].is_mixed;
+      parent.num_solid += children[i].num_solid;
+      for (std::map<uint16_t, uint64_t>::iterator itr = children[i].weights.begin(); itr != children[i].weights.end(); itr++)
+      {
+        parent.weights[itr->first] += itr->second;
+      }
+    }
+  }
+
+  nodes_.resize(tallies.size());
+  for (unsigned int level = 0; level <= depth_; level++)
+  {
+    uint64_t node_voxels = 1ULL << (3*(zone_layer - level));
+    for (uint32_t i = 0; i < (1u << (3*level)); i++)
+    {
+      const Tally &tally = tallies[getLevelOffset(level) + i];
+      Node &node = nodes_[getLevelOffset(level) + i];
+      // Ties go to the lowest type, as they do in VoxelSet
+      node.voxel_type = 0;
+      uint64_t heaviest = 0;
+      for (std::map<uint16_t, uint64_t>::const_iterator itr = tally.weights.begin(); itr != tally.weights.end(); itr++)
+      {
+        if (itr->second <= heaviest) continue;
+        heaviest = itr->second;
+        node.voxel_type = itr->first;
+      }
+      if (tally.num_solid == 0) node.coverage = 0;
+      else if (tally.num_solid == node_voxels) node.coverage = 255;
+      else node.coverage = (uint8_t)std::min<uint64_t>(std::max<uint64_t>(tally.num_solid * 255 / node_voxels, 1), 254);
+      node.flags = tally.is_mixed ? 0 : UNIFORM;
+    }
+  }
+  if (nodes_[0].isUniform()) nodes_.resize(1);
+}
+
+
+bool ZonePyramid::setNodes(std::vector<Node> nodes)
+{
+  if (nodes.size() != 1 && nodes.size() != getNumNodes(depth_)) return false;
+  nodes_.swap(nodes);
+  return true;
+}
@@ -0,0 +1,90 @@
+/* ---------------------------------------------------------------- *\
+ * zonepyramid.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * What a zone looks like from far away, worked out once so far LOD
+ * nodes can be drawn without touching its voxels. For the zone's
+ * node and every node under it down to a few layers (the depth),
+ * the pyramid has the type it's drawn as, how much of it is solid
+ * and whether it's all one type - so Octree can build and draw
+ * those nodes, and knows which never need splitting, before the
+ * zone is even decoded.
+ *
+ * The type is the most common solid type like VoxelSet's, except
+ * that voxels near the surface count for more than buried ones, so
+ * a hillside far away is the grass on it rather than the stone
+ * under the grass. The surface is found 8^3 voxels at a time: a
+ * cell with both air and solid in it is on the surface, and its
+ * voxels count surface_weight_ times over.
+ *
+ * ZoneStore keeps a pyramid for each zone it has loaded and caches
+ * them in the world directory (zones.lod) so later runs don't have
+ * to decode the zones again; roxel_worldgen lod builds the file
+ * ahead of time. Uniform and missing zones need no entry.
+ *
+ * File format (little endian):
+ *  "RXLP", uint32 version, uint32 depth, uint64 number of entries,
+ *  then per zone:
+ *   uint64 key high, uint64 key low - as in zones.idx
+ *   uint64 offset, uint32 size, uint16 flags - the zone's index
+ *    entry when the pyramid was built, so one whose zone has been
+ *    rewritten since is rebuilt instead of used
+ *   uint32 number of nodes - getNumNodes(depth), or 1 if the
+ *    whole zone is one type - then the nodes, each uint16 voxel
+ *    type, uint8 coverage, uint8 flags
+\* ---------------------------------------------------------------- */
+
+#ifndef ZONEPYRAMID_HPP
+#define ZONEPYRAMID_HPP
+
+#include <cstdint>
+#include <vector>
+#include "voxelset.hpp"
+
+class ZonePyramid
+{
+public:
+  enum Flags : uint8_t
+  {
+    UNIFORM = 1 // Every voxel under the node is voxel_type
+  };
+
+  struct Node
+  {
+    uint16_t voxel_type; // Drawn as - 0 only if it's all air
+    uint8_t coverage; // Solid voxels out of 255, 255 only if it's all solid and 0 only if it's all air
+    uint8_t flags;
+    bool isUniform() const { return flags & UNIFORM; }
+  };
+
+  ZonePyramid() : ZonePyramid(0, 0) {}
+  ZonePyramid(uint16_t voxel_type, unsigned int depth); // A zone that's all voxel_type
+  ZonePyramid(const VoxelSet &voxel_set, unsigned int zone_layer, unsigned int depth);
+  unsigned int getDepth() const { return depth_; }
+  // The node depth layers under the zone's, numbered by its path's last depth digits read as one
+  // base 8 number
+  const Node &getNode(unsigned int depth, uint32_t index) const
+  {
+    if (nodes_.size() == 1) return nodes_[0];
+    return nodes_[getLevelOffset(depth) + index];
+  }
+  const std::vector<Node> &getNodes() const { return nodes_; } // Every level, the zone's node first
+  bool setNodes(std::vector<Node> nodes); // As read back from getNodes() - false if there aren't the right number
+  static unsigned int getNumNodes(unsigned int depth) { return getLevelOffset(depth + 1); }
+  static unsigned int getMaxDepth(unsigned int zone_layer) { return (zone_layer > cell_layer_) ? zone_layer - cell_layer_ : 0; }
+  uint64_t getMemoryUsage() const { return sizeof(ZonePyramid) + nodes_.capacity()*sizeof(Node); }
+
+  static const unsigned int default_depth_ = 4;
+  static const unsigned int surface_weight_ = 16;
+private:
+  static unsigned int getLevelOffset(unsigned int depth) { return ((1u << (3*depth)) - 1) / 7; } // 1 + 8 + ... + 8^(depth-1)
+
+  unsigned int depth_;
+  std::vector<Node> nodes_; // Just one if the whole zone is one type
+  static const unsigned int cell_layer_ = 3; // Cells the surface is looked for in
+};
+
+#endif // ZONEPYRAMID_HPP
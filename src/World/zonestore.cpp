@@ -0,0 +1,343 @@
+/* ---------------------------------------------------------------- *\
+ * zonestore.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "zonestore.hpp"
+#include "durablefile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+
+void ZoneStore::open(std::string directory, ZoneAddress zone_address)
+{
+  flushWrites(true); // Edits to the last world opened
+  journal_.close();
+  pending_zones_.clear();
+  zone_writer_.setDirectory(directory);
+  directory_ = directory;
+  voxels_per_zone_ = zone_address.getVoxelsPerZone();
+  zone_layer_ = zone_address.getZoneDepth();
+  path_length_ = zone_address.getPathLength();
+  region_archives_.clear();
+  zone_cache_.clear();
+  if (!zone_index_.readFile(directory_ + "/zones.idx"))
+  {
+    unsigned int num_zones = zone_index_.scanDirectory(directory_, zone_address.getPathLength());
+    std::cout << "No zone index in " << directory_ << ", found " << num_zones << " zones by scanning (run roxel_worldgen index to create one)" << std::endl;
+  }
+  readPyramids();
+  std::vector<EditJournal::Record> records;
+  if (!journal_.open(directory_ + "/edits.jnl", records)) std::cout << "Edits to " << directory_ << " won't survive a crash" << std::endl;
+  replayJournal(records);
+}
+
+
+void ZoneStore::replayJournal(std::vector<EditJournal::Record> &records)
+{
+  // Edits since the last checkpoint, some of which may already be on disk - setting them again is
+  // harmless. They're already journaled, so they go straight to pending_zones_.
+  if (records.empty()) return;
+  for (unsigned int i = 0; i < records.size(); i++)
+  {
+    VoxelSet voxel_set = loadZone(records[i].path);
+    voxel_set.setRanges(records[i].ranges);
+    PendingZone &pending = pending_zones_[records[i].path];
+    if (pending.version == 0) pending.first_sequence = i + 1;
+    pending.voxel_set = voxel_set;
+    pending.version = next_version_++;
+    pending.pyramid.reset();
+  }
+  std::cout << "Replayed " << records.size() << " edits to " << pending_zones_.size() << " zones from " << directory_ << "/edits.jnl" << std::endl;
+}
+
+
+VoxelSet ZoneStore::loadZone(std::string path)
+{
+  std::map<std::string, PendingZone>::iterator pending = pending_zones_.find(path);
+  if (pending != pending_zones_.end()) return pending->second.voxel_set;
+  const ZoneIndex::Entry *entry = zone_index_.find(path);
+  if (entry == nullptr)
+  {
+    // Not on disk, so it's air
+    return uniformZone(0);
+  }
+  if (entry->isUniform())
+  {
+    // No need to touch the file
+    return uniformZone(entry->voxel_type);
+  }
+
+  VoxelSet voxel_set(voxels_per_zone_);
+  if (zone_cache_.find(entry->key, &voxel_set)) return voxel_set;
+  // The zone's file (or its slot in the archive) is the authority on where its data is - the index
+  // can be from before a crash that came after the zone was rewritten, which the journal replay fixes
+  if (entry->isArchived())
+  {
+    std::shared_ptr<RegionArchive> archive = getArchive(RegionArchive::regionPath(path));
+    const char *data = nullptr;
+    if (archive->isOpen())
+    {
+      const RegionArchive::Slot &slot = archive->getSlot(RegionArchive::slotFromPath(path));
+      if (!slot.isPresent()) return uniformZone(0);
+      if (slot.isUniform()) return uniformZone(slot.voxel_type);
+      data = archive->getData(slot.offset, slot.size);
+      if (data != nullptr) voxel_set.readMemory(data, slot.size);
+    }
+    if (data == nullptr)
+    {
+      std::cout << "Zone " << path << " is missing from its region archive" << std::endl;
+      return uniformZone(0);
+    }
+  }
+  else
+  {
+    voxel_set.readFile(directory_ + "/" + path + ".zn");
+  }
+  zone_cache_.insert(entry->key, voxel_set);
+  return voxel_set;
+}
+
+
+VoxelSet ZoneStore::uniformZone(uint16_t voxel_type)
+{
+  // Every uniform zone of a type views the same run
+  VoxelSet voxel_set(voxels_per_zone_);
+  voxel_set.setUniform(voxel_type);
+  return voxel_set;
+}
+
+
+std::shared_ptr<const ZonePyramid> ZoneStore::loadPyramid(std::string path)
+{
+  std::map<std::string, PendingZone>::iterator pending = pending_zones_.find(path);
+  if (pending != pending_zones_.end())
+  {
+    if (pending->second.pyramid == nullptr) pending->second.pyramid = buildPyramid(pending->second.voxel_set);
+    return pending->second.pyramid;
+  }
+  const ZoneIndex::Entry *entry = zone_index_.find(path);
+  if (entry == nullptr || entry->isUniform())
+  {
+    uint16_t voxel_type = (entry == nullptr) ? 0 : entry->voxel_type;
+    std::shared_ptr<const ZonePyramid> &pyramid = uniform_pyramids_[voxel_type];
+    if (pyramid == nullptr) pyramid = std::make_shared<ZonePyramid>(voxel_type, std::min(pyramid_depth_, ZonePyramid::getMaxDepth(zone_layer_)));
+    return pyramid;
+  }
+  std::map<ZoneIndex::Key, CachedPyramid>::iterator cached = pyramids_.find(entry->key);
+  if (cached != pyramids_.end() && cached->second.matches(*entry)) return cached->second.pyramid;
+
+  CachedPyramid built = {buildPyramid(loadZone(path)), entry->offset, entry->size, entry->flags};
+  pyramids_[entry->key] = built;
+  pyramids_changed_ = true;
+  return built.pyramid;
+}
+
+
+unsigned int ZoneStore::buildPyramids()
+{
+  uint64_t num_built = num_pyramids_built_;
+  for (unsigned int i = 0; i < zone_index_.size(); i++)
+  {
+    const ZoneIndex::Entry &entry = zone_index_.getEntry(i);
+    if (!entry.isUniform()) loadPyramid(ZoneIndex::pathFromKey(entry.key, path_length_));
+  }
+  if (pyramids_changed_ && writePyramids()) pyramids_changed_ = false;
+  return num_pyramids_built_ - num_built;
+}
+
+
+std::shared_ptr<const ZonePyramid> ZoneStore::buildPyramid(const VoxelSet &voxel_set)
+{
+  num_pyramids_built_++;
+  return std::make_shared<ZonePyramid>(voxel_set, zone_layer_, pyramid_depth_);
+}
+
+
+std::shared_ptr<RegionArchive> ZoneStore::getArchive(std::string region_path)
+{
+  std::map<std::string, std::shared_ptr<RegionArchive>>::iterator itr = region_archives_.find(region_path);
+  if (itr != region_archives_.end()) return itr->second;
+  std::shared_ptr<RegionArchive> archive = std::make_shared<RegionArchive>(directory_ + "/" + region_path + ".rgn");
+  region_archives_[region_path] = archive;
+  return archive;
+}
+
+
+void ZoneStore::saveZone(std::string path, const VoxelSet &voxel_set, const std::vector<VoxelRange> &ranges, std::shared_ptr<const ZonePyramid> pyramid)
+{
+  uint64_t sequence = journal_.append(path, ranges);
+  PendingZone &pending = pending_zones_[path];
+  if (pending.version == 0) pending.first_sequence = sequence;
+  pending.voxel_set = voxel_set;
+  pending.version = next_version_++;
+  pending.pyramid = pyramid;
+  zone_cache_.erase(ZoneIndex::keyFromPath(path)); // Stale as of now
+}
+
+
+void ZoneStore::flushWrites(bool wait)
+{
+  applyWrites();
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  bool is_due = (now - last_write_ >= std::chrono::milliseconds(checkpoint_interval_ms_) || pending_zones_.size() >= max_pending_zones_);
+  if (!wait && !is_due) return;
+
+  std::vector<ZoneWriter::Job> batch;
+  for (std::map<std::string, PendingZone>::iterator itr = pending_zones_.begin(); itr != pending_zones_.end(); itr++)
+  {
+    if (itr->second.submitted_version == itr->second.version) continue;
+    batch.push_back({itr->first, itr->second.voxel_set, itr->second.version});
+    itr->second.submitted_version = itr->second.version;
+  }
+  if (!batch.empty())
+  {
+    zone_writer_.submit(std::move(batch));
+    last_write_ = now;
+  }
+  if (wait)
+  {
+    zone_writer_.wait();
+    applyWrites();
+    zone_writer_.wait(); // For the index
+    journal_.commit(); // And the checkpoint after it
+    if (pyramids_changed_ && writePyramids()) pyramids_changed_ = false;
+  }
+}
+
+
+void ZoneStore::applyWrites()
+{
+  std::vector<ZoneWriter::Result> results = zone_writer_.collect();
+  if (results.empty()) return;
+  for (unsigned int i = 0; i < results.size(); i++)
+  {
+    ZoneWriter::Result &result = results[i];
+    std::map<std::string, PendingZone>::iterator pending = pending_zones_.find(result.path);
+    if (!result.written)
+    {
+      // Keep the edited copy, and try again with the next batch
+      if (pending != pending_zones_.end() && pending->second.version == result.version) pending->second.submitted_version = 0;
+      continue;
+    }
+    zone_index_.insert(result.path, result.offset, result.size, result.is_uniform, result.voxel_type, result.is_archived);
+    // The mapping ends where the archive did, before the new data
+    if (result.is_archived) region_archives_.erase(RegionArchive::regionPath(result.path));
+    // Pyramids are matched to what's on disk by the zone's new index entry
+    ZoneIndex::Key key = ZoneIndex::keyFromPath(result.path);
+    CachedPyramid written = {nullptr, result.offset, result.size, (uint16_t)((result.is_uniform ? ZoneIndex::UNIFORM : 0) | (result.is_archived ? ZoneIndex::ARCHIVED : 0))};
+    std::map<ZoneIndex::Key, CachedPyramid>::iterator cached = pyramids_.find(key);
+    if (pending != pending_zones_.end() && pending->second.version == result.version) written.pyramid = pending->second.pyramid;
+    else if (pending == pending_zones_.end() && cached != pyramids_.end()) written.pyramid = cached->second.pyramid; // Only moved
+    if (written.pyramid != nullptr && !result.is_uniform)
+    {
+      pyramids_[key] = written;
+      pyramids_changed_ = true;
+    }
+    else if (cached != pyramids_.end())
+    {
+      pyramids_.erase(cached);
+      pyramids_changed_ = true;
+    }
+    // Edited again since - that copy is still the only one that's current
+    if (pending != pending_zones_.end() && pending->second.version == result.version) pending_zones_.erase(pending);
+  }
+  // The journal can drop everything before the oldest edit that isn't on disk. A zone edited again
+  // while its write was in flight keeps its first_sequence, so it's held a little longer than needed.
+  uint64_t sequence = journal_.getLastSequence();
+  for (std::map<std::string, PendingZone>::iterator itr = pending_zones_.begin(); itr != pending_zones_.end(); itr++)
+  {
+    sequence = std::min(sequence, itr->second.first_sequence - 1);
+  }
+  zone_writer_.submitIndex(zone_index_, &journal_, sequence);
+}
+
+
+void ZoneStore::readPyramids()
+{
+  pyramids_.clear();
+  uniform_pyramids_.clear();
+  pyramids_changed_ = false;
+  num_pyramids_built_ = 0;
+  num_pyramids_read_ = 0;
+  std::ifstream file(directory_ + "/zones.lod", std::ios::binary);
+  if (!file) return;
+
+  char magic[4];
+  uint32_t version, depth;
+  uint64_t num_entries;
+  file.read(magic, 4);
+  file.read(reinterpret_cast<char*>(&version), 4);
+  file.read(reinterpret_cast<char*>(&depth), 4);
+  file.read(reinterpret_cast<char*>(&num_entries), 8);
+  // Built to a different depth, they'd all have to be rebuilt anyway
+  if (!file || strncmp(magic, "RXLP", 4) != 0 || version != pyramid_version_ || depth != std::min(pyramid_depth_, ZonePyramid::getMaxDepth(zone_layer_))) return;
+
+  for (uint64_t i = 0; i < num_entries; i++)
+  {
+    ZoneIndex::Key key;
+    CachedPyramid cached;
+    uint32_t num_nodes;
+    file.read(reinterpret_cast<char*>(&key.high), 8);
+    file.read(reinterpret_cast<char*>(&key.low), 8);
+    file.read(reinterpret_cast<char*>(&cached.offset), 8);
+    file.read(reinterpret_cast<char*>(&cached.size), 4);
+    file.read(reinterpret_cast<char*>(&cached.flags), 2);
+    file.read(reinterpret_cast<char*>(&num_nodes), 4);
+    if (!file || num_nodes > ZonePyramid::getNumNodes(depth)) break;
+    std::vector<ZonePyramid::Node> nodes(num_nodes);
+    for (uint32_t j = 0; j < num_nodes; j++)
+    {
+      file.read(reinterpret_cast<char*>(&nodes[j].voxel_type), 2);
+      file.read(reinterpret_cast<char*>(&nodes[j].coverage), 1);
+      file.read(reinterpret_cast<char*>(&nodes[j].flags), 1);
+    }
+    std::shared_ptr<ZonePyramid> pyramid = std::make_shared<ZonePyramid>(0, depth);
+    if (!file || !pyramid->setNodes(nodes)) break;
+    cached.pyramid = pyramid;
+    pyramids_[key] = cached;
+  }
+  // Whatever was read before a bad entry is still good - the rest gets rebuilt
+  num_pyramids_read_ = pyramids_.size();
+  if (num_pyramids_read_ != num_entries) std::cout << "Only read " << num_pyramids_read_ << " of " << num_entries << " LOD pyramids from " << directory_ << "/zones.lod" << std::endl;
+}
+
+
+bool ZoneStore::writePyramids()
+{
+  // Written next to the original and swapped in, like the index
+  std::string filepath = directory_ + "/zones.lod";
+  std::ofstream file(filepath + ".tmp", std::ios::binary);
+  uint32_t version = pyramid_version_;
+  uint32_t depth = std::min(pyramid_depth_, ZonePyramid::getMaxDepth(zone_layer_));
+  uint64_t num_entries = pyramids_.size();
+  file.write("RXLP", 4);
+  file.write(reinterpret_cast<const char*>(&version), 4);
+  file.write(reinterpret_cast<const char*>(&depth), 4);
+  file.write(reinterpret_cast<const char*>(&num_entries), 8);
+  for (std::map<ZoneIndex::Key, CachedPyramid>::iterator itr = pyramids_.begin(); itr != pyramids_.end(); itr++)
+  {
+    const CachedPyramid &cached = itr->second;
+    const std::vector<ZonePyramid::Node> &nodes = cached.pyramid->getNodes();
+    uint32_t num_nodes = nodes.size();
+    file.write(reinterpret_cast<const char*>(&itr->first.high), 8);
+    file.write(reinterpret_cast<const char*>(&itr->first.low), 8);
+    file.write(reinterpret_cast<const char*>(&cached.offset), 8);
+    file.write(reinterpret_cast<const char*>(&cached.size), 4);
+    file.write(reinterpret_cast<const char*>(&cached.flags), 2);
+    file.write(reinterpret_cast<const char*>(&num_nodes), 4);
+    for (uint32_t j = 0; j < num_nodes; j++)
+    {
+      file.write(reinterpret_cast<const char*>(&nodes[j].voxel_type), 2);
+      file.write(reinterpret_cast<const char*>(&nodes[j].coverage), 1);
+      file.write(reinterpret_cast<const char*>(&nodes[j].flags), 1);
+    }
+  }
+  file.close();
+  if (file && DurableFile::replace(filepath + ".tmp", filepath)) return true;
+  std::cout << "Failed to write " << filepath << std::endl;
+  return false;
+}
@@ -0,0 +1,129 @@
+/* ---------------------------------------------------------------- *\
+ * zonestore.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Where Octree gets its zones from. Looks the zone up in the world's
+ * zone index and then builds it from the index alone (missing or
+ * uniform zones), from a slice of its mapped region archive, or
+ * from its own .zn file for worlds that haven't been packed.
+ * Decoded zones are kept in a ZoneCache so reloading a recently
+ * unloaded zone doesn't touch the disk.
+ *
+ * Edited zones are saved through saveZone(), which appends the edit
+ * to the world's EditJournal (edits.jnl) - that one append is what
+ * makes the edit durable. The zones themselves are written back by a
+ * ZoneWriter in the background every checkpoint_interval_ms_ (or
+ * sooner if max_pending_zones_ pile up), and once they and the zone
+ * index are on disk the journal is checkpointed past their edits.
+ * Until a zone's write has landed, loadZone() hands out the edited
+ * copy instead of what's on disk. Opening a world replays whatever
+ * is left in its journal over the zones on disk, so edits made
+ * since the last checkpoint survive a crash.
+ *
+ * Each zone's ZonePyramid (see zonepyramid.hpp) comes from here too.
+ * They're read from zones.lod when the world is opened, built from
+ * the zone the first time one that isn't there (or is out of date)
+ * is asked for, rebuilt when the zone is saved, and written back to
+ * zones.lod whenever flushWrites() waits.
+\* ---------------------------------------------------------------- */
+
+#ifndef ZONESTORE_HPP
+#define ZONESTORE_HPP
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include "editjournal.hpp"
+#include "regionarchive.hpp"
+#include "voxelset.hpp"
+#include "zonecache.hpp"
+#include "zoneaddress.hpp"
+#include "zoneindex.hpp"
+#include "zonepyramid.hpp"
+#include "zonewriter.hpp"
+
+class ZoneStore
+{
+public:
+  ZoneStore() {}
+  void open(std::string directory, ZoneAddress zone_address);
+  VoxelSet loadZone(std::string path); // path is relative to the world directory, without an extension
+  std::shared_ptr<const ZonePyramid> loadPyramid(std::string path); // Decodes the zone only if there isn't one yet
+  // Pyramids built from then on go this deep (see ZonePyramid) - the ones in zones.lod are only used
+  // if they're as deep. Set it before open().
+  void setPyramidDepth(unsigned int pyramid_depth) { pyramid_depth_ = pyramid_depth; }
+  unsigned int getPyramidDepth() { return pyramid_depth_; }
+  uint64_t getNumPyramidsBuilt() { return num_pyramids_built_; } // Since the world was opened
+  // Builds every zone's pyramid that isn't already current and writes zones.lod, returning how many
+  // it built
+  unsigned int buildPyramids();
+  unsigned int getNumPyramidsRead() { return num_pyramids_read_; } // From zones.lod when it was opened
+  ZoneIndex &getIndex() { return zone_index_; }
+  ZoneCache &getCache() { return zone_cache_; }
+  void evictZone(std::string path) { zone_cache_.erase(ZoneIndex::keyFromPath(path)); } // From the cache, so its runs can go
+  void closeArchives() { region_archives_.clear(); }
+  // voxel_set is the zone with ranges (in its run order) already set - ranges is what gets journaled.
+  // pyramid is the edited zone's, if the caller has already built it.
+  void saveZone(std::string path, const VoxelSet &voxel_set, const std::vector<VoxelRange> &ranges, std::shared_ptr<const ZonePyramid> pyramid = nullptr);
+  // Applies the writes that have finished and, once checkpoint_interval_ms_ has passed since the
+  // last batch, hands the zones saved since then to the writer. With wait, sends everything now and
+  // returns once it's all on disk and the journal is checkpointed.
+  void flushWrites(bool wait = false);
+  bool commitJournal() { return journal_.commit(); } // Blocks until every edit saved so far is durable, false if the write failed
+  EditJournal &getJournal() { return journal_; }
+  unsigned int getNumUnwritten() { return pending_zones_.size(); } // Saved, but not on disk yet
+  void setCheckpointInterval(unsigned int checkpoint_interval_ms) { checkpoint_interval_ms_ = checkpoint_interval_ms; }
+private:
+  struct PendingZone
+  {
+    VoxelSet voxel_set;
+    uint64_t version = 0; // Of the last save
+    uint64_t submitted_version = 0; // Of the last save handed to the writer, 0 for none
+    uint64_t first_sequence = 0; // Journal record of the oldest edit not on disk yet
+    std::shared_ptr<const ZonePyramid> pyramid; // Built when it's first asked for
+  };
+  struct CachedPyramid
+  {
+    std::shared_ptr<const ZonePyramid> pyramid;
+    // The zone's index entry it was built from
+    uint64_t offset;
+    uint32_t size;
+    uint16_t flags;
+    bool matches(const ZoneIndex::Entry &entry) const { return entry.offset == offset && entry.size == size && entry.flags == flags; }
+  };
+  std::shared_ptr<RegionArchive> getArchive(std::string region_path);
+  VoxelSet uniformZone(uint16_t voxel_type);
+  void applyWrites();
+  void replayJournal(std::vector<EditJournal::Record> &records);
+  std::shared_ptr<const ZonePyramid> buildPyramid(const VoxelSet &voxel_set);
+  void readPyramids();
+  bool writePyramids();
+
+  std::string directory_;
+  uint64_t voxels_per_zone_ = 0;
+  unsigned int zone_layer_ = 0;
+  unsigned int path_length_ = 0;
+  ZoneIndex zone_index_;
+  ZoneCache zone_cache_;
+  std::map<std::string, std::shared_ptr<RegionArchive>> region_archives_; // Stay mapped until closed
+  std::map<std::string, PendingZone> pending_zones_; // By path
+  uint64_t next_version_ = 1;
+  std::map<ZoneIndex::Key, CachedPyramid> pyramids_; // Of zones that aren't pending
+  std::map<uint16_t, std::shared_ptr<const ZonePyramid>> uniform_pyramids_; // By type, shared by every uniform zone
+  unsigned int pyramid_depth_ = ZonePyramid::default_depth_;
+  bool pyramids_changed_ = false; // Since zones.lod was read or written
+  uint64_t num_pyramids_built_ = 0;
+  unsigned int num_pyramids_read_ = 0;
+  static const uint32_t pyramid_version_ = 1;
+  EditJournal journal_;
+  ZoneWriter zone_writer_; // After journal_, so it's finished with the journal before it closes
+  unsigned int checkpoint_interval_ms_ = 5000;
+  static const unsigned int max_pending_zones_ = 64;
+  std::chrono::steady_clock::time_point last_write_;
+};
+
+#endif // ZONESTORE_HPP
@@ -0,0 +1,184 @@
+/* ---------------------------------------------------------------- *\
+ * zonewriter.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+#include "zonewriter.hpp"
+#include "durablefile.hpp"
+#include "editjournal.hpp"
+#include "regionarchive.hpp"
+#include "profiler.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <map>
+
+
+ZoneWriter::~ZoneWriter()
+{
+  if (!thread_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_stopping_ = true;
+  }
+  work_ready_.notify_all();
+  thread_.join();
+}
+
+
+void ZoneWriter::setDirectory(std::string directory)
+{
+  wait(); // Anything already submitted belongs to the old directory
+  std::lock_guard<std::mutex> lock(mutex_);
+  directory_ = directory;
+}
+
+
+void ZoneWriter::submit(std::vector<Job> batch)
+{
+  if (batch.empty()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    batches_.push_back(std::move(batch));
+    if (!thread_.joinable()) thread_ = std::thread(&ZoneWriter::run, this);
+  }
+  work_ready_.notify_one();
+}
+
+
+void ZoneWriter::submitIndex(const ZoneIndex &zone_index, EditJournal *journal, uint64_t journal_sequence)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    zone_index_.reset(new ZoneIndex(zone_index));
+    journal_ = journal;
+    journal_sequence_ = journal_sequence;
+    if (!thread_.joinable()) thread_ = std::thread(&ZoneWriter::run, this);
+  }
+  work_ready_.notify_one();
+}
+
+
+std::vector<ZoneWriter::Result> ZoneWriter::collect()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Result> results;
+  results.swap(results_);
+  return results;
+}
+
+
+void ZoneWriter::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  work_done_.wait(lock, [this]() { return batches_.empty() && zone_index_ == nullptr && !is_busy_; });
+}
+
+
+bool ZoneWriter::isIdle()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return batches_.empty() && zone_index_ == nullptr && !is_busy_;
+}
+
+
+void ZoneWriter::run()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true)
+  {
+    work_ready_.wait(lock, [this]() { return is_stopping_ || !batches_.empty() || zone_index_ != nullptr; });
+    if (batches_.empty() && zone_index_ == nullptr) break; // Stopping, and nothing left
+    is_busy_ = true;
+    std::vector<Result> results;
+    if (!batches_.empty())
+    {
+      // Batches go first, so an index never points at data that isn't written yet
+      std::vector<Job> batch = std::move(batches_.front());
+      batches_.pop_front();
+      lock.unlock();
+      writeBatch(batch, results);
+      Anthrax::Profiler::addCounter(Anthrax::Profiler::ZONES_WRITTEN, batch.size());
+    }
+    else
+    {
+      std::unique_ptr<ZoneIndex> zone_index = std::move(zone_index_);
+      EditJournal *journal = journal_;
+      uint64_t journal_sequence = journal_sequence_;
+      lock.unlock();
+      // The zones and the index pointing at them are on disk, so the journal doesn't need them
+      if (zone_index->writeFile(directory_ + "/zones.idx") && journal != nullptr && journal_sequence > 0) journal->checkpoint(journal_sequence);
+    }
+    lock.lock();
+    results_.insert(results_.end(), results.begin(), results.end());
+    is_busy_ = false;
+    work_done_.notify_all();
+  }
+}
+
+
+void ZoneWriter::writeBatch(std::vector<Job> &batch, std::vector<Result> &results)
+{
+  // One append per region archive, however many of its zones are in the batch
+  std::map<std::string, std::vector<Job*>> regions;
+  for (unsigned int i = 0; i < batch.size(); i++)
+  {
+    std::string region_path = RegionArchive::regionPath(batch[i].path);
+    if (std::filesystem::exists(directory_ + "/" + region_path + ".rgn")) regions[region_path].push_back(&batch[i]);
+    else writeLoose(batch[i], results);
+  }
+  for (std::map<std::string, std::vector<Job*>>::iterator itr = regions.begin(); itr != regions.end(); itr++)
+  {
+    writeRegion(itr->first, itr->second, results);
+  }
+}
+
+
+void ZoneWriter::writeRegion(std::string region_path, std::vector<Job*> &jobs, std::vector<Result> &results)
+{
+  std::string filepath = directory_ + "/" + region_path + ".rgn";
+  std::vector<RegionArchive::ZoneData> zones;
+  for (unsigned int i = 0; i < jobs.size(); i++)
+  {
+    RegionArchive::ZoneData zone;
+    zone.slot = RegionArchive::slotFromPath(jobs[i]->path);
+    zone.is_uniform = jobs[i]->voxel_set.isUniform();
+    zone.voxel_type = jobs[i]->voxel_set.getVoxelType();
+    if (!zone.is_uniform) zone.data = jobs[i]->voxel_set.toBytes();
+    zones.push_back(zone);
+  }
+  // Compacting picks the offsets, so they're read back from the new header
+  std::vector<RegionArchive::Slot> slots;
+  bool written = RegionArchive::replaceZones(filepath, zones, slots);
+  if (!written) std::cout << "Failed to write " << jobs.size() << " zones to " << filepath << std::endl;
+  std::vector<bool> is_job(RegionArchive::num_slots_, false);
+  for (unsigned int i = 0; i < jobs.size(); i++)
+  {
+    Result result = {jobs[i]->path, jobs[i]->version, written, 0, 0, zones[i].is_uniform, zones[i].voxel_type, true};
+    if (written)
+    {
+      result.offset = slots[zones[i].slot].offset;
+      result.size = slots[zones[i].slot].size;
+    }
+    results.push_back(result);
+    is_job[zones[i].slot] = true;
+  }
+  if (!written) return;
+  // Compacting moved the rest of the region's zones too
+  for (unsigned int slot = 0; slot < RegionArchive::num_slots_; slot++)
+  {
+    if (is_job[slot] || !slots[slot].isPresent()) continue;
+    results.push_back({RegionArchive::zonePath(region_path, slot), 0, true, slots[slot].offset, slots[slot].size, slots[slot].isUniform(), slots[slot].voxel_type, true});
+  }
+}
+
+
+void ZoneWriter::writeLoose(Job &job, std::vector<Result> &results)
+{
+  // Written next to the original and swapped in, so a crash never leaves half a zone
+  std::string filepath = directory_ + "/" + job.path + ".zn";
+  job.voxel_set.writeFile(filepath + ".tmp");
+  bool written = DurableFile::replace(filepath + ".tmp", filepath);
+  if (!written) std::cout << "Failed to write " << filepath << std::endl;
+  results.push_back({job.path, job.version, written, 0, 6*job.voxel_set.getNumRuns(), job.voxel_set.isUniform(), job.voxel_set.getVoxelType(), false});
+}
@@ -0,0 +1,93 @@
+/* ---------------------------------------------------------------- *\
+ * zonewriter.hpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Writes edited zones back to the world directory on a background
+ * thread, so saving never holds up a frame. ZoneStore hands it
+ * batches of zones; each batch is written in one go - zones whose
+ * region archive exists go into a compacted copy of it (one per
+ * region per batch), the rest are written to their own .zn file,
+ * all renamed into place once on disk (see durablefile.hpp) - and
+ * the results are handed back through collect() for ZoneStore to
+ * point its zone index at.
+ *
+ * The writer only touches files. The zone index it's given to save
+ * is its own copy, written after every batch submitted before it,
+ * and once it's on disk the edit journal is checkpointed.
+\* ---------------------------------------------------------------- */
+
+#ifndef ZONEWRITER_HPP
+#define ZONEWRITER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "voxelset.hpp"
+#include "zoneindex.hpp"
+
+class EditJournal;
+
+class ZoneWriter
+{
+public:
+  struct Job
+  {
+    std::string path; // Relative to the world directory, without an extension
+    VoxelSet voxel_set;
+    uint64_t version; // Handed back in the result, so the caller can tell which edit landed - never 0
+  };
+
+  struct Result
+  {
+    std::string path;
+    uint64_t version; // 0 for zones that weren't in the batch but were moved within their region archive
+    bool written;
+    // Where the zone ended up, for its zone index entry
+    uint64_t offset;
+    uint32_t size;
+    bool is_uniform;
+    uint16_t voxel_type;
+    bool is_archived;
+  };
+
+  ZoneWriter() {}
+  ~ZoneWriter(); // Finishes everything submitted first
+  ZoneWriter(const ZoneWriter&) = delete;
+  ZoneWriter& operator=(const ZoneWriter&) = delete;
+  void setDirectory(std::string directory);
+  void submit(std::vector<Job> batch);
+  // Replaces any index still waiting to be written. Once it's on disk, journal is checkpointed at
+  // journal_sequence (0 for none).
+  void submitIndex(const ZoneIndex &zone_index, EditJournal *journal = nullptr, uint64_t journal_sequence = 0);
+  std::vector<Result> collect(); // Results of the batches finished since the last call
+  void wait(); // Until everything submitted is on disk
+  bool isIdle();
+private:
+  void run();
+  void writeBatch(std::vector<Job> &batch, std::vector<Result> &results);
+  void writeRegion(std::string region_path, std::vector<Job*> &jobs, std::vector<Result> &results);
+  void writeLoose(Job &job, std::vector<Result> &results);
+
+  std::string directory_;
+  std::thread thread_; // Started on the first submit
+  std::mutex mutex_;
+  std::condition_variable work_ready_;
+  std::condition_variable work_done_;
+  std::deque<std::vector<Job>> batches_;
+  std::unique_ptr<ZoneIndex> zone_index_; // Waiting to be written
+  EditJournal *journal_ = nullptr;
+  uint64_t journal_sequence_ = 0;
+  std::vector<Result> results_;
+  bool is_busy_ = false;
+  bool is_stopping_ = false;
+};
+
+#endif // ZONEWRITER_HPP
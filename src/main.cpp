@@ -4,9 +4,11 @@
  * Date Created: 2023-12-02
 \* ---------------------------------------------------------------- */
 #include <stdlib.h>
+#include <cmath>
 #include <iostream>
 
 #include "anthrax.hpp"
+#include "framearena.hpp"
 #include "Player/player.hpp"
 #include "World/world.hpp"
 
@@ -37,6 +39,7 @@ int main()
   //world.getCubes();
 
   Player player = Player(anthrax_handle_);
+  player.setCollider(world.getCollider());
   //player.updateForce("gravity", Anthrax::vec3<float>(0.0, -9.8, 0.0));
 
 #ifndef WIN32
@@ -52,17 +55,21 @@ int main()
     if (time_now-time_frame_start >= 1)
     {
       time(&time_frame_start);
-      std::cout << "Framerate: " << num_frames << " FPS" << std::endl;
+      std::cout << "Framerate: " << num_frames << " FPS (" << Anthrax::Profiler::getAverageFrameTime(num_frames) << " ms/frame)" << std::endl;
       num_frames = 0;
     }
     num_frames++;
 #endif
-    Anthrax::vec3<int64_t> position = Anthrax::vec3<int64_t>(player.getPosition().getX(), player.getPosition().getY(), player.getPosition().getZ());
-    world.loadAreaRecursive(position);
+    Anthrax::Profiler::beginFrame();
+    Anthrax::vec3<double> player_position = player.getPosition();
+    Anthrax::vec3<int64_t> position = Anthrax::vec3<int64_t>(floor(player_position.getX()), floor(player_position.getY()), floor(player_position.getZ()));
+    world.loadArea(position);
 
     window_closed = anthrax_handle_->renderFrame();
     player.processInput();
-    player.update();
+    player.update(anthrax_handle_->getTimeSinceLastFrame());
+    Anthrax::Profiler::endFrame();
+    Anthrax::FrameArena::getFrameArena().reset();
   }
 
   delete anthrax_handle_;
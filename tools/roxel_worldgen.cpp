@@ -0,0 +1,308 @@
+/* ---------------------------------------------------------------- *\
+ * roxel_worldgen.cpp
+ * Author: Gavin Ralston
+ * Date Created: 2026-10-19
+\* ---------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------- *\
+ * Offline world tool. All commands are multi-threaded (one zone
+ * per job) and finish by writing zones.idx, the index of zones on
+ * disk that the runtime uses instead of probing for files:
+ *
+ *  generate DIR  - procedurally generates zones (noise heightmap
+ *                  terrain plus caves) straight into DIR as .zn files
+ *  compact DIR   - re-encodes the existing zones in DIR, merging
+ *                  adjacent runs of the same type and dropping empty
+ *                  runs, and drops superseded data from its region
+ *                  archives
+ *  pack DIR      - converts the .zn files in DIR into region
+ *                  archives (.rgn), deleting them with --delete
+ *  index DIR     - only rebuilds the index for the zones in DIR
+ *  lod DIR       - builds the LOD pyramid of every zone in DIR into
+ *                  zones.lod (see zonepyramid.hpp), which the game
+ *                  otherwise builds as it first loads each zone. One
+ *                  thread, since it goes through ZoneStore, and it
+ *                  uses the index rather than writing it.
+ *
+ * Zone paths and voxel ordering come from ZoneAddress so they
+ * always match what Octree expects.
+\* ---------------------------------------------------------------- */
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "World/regionarchive.hpp"
+#include "World/workerpool.hpp"
+#include "World/worldgenerator.hpp"
+#include "World/zoneaddress.hpp"
+#include "World/zoneindex.hpp"
+#include "World/zonestore.hpp"
+
+struct ToolOptions
+{
+  std::string command = "";
+  std::string directory = "";
+  uint32_t seed = 1;
+  int radius = 4; // Zones generated in each horizontal direction from the origin
+  int bottom = -2; // Lowest row of zones generated
+  int top = 0; // Highest row of zones generated
+  bool caves = true;
+  bool delete_zones = false; // Remove .zn files once they've been packed
+  unsigned int num_threads = 0; // 0 = one per hardware thread
+  unsigned int pyramid_depth = ZonePyramid::default_depth_;
+};
+
+struct ZoneResult
+{
+  std::string path;
+  bool is_uniform;
+  uint16_t voxel_type;
+  unsigned int runs_before;
+  unsigned int runs_after;
+  uint32_t size; // Bytes on disk
+};
+
+
+// Shared by every step, so its threads are only started once
+static WorkerPool workers;
+
+
+// results holds what's known about the loose .zn files - archived zones are described by their archive's header
+static void writeIndex(std::string directory, ZoneAddress zone_address, std::vector<ZoneResult> &results)
+{
+  ZoneIndex zone_index;
+  zone_index.scanDirectory(directory, zone_address.getPathLength());
+  for (unsigned int i = 0; i < results.size(); i++)
+  {
+    const ZoneIndex::Entry *entry = zone_index.find(results[i].path);
+    if (entry != nullptr && entry->isArchived()) continue; // The archived copy wins
+    // One file per zone, so its runs always start at the beginning
+    zone_index.insert(results[i].path, 0, results[i].size, results[i].is_uniform, results[i].voxel_type);
+  }
+  zone_index.writeFile(directory + "/zones.idx");
+  std::cout << "Indexed " << zone_index.size() << " zones, " << zone_index.getNumUniform() << " uniform" << std::endl;
+}
+
+
+// Paths of the files in directory with the given extension and path length
+static std::vector<std::string> findFiles(std::string directory, std::string extension, unsigned int path_length)
+{
+  std::vector<std::string> paths;
+  for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(directory))
+  {
+    if (entry.path().extension() != extension) continue;
+    std::string path = entry.path().stem().string();
+    if (path.size() != path_length || path.find_first_not_of("01234567") != std::string::npos) continue;
+    paths.push_back(path);
+  }
+  return paths;
+}
+
+
+static int generate(ToolOptions &options, ZoneAddress zone_address)
+{
+  std::filesystem::create_directories(options.directory);
+  WorldGenerator generator(options.seed, zone_address);
+  generator.setCaves(options.caves);
+
+  std::vector<std::string> paths;
+  int64_t width = zone_address.getZoneWidth();
+  for (int zone_x = -options.radius; zone_x < options.radius; zone_x++)
+  {
+    for (int zone_y = options.bottom; zone_y <= options.top; zone_y++)
+    {
+      for (int zone_z = -options.radius; zone_z < options.radius; zone_z++)
+      {
+        paths.push_back(zone_address.pathFromPosition(Anthrax::vec3<int64_t>(zone_x*width, zone_y*width, zone_z*width)));
+      }
+    }
+  }
+
+  std::vector<ZoneResult> results(paths.size());
+  std::mutex print_mutex;
+  unsigned int num_done = 0;
+  workers.run(options.num_threads, paths.size(), [&](unsigned int, unsigned int i) {
+      // WorldGenerator only reads its own members, so sharing it between threads is fine
+      VoxelSet voxel_set = generator.generateZone(paths[i]);
+      voxel_set.writeFile(options.directory + "/" + paths[i] + ".zn");
+      results[i] = {paths[i], voxel_set.isUniform(), voxel_set.getVoxelType(), voxel_set.getNumRuns(), voxel_set.getNumRuns(), 6*voxel_set.getNumRuns()};
+      std::lock_guard<std::mutex> lock(print_mutex);
+      std::cout << "\rGenerated " << ++num_done << "/" << paths.size() << " zones" << std::flush;
+    });
+  std::cout << std::endl;
+  writeIndex(options.directory, zone_address, results);
+  std::filesystem::remove(options.directory + "/zones.lod"); // Any left from an old world
+  return 0;
+}
+
+
+// Without rewrite, the zones are only read to rebuild the index
+static int compact(ToolOptions &options, ZoneAddress zone_address, bool rewrite)
+{
+  std::vector<std::string> paths = findFiles(options.directory, ".zn", zone_address.getPathLength());
+  std::vector<std::string> region_paths = findFiles(options.directory, ".rgn", zone_address.getPathLength() - RegionArchive::region_depth_);
+  if (paths.empty() && region_paths.empty())
+  {
+    std::cout << "No zones found in " << options.directory << std::endl;
+    return 1;
+  }
+
+  std::vector<ZoneResult> results(paths.size());
+  workers.run(options.num_threads, paths.size(), [&](unsigned int, unsigned int i) {
+      std::string filepath = options.directory + "/" + paths[i] + ".zn";
+      VoxelSet voxel_set(zone_address.getVoxelsPerZone());
+      voxel_set.readFile(filepath);
+      unsigned int runs_before = voxel_set.getNumRuns();
+      if (rewrite && voxel_set.compact())
+      {
+        // Write next to the original and swap it in so a crash never leaves a half-written zone
+        voxel_set.writeFile(filepath + ".tmp");
+        std::filesystem::rename(filepath + ".tmp", filepath);
+      }
+      results[i] = {paths[i], voxel_set.isUniform(), voxel_set.getVoxelType(), runs_before, voxel_set.getNumRuns(), 6*voxel_set.getNumRuns()};
+    });
+
+  uint64_t runs_before = 0, runs_after = 0;
+  unsigned int num_rewritten = 0;
+  for (unsigned int i = 0; i < results.size(); i++)
+  {
+    runs_before += results[i].runs_before;
+    runs_after += results[i].runs_after;
+    if (results[i].runs_before != results[i].runs_after) num_rewritten++;
+  }
+  if (rewrite) std::cout << "Compacted " << num_rewritten << " of " << results.size() << " zones (" << runs_before << " -> " << runs_after << " runs)" << std::endl;
+
+  if (rewrite && !region_paths.empty())
+  {
+    std::atomic<uint64_t> bytes_reclaimed(0);
+    workers.run(options.num_threads, region_paths.size(), [&](unsigned int, unsigned int i) {
+        bytes_reclaimed += RegionArchive::compact(options.directory + "/" + region_paths[i] + ".rgn");
+      });
+    std::cout << "Compacted " << region_paths.size() << " region archives (" << bytes_reclaimed << " bytes reclaimed)" << std::endl;
+  }
+  writeIndex(options.directory, zone_address, results);
+  return 0;
+}
+
+
+static int pack(ToolOptions &options, ZoneAddress zone_address)
+{
+  std::vector<std::string> paths = findFiles(options.directory, ".zn", zone_address.getPathLength());
+  if (paths.empty())
+  {
+    std::cout << "No zones found in " << options.directory << std::endl;
+    return 1;
+  }
+  // One job per region, so no two threads ever write the same archive
+  std::map<std::string, std::vector<std::string>> regions;
+  for (unsigned int i = 0; i < paths.size(); i++)
+  {
+    regions[RegionArchive::regionPath(paths[i])].push_back(paths[i]);
+  }
+  std::vector<std::string> region_paths;
+  for (std::map<std::string, std::vector<std::string>>::iterator itr = regions.begin(); itr != regions.end(); itr++)
+  {
+    region_paths.push_back(itr->first);
+  }
+
+  std::atomic<bool> failed(false);
+  workers.run(options.num_threads, region_paths.size(), [&](unsigned int, unsigned int i) {
+      const std::vector<std::string> &zone_paths = regions.at(region_paths[i]);
+      std::vector<RegionArchive::ZoneData> zones;
+      for (unsigned int j = 0; j < zone_paths.size(); j++)
+      {
+        VoxelSet voxel_set(zone_address.getVoxelsPerZone());
+        voxel_set.readFile(options.directory + "/" + zone_paths[j] + ".zn");
+        voxel_set.compact();
+        RegionArchive::ZoneData zone = {RegionArchive::slotFromPath(zone_paths[j]), std::vector<char>(), voxel_set.isUniform(), voxel_set.getVoxelType()};
+        if (!zone.is_uniform) zone.data = voxel_set.toBytes();
+        zones.push_back(zone);
+      }
+      if (!RegionArchive::appendZones(options.directory + "/" + region_paths[i] + ".rgn", zones))
+      {
+        std::cout << "Failed to write region " << region_paths[i] << std::endl;
+        failed = true;
+        return;
+      }
+      if (!options.delete_zones) return;
+      for (unsigned int j = 0; j < zone_paths.size(); j++)
+      {
+        std::filesystem::remove(options.directory + "/" + zone_paths[j] + ".zn");
+      }
+    });
+  std::cout << "Packed " << paths.size() << " zones into " << region_paths.size() << " region archives" << std::endl;
+
+  // Every packed zone is archived now, so the index comes straight from the archive headers
+  std::vector<ZoneResult> results;
+  writeIndex(options.directory, zone_address, results);
+  return failed ? 1 : 0;
+}
+
+
+static int buildLod(ToolOptions &options, ZoneAddress zone_address)
+{
+  if (!std::filesystem::exists(options.directory + "/zones.idx"))
+  {
+    std::cout << "No zone index in " << options.directory << " (run index first)" << std::endl;
+    return 1;
+  }
+  ZoneStore zone_store;
+  zone_store.setPyramidDepth(options.pyramid_depth);
+  zone_store.open(options.directory, zone_address);
+  unsigned int num_built = zone_store.buildPyramids();
+  std::cout << "Built " << num_built << " LOD pyramids, " << zone_store.getNumPyramidsRead() << " read from zones.lod" << std::endl;
+  return 0;
+}
+
+
+static bool parseOptions(int argc, char **argv, ToolOptions &options)
+{
+  if (argc < 3) return false;
+  options.command = argv[1];
+  options.directory = argv[2];
+  for (int i = 3; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    bool has_value = (i + 1 < argc);
+    if (arg == "--seed" && has_value) options.seed = std::stoul(argv[++i]);
+    else if (arg == "--radius" && has_value) options.radius = std::stoi(argv[++i]);
+    else if (arg == "--bottom" && has_value) options.bottom = std::stoi(argv[++i]);
+    else if (arg == "--top" && has_value) options.top = std::stoi(argv[++i]);
+    else if (arg == "--no-caves") options.caves = false;
+    else if (arg == "--delete") options.delete_zones = true;
+    else if (arg == "--threads" && has_value) options.num_threads = std::stoi(argv[++i]);
+    else if (arg == "--depth" && has_value) options.pyramid_depth = std::stoi(argv[++i]);
+    else return false;
+  }
+  if (options.num_threads == 0) options.num_threads = std::max(1u, std::thread::hardware_concurrency());
+  return (options.command == "generate" || options.command == "compact" || options.command == "pack" || options.command == "index" || options.command == "lod");
+}
+
+
+int main(int argc, char **argv)
+{
+  ToolOptions options;
+  if (!parseOptions(argc, argv, options))
+  {
+    std::cout << "Usage: roxel_worldgen generate DIR [--seed N] [--radius ZONES] [--bottom ZONE_Y] [--top ZONE_Y] [--no-caves] [--threads N]" << std::endl;
+    std::cout << "       roxel_worldgen compact DIR [--threads N]" << std::endl;
+    std::cout << "       roxel_worldgen pack DIR [--delete] [--threads N]" << std::endl;
+    std::cout << "       roxel_worldgen index DIR [--threads N]" << std::endl;
+    std::cout << "       roxel_worldgen lod DIR [--depth N]" << std::endl;
+    return 1;
+  }
+
+  // Must match World's layout (see World::getZoneAddress)
+  ZoneAddress zone_address(32, 8);
+  if (options.command == "generate") return generate(options, zone_address);
+  if (options.command == "pack") return pack(options, zone_address);
+  if (options.command == "lod") return buildLod(options, zone_address);
+  return compact(options, zone_address, options.command == "compact");
+}